@@ -38,14 +38,29 @@ struct PointLight
 	LightColor lightColor;
 };
 
-uniform vec3 viewPos;
-uniform Material material;
-uniform DirectionalLight dirLights[MAX_DIRLIGHT];
-uniform PointLight pointLights[MAX_POINTLIGHT];
-uniform sampler2D tex;
+// std140 blocks, RendererSystem.hpp mirrors their layout. Frame's matrix
+// is column major like the MVP uniform, so viewProjection * p applies the
+// camera to p as it does on the CPU.
+layout(std140) uniform Frame
+{
+	mat4 viewProjection;
+	vec3 viewPos;
+};
+
+layout(std140) uniform Lights
+{
+	DirectionalLight dirLights[MAX_DIRLIGHT];
+	PointLight pointLights[MAX_POINTLIGHT];
+	uint numDirLights;
+	uint numPointLights;
+};
 
-uniform uint numDirLights;
-uniform uint numPointLights;
+layout(std140) uniform MaterialBlock
+{
+	Material material;
+};
+
+uniform sampler2D tex;
 
 vec3 CalcDirectionalLights(vec3 normal, vec3 viewDir)
 {
@@ -10,13 +10,26 @@ out vec2 uv;
 
 uniform mat4 MVP;
 uniform vec3 roughness;
+// Compact vertices store quantized positions and octahedral normals
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+uniform int octahedralNormal;
+
+vec3 OctahedralDecode(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
 
 void main()
 {
-  	gl_Position = MVP * aPos;
+	vec4 position = vec4(aPos.xyz * positionScale + positionOffset, 1.0);
+  	gl_Position = MVP * position;
 	//gl_Position = aPos;
 	fragPos = gl_Position.xyz;
-    oNormal = aNormal;
+    oNormal = octahedralNormal != 0 ? OctahedralDecode(aNormal.xy) : aNormal;
     uv = texCoord;
 }
-
@@ -18,6 +18,7 @@
 #include "SDL_mouse.h"
 #include "SDL_stdinc.h"
 #include "TestGame.hpp"
+#include "UploadQueue.hpp"
 
 namespace ComponentTypes {
 constexpr uint32_t MAINTYPE = 0;
@@ -25,6 +26,9 @@ constexpr uint32_t MAINTYPE = 0;
 
 struct MainType {};
 
+// Main thread time per frame spent on uploading loaded assets
+constexpr float uploadBudgetMs = 4.f;
+
 Application::Application() {
     height = 900;
     width = 1400;
@@ -115,6 +119,7 @@ uint32_t Application::run() {
 		    break;
 	    }
 	}
+	UploadQueue::GetSingleton()->Drain(uploadBudgetMs);
 	manager->settings->fps = 1000 / ((currentTime - lastTime));
 	manager->update(1 / (currentTime - lastTime));
 	SDL_GL_SwapWindow(window);
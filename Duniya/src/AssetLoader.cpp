@@ -4,15 +4,29 @@
 #include <assimp/scene.h>
 
 #include <Exception.hpp>
+#include <Graphics/MeshOptimizer.hpp>
+#include <Graphics/MeshSimplifier.hpp>
+#include <Graphics/MipGenerator.hpp>
+#include <Graphics/ObjParser.hpp>
+#include <Graphics/VertexFormat.hpp>
+#include <JobSystem.hpp>
+#include <StagingPool.hpp>
+#include <UploadQueue.hpp>
+#include <algorithm>
 #include <array>
+#include <cmath>
 #include <codecvt>
+#include <cstdio>
 #include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <iterator>
 #include <map>
+#include <mutex>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
 
 #include "ECS/GraphicsComponent.hpp"
@@ -20,82 +34,20 @@
 #include "SDL_pixels.h"
 
 void AssetLoader::ObjLoader::SetFile(const std::string& fileName) {
-    fin.open(fileName);
-    if (!fin.is_open()) throw std::runtime_error("file not found");
+    file.reset(new MappedFile(fileName));
+}
+
+void AssetLoader::ObjLoader::SetFile(std::unique_ptr<MappedFile> file) {
+    this->file = std::move(file);
 }
 
 void AssetLoader::ObjLoader::Interpret(std::vector<Vertex>& verticies,
 				       std::vector<uint32_t>& indicies,
 				       DrawPrimitive& drawPrimitive) {
-    uint32_t indexSize = 0;
-    std::string line;
     drawPrimitive = DrawPrimitive::TRIANGLES;
-    while (!fin.eof()) {
-	std::string temp;
-	std::getline(fin, temp);
-	std::istringstream line(temp);
-	if (line.peek() == 'v') {
-	    line.ignore();
-	    if (line.peek() == ' ') {
-		aPos.emplace_back();
-		RepeatInsert(line, aPos.back(), 3);
-		aPos.back().coordinates[3] = 1.f;
-	    } else {
-		if (line.peek() == 't') {
-		    line.ignore();
-		    texCord.emplace_back();
-		    RepeatInsert(line, texCord.back(), 2);
-		} else if (line.peek() == 'n') {
-		    line.ignore();
-		    vNormal.emplace_back();
-		    RepeatInsert(line, vNormal.back(), 3);
-		}
-	    }
-	} else if (line.peek() == 'f') {
-	    line.ignore();
-	    std::array<int, 3> tempFace;
-	    for (int i = 0; i < 3; i++) {
-		tempFace.fill(0);
-		for (int j = 0; j < 3; j++) {
-		    line >> tempFace[j];
-		    tempFace[j] -= 1;
-		    line.ignore();
-		}
-		auto check = repeatCheck.find(tempFace);
-		if (check == repeatCheck.end()) {
-		    verticies.push_back({aPos[tempFace[0]],
-					 vNormal[tempFace[2]],
-					 texCord[tempFace[1]]});
-		    indicies.push_back(indexSize);
-		    repeatCheck.insert(std::make_pair(tempFace, indexSize));
-		    indexSize++;
-		} else
-		    indicies.push_back(check->second);
-	    }
-
-	    if (!line.eof()) {
-		indicies.push_back(indicies[indicies.size() - 2]);
-		indicies.push_back(indicies[indicies.size() - 2]);
-		tempFace.fill(0);
-		for (int j = 0; j < 3; j++) {
-		    line >> tempFace[j];
-		    tempFace[j] -= 1;
-		    line.ignore();
-		}
-		auto check = repeatCheck.find(tempFace);
-		if (check == repeatCheck.end()) {
-		    verticies.push_back({aPos[tempFace[0]],
-					 vNormal[tempFace[2]],
-					 texCord[tempFace[1]]});
-		    indicies.push_back(indexSize);
-		    repeatCheck.insert(std::make_pair(tempFace, indexSize));
-		    indexSize++;
-		} else
-		    indicies.push_back(check->second);
-	    }
-	}
-    }
+    ParseObj(file->GetData(), file->GetSize(), verticies, indicies);
 }
+
 AssetLoader* AssetLoader::singleton = nullptr;
 bool AssetLoader::sdl_initialised = false;
 
@@ -113,89 +65,371 @@ Scene* AssetLoader::GetScene() {
     return scene;
 }
 
-void AssetLoader::LoadObj(std::string filePath, Mesh* mesh) {
+// "DMSH", bump bakedMeshVersion whenever the loader's output changes so
+// stale baked files are rebuilt
+constexpr uint32_t bakedMeshMagic = 0x48534D44;
+constexpr uint32_t bakedMeshVersion = 4;
+constexpr uint64_t hashBlockSize = 1 << 20;
+
+// The mesh is stored whole, its resource indices mean nothing on disk
+struct BakedMeshHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceHash;
+    uint32_t vertexSize;
+    uint32_t meshSize;
+    uint64_t verticiesOffset;
+    uint64_t indiciesOffset;
+    Mesh mesh;
+};
+static_assert(std::is_trivially_copyable<BakedMeshHeader>::value,
+	      "baked header is written as is");
+
+static uint64_t Fnv1a(const char* data, uint64_t size) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (uint64_t i = 0; i < size; i++) {
+	hash ^= (uint8_t)data[i];
+	hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// FNV-1a of every 1 MiB block in parallel, then of the block hashes
+static uint64_t HashFile(const MappedFile& file) {
+    uint64_t blockCount = (file.GetSize() + hashBlockSize - 1) / hashBlockSize;
+    std::vector<uint64_t> hashes(blockCount + 1, file.GetSize());
+    JobSystem::GetSingleton()->ParallelFor(
+	blockCount, 1, [&](uint32_t begin, uint32_t end) {
+	    for (uint32_t i = begin; i < end; i++) {
+		uint64_t offset = i * hashBlockSize;
+		hashes[i] = Fnv1a(file.GetData() + offset,
+				  std::min(hashBlockSize,
+					   file.GetSize() - offset));
+	    }
+	});
+    return Fnv1a((const char*)hashes.data(), hashes.size() * sizeof(uint64_t));
+}
+
+// Owns the vertices of a freshly parsed mesh until the scene drops them
+struct ParsedMesh {
     std::vector<Vertex> verticies;
     std::vector<uint32_t> indicies;
-    ObjLoader objLoader;
-    objLoader.SetFile(filePath);
-    objLoader.Interpret(verticies, indicies, mesh->drawPrimitive);
+    // The vertices in the mesh's vertex format
+    std::vector<uint8_t> encoded;
+};
+
+bool AssetLoader::LoadBakedMesh(const std::string& bakedPath,
+				uint64_t sourceHash, MeshData& data) {
+    std::shared_ptr<MappedFile> baked;
+    try {
+	baked = std::make_shared<MappedFile>(
+	    bakedPath, MappedFile::Access::COPY_ON_WRITE);
+    } catch (CException&) {
+	return false;
+    }
+    if (baked->GetSize() < sizeof(BakedMeshHeader)) return false;
+    BakedMeshHeader header;
+    memcpy(&header, baked->GetData(), sizeof(BakedMeshHeader));
+    if (header.magic != bakedMeshMagic || header.version != bakedMeshVersion ||
+	header.sourceHash != sourceHash || header.meshSize != sizeof(Mesh) ||
+	header.vertexSize != GetVertexSize(header.mesh.vertexFormat))
+	return false;
+    uint64_t verticiesSize = (uint64_t)header.mesh.vertexCount *
+			     GetVertexSize(header.mesh.vertexFormat);
+    uint64_t indiciesSize = (uint64_t)header.mesh.indexCount * sizeof(uint32_t);
+    if (header.verticiesOffset + verticiesSize > baked->GetSize() ||
+	header.indiciesOffset + indiciesSize > baked->GetSize())
+	return false;
+    // A stale or damaged header mustn't send draws past the index buffer
+    if (header.mesh.lodCount > maxMeshLods) return false;
+    for (uint32_t i = 0; i < header.mesh.lodCount; i++)
+	if ((uint64_t)header.mesh.lods[i].indexOffset +
+		header.mesh.lods[i].indexCount >
+	    header.mesh.indexCount)
+	    return false;
+
+    // Resources point into the mapping, which lives as long as they do
+    uint8_t* bytes = (uint8_t*)baked->GetData();
+    data.mesh = header.mesh;
+    data.verticies = bytes + header.verticiesOffset;
+    data.indicies = header.mesh.indexCount != 0
+			? bytes + header.indiciesOffset
+			: nullptr;
+    data.owner = baked;
+    return true;
+}
+
+void AssetLoader::WriteBakedMesh(const std::string& bakedPath,
+				 uint64_t sourceHash, const MeshData& data) {
+    BakedMeshHeader header = {};
+    header.magic = bakedMeshMagic;
+    header.version = bakedMeshVersion;
+    header.sourceHash = sourceHash;
+    header.vertexSize = GetVertexSize(data.mesh.vertexFormat);
+    header.meshSize = sizeof(Mesh);
+    header.mesh = data.mesh;
+    header.verticiesOffset = sizeof(BakedMeshHeader);
+    header.indiciesOffset = header.verticiesOffset +
+			    (uint64_t)header.vertexSize * data.mesh.vertexCount;
+
+    // Written aside and renamed so a crash never leaves a torn baked file
+    std::string tempPath = bakedPath + ".tmp";
+    {
+	std::ofstream fout(tempPath, std::ios::binary | std::ios::trunc);
+	fout.write((const char*)&header, sizeof(BakedMeshHeader));
+	fout.write((const char*)data.verticies,
+		   (uint64_t)header.vertexSize * data.mesh.vertexCount);
+	fout.write((const char*)data.indicies,
+		   sizeof(uint32_t) * data.mesh.indexCount);
+	if (!fout) {
+	    fout.close();
+	    std::remove(tempPath.c_str());
+	    throw CException(__LINE__, __FILE__, "File Exception",
+			     "Couldn't write the baked mesh " + bakedPath);
+	}
+    }
+    if (std::rename(tempPath.c_str(), bakedPath.c_str()) != 0) {
+	std::remove(tempPath.c_str());
+	throw CException(__LINE__, __FILE__, "File Exception",
+			 "Couldn't replace the baked mesh " + bakedPath);
+    }
+}
+
+AssetLoader::MeshData AssetLoader::DecodeObj(const std::string& filePath) {
+    std::unique_ptr<MappedFile> source(new MappedFile(filePath));
+    uint64_t sourceHash = HashFile(*source);
+    std::string bakedPath = filePath + ".dmesh";
+    MeshData data;
+    if (LoadBakedMesh(bakedPath, sourceHash, data)) return data;
 
-    mesh->vertexCount = verticies.size();
-    auto vertexData = new Vertex[mesh->vertexCount];
-    if (indicies.size() == verticies.size()) {
-	mesh->indexCount = 0;
+    auto parsed = std::make_shared<ParsedMesh>();
+    data.mesh = Mesh();
+    ObjLoader objLoader;
+    objLoader.SetFile(std::move(source));
+    objLoader.Interpret(parsed->verticies, parsed->indicies,
+			data.mesh.drawPrimitive);
+    data.mesh.vertexCount = parsed->verticies.size();
+    // Every vertex used once in order, drawn without an index buffer
+    if (parsed->indicies.size() == parsed->verticies.size()) {
+	data.mesh.indexCount = 0;
     } else {
-	mesh->indexCount = indicies.size();
-	auto indiciesData = new uint32_t[mesh->indexCount];
-	std::copy(indicies.begin(), indicies.end(), indiciesData);
-	mesh->indiciesIndex = scene->resourceBank->Push_Back(
-	    reinterpret_cast<uint8_t*>(indiciesData),
-	    sizeof(uint32_t) * mesh->indexCount);
+	data.mesh.indexCount = parsed->indicies.size();
+	// Done once here, the bake keeps the optimized order
+	if (data.mesh.drawPrimitive == DrawPrimitive::TRIANGLES) {
+	    data.mesh.vertexCount = OptimizeMesh(
+		parsed->verticies.data(), sizeof(Vertex),
+		parsed->indicies.data(), data.mesh.indexCount,
+		data.mesh.vertexCount);
+	    parsed->verticies.resize(data.mesh.vertexCount);
+	    GenerateMeshLods(parsed->verticies.data(), data.mesh.vertexCount,
+			     parsed->indicies, data.mesh);
+	}
+    }
+    // Kept in the smallest vertex layout that holds the mesh intact
+    auto format =
+	SelectVertexFormat(parsed->verticies.data(), data.mesh.vertexCount);
+    parsed->encoded.resize((size_t)GetVertexSize(format) *
+			   data.mesh.vertexCount);
+    EncodeVertices(parsed->verticies.data(), data.mesh.vertexCount, format,
+		   data.mesh, parsed->encoded.data());
+    parsed->verticies = std::vector<Vertex>();
+    data.verticies = parsed->encoded.data();
+    data.indicies = data.mesh.indexCount != 0
+			? (uint8_t*)parsed->indicies.data()
+			: nullptr;
+    data.owner = parsed;
+    // The bake only saves parsing next time, the mesh is fine without it
+    try {
+	WriteBakedMesh(bakedPath, sourceHash, data);
+    } catch (const CException& exception) {
+	std::cout << "Can't bake " << filePath << std::endl;
+	std::cout << "Reason given: " << exception.what() << std::endl;
     }
-    std::copy(verticies.begin(), verticies.end(), vertexData);
-    mesh->verticiesIndex =
-	scene->resourceBank->Push_Back(reinterpret_cast<uint8_t*>(vertexData),
-				       sizeof(Vertex) * mesh->vertexCount);
-}
-
-Texture::Format GetFormat(uint32_t sdlFormat) {
-    Texture::Format ans;
-    switch (sdlFormat) {
-	case SDL_PIXELFORMAT_RGB888:
-	    ans = Texture::RGB;
-	    break;
-	case SDL_PIXELFORMAT_RGBA8888:
-	    ans = Texture::RGBA;
-	    break;
-	case SDL_PIXELFORMAT_INDEX8:
-	    ans = Texture::R;
-	    break;
-	default:
-	    throw std::runtime_error("We don't support that image format");
-    };
-    return ans;
-}
-
-void AssetLoader::LoadTextureFile(std::string hPath, Texture* texture) {
-    if (!sdl_initialised) {
+    return data;
+}
+
+void AssetLoader::CommitMesh(Scene* scene, const MeshData& data, Mesh* mesh) {
+    *mesh = data.mesh;
+    mesh->verticiesIndex = scene->resourceBank->Push_Back(
+	data.verticies,
+	GetVertexSize(data.mesh.vertexFormat) * data.mesh.vertexCount,
+	data.owner);
+    if (mesh->indexCount != 0)
+	mesh->indiciesIndex = scene->resourceBank->Push_Back(
+	    data.indicies, sizeof(uint32_t) * data.mesh.indexCount,
+	    data.owner);
+}
+
+void AssetLoader::LoadObj(std::string filePath, Mesh* mesh) {
+    CommitMesh(GetScene(), DecodeObj(filePath), mesh);
+}
+
+static std::once_flag sdlImageInit;
+
+AssetLoader::TextureData AssetLoader::DecodeTexture(
+    const std::string& filePath, const std::vector<char>& contents) {
+    std::call_once(sdlImageInit, []() {
 	uint32_t flags = IMG_INIT_PNG | IMG_INIT_JPG;
 	uint32_t tempFlag = IMG_Init(flags);
 	if (tempFlag != flags) {
 	    std::cout << "Can't initalize on sdl image " << std::endl;
 	    std::cout << "Reason given: " << IMG_GetError() << std::endl;
 	}
+	sdl_initialised = true;
+    });
+    SDL_Surface* loadedImage = IMG_Load_RW(
+	SDL_RWFromConstMem(contents.data(), contents.size()), 1);
+    if (loadedImage == nullptr)
+	throw CException(__LINE__, __FILE__, "Texture Loader",
+			 "Can't load " + filePath + ": " + IMG_GetError());
+
+    TextureData data;
+    data.texture = Texture();
+    data.texture.width = loadedImage->w;
+    data.texture.height = loadedImage->h;
+    data.texture.format = Texture::RGBA;
+    data.texture.colorSpace = Texture::SRGB;
+    data.texture.mipLevels =
+	GetMipLevelCount(data.texture.width, data.texture.height);
+    // RGBA32 is R,G,B,A in memory whatever the endianness, rows are packed
+    // tightly into the staging buffer and the mips follow level 0
+    uint32_t rowSize = data.texture.width * 4;
+    data.size = GetMipChainSize(data.texture);
+    auto pixels = StagingPool::GetSingleton()->Acquire(data.size);
+    SDL_LockSurface(loadedImage);
+    int converted = SDL_ConvertPixels(
+	loadedImage->w, loadedImage->h, loadedImage->format->format,
+	loadedImage->pixels, loadedImage->pitch, SDL_PIXELFORMAT_RGBA32,
+	pixels.get(), rowSize);
+    SDL_UnlockSurface(loadedImage);
+    if (converted != 0) {
+	// Paletted images can't be converted in place, they go through a
+	// converted surface instead
+	SDL_Surface* formattedImage =
+	    SDL_ConvertSurfaceFormat(loadedImage, SDL_PIXELFORMAT_RGBA32, 0);
+	SDL_FreeSurface(loadedImage);
+	if (formattedImage == nullptr)
+	    throw CException(
+		__LINE__, __FILE__, "Texture Loader",
+		"Can't convert " + filePath + ": " + IMG_GetError());
+	SDL_LockSurface(formattedImage);
+	for (uint32_t row = 0; row < data.texture.height; row++)
+	    memcpy(pixels.get() + (size_t)row * rowSize,
+		   (uint8_t*)formattedImage->pixels +
+		       (size_t)row * formattedImage->pitch,
+		   rowSize);
+	SDL_UnlockSurface(formattedImage);
+	loadedImage = formattedImage;
     }
-    uint32_t pixelFormat = SDL_PIXELFORMAT_RGBA8888;
-    SDL_Surface* loadedImage = IMG_Load(hPath.c_str());
-    if (loadedImage == nullptr) {
-	std::cout << "Can't load the image \n "
-		  << "Reason Given: " << IMG_GetError() << std::endl;
-    }
-    SDL_Surface* formattedImage;
-    formattedImage = SDL_ConvertSurfaceFormat(loadedImage, pixelFormat, 0);
-    if (formattedImage == NULL)
-	std::cout << "Can't convert to different format \n"
-		  << "Reason Given: " << IMG_GetError() << std::endl;
-    SDL_LockSurface(formattedImage);
-    texture->width = formattedImage->w;
-    texture->height = formattedImage->h;
-
-    texture->data = scene->resourceBank->Push_Back(
-	reinterpret_cast<uint8_t*>(formattedImage->pixels),
-	texture->width * texture->height * formattedImage->pitch);
-    if (texture == nullptr)
-	std::cout << "Texture is nullptr in the function " << std::endl;
+    SDL_FreeSurface(loadedImage);
+    GenerateMips(data.texture, pixels.get(), MipFilter::KAISER);
+    data.pixels = pixels.get();
+    data.owner = pixels;
+    return data;
+}
+
+void AssetLoader::CommitTexture(Scene* scene, const TextureData& data,
+				Texture* texture) {
+    *texture = data.texture;
+    texture->data =
+	scene->resourceBank->Push_Back(data.pixels, data.size, data.owner);
+}
+
+void AssetLoader::LoadTextureFile(std::string filePath, Texture* texture) {
+    auto contents = FileReader::GetSingleton()->Read(filePath).get();
+    CommitTexture(GetScene(), DecodeTexture(filePath, *contents), texture);
 }
 
 void AssetLoader::LoadTextFile(std::string filePath, std::string& source) {
-    std::ifstream fin;
-    fin.open(filePath.c_str(), std::ios::in);
-    if (!fin)
-	throw CException(
-	    __LINE__, __FILE__, "Text file Loader",
-	    std::string("Couldn't open the file path: ") + filePath);
-    std::stringstream ss;
-    ss << fin.rdbuf();
-    source = ss.str();
+    source = LoadTextFileAsync(filePath).get();
+}
+
+template <typename T, typename Data>
+void AssetLoader::Deliver(Scene* scene, ComponentType componentType,
+			  uint32_t entity, std::function<Data()> decode,
+			  void (*commit)(Scene*, const Data&, T*),
+			  std::shared_ptr<std::promise<void>> promise) {
+    std::shared_ptr<Data> data;
+    try {
+	data = std::make_shared<Data>(decode());
+    } catch (...) {
+	promise->set_exception(std::current_exception());
+	return;
+    }
+    // Scenes are only touched from the main thread
+    UploadQueue::GetSingleton()->Push([=]() {
+	try {
+	    auto components = scene->GetEntity(entity);
+	    if (components == nullptr)
+		throw CException(__LINE__, __FILE__, "AssetLoader",
+				 "entity " + std::to_string(entity) +
+				     " is gone");
+	    T* component = components->Get<T>(componentType);
+	    if (component == nullptr)
+		component = components->Emplace<T>(componentType);
+	    commit(scene, *data, component);
+	    promise->set_value();
+	} catch (...) {
+	    promise->set_exception(std::current_exception());
+	}
+    });
 }
 
+std::shared_future<void> AssetLoader::LoadObjAsync(std::string filePath,
+						   uint32_t entity) {
+    Scene* scene = GetScene();
+    auto promise = std::make_shared<std::promise<void>>();
+    // OBJ files are mapped rather than read, the parser works in place
+    JobSystem::GetSingleton()->Push([=]() {
+	Deliver<Mesh, MeshData>(
+	    scene, ComponentTypes::MESH, entity,
+	    [filePath]() { return DecodeObj(filePath); }, &CommitMesh,
+	    promise);
+    });
+    return promise->get_future().share();
+}
+
+std::shared_future<void> AssetLoader::LoadTextureFileAsync(
+    std::string filePath, uint32_t entity) {
+    Scene* scene = GetScene();
+    auto promise = std::make_shared<std::promise<void>>();
+    FileReader::GetSingleton()->Read(
+	filePath,
+	[=](FileReader::FileBuffer contents, std::exception_ptr error) {
+	    if (error != nullptr) return promise->set_exception(error);
+	    JobSystem::GetSingleton()->Push([=]() {
+		Deliver<Texture, TextureData>(
+		    scene, ComponentTypes::TEXTURE, entity,
+		    [&]() { return DecodeTexture(filePath, *contents); },
+		    &CommitTexture, promise);
+	    });
+	});
+    return promise->get_future().share();
+}
+
+std::vector<std::shared_future<void>> AssetLoader::LoadTextureFilesAsync(
+    const std::vector<std::string>& filePaths,
+    const std::vector<uint32_t>& entities) {
+    if (filePaths.size() != entities.size())
+	throw CException(__LINE__, __FILE__, "AssetLoader",
+			 "every texture needs an entity");
+    // Every file is read and decoded on its own, so the decodes overlap
+    // with each other and with the reads still in flight
+    std::vector<std::shared_future<void>> futures;
+    futures.reserve(filePaths.size());
+    for (size_t i = 0; i < filePaths.size(); i++)
+	futures.push_back(LoadTextureFileAsync(filePaths[i], entities[i]));
+    return futures;
+}
+
+std::shared_future<std::string> AssetLoader::LoadTextFileAsync(
+    std::string filePath) {
+    auto promise = std::make_shared<std::promise<std::string>>();
+    FileReader::GetSingleton()->Read(
+	filePath,
+	[=](FileReader::FileBuffer contents, std::exception_ptr error) {
+	    if (error != nullptr) return promise->set_exception(error);
+	    promise->set_value(std::string(contents->begin(), contents->end()));
+	});
+    return promise->get_future().share();
+}
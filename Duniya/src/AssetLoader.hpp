@@ -2,49 +2,89 @@
 #include <ECS/CommonComponent.hpp>
 #include <ECS/ECS.hpp>
 #include <ECS/GraphicsComponent.hpp>
+#include <FileReader.hpp>
+#include <MappedFile.hpp>
 #include <fstream>
+#include <functional>
+#include <future>
 #include <iostream>
-#include <map>
-#include <sstream>
+#include <memory>
 #include <string>
+#include <vector>
 
 class AssetLoader {
    private:
     AssetLoader() = default;
 
    private:
+    // Maps the file and hands it to ParseObj
     class ObjLoader {
        private:
-	template <typename T>
-	void RepeatInsert(std::istringstream& line, T& var, uint32_t count) {
-	    for (int i = 0; i < count; i++) line >> var;
-	}
-
-       private:
-	std::ifstream fin;
-	std::string lineStore;
-	std::vector<Vect4> aPos;
-	std::vector<Vect3> vNormal;
-	std::vector<Vect2> texCord;
-	std::map<std::array<int, 3>, int> repeatCheck;
+	std::unique_ptr<MappedFile> file;
 
        public:
 	void SetFile(const std::string& fileName);
+	void SetFile(std::unique_ptr<MappedFile> file);
 	void Interpret(std::vector<Vertex>& vertex,
 		       std::vector<uint32_t>& indicies,
 		       DrawPrimitive& drawPrimitve);
     };
 
+    // Decoded assets waiting to be handed to a scene, their data lives
+    // inside owner
+    struct MeshData {
+	Mesh mesh;
+	uint8_t* verticies;
+	uint8_t* indicies;
+	std::shared_ptr<void> owner;
+    };
+    struct TextureData {
+	Texture texture;
+	uint8_t* pixels;
+	size_t size;
+	std::shared_ptr<void> owner;
+    };
+
    public:
     static AssetLoader* init();
     static AssetLoader* GetSingleton();
+    // The parsed mesh is baked next to the source as <filePath>.dmesh and
+    // mapped from there as long as the source's contents don't change
     void LoadObj(std::string filePath, Mesh* mesh);
     void LoadTextureFile(std::string filePath, Texture* texture);
     void LoadTextFile(std::string filePath, std::string& fileSource);
+    // Decode on the job system, the result reaches the entity's component
+    // (emplaced if missing) through the UploadQueue. The future is ready
+    // once the component holds the asset, so don't wait on it from the
+    // main thread before the queue is drained.
+    std::shared_future<void> LoadObjAsync(std::string filePath,
+					  uint32_t entity);
+    std::shared_future<void> LoadTextureFileAsync(std::string filePath,
+						  uint32_t entity);
+    // Decodes the textures concurrently, filePaths[i] goes to entities[i]
+    std::vector<std::shared_future<void>> LoadTextureFilesAsync(
+	const std::vector<std::string>& filePaths,
+	const std::vector<uint32_t>& entities);
+    std::shared_future<std::string> LoadTextFileAsync(std::string filePath);
     Scene* scene;
 
    private:
     Scene* GetScene();
+    template <typename T, typename Data>
+    static void Deliver(Scene* scene, ComponentType componentType,
+			uint32_t entity, std::function<Data()> decode,
+			void (*commit)(Scene*, const Data&, T*),
+			std::shared_ptr<std::promise<void>> promise);
+    static MeshData DecodeObj(const std::string& filePath);
+    static TextureData DecodeTexture(const std::string& filePath,
+				     const std::vector<char>& contents);
+    static void CommitMesh(Scene* scene, const MeshData& data, Mesh* mesh);
+    static void CommitTexture(Scene* scene, const TextureData& data,
+			      Texture* texture);
+    static bool LoadBakedMesh(const std::string& bakedPath,
+			      uint64_t sourceHash, MeshData& data);
+    static void WriteBakedMesh(const std::string& bakedPath,
+			       uint64_t sourceHash, const MeshData& data);
 
    public:
     static AssetLoader* singleton;
@@ -0,0 +1,206 @@
+#include "BlockStream.hpp"
+
+#include <Exception.hpp>
+#include <JobSystem.hpp>
+#include <algorithm>
+#include <cstring>
+
+#ifdef DUNIYA_HAS_LZ4
+#include <lz4.h>
+#endif
+#ifdef DUNIYA_HAS_ZSTD
+#include <zstd.h>
+#endif
+
+bool BlockWriter::IsCodecAvailable(BlockCodec codec) {
+    switch (codec) {
+	case BlockCodec::NONE:
+	    return true;
+	case BlockCodec::LZ4:
+#ifdef DUNIYA_HAS_LZ4
+	    return true;
+#else
+	    return false;
+#endif
+	case BlockCodec::ZSTD:
+#ifdef DUNIYA_HAS_ZSTD
+	    return true;
+#else
+	    return false;
+#endif
+    };
+    return false;
+}
+
+// Returns the compressed size or 0 when the block should be stored raw
+static uint32_t CompressBlock(const BlockOptions& options,
+			      [[maybe_unused]] const char* src,
+			      [[maybe_unused]] uint32_t srcSize,
+			      [[maybe_unused]] std::string& dst) {
+    switch (options.codec) {
+#ifdef DUNIYA_HAS_LZ4
+	case BlockCodec::LZ4: {
+	    dst.resize(LZ4_compressBound(srcSize));
+	    int size =
+		LZ4_compress_default(src, &dst[0], srcSize, dst.size());
+	    return size > 0 ? size : 0;
+	}
+#endif
+#ifdef DUNIYA_HAS_ZSTD
+	case BlockCodec::ZSTD: {
+	    dst.resize(ZSTD_compressBound(srcSize));
+	    size_t size = ZSTD_compress(&dst[0], dst.size(), src, srcSize,
+					options.level);
+	    return ZSTD_isError(size) ? 0 : size;
+	}
+#endif
+	default:
+	    return 0;
+    };
+}
+
+void BlockWriter::Write(std::ostream& os, const std::string& raw,
+			const BlockOptions& options) {
+    BlockHeader header;
+    header.blockSize = std::max(options.blockSize, 1u);
+    header.rawSize = raw.size();
+    header.blockCount =
+	(header.rawSize + header.blockSize - 1) / header.blockSize;
+
+    std::vector<BlockEntry> entries(header.blockCount);
+    std::vector<std::string> compressed(header.blockCount);
+    bool compress = options.codec != BlockCodec::NONE &&
+		    IsCodecAvailable(options.codec);
+
+    JobSystem::GetSingleton()->ParallelFor(
+	header.blockCount, 1, [&](uint32_t begin, uint32_t end) {
+	    for (uint32_t i = begin; i < end; i++) {
+		auto& entry = entries[i];
+		uint64_t rawOffset = (uint64_t)i * header.blockSize;
+		entry.rawSize =
+		    std::min<uint64_t>(header.blockSize, raw.size() - rawOffset);
+		entry.codec = BlockCodec::NONE;
+		entry.reserved = 0;
+		entry.compressedSize = entry.rawSize;
+		if (!compress) continue;
+		uint32_t size = CompressBlock(options, raw.data() + rawOffset,
+					      entry.rawSize, compressed[i]);
+		if (size != 0 && size < entry.rawSize) {
+		    entry.codec = options.codec;
+		    entry.compressedSize = size;
+		}
+	    }
+	});
+
+    uint64_t offset = 0;
+    for (auto& entry : entries) {
+	entry.offset = offset;
+	offset += entry.compressedSize;
+    }
+    os.write((char*)&header, sizeof(BlockHeader));
+    os.write((char*)entries.data(), sizeof(BlockEntry) * entries.size());
+    for (uint32_t i = 0; i < header.blockCount; i++) {
+	if (entries[i].codec == BlockCodec::NONE)
+	    os.write(raw.data() + (uint64_t)i * header.blockSize,
+		     entries[i].rawSize);
+	else
+	    os.write(compressed[i].data(), entries[i].compressedSize);
+    }
+}
+
+BlockReader::BlockReader(std::istream& is) : is(&is) {
+    is.read((char*)&header, sizeof(BlockHeader));
+    entries.resize(header.blockCount);
+    is.read((char*)entries.data(), sizeof(BlockEntry) * entries.size());
+    if (!is)
+	throw CException(__LINE__, __FILE__, "BlockReader",
+			 "block index is truncated");
+    dataStart = is.tellg();
+    // Every block but the last one holds exactly blockSize raw bytes
+    uint64_t dataSize = 0, rawSize = 0;
+    for (uint32_t i = 0; i < header.blockCount; i++) {
+	auto& entry = entries[i];
+	bool fullBlock = entry.rawSize == header.blockSize;
+	if (entry.offset != dataSize || entry.rawSize > header.blockSize ||
+	    (!fullBlock && i + 1 != header.blockCount))
+	    throw CException(__LINE__, __FILE__, "BlockReader",
+			     "block index is corrupted");
+	dataSize += entry.compressedSize;
+	rawSize += entry.rawSize;
+    }
+    if (rawSize != header.rawSize)
+	throw CException(__LINE__, __FILE__, "BlockReader",
+			 "block index is corrupted");
+    dataEnd = dataStart + (std::streamoff)dataSize;
+}
+
+uint32_t BlockReader::GetBlockCount() const { return header.blockCount; }
+
+uint64_t BlockReader::GetRawSize() const { return header.rawSize; }
+
+const BlockEntry& BlockReader::GetEntry(uint32_t block) const {
+    return entries.at(block);
+}
+
+void BlockReader::Decompress(const BlockEntry& entry, const char* src,
+			     char* dst) {
+    bool decompressed = false;
+    switch (entry.codec) {
+	case BlockCodec::NONE:
+	    // src only holds compressedSize bytes
+	    decompressed = entry.compressedSize == entry.rawSize;
+	    if (decompressed) memcpy(dst, src, entry.rawSize);
+	    break;
+#ifdef DUNIYA_HAS_LZ4
+	case BlockCodec::LZ4:
+	    decompressed = LZ4_decompress_safe(src, dst, entry.compressedSize,
+					       entry.rawSize) ==
+			   (int)entry.rawSize;
+	    break;
+#endif
+#ifdef DUNIYA_HAS_ZSTD
+	case BlockCodec::ZSTD:
+	    decompressed = ZSTD_decompress(dst, entry.rawSize, src,
+					   entry.compressedSize) ==
+			   entry.rawSize;
+	    break;
+#endif
+	default:
+	    throw CException(__LINE__, __FILE__, "BlockReader",
+			     "block codec " +
+				 std::to_string((uint32_t)entry.codec) +
+				 " is not supported by this build");
+    };
+    if (!decompressed)
+	throw CException(__LINE__, __FILE__, "BlockReader",
+			 "couldn't decompress block");
+}
+
+void BlockReader::ReadBlock(uint32_t block, std::string& out) {
+    auto& entry = GetEntry(block);
+    std::string compressed(entry.compressedSize, '\0');
+    is->seekg(dataStart + (std::streamoff)entry.offset);
+    is->read(&compressed[0], entry.compressedSize);
+    if (!*is)
+	throw CException(__LINE__, __FILE__, "BlockReader",
+			 "block data is truncated");
+    out.resize(entry.rawSize);
+    Decompress(entry, compressed.data(), &out[0]);
+}
+
+void BlockReader::ReadAll(std::string& out) {
+    std::string compressed(dataEnd - dataStart, '\0');
+    is->seekg(dataStart);
+    is->read(&compressed[0], compressed.size());
+    if (!*is)
+	throw CException(__LINE__, __FILE__, "BlockReader",
+			 "block data is truncated");
+    out.resize(header.rawSize);
+    JobSystem::GetSingleton()->ParallelFor(
+	header.blockCount, 1, [&](uint32_t begin, uint32_t end) {
+	    for (uint32_t i = begin; i < end; i++) {
+		Decompress(entries[i], compressed.data() + entries[i].offset,
+			   &out[0] + (uint64_t)i * header.blockSize);
+	    }
+	});
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+enum class BlockCodec : uint32_t { NONE = 0, LZ4 = 1, ZSTD = 2 };
+
+struct BlockOptions {
+    BlockCodec codec = BlockCodec::LZ4;
+    uint32_t blockSize = 1u << 18;
+    // Only used by ZSTD
+    int32_t level = 3;
+};
+
+// A section is stored as a header, an index with one entry per block and the
+// blocks themselves. The index lets a reader seek to any block without
+// touching the ones before it.
+struct BlockHeader {
+    uint32_t blockCount;
+    uint32_t blockSize;
+    uint64_t rawSize;
+};
+
+struct BlockEntry {
+    uint64_t offset;
+    uint32_t compressedSize;
+    uint32_t rawSize;
+    BlockCodec codec;
+    uint32_t reserved;
+};
+
+class BlockWriter {
+   public:
+    // Blocks are compressed in parallel on the job system. A codec which was
+    // not compiled in, or a block which doesn't shrink, is stored as NONE.
+    static void Write(std::ostream& os, const std::string& raw,
+		      const BlockOptions& options);
+    static bool IsCodecAvailable(BlockCodec codec);
+};
+
+class BlockReader {
+   public:
+    BlockReader(std::istream& is);
+    uint32_t GetBlockCount() const;
+    uint64_t GetRawSize() const;
+    const BlockEntry& GetEntry(uint32_t block) const;
+    // Seeks to a single block and decompresses it
+    void ReadBlock(uint32_t block, std::string& out);
+    // Reads every block and decompresses them in parallel on the job
+    // system, leaves the stream at the end of the section
+    void ReadAll(std::string& out);
+
+   private:
+    static void Decompress(const BlockEntry& entry, const char* src,
+			   char* dst);
+
+   private:
+    std::istream* is;
+    BlockHeader header;
+    std::vector<BlockEntry> entries;
+    std::streampos dataStart;
+    std::streampos dataEnd;
+};
@@ -1,5 +1,7 @@
 #pragma once
+#include <Math/FixedMat.hpp>
 #include <Math/Mat.hpp>
+#include <Math/Quat.hpp>
 #include <Math/Vect2.hpp>
 #include <Math/Vect3.hpp>
 #include <Math/Vect4.hpp>
@@ -10,9 +12,18 @@ struct Transform {
     Vect3 rotation;
 };
 
+// Optional next to a Transform, rotates the entity instead of
+// Transform::rotation
+struct Orientation {
+    Quat rotation;
+};
+
 namespace ComponentTypes {
 constexpr uint32_t POINTLIGHT = 7;
 constexpr uint32_t DIRLIGHT = 8;
+constexpr uint32_t ORIENTATION = 10;
+constexpr uint32_t VIEWPORT = 11;
+constexpr uint32_t CAMERAMATRICES = 12;
 };  // namespace ComponentTypes
 
 struct LightColor {
@@ -37,35 +48,70 @@ struct Camera {
     Vect3 lookAt;
 };
 
-inline Mat GetRotationMatrix(Vect3 rotation) {
-    Mat mat = DefaultMatrix::generateIdentityMatrix({4, 4});
+// Optional next to a Camera, the part of the window it draws to in
+// fractions of the window from the bottom left. Every camera with one is
+// drawn each frame, lowest order first, the viewports shouldn't overlap.
+// Without any the scene's main camera gets the whole window.
+struct Viewport {
+    Vect2 offset;
+    Vect2 size = Vect2(1.f, 1.f);
+    int32_t order = 0;
+};
+
+// Runtime only, the renderer keeps one next to each camera it draws and
+// rebuilds the matrices only when an input they were built from changes.
+// viewProjection is view * projection like the matrices are laid out.
+struct CameraMatrices {
+    Mat4 view;
+    Mat4 projection;
+    Mat4 viewProjection;
+    Mat4 inverseViewProjection;
+    // The inputs the matrices were built from
+    Transform transform;
+    Camera camera;
+    float aspectRatio = 0.f;
+    bool built = false;
+};
+
+inline Mat4 GetRotationMatrix(Vect3 rotation) {
+    Mat4 mat = DefaultMatrix::generateIdentityMatrix<4>();
     if (rotation.x != 0)
-	mat *= DefaultMatrix::generateRollMatrix({4, 4}, rotation.x);
+	mat *= DefaultMatrix::generateRollMatrix<4>(rotation.x);
     if (rotation.y != 0)
-	mat *= DefaultMatrix::generatePitchMatrix({4, 4}, rotation.y);
+	mat *= DefaultMatrix::generatePitchMatrix<4>(rotation.y);
     if (rotation.z != 0)
-	mat *= DefaultMatrix::generateYawMatrix({4, 4}, rotation.z);
+	mat *= DefaultMatrix::generateYawMatrix<4>(rotation.z);
     return mat;
 }
 
-inline Mat ConvertTranforToMatrix(Transform& transform) {
-    Mat mat({4, 4});
-    mat = {transform.scale.x,
-	   .0f,
-	   .0f,
-	   transform.pos.x,
-	   .0f,
-	   transform.scale.y,
-	   .0f,
-	   transform.pos.y,
-	   .0f,
-	   .0f,
-	   transform.scale.z,
-	   transform.pos.z,
-	   .0f,
-	   .0f,
-	   .0f,
-	   1.0f};
+inline Mat4 ConvertTranforToMatrix(Transform& transform) {
+    Mat4 mat = {transform.scale.x,
+		.0f,
+		.0f,
+		transform.pos.x,
+		.0f,
+		transform.scale.y,
+		.0f,
+		transform.pos.y,
+		.0f,
+		.0f,
+		transform.scale.z,
+		transform.pos.z,
+		.0f,
+		.0f,
+		.0f,
+		1.0f};
     mat *= GetRotationMatrix(transform.rotation);
     return mat;
 }
+
+inline Mat4 ConvertTranforToMatrix(Transform& transform,
+				   const Orientation& orientation) {
+    auto mat = orientation.rotation.ToMat4();
+    for (uint32_t i = 0; i < 3; i++) {
+	for (uint32_t j = 0; j < 3; j++)
+	    mat.Get(i, j) *= transform.scale.coordinates[i];
+	mat.Get(i, 3) = transform.pos.coordinates[i];
+    }
+    return mat;
+}
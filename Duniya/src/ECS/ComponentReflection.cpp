@@ -0,0 +1,52 @@
+#include "ComponentReflection.hpp"
+
+#include <Exception.hpp>
+
+#include "CommonComponent.hpp"
+#include "GraphicsComponent.hpp"
+
+DUNIYA_REGISTER_COMPONENT(Transform, ComponentTypes::TRANSFORM);
+DUNIYA_REGISTER_COMPONENT(Mesh, ComponentTypes::MESH);
+DUNIYA_REGISTER_COMPONENT(Texture, ComponentTypes::TEXTURE);
+DUNIYA_REGISTER_COMPONENT(Material, ComponentTypes::MATERIAL);
+DUNIYA_REGISTER_COMPONENT(Camera, ComponentTypes::CAMERA);
+DUNIYA_REGISTER_COMPONENT(PointLight, ComponentTypes::POINTLIGHT);
+DUNIYA_REGISTER_COMPONENT(DirectionalLight, ComponentTypes::DIRLIGHT);
+DUNIYA_REGISTER_COMPONENT(Orientation, ComponentTypes::ORIENTATION);
+DUNIYA_REGISTER_COMPONENT(Viewport, ComponentTypes::VIEWPORT);
+
+// Registrars run during static initialization, a function local static is
+// constructed before the first of them uses it
+ComponentRegistry& ComponentRegistry::Get() {
+    static ComponentRegistry registry;
+    return registry;
+}
+
+void ComponentRegistry::Add(ComponentInfo info) {
+    if (components.find(info.type) != components.end())
+	throw CException(__LINE__, __FILE__, "ComponentRegistry",
+			 "component type " + std::to_string(info.type) +
+			     " is registered twice, " + info.name + " and " +
+			     components.at(info.type).name);
+    names[info.name] = info.type;
+    typeIndices.emplace(info.typeIndex, info.type);
+    components.emplace(info.type, std::move(info));
+}
+
+const ComponentInfo* ComponentRegistry::Find(ComponentType type) {
+    auto& registry = Get();
+    auto itr = registry.components.find(type);
+    return itr != registry.components.end() ? &itr->second : nullptr;
+}
+
+const ComponentInfo* ComponentRegistry::Find(const std::string& name) {
+    auto& registry = Get();
+    auto itr = registry.names.find(name);
+    return itr != registry.names.end() ? Find(itr->second) : nullptr;
+}
+
+const ComponentInfo* ComponentRegistry::Find(std::type_index typeIndex) {
+    auto& registry = Get();
+    auto itr = registry.typeIndices.find(typeIndex);
+    return itr != registry.typeIndices.end() ? Find(itr->second) : nullptr;
+}
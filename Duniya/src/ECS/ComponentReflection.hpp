@@ -0,0 +1,175 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+
+#include "ECS.hpp"
+
+// Field list of a component, only needed for components which aren't
+// trivially copyable. Those are written field by field, the others are
+// memcpy'd in bulk.
+//     DUNIYA_REFLECT(Text, &Text::str, &Text::scale, &Text::color);
+template <typename T>
+struct Reflection;
+
+#define DUNIYA_REFLECT(Type, ...)                                        \
+    template <>                                                          \
+    struct Reflection<Type> {                                            \
+	static constexpr auto fields = std::make_tuple(__VA_ARGS__);     \
+    }
+
+template <typename T>
+struct FieldSerializer {
+    static void Write(std::ostream& os, const T& var) {
+	if constexpr (std::is_trivially_copyable<T>::value) {
+	    os.write((const char*)&var, sizeof(T));
+	} else {
+	    std::apply(
+		[&](auto... fields) {
+		    (FieldSerializer<std::decay_t<decltype(var.*fields)>>::
+			 Write(os, var.*fields),
+		     ...);
+		},
+		Reflection<T>::fields);
+	}
+    }
+    static void Read(std::istream& is, T& var) {
+	if constexpr (std::is_trivially_copyable<T>::value) {
+	    is.read((char*)&var, sizeof(T));
+	} else {
+	    std::apply(
+		[&](auto... fields) {
+		    (FieldSerializer<std::decay_t<decltype(var.*fields)>>::
+			 Read(is, var.*fields),
+		     ...);
+		},
+		Reflection<T>::fields);
+	}
+    }
+};
+
+template <>
+struct FieldSerializer<std::string> {
+    static void Write(std::ostream& os, const std::string& var) {
+	uint32_t size = var.size();
+	os.write((const char*)&size, sizeof(uint32_t));
+	os.write(var.data(), size);
+    }
+    static void Read(std::istream& is, std::string& var) {
+	uint32_t size = 0;
+	is.read((char*)&size, sizeof(uint32_t));
+	var.resize(size);
+	is.read(&var[0], size);
+    }
+};
+
+template <typename U>
+struct FieldSerializer<std::vector<U>> {
+    static void Write(std::ostream& os, const std::vector<U>& var) {
+	uint32_t size = var.size();
+	os.write((const char*)&size, sizeof(uint32_t));
+	for (auto& i : var) FieldSerializer<U>::Write(os, i);
+    }
+    static void Read(std::istream& is, std::vector<U>& var) {
+	uint32_t size = 0;
+	is.read((char*)&size, sizeof(uint32_t));
+	var.resize(size);
+	for (auto& i : var) FieldSerializer<U>::Read(is, i);
+    }
+};
+
+struct ComponentInfo {
+    ComponentType type;
+    std::string name;
+    std::type_index typeIndex;
+    // sizeof the component when it is memcpy'd, 0 for field by field ones
+    uint32_t trivialSize;
+    ComponentPtr::BaseImpl* (*CreateImpl)();
+    // A column holds one component type for every entity of a chunk
+    void (*WriteColumn)(std::ostream& os, void* const* components,
+			uint32_t count);
+    void (*ReadColumn)(std::istream& is, void* const* components,
+		       uint32_t count);
+};
+
+class ComponentRegistry {
+   private:
+    ComponentRegistry() = default;
+    static ComponentRegistry& Get();
+    void Add(ComponentInfo info);
+
+    template <typename T>
+    static void WriteColumn(std::ostream& os, void* const* components,
+			    uint32_t count);
+    template <typename T>
+    static void ReadColumn(std::istream& is, void* const* components,
+			   uint32_t count);
+
+   public:
+    template <typename T>
+    static void Register(ComponentType type, std::string name);
+    static const ComponentInfo* Find(ComponentType type);
+    static const ComponentInfo* Find(const std::string& name);
+    static const ComponentInfo* Find(std::type_index typeIndex);
+
+   private:
+    std::unordered_map<ComponentType, ComponentInfo> components;
+    std::unordered_map<std::string, ComponentType> names;
+    std::unordered_map<std::type_index, ComponentType> typeIndices;
+};
+
+template <typename T>
+struct ComponentRegistrar {
+    ComponentRegistrar(ComponentType type, const char* name) {
+	ComponentRegistry::Register<T>(type, name);
+    }
+};
+
+// Registers a component for serialization, goes in a source file
+#define DUNIYA_REGISTER_COMPONENT(Type, componentType) \
+    static ComponentRegistrar<Type> Type##Registrar(componentType, #Type)
+
+template <typename T>
+void ComponentRegistry::WriteColumn(std::ostream& os, void* const* components,
+				    uint32_t count) {
+    if constexpr (std::is_trivially_copyable<T>::value) {
+	std::vector<char> column(sizeof(T) * count);
+	for (uint32_t i = 0; i < count; i++)
+	    memcpy(column.data() + sizeof(T) * i, components[i], sizeof(T));
+	os.write(column.data(), column.size());
+    } else {
+	for (uint32_t i = 0; i < count; i++)
+	    FieldSerializer<T>::Write(os, *static_cast<T*>(components[i]));
+    }
+}
+
+template <typename T>
+void ComponentRegistry::ReadColumn(std::istream& is, void* const* components,
+				   uint32_t count) {
+    if constexpr (std::is_trivially_copyable<T>::value) {
+	std::vector<char> column(sizeof(T) * count);
+	is.read(column.data(), column.size());
+	for (uint32_t i = 0; i < count; i++)
+	    memcpy(components[i], column.data() + sizeof(T) * i, sizeof(T));
+    } else {
+	for (uint32_t i = 0; i < count; i++)
+	    FieldSerializer<T>::Read(is, *static_cast<T*>(components[i]));
+    }
+}
+
+template <typename T>
+void ComponentRegistry::Register(ComponentType type, std::string name) {
+    uint32_t trivialSize =
+	std::is_trivially_copyable<T>::value ? sizeof(T) : 0;
+    Get().Add({type, name, std::type_index(typeid(T)), trivialSize,
+	       []() -> ComponentPtr::BaseImpl* {
+		   return new ComponentPtr::Impl<T>();
+	       },
+	       &WriteColumn<T>, &ReadColumn<T>});
+}
@@ -0,0 +1,417 @@
+#include "DeltaSerializer.hpp"
+
+#include <Exception.hpp>
+#include <JobSystem.hpp>
+#include <cstring>
+#include <sstream>
+
+#include "SerializerSystem.hpp"
+
+// "DDLT" followed by the version of the record layout
+constexpr uint32_t deltaFileMagic = 0x544C4444;
+constexpr uint32_t deltaFileVersion = 4;
+// Zero bytes shorter than this stay inside a literal run, a new run costs
+// two varints
+constexpr uint64_t minZeroRun = 4;
+// Section key of a chunk's component type lists, the columns are keyed by
+// their component type
+constexpr uint32_t typeListsKey = ~0u;
+
+struct ByteRange {
+    const char* data;
+    uint64_t size;
+};
+
+static void WriteVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+	out.push_back((char)(value | 0x80));
+	value >>= 7;
+    }
+    out.push_back((char)value);
+}
+
+static uint64_t ReadVarint(const std::string& in, uint64_t& pos) {
+    uint64_t value = 0;
+    for (uint32_t shift = 0; pos < in.size() && shift < 64; shift += 7) {
+	uint8_t byte = in[pos++];
+	value |= (uint64_t)(byte & 0x7f) << shift;
+	if ((byte & 0x80) == 0) return value;
+    }
+    throw CException(__LINE__, __FILE__, "DeltaSerializer",
+		     "delta record is truncated");
+}
+
+template <typename T>
+static void Write(std::ostream& os, const T& var) {
+    os.write((const char*)&var, sizeof(T));
+}
+
+template <typename T>
+static void Read(std::istream& is, T& var) {
+    is.read((char*)&var, sizeof(T));
+}
+
+// Run length encodes current XOR base as pairs of (zero run, literal run)
+static std::string EncodeXorRle(const std::string& base, ByteRange current) {
+    auto XorAt = [&](uint64_t i) -> char {
+	char baseByte = i < base.size() ? base[i] : 0;
+	return current.data[i] ^ baseByte;
+    };
+    std::string out;
+    uint64_t i = 0;
+    while (i < current.size) {
+	uint64_t zeroStart = i;
+	while (i < current.size && XorAt(i) == 0) i++;
+	uint64_t literalEnd = i;
+	for (uint64_t j = i; j < current.size && j - literalEnd < minZeroRun;
+	     j++) {
+	    if (XorAt(j) != 0) literalEnd = j + 1;
+	}
+	WriteVarint(out, i - zeroStart);
+	WriteVarint(out, literalEnd - i);
+	for (; i < literalEnd; i++) out.push_back(XorAt(i));
+    }
+    return out;
+}
+
+static std::string DecodeXorRle(const std::string& base,
+				const std::string& payload,
+				uint64_t resultSize) {
+    std::string out(resultSize, '\0');
+    memcpy(&out[0], base.data(), std::min<uint64_t>(base.size(), resultSize));
+    uint64_t pos = 0, i = 0;
+    while (pos < payload.size()) {
+	i += ReadVarint(payload, pos);
+	uint64_t literalSize = ReadVarint(payload, pos);
+	if (i + literalSize > resultSize || pos + literalSize > payload.size())
+	    throw CException(__LINE__, __FILE__, "DeltaSerializer",
+			     "delta record is corrupted");
+	for (uint64_t end = i + literalSize; i < end; i++)
+	    out[i] ^= payload[pos++];
+    }
+    return out;
+}
+
+// Records skipped are taken as equal to their baseline
+static void EncodeRecords(const std::vector<std::string>& baseline,
+			  const std::vector<ByteRange>& current,
+			  const std::vector<uint8_t>& skipped,
+			  std::ostream& os) {
+    static const std::string empty;
+    uint32_t count = current.size();
+    std::vector<std::string> payloads(count);
+    std::vector<uint8_t> changed(count, 0);
+    JobSystem::GetSingleton()->ParallelFor(
+	count, 1, [&](uint32_t begin, uint32_t end) {
+	    for (uint32_t i = begin; i < end; i++) {
+		auto& base = i < baseline.size() ? baseline[i] : empty;
+		if (skipped[i]) continue;
+		if (base.size() == current[i].size &&
+		    memcmp(base.data(), current[i].data, base.size()) == 0)
+		    continue;
+		changed[i] = 1;
+		payloads[i] = EncodeXorRle(base, current[i]);
+	    }
+	});
+
+    uint32_t changedCount = 0;
+    for (auto i : changed) changedCount += i;
+    Write(os, count);
+    Write(os, changedCount);
+    for (uint32_t i = 0; i < count; i++) {
+	if (!changed[i]) continue;
+	uint64_t payloadSize = payloads[i].size();
+	Write(os, i);
+	Write(os, current[i].size);
+	Write(os, payloadSize);
+	os.write(payloads[i].data(), payloadSize);
+    }
+}
+
+static void ApplyRecords(const std::vector<std::string>& baseline,
+			 std::istream& is, std::vector<std::string>& result) {
+    static const std::string empty;
+    uint32_t count, changedCount;
+    Read(is, count);
+    Read(is, changedCount);
+    std::vector<uint32_t> indices(changedCount);
+    std::vector<uint64_t> sizes(changedCount);
+    std::vector<std::string> payloads(changedCount);
+    for (uint32_t i = 0; i < changedCount; i++) {
+	uint64_t payloadSize;
+	Read(is, indices[i]);
+	Read(is, sizes[i]);
+	Read(is, payloadSize);
+	if (!is || indices[i] >= count)
+	    throw CException(__LINE__, __FILE__, "DeltaSerializer",
+			     "delta record is corrupted");
+	payloads[i].resize(payloadSize);
+	is.read(&payloads[i][0], payloadSize);
+    }
+    if (!is)
+	throw CException(__LINE__, __FILE__, "DeltaSerializer",
+			 "delta is truncated");
+
+    result.resize(count);
+    for (uint32_t i = 0; i < count && i < baseline.size(); i++)
+	result[i] = baseline[i];
+    JobSystem::GetSingleton()->ParallelFor(
+	changedCount, 1, [&](uint32_t begin, uint32_t end) {
+	    for (uint32_t i = begin; i < end; i++) {
+		auto& base =
+		    indices[i] < baseline.size() ? baseline[indices[i]] : empty;
+		result[indices[i]] = DecodeXorRle(base, payloads[i], sizes[i]);
+	    }
+	});
+}
+
+static const std::string& FindSection(
+    const SerializerSystem::ChunkSections* chunk, uint32_t key) {
+    static const std::string empty;
+    if (chunk == nullptr) return empty;
+    if (key == typeListsKey) return chunk->typeLists;
+    for (auto& column : chunk->columns)
+	if (column.first == key) return column.second;
+    return empty;
+}
+
+static bool SameSections(const SerializerSystem::ChunkSections& a,
+			 const SerializerSystem::ChunkSections& b) {
+    return a.typeLists == b.typeLists && a.columns == b.columns;
+}
+
+// A changed chunk lists all of its sections, each one XORed against the
+// baseline section with the same key
+static std::string EncodeChunk(const SerializerSystem::ChunkSections* base,
+			       const SerializerSystem::ChunkSections& current) {
+    std::ostringstream oss(std::ios::binary);
+    auto WriteSection = [&](uint32_t key, const std::string& section) {
+	std::string payload = EncodeXorRle(FindSection(base, key),
+					   {section.data(), section.size()});
+	uint64_t size = section.size(), payloadSize = payload.size();
+	Write(oss, key);
+	Write(oss, size);
+	Write(oss, payloadSize);
+	oss.write(payload.data(), payloadSize);
+    };
+    uint32_t sectionCount = current.columns.size() + 1;
+    Write(oss, sectionCount);
+    WriteSection(typeListsKey, current.typeLists);
+    for (auto& column : current.columns)
+	WriteSection(column.first, column.second);
+    return oss.str();
+}
+
+static void EncodeChunks(
+    const std::vector<SerializerSystem::ChunkSections>& baseline,
+    const std::vector<SerializerSystem::ChunkSections>& current,
+    std::ostream& os) {
+    uint32_t count = current.size();
+    std::vector<std::string> payloads(count);
+    std::vector<uint8_t> changed(count, 0);
+    JobSystem::GetSingleton()->ParallelFor(
+	count, 1, [&](uint32_t begin, uint32_t end) {
+	    for (uint32_t i = begin; i < end; i++) {
+		auto base = i < baseline.size() ? &baseline[i] : nullptr;
+		if (base != nullptr && SameSections(*base, current[i]))
+		    continue;
+		changed[i] = 1;
+		payloads[i] = EncodeChunk(base, current[i]);
+	    }
+	});
+
+    uint32_t changedCount = 0;
+    for (auto i : changed) changedCount += i;
+    Write(os, count);
+    Write(os, changedCount);
+    for (uint32_t i = 0; i < count; i++) {
+	if (!changed[i]) continue;
+	Write(os, i);
+	os.write(payloads[i].data(), payloads[i].size());
+    }
+}
+
+static void ApplyChunks(
+    const std::vector<SerializerSystem::ChunkSections>& baseline,
+    std::istream& is, std::vector<SerializerSystem::ChunkSections>& result) {
+    struct Section {
+	uint32_t key;
+	uint64_t size;
+	std::string payload;
+    };
+    auto Corrupted = []() {
+	return CException(__LINE__, __FILE__, "DeltaSerializer",
+			  "delta record is corrupted");
+    };
+    uint32_t count, changedCount;
+    Read(is, count);
+    Read(is, changedCount);
+    std::vector<uint32_t> indices(changedCount);
+    std::vector<std::vector<Section>> sections(changedCount);
+    for (uint32_t i = 0; i < changedCount; i++) {
+	uint32_t sectionCount = 0;
+	Read(is, indices[i]);
+	Read(is, sectionCount);
+	if (!is || indices[i] >= count) throw Corrupted();
+	for (uint32_t j = 0; j < sectionCount && is; j++) {
+	    Section section;
+	    uint64_t payloadSize = 0;
+	    Read(is, section.key);
+	    Read(is, section.size);
+	    Read(is, payloadSize);
+	    if (!is) break;
+	    section.payload.resize(payloadSize);
+	    is.read(&section.payload[0], payloadSize);
+	    sections[i].push_back(std::move(section));
+	}
+	if (!is) break;
+	// The type lists lead every changed chunk
+	if (sections[i].empty() || sections[i][0].key != typeListsKey)
+	    throw Corrupted();
+    }
+    if (!is)
+	throw CException(__LINE__, __FILE__, "DeltaSerializer",
+			 "delta is truncated");
+
+    result.resize(count);
+    for (uint32_t i = 0; i < count && i < baseline.size(); i++)
+	result[i] = baseline[i];
+    JobSystem::GetSingleton()->ParallelFor(
+	changedCount, 1, [&](uint32_t begin, uint32_t end) {
+	    for (uint32_t i = begin; i < end; i++) {
+		auto base = indices[i] < baseline.size()
+				? &baseline[indices[i]]
+				: nullptr;
+		SerializerSystem::ChunkSections chunk;
+		for (auto& section : sections[i]) {
+		    auto decoded =
+			DecodeXorRle(FindSection(base, section.key),
+				     section.payload, section.size);
+		    if (section.key == typeListsKey)
+			chunk.typeLists = std::move(decoded);
+		    else
+			chunk.columns.emplace_back(section.key,
+						   std::move(decoded));
+		}
+		result[indices[i]] = std::move(chunk);
+	    }
+	});
+}
+
+// Cuts the scene's entities into the chunks SerializerSystem writes
+static void CaptureEntities(Scene& scene, SceneSnapshot& snapshot) {
+    SerializerSystem serializer;
+    std::ostringstream typeMapStream(std::ios::binary);
+    serializer.SetOStream(typeMapStream);
+    serializer.Serialize<ComponentTypeMap>(scene.componentTypeMap);
+    snapshot.typeMap = typeMapStream.str();
+
+    auto& entities = scene.entities;
+    uint32_t entitiesPerChunk = SerializerSystem::entitiesPerChunk;
+    snapshot.entityCount = entities.size();
+    uint32_t chunkCount =
+	(snapshot.entityCount + entitiesPerChunk - 1) / entitiesPerChunk;
+    snapshot.chunks.resize(chunkCount);
+    JobSystem::GetSingleton()->ParallelFor(
+	chunkCount, 1, [&](uint32_t begin, uint32_t end) {
+	    for (uint32_t i = begin; i < end; i++) {
+		SerializerSystem::ChunkEntry chunk;
+		chunk.firstEntity = i * entitiesPerChunk;
+		chunk.entityCount = std::min(
+		    entitiesPerChunk, snapshot.entityCount - chunk.firstEntity);
+		snapshot.chunks[i] =
+		    SerializerSystem::EncodeChunk(entities, chunk);
+	    }
+	});
+}
+
+void SceneSnapshot::Capture(Scene& scene) {
+    CaptureEntities(scene, *this);
+    auto& bank = scene.resourceBank->resources;
+    resources.resize(bank.size());
+    resourceHandles.resize(bank.size());
+    for (uint32_t i = 0; i < bank.size(); i++) {
+	resources[i].assign((const char*)bank[i].Get(), bank[i].GetSize());
+	resourceHandles[i] = bank[i].Get();
+    }
+}
+
+void SceneSnapshot::Restore(Scene& scene) const {
+    SerializerSystem serializer;
+    std::istringstream typeMapStream(typeMap, std::ios::binary);
+    serializer.SetIStream(typeMapStream);
+    serializer.Deserialize<ComponentTypeMap>(scene.componentTypeMap);
+
+    // Rebuilds the chunk table so the chunks decode in parallel again
+    std::ostringstream section(std::ios::binary);
+    uint32_t chunkCount = chunks.size();
+    uint64_t offset = 0;
+    std::vector<std::string> payloads(chunkCount);
+    for (uint32_t i = 0; i < chunkCount; i++) payloads[i] = chunks[i].Join();
+    Write(section, entityCount);
+    Write(section, chunkCount);
+    for (uint32_t i = 0; i < chunkCount; i++) {
+	SerializerSystem::ChunkEntry entry;
+	entry.firstEntity = i * SerializerSystem::entitiesPerChunk;
+	entry.entityCount = std::min(SerializerSystem::entitiesPerChunk,
+				     entityCount - entry.firstEntity);
+	entry.offset = offset;
+	entry.size = payloads[i].size();
+	offset += entry.size;
+	Write(section, entry);
+    }
+    for (auto& payload : payloads)
+	section.write(payload.data(), payload.size());
+    std::istringstream entitiesStream(section.str(), std::ios::binary);
+    serializer.SetIStream(entitiesStream);
+    serializer.Deserialize<Scene::Entities>(scene.entities);
+
+    auto& bank = scene.resourceBank->resources;
+    bank.clear();
+    bank.reserve(resources.size());
+    for (auto& resource : resources) {
+	bank.emplace_back(resource.size());
+	memcpy(bank.back().Get(), resource.data(), resource.size());
+    }
+}
+
+void DeltaSerializer::Encode(const SceneSnapshot& baseline, Scene& scene,
+			     std::ostream& os) {
+    SceneSnapshot current;
+    CaptureEntities(scene, current);
+    auto& bank = scene.resourceBank->resources;
+    std::vector<ByteRange> resources;
+    std::vector<uint8_t> sameResources(bank.size(), 0);
+    for (uint32_t i = 0; i < bank.size(); i++) {
+	resources.push_back(
+	    {(const char*)bank[i].Get(), (uint64_t)bank[i].GetSize()});
+	sameResources[i] = i < baseline.resourceHandles.size() &&
+			   baseline.resourceHandles[i] == bank[i].Get() &&
+			   baseline.resources[i].size() == bank[i].GetSize();
+    }
+
+    uint32_t typeMapSize = current.typeMap.size();
+    Write(os, deltaFileMagic);
+    Write(os, deltaFileVersion);
+    Write(os, typeMapSize);
+    os.write(current.typeMap.data(), typeMapSize);
+    Write(os, current.entityCount);
+    EncodeChunks(baseline.chunks, current.chunks, os);
+    EncodeRecords(baseline.resources, resources, sameResources, os);
+}
+
+void DeltaSerializer::Apply(const SceneSnapshot& baseline, std::istream& is,
+			    SceneSnapshot& result) {
+    uint32_t magic = 0, version = 0, typeMapSize = 0;
+    Read(is, magic);
+    Read(is, version);
+    if (magic != deltaFileMagic || version != deltaFileVersion)
+	throw CException(__LINE__, __FILE__, "DeltaSerializer",
+			 "not a supported scene delta");
+    Read(is, typeMapSize);
+    result.typeMap.resize(typeMapSize);
+    is.read(&result.typeMap[0], typeMapSize);
+    Read(is, result.entityCount);
+    ApplyChunks(baseline.chunks, is, result.chunks);
+    ApplyRecords(baseline.resources, is, result.resources);
+}
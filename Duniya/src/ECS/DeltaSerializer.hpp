@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ECS.hpp"
+
+// Serialized copy of a scene, the baseline deltas are computed against.
+// Entities are kept in the same chunks SerializerSystem writes, each cut in
+// its sections, so an untouched chunk or column compares equal byte for
+// byte.
+struct SceneSnapshot {
+    std::string typeMap;
+    uint32_t entityCount = 0;
+    std::vector<SerializerSystem::ChunkSections> chunks;
+    std::vector<std::string> resources;
+    // Where each resource's bytes lived when captured. A resource still at
+    // the same address with the same size is taken as unchanged without
+    // comparing its bytes.
+    std::vector<const void*> resourceHandles;
+
+    void Capture(Scene& scene);
+    void Restore(Scene& scene) const;
+};
+
+// A delta stores, for every chunk section and resource that differs from
+// the baseline, the XOR of the new bytes against the old ones. Unchanged
+// fields XOR to zero and are run length encoded away, so only the changed
+// ranges cost space. Sections are matched by component type, adding a
+// component or growing a string only shifts the bytes of its own column.
+class DeltaSerializer {
+   public:
+    static void Encode(const SceneSnapshot& baseline, Scene& scene,
+		       std::ostream& os);
+    static void Apply(const SceneSnapshot& baseline, std::istream& is,
+		      SceneSnapshot& result);
+};
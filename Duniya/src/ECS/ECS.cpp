@@ -3,13 +3,16 @@
 #include <ECS/CommonComponent.hpp>
 #include <ECS/GraphicsComponent.hpp>
 #include <Exception.hpp>
+#include <FileReader.hpp>
 #include <condition_variable>
 #include <fstream>
 #include <memory>
 #include <random>
+#include <sstream>
 #include <thread>
 #include <unordered_map>
 
+#include "DeltaSerializer.hpp"
 #include "SerializerSystem.hpp"
 
 void* ComponentPtr::emplace(BaseImpl* impl) {
@@ -105,28 +108,84 @@ uint32_t Scene::PushDef() {
     return tmp;
 }
 
+// "DSCN" followed by the version of the section layout
+constexpr uint32_t sceneFileMagic = 0x4E435344;
+constexpr uint32_t sceneFileVersion = 8;
+
 void Scene::LoadScene(std::string filePath) {
-    std::ifstream fin(filePath, std::ifstream::binary);
-    if (!fin.is_open())
-	throw CException(__LINE__, __FILE__, "File Exception",
-			 filePath + " not found");
+    // Read in one go, the sections seek around inside it
+    FileBufferStream fin(FileReader::GetSingleton()->Read(filePath).get());
     SerializerSystem::init();
     SerializerSystem::singleton->SetIStream(fin);
+    uint32_t magic = 0, version = 0;
+    SerializerSystem::singleton->Deserialize<uint32_t>(magic);
+    SerializerSystem::singleton->Deserialize<uint32_t>(version);
+    if (magic != sceneFileMagic || version != sceneFileVersion)
+	throw CException(__LINE__, __FILE__, "File Exception",
+			 filePath + " is not a supported scene file");
     SerializerSystem::singleton->Deserialize<ComponentTypeMap>(
 	componentTypeMap);
-    SerializerSystem::singleton->Deserialize<Entities>(entities);
-    fin.close();
+
+    std::string section;
+    SerializerSystem sectionSerializer;
+    BlockReader(fin).ReadAll(section);
+    std::istringstream entitiesSection(section, std::ios::binary);
+    sectionSerializer.SetIStream(entitiesSection);
+    sectionSerializer.Deserialize<Entities>(entities);
+
+    BlockReader(fin).ReadAll(section);
+    std::istringstream resourcesSection(section, std::ios::binary);
+    sectionSerializer.SetIStream(resourcesSection);
+    sectionSerializer.Deserialize<ResourceBank>(*resourceBank);
 }
 
-void Scene::SaveScene(std::string filePath) {
+void Scene::SaveScene(std::string filePath, const SceneFileOptions& options) {
     std::ofstream fout(filePath, std::ofstream::binary);
+    if (!fout.is_open())
+	throw CException(__LINE__, __FILE__, "File Exception",
+			 "Couldn't create " + filePath);
     SerializerSystem::init();
     SerializerSystem::singleton->SetOStream(fout);
+    SerializerSystem::singleton->Serialize<uint32_t>(sceneFileMagic);
+    SerializerSystem::singleton->Serialize<uint32_t>(sceneFileVersion);
     SerializerSystem::singleton->Serialize<ComponentTypeMap>(componentTypeMap);
-    SerializerSystem::singleton->Serialize<Entities>(entities);
+
+    SerializerSystem sectionSerializer;
+    std::ostringstream entitiesSection(std::ios::binary);
+    sectionSerializer.SetOStream(entitiesSection);
+    sectionSerializer.Serialize<Entities>(entities);
+    BlockWriter::Write(fout, entitiesSection.str(), options.entities);
+
+    std::ostringstream resourcesSection(std::ios::binary);
+    sectionSerializer.SetOStream(resourcesSection);
+    sectionSerializer.Serialize<ResourceBank>(*resourceBank);
+    BlockWriter::Write(fout, resourcesSection.str(), options.resources);
     fout.close();
 }
 
+void Scene::SaveSceneDelta(std::string filePath, const SceneSnapshot& baseline,
+			   const BlockOptions& options) {
+    std::ofstream fout(filePath, std::ofstream::binary);
+    if (!fout.is_open())
+	throw CException(__LINE__, __FILE__, "File Exception",
+			 "Couldn't create " + filePath);
+    std::ostringstream delta(std::ios::binary);
+    DeltaSerializer::Encode(baseline, *this, delta);
+    BlockWriter::Write(fout, delta.str(), options);
+    fout.close();
+}
+
+void Scene::LoadSceneDelta(std::string filePath,
+			   const SceneSnapshot& baseline) {
+    FileBufferStream fin(FileReader::GetSingleton()->Read(filePath).get());
+    std::string delta;
+    BlockReader(fin).ReadAll(delta);
+    std::istringstream deltaStream(delta, std::ios::binary);
+    SceneSnapshot snapshot;
+    DeltaSerializer::Apply(baseline, deltaStream, snapshot);
+    snapshot.Restore(*this);
+}
+
 SystemManager::SystemManager() {
     logger = new Logger;
     queryMessages.reset(new QueryMessages);
@@ -193,6 +252,9 @@ ResourceBank::ResourcePtr::ResourcePtr(size_t size) : size(size) {
 }
 ResourceBank::ResourcePtr::ResourcePtr(uint8_t* data, size_t size)
     : data(data), size(size) {}
+ResourceBank::ResourcePtr::ResourcePtr(uint8_t* data, size_t size,
+				       std::shared_ptr<void> owner)
+    : data(data), size(size), owner(std::move(owner)) {}
 ResourceBank::ResourcePtr::ResourcePtr(const ResourceBank::ResourcePtr& ptr) {
     size = ptr.size;
     if (ptr.data != nullptr) {
@@ -206,12 +268,16 @@ ResourceBank::ResourcePtr::ResourcePtr(
     ResourceBank::ResourcePtr&& ptr) noexcept {
     this->size = std::move(ptr.size);
     this->data = std::move(ptr.data);
+    this->owner = std::move(ptr.owner);
     ptr.data = nullptr;
     ptr.size = 0;
 }
 
 ResourceBank::ResourcePtr& ResourceBank::ResourcePtr::operator=(
     const ResourceBank::ResourcePtr& ptr) {
+    if (this == &ptr) return *this;
+    if (data != nullptr && owner == nullptr) delete[] data;
+    owner = nullptr;
     size = ptr.size;
     if (ptr.data != nullptr) {
 	data = new uint8_t[ptr.size];
@@ -223,16 +289,19 @@ ResourceBank::ResourcePtr& ResourceBank::ResourcePtr::operator=(
 
 ResourceBank::ResourcePtr& ResourceBank::ResourcePtr::operator=(
     ResourceBank::ResourcePtr&& ptr) {
-    if (this->data != nullptr) delete this->data;
+    if (this->data != nullptr && this->owner == nullptr) delete[] this->data;
     this->data = ptr.data;
     this->size = ptr.size;
+    this->owner = std::move(ptr.owner);
     ptr.data = nullptr;
     ptr.size = 0;
     return *this;
 }
 ResourceBank::ResourcePtr::~ResourcePtr() noexcept {
-    if (data != nullptr) delete[] data;
+    if (data != nullptr && owner == nullptr) delete[] data;
 }
 uint8_t* ResourceBank::ResourcePtr::Get() { return data; }
 
-size_t ResourceBank::ResourcePtr::GetSize() { return size; }
+const uint8_t* ResourceBank::ResourcePtr::Get() const { return data; }
+
+size_t ResourceBank::ResourcePtr::GetSize() const { return size; }
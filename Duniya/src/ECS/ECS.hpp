@@ -13,6 +13,7 @@
 #include <typeinfo>
 #include <unordered_map>
 
+#include "ECS/BlockStream.hpp"
 #include "ECS/SerializerSystem.hpp"
 #include "Logger.hpp"
 
@@ -24,7 +25,7 @@ constexpr uint32_t CHILDREN = 0x3;
 constexpr uint32_t MATERIAL = 0x4;
 constexpr uint32_t TEXTURE = 0x5;
 constexpr uint32_t RENDERERSTUFF = 0x6;
-constexpr uint32_t CAMERA = 0x7;
+constexpr uint32_t CAMERA = 0x9;
 
 };  // namespace ComponentTypes
 
@@ -89,11 +90,15 @@ class ResourceBank {
        private:
 	uint8_t* data;
 	size_t size;
+	// Set when data lives inside memory someone else owns, e.g. a mapped
+	// file, data is then not freed by the ResourcePtr
+	std::shared_ptr<void> owner;
 
        public:
 	ResourcePtr();
 	ResourcePtr(size_t size);
 	ResourcePtr(uint8_t* data, size_t size);
+	ResourcePtr(uint8_t* data, size_t size, std::shared_ptr<void> owner);
 	ResourcePtr(const ResourcePtr& ptr);
 	ResourcePtr(ResourcePtr&& ptr) noexcept;
 
@@ -103,7 +108,8 @@ class ResourceBank {
 	ResourcePtr& operator=(ResourcePtr&& ptr);
 
 	uint8_t* Get();
-	size_t GetSize();
+	const uint8_t* Get() const;
+	size_t GetSize() const;
     };
     //		std::vector<std::unique_ptr<char>> resouces;
     std::vector<ResourcePtr> resources;
@@ -114,6 +120,19 @@ class ResourceBank {
 	resources.emplace_back(__ptr, size);
 	return resources.size() - 1;
     }
+    uint32_t Push_Back(uint8_t* __ptr, size_t size,
+		       std::shared_ptr<void> owner) {
+	resources.emplace_back(__ptr, size, std::move(owner));
+	return resources.size() - 1;
+    }
+};
+
+struct SceneSnapshot;
+
+// Codec and block size used for every section of a scene file
+struct SceneFileOptions {
+    BlockOptions entities;
+    BlockOptions resources;
 };
 
 class Scene {
@@ -183,7 +202,12 @@ class Scene {
     void UnRegisterComponent();
 
     void LoadScene(std::string filePath);
-    void SaveScene(std::string filePath);
+    void SaveScene(std::string filePath,
+		   const SceneFileOptions& options = SceneFileOptions());
+    // Autosave files only hold what changed since the baseline snapshot
+    void SaveSceneDelta(std::string filePath, const SceneSnapshot& baseline,
+			const BlockOptions& options = BlockOptions());
+    void LoadSceneDelta(std::string filePath, const SceneSnapshot& baseline);
 };
 
 struct Children {
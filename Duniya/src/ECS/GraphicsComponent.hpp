@@ -27,16 +27,50 @@ enum class DrawPrimitive : uint32_t {
     LINES
 };
 
+// Vertex layouts, see Graphics/VertexFormat.hpp
+enum class VertexFormat : uint32_t {
+    FULL,
+    COMPACT,
+    COMPACT_NO_UV,
+    COMPACT_FLOAT_POSITION
+};
+
+constexpr uint32_t maxMeshLods = 4;
+
+// Index range of one level of detail, error is how far the level strays
+// from the full mesh relative to boundsRadius
+struct MeshLod {
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    float error;
+};
+
 struct Mesh {
     uint32_t vertexCount;
     uint32_t indexCount;
     uint32_t verticiesIndex;
     uint32_t indiciesIndex;
     DrawPrimitive drawPrimitive;
+    VertexFormat vertexFormat;
+    // Quantized positions decode to positionOffset + positionScale * q
+    Vect3 positionScale;
+    Vect3 positionOffset;
+    // Model space bounding sphere
+    Vect3 boundsCenter;
+    float boundsRadius;
+    // lods[0] is the full mesh and the coarser levels follow it in the
+    // index buffer, no levels means the whole buffer is drawn
+    uint32_t lodCount = 0;
+    MeshLod lods[maxMeshLods];
 };
 
 struct Texture {
     uint32_t width, height, channels, data;
-    enum Format { RGBA, RGB, R } format;
+    // BCn formats are 4x4 blocks, see Graphics/BCnCodec.hpp
+    enum Format { RGBA, RGB, R, BC1, BC3, BC4, BC7 } format;
+    // Levels stored in data, see Graphics/MipGenerator.hpp
+    uint32_t mipLevels = 1;
+    // Images are sRGB encoded, data such as glyph coverage is linear
+    enum ColorSpace { SRGB, LINEAR } colorSpace = SRGB;
 };
 
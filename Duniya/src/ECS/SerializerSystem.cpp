@@ -1,8 +1,12 @@
 #include "SerializerSystem.hpp"
 
-#include "CommonComponent.hpp"
+#include <JobSystem.hpp>
+#include <algorithm>
+#include <map>
+#include <sstream>
+
+#include "ComponentReflection.hpp"
 #include "ECS.hpp"
-#include "GraphicsComponent.hpp"
 
 SerializerSystem* SerializerSystem::singleton = nullptr;
 
@@ -32,138 +36,292 @@ void SerializerSystem::Deserialize(T& var) {
     is->read((char*)&var, sizeof(T));
 }
 
+// Scene files start with their magic and version, written from ECS.cpp
+template void SerializerSystem::Serialize<uint32_t>(const uint32_t&);
+template void SerializerSystem::Deserialize<uint32_t>(uint32_t&);
+
+// Registered component types of an entity, sorted so the same components
+// always encode to the same bytes. Unregistered ones are runtime only state.
+static std::vector<std::pair<const ComponentInfo*, void*>> SortedComponents(
+    const Scene::IComponentArray& var) {
+    std::vector<std::pair<const ComponentInfo*, void*>> sorted;
+    for (auto& component : var.components) {
+	auto info = ComponentRegistry::Find(component.first);
+	if (info == nullptr || component.second.base == nullptr) continue;
+	sorted.emplace_back(info, component.second.base->GetPointer());
+    }
+    std::sort(sorted.begin(), sorted.end(), [](auto& a, auto& b) {
+	return a.first->type < b.first->type;
+    });
+    return sorted;
+}
+
+static const ComponentInfo* FindComponent(ComponentType type) {
+    auto info = ComponentRegistry::Find(type);
+    if (info == nullptr)
+	throw CException(__LINE__, __FILE__, "SerilzerSystem",
+			 "component type " + std::to_string(type) +
+			     " is not registered");
+    return info;
+}
+
 template <>
 void SerializerSystem::Serialize<Scene::IComponentArray>(
     const Scene::IComponentArray& var) {
-    auto comptritr = var.components.begin();
-    uint32_t totalSize = var.components.size();
+    CHECKOS;
+    auto sorted = SortedComponents(var);
+    uint32_t totalSize = sorted.size();
     os->write((char*)&totalSize, sizeof(uint32_t));
-    while (comptritr != var.components.end()) {
-	os->write((char*)&comptritr->first, sizeof(uint32_t));
-	if (comptritr->first == ComponentTypes::TRANSFORM) {
-	    Transform* transform =
-		(Transform*)comptritr->second.base->GetPointer();
-	    SerializerSystem::singleton->Serialize<Transform>(*transform);
-	} else if (comptritr->first == ComponentTypes::MESH) {
-	    Mesh* mesh = (Mesh*)comptritr->second.base->GetPointer();
-	    SerializerSystem::singleton->Serialize<Mesh>(*mesh);
-	} else if (comptritr->first == ComponentTypes::TEXTURE) {
-	    Texture* texture = (Texture*)comptritr->second.base->GetPointer();
-	    SerializerSystem::singleton->Serialize<Texture>(*texture);
-	}
-	comptritr++;
+    for (auto& component : sorted) {
+	os->write((char*)&component.first->type, sizeof(uint32_t));
+	component.first->WriteColumn(*os, &component.second, 1);
     }
 }
 
 template <>
 void SerializerSystem::Deserialize<Scene::IComponentArray>(
     Scene::IComponentArray& var) {
+    CHECKIS;
     uint32_t totalSize;
     is->read((char*)&totalSize, sizeof(uint32_t));
-    // std::cout << "Totatl Size: " << totalSize << std::endl;
-    // in.read((char*)componentArray->componentTypes.data(), sizeof(uint32_t) *
-    // totalSize);
     for (uint32_t itr = 0; itr < totalSize; itr++) {
-	ComponentType componentTypeTemp;
-	uint32_t componentTypeinInt;
-	is->read((char*)&componentTypeinInt, sizeof(uint32_t));
-	componentTypeTemp = static_cast<ComponentType>(componentTypeinInt);
-	ComponentPtr& componentPtr = var.components[componentTypeTemp];
-	if (componentTypeTemp == ComponentTypes::MESH) {
-	    componentPtr.base = new ComponentPtr::Impl<Mesh>();
-	    componentPtr.base->Create();
-	    Mesh* mesh = (Mesh*)componentPtr.base->GetPointer();
-	    SerializerSystem::singleton->Deserialize<Mesh>(*mesh);
-	} else if (componentTypeTemp == ComponentTypes::TEXTURE) {
-	    componentPtr.base = new ComponentPtr::Impl<Texture>();
-	    componentPtr.base->Create();
-	    Texture* texture = (Texture*)componentPtr.base->GetPointer();
-	    SerializerSystem::singleton->Deserialize<Texture>(*texture);
-	} else if (componentTypeTemp == ComponentTypes::TRANSFORM) {
-	    componentPtr.base = new ComponentPtr::Impl<Transform>();
-	    componentPtr.base->Create();
-	    Transform* transform = (Transform*)componentPtr.base->GetPointer();
-	    SerializerSystem::singleton->Deserialize<Transform>(*transform);
-	}
+	ComponentType componentType;
+	is->read((char*)&componentType, sizeof(uint32_t));
+	auto info = FindComponent(componentType);
+	void* component =
+	    var.components[componentType].emplace(info->CreateImpl());
+	info->ReadColumn(*is, &component, 1);
     }
 }
 
 template <>
 void SerializerSystem::Serialize<ComponentTypeMap>(
     const ComponentTypeMap& var) {
-    uint32_t typeMapSize = var.size();
-    os->write((char*)&typeMapSize, sizeof(uint32_t));
+    CHECKOS;
+    std::vector<std::pair<const std::string*, ComponentType>> entries;
     for (auto& i : var) {
-	std::string temp;
-	if (i.first == std::type_index(typeid(Transform)))
-	    temp = "Transform";
-	else if (i.first == std::type_index(typeid(Mesh)))
-	    temp = "Mesh";
-	else if (i.first == std::type_index(typeid(Texture)))
-	    temp = "Texture";
-	else if (i.first == std::type_index(typeid(Material)))
-	    temp = "Material";
-	uint32_t tempSize = temp.size();
-	// std::cout << "Temp Name " <<  temp << std::endl;
-	os->write((char*)&tempSize, sizeof(uint32_t));
-	os->write(temp.data(), tempSize);
+	auto info = ComponentRegistry::Find(i.first);
+	if (info != nullptr) entries.emplace_back(&info->name, i.second);
+    }
+    std::sort(entries.begin(), entries.end(),
+	      [](auto& a, auto& b) { return *a.first < *b.first; });
+    uint32_t typeMapSize = entries.size();
+    os->write((char*)&typeMapSize, sizeof(uint32_t));
+    for (auto& i : entries) {
+	uint32_t nameSize = i.first->size();
+	os->write((char*)&nameSize, sizeof(uint32_t));
+	os->write(i.first->data(), nameSize);
 	os->write((char*)&i.second, sizeof(uint32_t));
     }
 }
 
 template <>
 void SerializerSystem::Deserialize<ComponentTypeMap>(ComponentTypeMap& var) {
+    CHECKIS;
     uint32_t typeMapSize;
-    SerializerSystem::Deserialize<uint32_t>(typeMapSize);
-
+    Deserialize<uint32_t>(typeMapSize);
     while (typeMapSize--) {
-	uint32_t tempSize;
-	uint32_t componentTypeUI;
-	char* typeNameChar;
-	SerializerSystem::Deserialize<uint32_t>(tempSize);
-	typeNameChar = new char[tempSize];
-	is->read(typeNameChar, tempSize);
-	SerializerSystem::Deserialize<uint32_t>(componentTypeUI);
-
-	std::type_index* typeIndex = nullptr;
-	std::string typeName(typeNameChar, tempSize);
-
-	if (typeName == "Transform")
-	    typeIndex = new std::type_index(typeid(Transform));
-	else if (typeName == "Mesh")
-	    typeIndex = new std::type_index(typeid(Mesh));
-	else if (typeName == "Texture")
-	    typeIndex = new std::type_index(typeid(Texture));
-	else if (typeName == "Material")
-	    typeIndex = new std::type_index(typeid(Material));
-	if (var.find(*typeIndex) == var.end())
-	    var.insert(std::make_pair(
-		*typeIndex, static_cast<ComponentType>(componentTypeUI)));
-	delete[] typeNameChar;
-	typeNameChar = nullptr;
+	uint32_t nameSize;
+	ComponentType componentType;
+	Deserialize<uint32_t>(nameSize);
+	std::string typeName(nameSize, '\0');
+	is->read(&typeName[0], nameSize);
+	Deserialize<uint32_t>(componentType);
+	// Names of components this build doesn't know are dropped
+	auto info = ComponentRegistry::Find(typeName);
+	if (info != nullptr) var.emplace(info->typeIndex, componentType);
     }
 }
 
+// Component count written in place of a null entity's, loading gives the
+// null entity back rather than an empty one
+constexpr uint32_t nullEntityMarker = ~0u;
+
+// A chunk is stored column wise. Every entity first lists the component
+// types it has, then every component type is stored as one column holding
+// that component of every entity which has it, in entity order. Trivially
+// copyable columns are a single memcpy'd block.
+template <>
+SerializerSystem::ChunkSections SerializerSystem::EncodeChunk<Scene::Entities>(
+    const Scene::Entities& entities, const ChunkEntry& chunk) {
+    std::ostringstream typeLists(std::ios::binary);
+    std::map<ComponentType, std::vector<void*>> columns;
+    for (uint32_t i = 0; i < chunk.entityCount; i++) {
+	auto& entity = entities[chunk.firstEntity + i];
+	if (entity == nullptr) {
+	    typeLists.write((char*)&nullEntityMarker, sizeof(uint32_t));
+	    continue;
+	}
+	auto sorted = SortedComponents(*entity);
+	uint32_t componentCount = sorted.size();
+	typeLists.write((char*)&componentCount, sizeof(uint32_t));
+	for (auto& component : sorted) {
+	    typeLists.write((char*)&component.first->type, sizeof(uint32_t));
+	    columns[component.first->type].push_back(component.second);
+	}
+    }
+    ChunkSections sections;
+    sections.typeLists = typeLists.str();
+    for (auto& column : columns) {
+	std::ostringstream oss(std::ios::binary);
+	auto info = ComponentRegistry::Find(column.first);
+	uint32_t count = column.second.size();
+	oss.write((char*)&column.first, sizeof(uint32_t));
+	oss.write((char*)&count, sizeof(uint32_t));
+	oss.write((char*)&info->trivialSize, sizeof(uint32_t));
+	info->WriteColumn(oss, column.second.data(), count);
+	sections.columns.emplace_back(column.first, oss.str());
+    }
+    return sections;
+}
+
+std::string SerializerSystem::ChunkSections::Join() const {
+    uint32_t columnCount = columns.size();
+    std::string chunk = typeLists;
+    chunk.append((const char*)&columnCount, sizeof(uint32_t));
+    for (auto& column : columns) chunk += column.second;
+    return chunk;
+}
+
+static void DecodeChunk(Scene::Entities& entities,
+			const SerializerSystem::ChunkEntry& chunk,
+			const std::string& payload) {
+    auto Truncated = []() {
+	return CException(__LINE__, __FILE__, "SerilzerSystem",
+			  "entity chunk is truncated");
+    };
+    std::istringstream iss(payload, std::ios::binary);
+    std::unordered_map<ComponentType, std::vector<void*>> columns;
+    for (uint32_t i = 0; i < chunk.entityCount; i++) {
+	auto& entity = entities[chunk.firstEntity + i];
+	uint32_t componentCount = 0;
+	iss.read((char*)&componentCount, sizeof(uint32_t));
+	if (!iss) throw Truncated();
+	if (componentCount == nullEntityMarker) {
+	    entity.reset();
+	    continue;
+	}
+	entity.reset(new Scene::IComponentArray);
+	while (componentCount--) {
+	    ComponentType componentType;
+	    iss.read((char*)&componentType, sizeof(uint32_t));
+	    auto info = FindComponent(componentType);
+	    columns[componentType].push_back(
+		entity->components[componentType].emplace(
+		    info->CreateImpl()));
+	}
+    }
+    uint32_t columnCount = 0;
+    iss.read((char*)&columnCount, sizeof(uint32_t));
+    while (columnCount--) {
+	ComponentType componentType;
+	uint32_t count, trivialSize;
+	iss.read((char*)&componentType, sizeof(uint32_t));
+	iss.read((char*)&count, sizeof(uint32_t));
+	iss.read((char*)&trivialSize, sizeof(uint32_t));
+	if (!iss) throw Truncated();
+	auto info = FindComponent(componentType);
+	auto& column = columns[componentType];
+	if (count != column.size() || trivialSize != info->trivialSize)
+	    throw CException(__LINE__, __FILE__, "SerilzerSystem",
+			     "column of " + info->name +
+				 " doesn't match this build's layout");
+	info->ReadColumn(iss, column.data(), count);
+    }
+    if (!iss) throw Truncated();
+}
+
 template <>
 void SerializerSystem::Serialize<Scene::Entities>(const Scene::Entities& var) {
+    CHECKOS;
     uint32_t entitySize = var.size();
-    singleton->Serialize<uint32_t>(entitySize);
-    for (int i = 0; i < var.size(); i++) {
-	singleton->Serialize<uint32_t>(i);
-	singleton->Serialize<Scene::IComponentArray>(*(var[i].get()));
+    uint32_t chunkCount =
+	(entitySize + entitiesPerChunk - 1) / entitiesPerChunk;
+    std::vector<ChunkEntry> chunks(chunkCount);
+    std::vector<std::string> payloads(chunkCount);
+    for (uint32_t i = 0; i < chunkCount; i++) {
+	chunks[i].firstEntity = i * entitiesPerChunk;
+	chunks[i].entityCount =
+	    std::min(entitiesPerChunk, entitySize - chunks[i].firstEntity);
+    }
+
+    JobSystem::GetSingleton()->ParallelFor(
+	chunkCount, 1, [&](uint32_t begin, uint32_t end) {
+	    for (uint32_t i = begin; i < end; i++)
+		payloads[i] = EncodeChunk(var, chunks[i]).Join();
+	});
+
+    uint64_t offset = 0;
+    for (uint32_t i = 0; i < chunkCount; i++) {
+	chunks[i].offset = offset;
+	chunks[i].size = payloads[i].size();
+	offset += chunks[i].size;
     }
+    Serialize<uint32_t>(entitySize);
+    Serialize<uint32_t>(chunkCount);
+    os->write((char*)chunks.data(), sizeof(ChunkEntry) * chunkCount);
+    for (auto& payload : payloads) os->write(payload.data(), payload.size());
 }
 
 template <>
 void SerializerSystem::Deserialize<Scene::Entities>(Scene::Entities& var) {
-    uint32_t entitySize;
-    singleton->Deserialize<uint32_t>(entitySize);
+    CHECKIS;
+    uint32_t entitySize, chunkCount;
+    Deserialize<uint32_t>(entitySize);
+    Deserialize<uint32_t>(chunkCount);
+    std::vector<ChunkEntry> chunks(chunkCount);
+    is->read((char*)chunks.data(), sizeof(ChunkEntry) * chunkCount);
+
+    // Payloads are read sequentially, the decoding is what runs in parallel
+    std::vector<std::string> payloads(chunkCount);
+    auto payloadStart = is->tellg();
+    for (uint32_t i = 0; i < chunkCount; i++) {
+	if (chunks[i].firstEntity + chunks[i].entityCount > entitySize)
+	    throw CException(__LINE__, __FILE__, "SerilzerSystem",
+			     "entity chunk out of range");
+	payloads[i].resize(chunks[i].size);
+	is->seekg(payloadStart + (std::streamoff)chunks[i].offset);
+	is->read(&payloads[i][0], chunks[i].size);
+    }
+    if (!*is)
+	throw CException(__LINE__, __FILE__, "SerilzerSystem",
+			 "entity chunks are truncated");
+
     var.resize(entitySize);
-    while (entitySize--) {
-	uint32_t entity;
-	singleton->Deserialize<uint32_t>(entity);
-	var[entity] =
-	    std::unique_ptr<Scene::IComponentArray>(new Scene::IComponentArray);
-	singleton->Deserialize<Scene::IComponentArray>(*(var[entity].get()));
+    JobSystem::GetSingleton()->ParallelFor(
+	chunkCount, 1, [&](uint32_t begin, uint32_t end) {
+	    for (uint32_t i = begin; i < end; i++)
+		DecodeChunk(var, chunks[i], payloads[i]);
+	});
+}
+
+template <>
+void SerializerSystem::Serialize<ResourceBank>(const ResourceBank& var) {
+    CHECKOS;
+    uint32_t resourceCount = var.resources.size();
+    Serialize<uint32_t>(resourceCount);
+    for (auto& resource : var.resources) {
+	uint64_t size = resource.GetSize();
+	Serialize<uint64_t>(size);
+    }
+    for (auto& resource : var.resources)
+	os->write((const char*)resource.Get(), resource.GetSize());
+}
+
+template <>
+void SerializerSystem::Deserialize<ResourceBank>(ResourceBank& var) {
+    CHECKIS;
+    uint32_t resourceCount;
+    Deserialize<uint32_t>(resourceCount);
+    std::vector<uint64_t> sizes(resourceCount);
+    is->read((char*)sizes.data(), sizeof(uint64_t) * resourceCount);
+    var.resources.clear();
+    var.resources.reserve(resourceCount);
+    for (auto size : sizes) {
+	var.resources.emplace_back(size);
+	is->read((char*)var.resources.back().Get(), size);
     }
+    if (!*is)
+	throw CException(__LINE__, __FILE__, "SerilzerSystem",
+			 "resource bank is truncated");
 }
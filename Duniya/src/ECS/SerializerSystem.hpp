@@ -1,6 +1,9 @@
 #pragma once
 #include <Exception.hpp>
+#include <cstdint>
 #include <iostream>
+#include <string>
+#include <vector>
 
 #define CHECKIS        \
     if (is == nullptr) \
@@ -10,9 +13,35 @@
     throw CException(__LINE__, __FILE__, "SerilzerSystem", "os is null")
 
 class SerializerSystem {
-   private:
+   public:
+    // Chunks encode and decode in parallel, each one with its own serializer
     SerializerSystem();
 
+    // Entities serialized per chunk, every chunk is independent of the others
+    static constexpr uint32_t entitiesPerChunk = 256;
+
+    struct ChunkEntry {
+	uint32_t firstEntity;
+	uint32_t entityCount;
+	uint64_t offset;
+	uint64_t size;
+    };
+
+    // A chunk cut where its columns start, so that a change which shifts
+    // bytes stays inside one section: the component type lists of its
+    // entities, then every column with its header by component type. Join
+    // gives back the chunk's bytes.
+    struct ChunkSections {
+	std::string typeLists;
+	std::vector<std::pair<uint32_t, std::string>> columns;
+
+	std::string Join() const;
+    };
+    // Specialized for Scene::Entities in SerializerSystem.cpp, as Serialize
+    template <class T>
+    static ChunkSections EncodeChunk(const T& entities,
+				     const ChunkEntry& chunk);
+
    public:
     static SerializerSystem* init();
     template <class T>
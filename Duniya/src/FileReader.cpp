@@ -0,0 +1,328 @@
+#include "FileReader.hpp"
+
+#include <Exception.hpp>
+#include <JobSystem.hpp>
+#include <cerrno>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define DUNIYA_POSIX_FILES
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <filesystem>
+#include <fstream>
+#endif
+
+#ifdef DUNIYA_HAS_IO_URING
+#include <liburing.h>
+#endif
+
+// Reads in flight at once, more wait in pending
+constexpr uint32_t ringDepth = 256;
+// Biggest single read, larger files take several
+constexpr size_t maxReadSize = 1u << 30;
+
+#ifdef DUNIYA_HAS_IO_URING
+struct FileReader::Ring {
+    io_uring ring;
+};
+#else
+struct FileReader::Ring {};
+#endif
+
+FileReader* FileReader::singleton = nullptr;
+
+FileReader::FileReader() : quit(false) {
+#ifdef DUNIYA_HAS_IO_URING
+    // Kernels without io_uring, or sandboxes blocking it, use pread
+    ring.reset(new Ring);
+    if (io_uring_queue_init(ringDepth, &ring->ring, 0) < 0)
+	ring.reset();
+    else
+	ringThread = std::thread(&FileReader::RingLoop, this);
+#endif
+}
+
+FileReader::~FileReader() {
+    {
+	std::unique_lock<std::mutex> lock(pendingMutex);
+	quit = true;
+    }
+    pendingCondition.notify_all();
+    if (ringThread.joinable()) ringThread.join();
+#ifdef DUNIYA_HAS_IO_URING
+    if (ring != nullptr) io_uring_queue_exit(&ring->ring);
+#endif
+}
+
+// Jobs read files, the first two may ask for the reader at once
+static std::once_flag singletonInit;
+
+FileReader* FileReader::init() {
+    std::call_once(singletonInit,
+		   []() { FileReader::singleton = new FileReader(); });
+    return singleton;
+}
+
+FileReader* FileReader::GetSingleton() { return init(); }
+
+bool FileReader::IsUsingIoUring() const { return ring != nullptr; }
+
+void FileReader::Read(const std::string& filePath, ReadCallback callback) {
+    auto request = std::make_shared<Request>();
+    request->filePath = filePath;
+    request->callback = std::move(callback);
+    Queue({request});
+}
+
+std::shared_future<FileReader::FileBuffer> FileReader::Read(
+    const std::string& filePath) {
+    return ReadBatch({filePath}).front();
+}
+
+std::vector<std::shared_future<FileReader::FileBuffer>> FileReader::ReadBatch(
+    const std::vector<std::string>& filePaths) {
+    std::vector<std::shared_ptr<Request>> requests;
+    std::vector<std::shared_future<FileBuffer>> futures;
+    for (auto& filePath : filePaths) {
+	auto promise = std::make_shared<std::promise<FileBuffer>>();
+	auto request = std::make_shared<Request>();
+	request->filePath = filePath;
+	request->callback = [promise](FileBuffer buffer,
+				      std::exception_ptr error) {
+	    if (error != nullptr)
+		promise->set_exception(error);
+	    else
+		promise->set_value(std::move(buffer));
+	};
+	futures.push_back(promise->get_future().share());
+	requests.push_back(std::move(request));
+    }
+    Queue(std::move(requests));
+    return futures;
+}
+
+void FileReader::Queue(std::vector<std::shared_ptr<Request>> requests) {
+    if (ring == nullptr) {
+	for (auto& request : requests)
+	    JobSystem::GetSingleton()->Push([request]() {
+		if (Open(*request)) ReadBlocking(*request);
+	    });
+	return;
+    }
+    {
+	std::unique_lock<std::mutex> lock(pendingMutex);
+	for (auto& request : requests) pending.push_back(std::move(request));
+    }
+    pendingCondition.notify_one();
+}
+
+std::exception_ptr FileReader::Error(const Request& request, int error) {
+    return std::make_exception_ptr(
+	CException(__LINE__, __FILE__, "FileReader",
+		   "Couldn't read " + request.filePath + ": " +
+		       strerror(error)));
+}
+
+void FileReader::Complete(Request& request, std::exception_ptr error) {
+#ifdef DUNIYA_POSIX_FILES
+    if (request.fd >= 0) close(request.fd);
+#endif
+    request.fd = -1;
+    request.callback(error == nullptr ? request.buffer : nullptr, error);
+}
+
+#ifdef DUNIYA_POSIX_FILES
+// Opens the file and sizes its buffer, false if the request is already done
+bool FileReader::Open(Request& request) {
+    request.fd = open(request.filePath.c_str(), O_RDONLY);
+    if (request.fd < 0) {
+	Complete(request, Error(request, errno));
+	return false;
+    }
+    struct stat fileStat;
+    if (fstat(request.fd, &fileStat) != 0) {
+	Complete(request, Error(request, errno));
+	return false;
+    }
+    request.buffer = std::make_shared<std::vector<char>>(fileStat.st_size);
+    if (fileStat.st_size == 0) {
+	Complete(request, nullptr);
+	return false;
+    }
+    return true;
+}
+
+void FileReader::ReadBlocking(Request& request) {
+    auto& buffer = *request.buffer;
+    while (request.done < buffer.size()) {
+	ssize_t result =
+	    pread(request.fd, buffer.data() + request.done,
+		  std::min(buffer.size() - request.done, maxReadSize),
+		  request.done);
+	if (result < 0 && errno == EINTR) continue;
+	if (result < 0) return Complete(request, Error(request, errno));
+	// The file shrank since it was opened
+	if (result == 0) break;
+	request.done += result;
+    }
+    buffer.resize(request.done);
+    Complete(request, nullptr);
+}
+#else
+// Without POSIX files, the file is sized up front and read in one go
+// through an ifstream
+bool FileReader::Open(Request& request) {
+    std::error_code error;
+    auto size = std::filesystem::file_size(request.filePath, error);
+    if (error) {
+	Complete(request, std::make_exception_ptr(CException(
+			      __LINE__, __FILE__, "FileReader",
+			      "Couldn't read " + request.filePath + ": " +
+				  error.message())));
+	return false;
+    }
+    request.buffer = std::make_shared<std::vector<char>>(size);
+    if (size == 0) {
+	Complete(request, nullptr);
+	return false;
+    }
+    return true;
+}
+
+void FileReader::ReadBlocking(Request& request) {
+    auto& buffer = *request.buffer;
+    std::ifstream file(request.filePath, std::ios::binary);
+    file.read(buffer.data(), buffer.size());
+    if (file.bad() || !file.is_open())
+	return Complete(request, Error(request, EIO));
+    // The file shrank since it was sized
+    request.done = file.gcount();
+    buffer.resize(request.done);
+    Complete(request, nullptr);
+}
+#endif
+
+#ifdef DUNIYA_HAS_IO_URING
+// A full submission queue is flushed to the kernel once, false if there's
+// still no room
+bool FileReader::SubmitRead(Request& request) {
+    io_uring_sqe* sqe = io_uring_get_sqe(&ring->ring);
+    if (sqe == nullptr && io_uring_submit(&ring->ring) >= 0)
+	sqe = io_uring_get_sqe(&ring->ring);
+    if (sqe == nullptr) return false;
+    io_uring_prep_read(
+	sqe, request.fd, request.buffer->data() + request.done,
+	std::min(request.buffer->size() - request.done, maxReadSize),
+	request.done);
+    io_uring_sqe_set_data(sqe, &request);
+    return true;
+}
+
+void FileReader::RingLoop() {
+    while (true) {
+	std::deque<std::shared_ptr<Request>> incoming;
+	{
+	    std::unique_lock<std::mutex> lock(pendingMutex);
+	    if (inflight.empty())
+		pendingCondition.wait(
+		    lock, [this]() { return quit || !pending.empty(); });
+	    if (quit && pending.empty() && inflight.empty()) return;
+	    while (!pending.empty() &&
+		   inflight.size() + incoming.size() < ringDepth) {
+		incoming.push_back(std::move(pending.front()));
+		pending.pop_front();
+	    }
+	}
+
+	// Everything that arrived since the last pass goes in one submit
+	bool submitted = false;
+	for (auto& request : incoming) {
+	    if (!Open(*request)) continue;
+	    if (!SubmitRead(*request)) {
+		Complete(*request, std::make_exception_ptr(CException(
+				       __LINE__, __FILE__, "FileReader",
+				       "submission queue is full")));
+		continue;
+	    }
+	    inflight[request.get()] = request;
+	    submitted = true;
+	}
+	if (submitted) io_uring_submit(&ring->ring);
+	if (inflight.empty()) continue;
+
+	// Wakes up now and then to pick up reads queued meanwhile
+	__kernel_timespec timeout = {0, 1000000};
+	io_uring_cqe* cqe = nullptr;
+	int result = io_uring_wait_cqe_timeout(&ring->ring, &cqe, &timeout);
+	bool resubmitted = false;
+	while (result == 0 && cqe != nullptr) {
+	    auto request = (Request*)io_uring_cqe_get_data(cqe);
+	    int readResult = cqe->res;
+	    io_uring_cqe_seen(&ring->ring, cqe);
+	    bool finished = true;
+	    std::exception_ptr error = nullptr;
+	    if (readResult == -EINTR || readResult == -EAGAIN) {
+		finished = false;
+	    } else if (readResult < 0) {
+		error = Error(*request, -readResult);
+	    } else if (readResult == 0) {
+		// The file shrank since it was opened
+		request->buffer->resize(request->done);
+	    } else {
+		request->done += readResult;
+		finished = request->done == request->buffer->size();
+	    }
+	    if (!finished && SubmitRead(*request)) {
+		resubmitted = true;
+	    } else {
+		if (!finished)
+		    error = std::make_exception_ptr(
+			CException(__LINE__, __FILE__, "FileReader",
+				   "submission queue is full"));
+		auto owner = std::move(inflight[request]);
+		inflight.erase(request);
+		Complete(*owner, error);
+	    }
+	    result = io_uring_peek_cqe(&ring->ring, &cqe);
+	}
+	if (resubmitted) io_uring_submit(&ring->ring);
+    }
+}
+#else
+bool FileReader::SubmitRead(Request&) { return false; }
+
+void FileReader::RingLoop() {}
+#endif
+
+FileBufferStream::Buffer::Buffer(char* begin, char* end) {
+    setg(begin, begin, end);
+}
+
+std::streambuf::pos_type FileBufferStream::Buffer::seekoff(
+    off_type offset, std::ios_base::seekdir dir,
+    std::ios_base::openmode which) {
+    char* base = dir == std::ios_base::beg   ? eback()
+		 : dir == std::ios_base::cur ? gptr()
+					     : egptr();
+    char* target = base + offset;
+    if (!(which & std::ios_base::in) || target < eback() || target > egptr())
+	return pos_type(off_type(-1));
+    setg(eback(), target, egptr());
+    return pos_type(target - eback());
+}
+
+std::streambuf::pos_type FileBufferStream::Buffer::seekpos(
+    pos_type pos, std::ios_base::openmode which) {
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+FileBufferStream::FileBufferStream(FileReader::FileBuffer buffer)
+    : std::istream(nullptr),
+      fileBuffer(std::move(buffer)),
+      streamBuffer(fileBuffer->data(),
+		   fileBuffer->data() + fileBuffer->size()) {
+    rdbuf(&streamBuffer);
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Reads whole files in the background. With io_uring every read queued
+// since the last submission goes to the kernel in one batch, so many small
+// reads overlap; without it each read is a pread on the job system.
+class FileReader {
+   public:
+    using FileBuffer = std::shared_ptr<std::vector<char>>;
+    // Called once the file is read, on the reader's thread, so anything
+    // heavier than handing the buffer on belongs on the job system
+    using ReadCallback = std::function<void(FileBuffer, std::exception_ptr)>;
+
+   private:
+    FileReader();
+
+   public:
+    ~FileReader();
+    static FileReader* init();
+    static FileReader* GetSingleton();
+
+    void Read(const std::string& filePath, ReadCallback callback);
+    std::shared_future<FileBuffer> Read(const std::string& filePath);
+    std::vector<std::shared_future<FileBuffer>> ReadBatch(
+	const std::vector<std::string>& filePaths);
+    bool IsUsingIoUring() const;
+
+   private:
+    struct Request {
+	std::string filePath;
+	ReadCallback callback;
+	int fd = -1;
+	FileBuffer buffer;
+	size_t done = 0;
+    };
+    struct Ring;
+
+    void Queue(std::vector<std::shared_ptr<Request>> requests);
+    static bool Open(Request& request);
+    static void ReadBlocking(Request& request);
+    static void Complete(Request& request, std::exception_ptr error);
+    static std::exception_ptr Error(const Request& request, int error);
+    void RingLoop();
+    bool SubmitRead(Request& request);
+
+   private:
+    std::unique_ptr<Ring> ring;
+    std::deque<std::shared_ptr<Request>> pending;
+    std::unordered_map<Request*, std::shared_ptr<Request>> inflight;
+    std::mutex pendingMutex;
+    std::condition_variable pendingCondition;
+    std::thread ringThread;
+    bool quit;
+
+   public:
+    static FileReader* singleton;
+};
+
+// Seekable istream over a buffer FileReader returned
+class FileBufferStream : public std::istream {
+    struct Buffer : public std::streambuf {
+	Buffer(char* begin, char* end);
+	pos_type seekoff(off_type offset, std::ios_base::seekdir dir,
+			 std::ios_base::openmode which) override;
+	pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+    };
+
+   public:
+    FileBufferStream(FileReader::FileBuffer buffer);
+
+   private:
+    FileReader::FileBuffer fileBuffer;
+    Buffer streamBuffer;
+};
@@ -0,0 +1,436 @@
+#include "BCnCodec.hpp"
+
+#include <Exception.hpp>
+#include <Graphics/MipGenerator.hpp>
+#include <JobSystem.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define DUNIYA_BCN_SSE
+#endif
+
+// Rows of blocks a job encodes
+constexpr uint32_t blockRowsPerJob = 4;
+constexpr uint32_t powerIterations = 8;
+
+// Palette order of the linear steps from endpoint 0 to endpoint 1
+constexpr uint8_t bc1Order[4] = {0, 2, 3, 1};
+constexpr uint8_t bc4Order[8] = {0, 2, 3, 4, 5, 6, 7, 1};
+constexpr uint8_t bc7Weights[16] = {0,  4,  9,  13, 17, 21, 26, 30,
+				    34, 38, 43, 47, 51, 55, 60, 64};
+
+bool IsBlockCompressed(Texture::Format format) {
+    return format == Texture::BC1 || format == Texture::BC3 ||
+	   format == Texture::BC4 || format == Texture::BC7;
+}
+
+uint32_t GetBlockSize(Texture::Format format) {
+    return format == Texture::BC1 || format == Texture::BC4 ? 8 : 16;
+}
+
+namespace {
+
+// Channels of the 16 pixels laid out for 4 wide SIMD
+struct alignas(16) Block {
+    float channel[4][16];
+};
+
+void LoadBlock(const uint8_t* level, uint32_t width, uint32_t height,
+	       uint32_t channels, uint32_t blockX, uint32_t blockY,
+	       Block& block) {
+    // Blocks hanging over the edge repeat the last row and column
+    for (uint32_t i = 0; i < 16; i++) {
+	uint32_t x = std::min(blockX * 4 + i % 4, width - 1);
+	uint32_t y = std::min(blockY * 4 + i / 4, height - 1);
+	const uint8_t* pixel = level + ((size_t)y * width + x) * channels;
+	for (uint32_t c = 0; c < 4; c++) {
+	    if (c < channels)
+		block.channel[c][i] = pixel[c];
+	    else
+		block.channel[c][i] = c == 3 ? 255.f : pixel[0];
+	}
+    }
+}
+
+// t[i] = dot(pixel[i] - origin, direction)
+void Project(const Block& block, const float origin[4],
+	     const float direction[4], float t[16]) {
+#ifdef DUNIYA_BCN_SSE
+    for (uint32_t i = 0; i < 16; i += 4) {
+	__m128 sum = _mm_setzero_ps();
+	for (uint32_t c = 0; c < 4; c++) {
+	    __m128 value = _mm_sub_ps(_mm_load_ps(&block.channel[c][i]),
+				      _mm_set1_ps(origin[c]));
+	    sum = _mm_add_ps(sum, _mm_mul_ps(value, _mm_set1_ps(direction[c])));
+	}
+	_mm_storeu_ps(t + i, sum);
+    }
+#else
+    for (uint32_t i = 0; i < 16; i++) {
+	t[i] = 0.f;
+	for (uint32_t c = 0; c < 4; c++)
+	    t[i] += (block.channel[c][i] - origin[c]) * direction[c];
+    }
+#endif
+}
+
+// Endpoints along the principal axis of the block's colors
+void FitEndpoints(const Block& block, uint32_t channels, float e0[4],
+		  float e1[4]) {
+    float mean[4] = {0.f, 0.f, 0.f, 0.f};
+    for (uint32_t c = 0; c < channels; c++) {
+	for (uint32_t i = 0; i < 16; i++) mean[c] += block.channel[c][i];
+	mean[c] /= 16.f;
+    }
+    float covariance[4][4] = {};
+    for (uint32_t i = 0; i < 16; i++)
+	for (uint32_t a = 0; a < channels; a++)
+	    for (uint32_t b = 0; b < channels; b++)
+		covariance[a][b] += (block.channel[a][i] - mean[a]) *
+				    (block.channel[b][i] - mean[b]);
+    float axis[4] = {1.f, 1.f, 1.f, channels == 4 ? 1.f : 0.f};
+    for (uint32_t iteration = 0; iteration < powerIterations; iteration++) {
+	float next[4] = {0.f, 0.f, 0.f, 0.f};
+	float length = 0.f;
+	for (uint32_t a = 0; a < channels; a++) {
+	    for (uint32_t b = 0; b < channels; b++)
+		next[a] += covariance[a][b] * axis[b];
+	    length = std::max(length, std::fabs(next[a]));
+	}
+	if (length == 0.f) break;
+	for (uint32_t a = 0; a < 4; a++) axis[a] = next[a] / length;
+    }
+    float t[16];
+    Project(block, mean, axis, t);
+    float tMin = *std::min_element(t, t + 16);
+    float tMax = *std::max_element(t, t + 16);
+    for (uint32_t c = 0; c < 4; c++) {
+	float base = c < channels ? mean[c] : 255.f;
+	float step = c < channels ? axis[c] : 0.f;
+	e0[c] = std::clamp(base + tMin * step, 0.f, 255.f);
+	e1[c] = std::clamp(base + tMax * step, 0.f, 255.f);
+    }
+}
+
+// Index of the nearest of steps evenly spaced points from e0 to e1
+void FitIndices(const Block& block, const float e0[4], const float e1[4],
+		uint32_t channels, uint32_t steps, uint8_t indices[16]) {
+    float direction[4] = {0.f, 0.f, 0.f, 0.f};
+    float lengthSquared = 0.f;
+    for (uint32_t c = 0; c < channels; c++) {
+	direction[c] = e1[c] - e0[c];
+	lengthSquared += direction[c] * direction[c];
+    }
+    if (lengthSquared == 0.f) {
+	memset(indices, 0, 16);
+	return;
+    }
+    for (uint32_t c = 0; c < 4; c++)
+	direction[c] *= (steps - 1) / lengthSquared;
+    float t[16];
+    Project(block, e0, direction, t);
+    for (uint32_t i = 0; i < 16; i++)
+	indices[i] = (uint8_t)std::clamp(t[i] + 0.5f, 0.f, steps - 1.f);
+}
+
+uint16_t Pack565(const float color[4]) {
+    uint32_t r = (uint32_t)(color[0] * 31.f / 255.f + 0.5f);
+    uint32_t g = (uint32_t)(color[1] * 63.f / 255.f + 0.5f);
+    uint32_t b = (uint32_t)(color[2] * 31.f / 255.f + 0.5f);
+    return (r << 11) | (g << 5) | b;
+}
+
+void Unpack565(uint16_t packed, float color[4]) {
+    uint32_t r = packed >> 11, g = (packed >> 5) & 0x3f, b = packed & 0x1f;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+    color[3] = 255.f;
+}
+
+void EncodeBC1(const Block& block, uint8_t* output) {
+    float e0[4], e1[4];
+    FitEndpoints(block, 3, e0, e1);
+    uint16_t c0 = Pack565(e0), c1 = Pack565(e1);
+    // c0 > c1 selects the four color mode
+    if (c0 < c1) std::swap(c0, c1);
+    uint32_t bits = 0;
+    if (c0 != c1) {
+	Unpack565(c0, e0);
+	Unpack565(c1, e1);
+	uint8_t indices[16];
+	FitIndices(block, e0, e1, 3, 4, indices);
+	for (uint32_t i = 0; i < 16; i++)
+	    bits |= (uint32_t)bc1Order[indices[i]] << (i * 2);
+    }
+    memcpy(output, &c0, 2);
+    memcpy(output + 2, &c1, 2);
+    memcpy(output + 4, &bits, 4);
+}
+
+void EncodeBC4(const float* values, uint8_t* output) {
+    uint8_t a0 = (uint8_t)(*std::max_element(values, values + 16) + 0.5f);
+    uint8_t a1 = (uint8_t)(*std::min_element(values, values + 16) + 0.5f);
+    uint64_t bits = 0;
+    if (a0 != a1) {
+	float scale = 7.f / (a0 - a1);
+	for (uint32_t i = 0; i < 16; i++) {
+	    uint32_t step =
+		(uint32_t)std::clamp((a0 - values[i]) * scale + 0.5f, 0.f, 7.f);
+	    bits |= (uint64_t)bc4Order[step] << (i * 3);
+	}
+    }
+    output[0] = a0;
+    output[1] = a1;
+    for (uint32_t i = 0; i < 6; i++) output[2 + i] = (uint8_t)(bits >> (i * 8));
+}
+
+struct BitWriter {
+    uint8_t* data;
+    uint32_t position = 0;
+    void Write(uint32_t value, uint32_t count) {
+	for (uint32_t i = 0; i < count; i++, position++)
+	    if (value & (1u << i)) data[position / 8] |= 1 << (position % 8);
+    }
+};
+
+struct BitReader {
+    const uint8_t* data;
+    uint32_t position = 0;
+    uint32_t Read(uint32_t count) {
+	uint32_t value = 0;
+	for (uint32_t i = 0; i < count; i++, position++)
+	    value |= ((data[position / 8] >> (position % 8)) & 1) << i;
+	return value;
+    }
+};
+
+// 7 bit endpoint plus the shared low bit that fits it best
+void QuantizeBC7Endpoint(const float endpoint[4], uint8_t quantized[4],
+			 uint32_t& pBit) {
+    float bestError = -1.f;
+    for (uint32_t p = 0; p < 2; p++) {
+	uint8_t candidate[4];
+	float error = 0.f;
+	for (uint32_t c = 0; c < 4; c++) {
+	    candidate[c] = (uint8_t)std::clamp(
+		std::floor((endpoint[c] - p) / 2.f + 0.5f), 0.f, 127.f);
+	    float difference = ((candidate[c] << 1) | p) - endpoint[c];
+	    error += difference * difference;
+	}
+	if (bestError < 0.f || error < bestError) {
+	    bestError = error;
+	    pBit = p;
+	    memcpy(quantized, candidate, 4);
+	}
+    }
+}
+
+void EncodeBC7(const Block& block, uint8_t* output) {
+    float e0[4], e1[4];
+    FitEndpoints(block, 4, e0, e1);
+    uint8_t q0[4], q1[4];
+    uint32_t p0, p1;
+    QuantizeBC7Endpoint(e0, q0, p0);
+    QuantizeBC7Endpoint(e1, q1, p1);
+    for (uint32_t c = 0; c < 4; c++) {
+	e0[c] = (q0[c] << 1) | p0;
+	e1[c] = (q1[c] << 1) | p1;
+    }
+    uint8_t indices[16];
+    FitIndices(block, e0, e1, 4, 16, indices);
+    // The first index has its top bit implied to be 0
+    if (indices[0] >= 8) {
+	std::swap(q0, q1);
+	std::swap(p0, p1);
+	for (auto& index : indices) index = 15 - index;
+    }
+    memset(output, 0, 16);
+    BitWriter writer{output};
+    writer.Write(1 << 6, 7);
+    for (uint32_t c = 0; c < 4; c++) {
+	writer.Write(q0[c], 7);
+	writer.Write(q1[c], 7);
+    }
+    writer.Write(p0, 1);
+    writer.Write(p1, 1);
+    for (uint32_t i = 0; i < 16; i++) writer.Write(indices[i], i == 0 ? 3 : 4);
+}
+
+void EncodeBlock(Texture::Format format, const Block& block,
+		 uint8_t* output) {
+    switch (format) {
+	case Texture::BC1:
+	    EncodeBC1(block, output);
+	    break;
+	case Texture::BC3:
+	    EncodeBC4(block.channel[3], output);
+	    EncodeBC1(block, output + 8);
+	    break;
+	case Texture::BC4:
+	    EncodeBC4(block.channel[0], output);
+	    break;
+	case Texture::BC7:
+	    EncodeBC7(block, output);
+	    break;
+	default:
+	    break;
+    };
+}
+
+// Blocks decode to 16 RGBA pixels, BC4 writes one channel every stride
+// bytes
+void DecodeBC1(const uint8_t* input, uint8_t* pixels, bool opaque) {
+    uint16_t c0, c1;
+    uint32_t bits;
+    memcpy(&c0, input, 2);
+    memcpy(&c1, input + 2, 2);
+    memcpy(&bits, input + 4, 4);
+    float colors[4][4];
+    Unpack565(c0, colors[0]);
+    Unpack565(c1, colors[1]);
+    for (uint32_t c = 0; c < 4; c++) {
+	if (c0 > c1 || opaque) {
+	    colors[2][c] = (2.f * colors[0][c] + colors[1][c]) / 3.f;
+	    colors[3][c] = (colors[0][c] + 2.f * colors[1][c]) / 3.f;
+	} else {
+	    // Three colors and transparent black
+	    colors[2][c] = (colors[0][c] + colors[1][c]) / 2.f;
+	    colors[3][c] = 0.f;
+	}
+    }
+    for (uint32_t i = 0; i < 16; i++) {
+	float* color = colors[(bits >> (i * 2)) & 3];
+	for (uint32_t c = 0; c < 4; c++)
+	    pixels[i * 4 + c] = (uint8_t)(color[c] + 0.5f);
+    }
+}
+
+void DecodeBC4(const uint8_t* input, uint8_t* pixels, uint32_t stride) {
+    uint32_t a0 = input[0], a1 = input[1];
+    uint8_t values[8] = {(uint8_t)a0, (uint8_t)a1};
+    for (uint32_t k = 2; k < 8; k++) {
+	if (a0 > a1)
+	    values[k] = ((8 - k) * a0 + (k - 1) * a1 + 3) / 7;
+	else if (k < 6)
+	    values[k] = ((6 - k) * a0 + (k - 1) * a1 + 2) / 5;
+	else
+	    values[k] = k == 6 ? 0 : 255;
+    }
+    uint64_t bits = 0;
+    for (uint32_t i = 0; i < 6; i++) bits |= (uint64_t)input[2 + i] << (i * 8);
+    for (uint32_t i = 0; i < 16; i++)
+	pixels[i * stride] = values[(bits >> (i * 3)) & 7];
+}
+
+void DecodeBC7(const uint8_t* input, uint8_t* pixels) {
+    // Only mode 6 is written by EncodeBC7, other modes show up magenta
+    if ((input[0] & 0x7f) != 1 << 6) {
+	for (uint32_t i = 0; i < 16; i++) {
+	    uint8_t magenta[4] = {255, 0, 255, 255};
+	    memcpy(pixels + i * 4, magenta, 4);
+	}
+	return;
+    }
+    BitReader reader{input, 7};
+    uint32_t e[2][4];
+    for (uint32_t c = 0; c < 4; c++) {
+	e[0][c] = reader.Read(7) << 1;
+	e[1][c] = reader.Read(7) << 1;
+    }
+    uint32_t p0 = reader.Read(1), p1 = reader.Read(1);
+    for (uint32_t c = 0; c < 4; c++) {
+	e[0][c] |= p0;
+	e[1][c] |= p1;
+    }
+    for (uint32_t i = 0; i < 16; i++) {
+	uint32_t weight = bc7Weights[reader.Read(i == 0 ? 3 : 4)];
+	for (uint32_t c = 0; c < 4; c++)
+	    pixels[i * 4 + c] =
+		((64 - weight) * e[0][c] + weight * e[1][c] + 32) >> 6;
+    }
+}
+
+void DecodeBlock(Texture::Format format, const uint8_t* input,
+		 uint8_t* pixels) {
+    switch (format) {
+	case Texture::BC1:
+	    DecodeBC1(input, pixels, false);
+	    break;
+	case Texture::BC3:
+	    DecodeBC1(input + 8, pixels, true);
+	    DecodeBC4(input, pixels + 3, 4);
+	    break;
+	case Texture::BC4:
+	    DecodeBC4(input, pixels, 1);
+	    break;
+	case Texture::BC7:
+	    DecodeBC7(input, pixels);
+	    break;
+	default:
+	    break;
+    };
+}
+
+}  // namespace
+
+Texture EncodeBlocks(const Texture& source, const uint8_t* chain,
+		     Texture::Format format, std::vector<uint8_t>& output) {
+    if (IsBlockCompressed(source.format) || !IsBlockCompressed(format))
+	throw CException(__LINE__, __FILE__, "BCnCodec",
+			 "can only encode uncompressed textures to blocks");
+    Texture encoded = source;
+    encoded.format = format;
+    encoded.mipLevels = std::max(source.mipLevels, 1u);
+    output.resize(GetMipChainSize(encoded));
+    uint32_t channels = GetChannelCount(source.format);
+    uint32_t blockSize = GetBlockSize(format);
+    for (uint32_t level = 0; level < encoded.mipLevels; level++) {
+	const uint8_t* pixels = chain + GetMipLevelOffset(source, level);
+	uint8_t* blocks = output.data() + GetMipLevelOffset(encoded, level);
+	uint32_t width = GetMipWidth(source, level);
+	uint32_t height = GetMipHeight(source, level);
+	uint32_t blocksWide = (width + 3) / 4;
+	JobSystem::GetSingleton()->ParallelFor(
+	    (height + 3) / 4, blockRowsPerJob,
+	    [&](uint32_t begin, uint32_t end) {
+		Block block;
+		for (uint32_t y = begin; y < end; y++)
+		    for (uint32_t x = 0; x < blocksWide; x++) {
+			LoadBlock(pixels, width, height, channels, x, y,
+				  block);
+			EncodeBlock(format, block,
+				    blocks + ((size_t)y * blocksWide + x) *
+						 blockSize);
+		    }
+	    });
+    }
+    return encoded;
+}
+
+void DecodeBlocks(const Texture& texture, const uint8_t* chain,
+		  uint32_t level, std::vector<uint8_t>& output) {
+    uint32_t width = GetMipWidth(texture, level);
+    uint32_t height = GetMipHeight(texture, level);
+    uint32_t channels = texture.format == Texture::BC4 ? 1 : 4;
+    uint32_t blockSize = GetBlockSize(texture.format);
+    uint32_t blocksWide = (width + 3) / 4;
+    const uint8_t* blocks = chain + GetMipLevelOffset(texture, level);
+    output.resize((size_t)width * height * channels);
+    uint8_t pixels[16 * 4];
+    for (uint32_t by = 0; by < (height + 3) / 4; by++)
+	for (uint32_t bx = 0; bx < blocksWide; bx++) {
+	    DecodeBlock(texture.format,
+			blocks + ((size_t)by * blocksWide + bx) * blockSize,
+			pixels);
+	    // Blocks hanging over the edge are cropped
+	    for (uint32_t i = 0; i < 16; i++) {
+		uint32_t x = bx * 4 + i % 4, y = by * 4 + i / 4;
+		if (x >= width || y >= height) continue;
+		memcpy(&output[((size_t)y * width + x) * channels],
+		       pixels + i * channels, channels);
+	    }
+	}
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <ECS/GraphicsComponent.hpp>
+#include <cstdint>
+#include <vector>
+
+// Block compression of 4x4 pixel blocks. BC1 is opaque RGB, BC3 adds a
+// separate alpha block, BC4 is a single channel and BC7 is written in mode 6
+// only (one subset, RGBA endpoints with 4 bit indices).
+
+bool IsBlockCompressed(Texture::Format format);
+// Bytes per 4x4 block
+uint32_t GetBlockSize(Texture::Format format);
+
+// source is an RGBA chain, or an R chain for BC4. Returns the texture
+// describing the encoded chain written to output.
+Texture EncodeBlocks(const Texture& source, const uint8_t* chain,
+		     Texture::Format format, std::vector<uint8_t>& output);
+// Decodes one level back to RGBA, R for BC4
+void DecodeBlocks(const Texture& texture, const uint8_t* chain,
+		  uint32_t level, std::vector<uint8_t>& output);
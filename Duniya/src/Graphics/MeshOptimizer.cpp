@@ -0,0 +1,292 @@
+#include "MeshOptimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+// Cache the Forsyth scores are tuned for and their weights
+constexpr uint32_t forsythCacheSize = 32;
+constexpr float lastTriangleScore = 0.75f;
+constexpr float cacheDecayPower = 1.5f;
+constexpr float valenceBoostScale = 2.f;
+constexpr float valenceBoostPower = 0.5f;
+// Valences above this share the smallest boost
+constexpr uint32_t maxScoredValence = 64;
+
+VertexCacheStatistics AnalyzeVertexCache(const uint32_t* indices,
+					 uint32_t indexCount,
+					 uint32_t vertexCount,
+					 uint32_t cacheSize) {
+    // FIFO like the post transform caches of most hardware
+    std::vector<uint32_t> insertedAt(vertexCount, 0);
+    std::vector<uint8_t> used(vertexCount, 0);
+    uint32_t misses = 0, usedCount = 0;
+    for (uint32_t i = 0; i < indexCount; i++) {
+	uint32_t vertex = indices[i];
+	if (!used[vertex]) {
+	    used[vertex] = 1;
+	    usedCount++;
+	}
+	// Still cached until cacheSize misses have come after it
+	if (insertedAt[vertex] != 0 && misses - insertedAt[vertex] < cacheSize)
+	    continue;
+	misses++;
+	insertedAt[vertex] = misses;
+    }
+    VertexCacheStatistics statistics;
+    uint32_t triangleCount = indexCount / 3;
+    statistics.acmr = triangleCount ? (float)misses / triangleCount : 0.f;
+    statistics.atvr = usedCount ? (float)misses / usedCount : 0.f;
+    return statistics;
+}
+
+namespace {
+
+struct ForsythScores {
+    float cache[forsythCacheSize];
+    float valence[maxScoredValence + 1];
+    ForsythScores() {
+	for (uint32_t i = 0; i < forsythCacheSize; i++) {
+	    if (i < 3) {
+		cache[i] = lastTriangleScore;
+	    } else {
+		float scale = 1.f / (forsythCacheSize - 3);
+		cache[i] =
+		    std::pow(1.f - (i - 3) * scale, cacheDecayPower);
+	    }
+	}
+	valence[0] = 0.f;
+	for (uint32_t i = 1; i <= maxScoredValence; i++)
+	    valence[i] =
+		valenceBoostScale * std::pow((float)i, -valenceBoostPower);
+    }
+    // cachePosition is -1 for vertices outside the cache
+    float Get(int32_t cachePosition, uint32_t remaining) const {
+	if (remaining == 0) return -1.f;
+	float score = cachePosition >= 0 ? cache[cachePosition] : 0.f;
+	return score + valence[std::min(remaining, maxScoredValence)];
+    }
+};
+
+}  // namespace
+
+void OptimizeVertexCache(uint32_t* indices, uint32_t indexCount,
+			 uint32_t vertexCount) {
+    static const ForsythScores scores;
+    uint32_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) return;
+
+    // Triangles of every vertex in one array
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (uint32_t i = 0; i < indexCount; i++) offsets[indices[i] + 1]++;
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    std::vector<uint32_t> remaining(vertexCount);
+    for (uint32_t v = 0; v < vertexCount; v++)
+	remaining[v] = offsets[v + 1] - offsets[v];
+    std::vector<uint32_t> adjacency(indexCount);
+    {
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+	for (uint32_t i = 0; i < indexCount; i++)
+	    adjacency[fill[indices[i]]++] = i / 3;
+    }
+
+    std::vector<int32_t> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (uint32_t v = 0; v < vertexCount; v++)
+	vertexScore[v] = scores.Get(-1, remaining[v]);
+    std::vector<float> triangleScore(triangleCount);
+    for (uint32_t t = 0; t < triangleCount; t++)
+	triangleScore[t] = vertexScore[indices[t * 3]] +
+			   vertexScore[indices[t * 3 + 1]] +
+			   vertexScore[indices[t * 3 + 2]];
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    std::vector<uint32_t> result;
+    result.reserve(indexCount);
+
+    // The three extra slots hold the vertices pushed out by the newest
+    // triangle until their scores are updated
+    uint32_t cache[forsythCacheSize + 3], nextCache[forsythCacheSize + 3];
+    uint32_t cacheCount = 0;
+    uint32_t scanStart = 0;
+    int64_t best = 0;
+    for (uint32_t t = 1; t < triangleCount; t++)
+	if (triangleScore[t] > triangleScore[best]) best = t;
+
+    while (best >= 0) {
+	emitted[best] = 1;
+	const uint32_t* triangle = indices + best * 3;
+	uint32_t nextCount = 0;
+	for (uint32_t k = 0; k < 3; k++) {
+	    uint32_t v = triangle[k];
+	    result.push_back(v);
+	    nextCache[nextCount++] = v;
+	    // Drop the triangle from the vertex's list
+	    uint32_t* begin = adjacency.data() + offsets[v];
+	    uint32_t* end = begin + remaining[v];
+	    uint32_t* found = std::find(begin, end, (uint32_t)best);
+	    if (found == end) continue;
+	    std::swap(*found, *(end - 1));
+	    remaining[v]--;
+	}
+	for (uint32_t i = 0; i < cacheCount; i++) {
+	    uint32_t v = cache[i];
+	    if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+		nextCache[nextCount++] = v;
+	}
+
+	// Rescore what moved in the cache, the best triangle is among theirs
+	best = -1;
+	float bestScore = -1.f;
+	for (uint32_t i = 0; i < nextCount; i++) {
+	    uint32_t v = nextCache[i];
+	    cachePosition[v] = i < forsythCacheSize ? (int32_t)i : -1;
+	    float score = scores.Get(cachePosition[v], remaining[v]);
+	    float delta = score - vertexScore[v];
+	    vertexScore[v] = score;
+	    for (uint32_t j = 0; j < remaining[v]; j++) {
+		uint32_t t = adjacency[offsets[v] + j];
+		triangleScore[t] += delta;
+		if (triangleScore[t] > bestScore) {
+		    bestScore = triangleScore[t];
+		    best = t;
+		}
+	    }
+	}
+	cacheCount = std::min(nextCount, forsythCacheSize);
+	memcpy(cache, nextCache, cacheCount * sizeof(uint32_t));
+
+	// Nothing left around the cache, carry on from the next triangle
+	if (best < 0) {
+	    while (scanStart < triangleCount && emitted[scanStart])
+		scanStart++;
+	    if (scanStart < triangleCount) best = scanStart;
+	}
+    }
+    memcpy(indices, result.data(), result.size() * sizeof(uint32_t));
+}
+
+void OptimizeOverdraw(uint32_t* indices, uint32_t indexCount,
+		      const float* positions, size_t positionStride,
+		      uint32_t vertexCount) {
+    uint32_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) return;
+    auto Position = [&](uint32_t vertex) {
+	return (const float*)((const uint8_t*)positions +
+			      vertex * positionStride);
+    };
+
+    // A triangle missing all three vertices starts a new cluster
+    std::vector<uint32_t> clusterStarts;
+    {
+	const uint32_t cacheSize = 16;
+	std::vector<uint32_t> insertedAt(vertexCount, 0);
+	uint32_t misses = 0;
+	for (uint32_t t = 0; t < triangleCount; t++) {
+	    uint32_t triangleMisses = 0;
+	    for (uint32_t k = 0; k < 3; k++) {
+		uint32_t v = indices[t * 3 + k];
+		if (insertedAt[v] != 0 && misses - insertedAt[v] < cacheSize)
+		    continue;
+		insertedAt[v] = ++misses;
+		triangleMisses++;
+	    }
+	    if (t == 0 || triangleMisses == 3) clusterStarts.push_back(t);
+	}
+    }
+    uint32_t clusterCount = clusterStarts.size();
+    clusterStarts.push_back(triangleCount);
+
+    // Area weighted centroid and normal of every cluster and of the mesh
+    std::vector<float> clusterData(clusterCount * 6, 0.f);
+    float meshCentroid[3] = {0.f, 0.f, 0.f};
+    float meshArea = 0.f;
+    for (uint32_t c = 0; c < clusterCount; c++) {
+	float* centroid = &clusterData[c * 6];
+	float* normal = centroid + 3;
+	float clusterArea = 0.f;
+	for (uint32_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++) {
+	    const float* a = Position(indices[t * 3]);
+	    const float* b = Position(indices[t * 3 + 1]);
+	    const float* p = Position(indices[t * 3 + 2]);
+	    float ab[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+	    float ac[3] = {p[0] - a[0], p[1] - a[1], p[2] - a[2]};
+	    float n[3] = {ab[1] * ac[2] - ab[2] * ac[1],
+			  ab[2] * ac[0] - ab[0] * ac[2],
+			  ab[0] * ac[1] - ab[1] * ac[0]};
+	    float area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+	    for (uint32_t k = 0; k < 3; k++) {
+		centroid[k] += (a[k] + b[k] + p[k]) / 3.f * area;
+		normal[k] += n[k];
+	    }
+	    clusterArea += area;
+	}
+	for (uint32_t k = 0; k < 3; k++) meshCentroid[k] += centroid[k];
+	meshArea += clusterArea;
+	if (clusterArea > 0.f)
+	    for (uint32_t k = 0; k < 3; k++) centroid[k] /= clusterArea;
+    }
+    if (meshArea > 0.f)
+	for (uint32_t k = 0; k < 3; k++) meshCentroid[k] /= meshArea;
+
+    std::vector<float> sortKeys(clusterCount);
+    for (uint32_t c = 0; c < clusterCount; c++) {
+	const float* centroid = &clusterData[c * 6];
+	const float* normal = centroid + 3;
+	float length = std::sqrt(normal[0] * normal[0] +
+				 normal[1] * normal[1] + normal[2] * normal[2]);
+	float key = 0.f;
+	for (uint32_t k = 0; k < 3; k++)
+	    key += (centroid[k] - meshCentroid[k]) * normal[k];
+	sortKeys[c] = length > 0.f ? key / length : 0.f;
+    }
+    std::vector<uint32_t> order(clusterCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+	return sortKeys[a] > sortKeys[b];
+    });
+
+    std::vector<uint32_t> result;
+    result.reserve(indexCount);
+    for (auto c : order)
+	result.insert(result.end(), indices + clusterStarts[c] * 3,
+		      indices + clusterStarts[c + 1] * 3);
+    memcpy(indices, result.data(), result.size() * sizeof(uint32_t));
+}
+
+uint32_t OptimizeVertexFetch(void* vertices, size_t vertexSize,
+			     uint32_t* indices, uint32_t indexCount,
+			     uint32_t vertexCount) {
+    const uint32_t unused = ~0u;
+    std::vector<uint32_t> remap(vertexCount, unused);
+    uint32_t nextVertex = 0;
+    for (uint32_t i = 0; i < indexCount; i++) {
+	uint32_t& target = remap[indices[i]];
+	if (target == unused) target = nextVertex++;
+	indices[i] = target;
+    }
+    std::vector<uint8_t> reordered((size_t)nextVertex * vertexSize);
+    for (uint32_t v = 0; v < vertexCount; v++)
+	if (remap[v] != unused)
+	    memcpy(reordered.data() + remap[v] * vertexSize,
+		   (uint8_t*)vertices + v * vertexSize, vertexSize);
+    memcpy(vertices, reordered.data(), reordered.size());
+    return nextVertex;
+}
+
+uint32_t OptimizeMesh(void* vertices, size_t vertexSize, uint32_t* indices,
+		      uint32_t indexCount, uint32_t vertexCount,
+		      VertexCacheStatistics* before,
+		      VertexCacheStatistics* after) {
+    if (before != nullptr)
+	*before = AnalyzeVertexCache(indices, indexCount, vertexCount);
+    OptimizeVertexCache(indices, indexCount, vertexCount);
+    OptimizeOverdraw(indices, indexCount, (const float*)vertices, vertexSize,
+		     vertexCount);
+    vertexCount = OptimizeVertexFetch(vertices, vertexSize, indices,
+				      indexCount, vertexCount);
+    if (after != nullptr)
+	*after = AnalyzeVertexCache(indices, indexCount, vertexCount);
+    return vertexCount;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Reorders indexed triangle lists for the GPU. Run them in the order
+// below, each one keeps what the previous ones did as far as it can.
+// positions point to 3 floats every positionStride bytes.
+
+struct VertexCacheStatistics {
+    // Vertices transformed per triangle, 0.5 is the best a regular grid
+    // can do and 3 the worst
+    float acmr;
+    // Vertices transformed per vertex, 1 is ideal
+    float atvr;
+};
+
+VertexCacheStatistics AnalyzeVertexCache(const uint32_t* indices,
+					 uint32_t indexCount,
+					 uint32_t vertexCount,
+					 uint32_t cacheSize = 16);
+// Tom Forsyth's linear speed vertex cache optimization
+void OptimizeVertexCache(uint32_t* indices, uint32_t indexCount,
+			 uint32_t vertexCount);
+// Splits the triangles where the cache runs cold and puts the clusters
+// facing away from the mesh's center first, they tend to occlude the rest
+void OptimizeOverdraw(uint32_t* indices, uint32_t indexCount,
+		      const float* positions, size_t positionStride,
+		      uint32_t vertexCount);
+// Moves vertices into the order the indices first use them and drops the
+// unused ones, returns the new vertex count
+uint32_t OptimizeVertexFetch(void* vertices, size_t vertexSize,
+			     uint32_t* indices, uint32_t indexCount,
+			     uint32_t vertexCount);
+
+// All three passes on a mesh whose vertices start with the position,
+// before and after hold the cache statistics if given
+uint32_t OptimizeMesh(void* vertices, size_t vertexSize, uint32_t* indices,
+		      uint32_t indexCount, uint32_t vertexCount,
+		      VertexCacheStatistics* before = nullptr,
+		      VertexCacheStatistics* after = nullptr);
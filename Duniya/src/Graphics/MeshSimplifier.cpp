@@ -0,0 +1,325 @@
+#include "MeshSimplifier.hpp"
+
+#include <Graphics/MeshOptimizer.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+// Coarsest a level may get, relative to the bounding radius
+constexpr float maxLodError = 0.1f;
+// A level has to drop at least this share of the previous one's triangles
+constexpr float minLodReduction = 0.2f;
+// Collapses flipping a triangle's normal further than this are rejected
+constexpr double minCollapseNormalDot = 0.25;
+
+namespace {
+
+// Sum of squared distances to the planes of the vertex's triangles,
+// weighted by their area
+struct Quadric {
+    double a2, b2, c2, d2, ab, ac, ad, bc, bd, cd, weight;
+
+    void AddPlane(double a, double b, double c, double d, double w) {
+	a2 += w * a * a;
+	b2 += w * b * b;
+	c2 += w * c * c;
+	d2 += w * d * d;
+	ab += w * a * b;
+	ac += w * a * c;
+	ad += w * a * d;
+	bc += w * b * c;
+	bd += w * b * d;
+	cd += w * c * d;
+	weight += w;
+    }
+    void Add(const Quadric& other) {
+	a2 += other.a2;
+	b2 += other.b2;
+	c2 += other.c2;
+	d2 += other.d2;
+	ab += other.ab;
+	ac += other.ac;
+	ad += other.ad;
+	bc += other.bc;
+	bd += other.bd;
+	cd += other.cd;
+	weight += other.weight;
+    }
+    // Mean squared distance of the point to the planes
+    double Error(const Vect4& p) const {
+	double x = p.x, y = p.y, z = p.z;
+	double error = a2 * x * x + b2 * y * y + c2 * z * z +
+		       2 * (ab * x * y + ac * x * z + bc * y * z) +
+		       2 * (ad * x + bd * y + cd * z) + d2;
+	return weight > 0 ? std::fabs(error) / weight : 0;
+    }
+};
+
+struct Collapse {
+    uint32_t from, to;
+    double error;
+};
+
+void Cross(const Vect4& a, const Vect4& b, const Vect4& c, double* normal) {
+    double e1[3] = {b.x - a.x, b.y - a.y, b.z - a.z};
+    double e2[3] = {c.x - a.x, c.y - a.y, c.z - a.z};
+    normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+// Vertices at the same position share the first one of them
+std::vector<uint32_t> WeldPositions(const Vertex* vertices,
+				    uint32_t vertexCount,
+				    std::vector<uint32_t>& wedgeCount) {
+    struct PositionHash {
+	size_t operator()(const Vect4& p) const {
+	    uint32_t bits[3];
+	    memcpy(&bits[0], &p.x, 4);
+	    memcpy(&bits[1], &p.y, 4);
+	    memcpy(&bits[2], &p.z, 4);
+	    return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^
+		   (bits[2] * 83492791u);
+	}
+    };
+    struct PositionEqual {
+	bool operator()(const Vect4& a, const Vect4& b) const {
+	    return a.x == b.x && a.y == b.y && a.z == b.z;
+	}
+    };
+    std::unordered_map<Vect4, uint32_t, PositionHash, PositionEqual> first;
+    first.reserve(vertexCount);
+    std::vector<uint32_t> remap(vertexCount);
+    wedgeCount.assign(vertexCount, 0);
+    for (uint32_t i = 0; i < vertexCount; i++) {
+	remap[i] = first.emplace(vertices[i].aPos, i).first->second;
+	wedgeCount[remap[i]]++;
+    }
+    return remap;
+}
+
+// Borders, seams and non manifold edges keep their vertices in place
+std::vector<uint8_t> FindLockedVertices(const uint32_t* indices,
+					uint32_t indexCount,
+					const std::vector<uint32_t>& remap,
+					const std::vector<uint32_t>& wedgeCount) {
+    std::unordered_map<uint64_t, uint32_t> edges;
+    edges.reserve(indexCount);
+    for (uint32_t i = 0; i < indexCount; i += 3) {
+	for (uint32_t e = 0; e < 3; e++) {
+	    uint64_t a = remap[indices[i + e]];
+	    uint64_t b = remap[indices[i + (e + 1) % 3]];
+	    edges[a << 32 | b]++;
+	}
+    }
+    std::vector<uint8_t> locked(remap.size(), 0);
+    for (uint32_t i = 0; i < remap.size(); i++)
+	locked[i] = wedgeCount[remap[i]] > 1;
+    for (auto& edge : edges) {
+	uint64_t a = edge.first >> 32, b = edge.first & 0xffffffffu;
+	auto opposite = edges.find(b << 32 | a);
+	if (edge.second != 1 || opposite == edges.end() ||
+	    opposite->second != 1) {
+	    locked[a] = 1;
+	    locked[b] = 1;
+	}
+    }
+    // Locks reach every wedge of a position
+    for (uint32_t i = 0; i < remap.size(); i++)
+	if (locked[i]) locked[remap[i]] = 1;
+    for (uint32_t i = 0; i < remap.size(); i++)
+	locked[i] = locked[remap[i]];
+    return locked;
+}
+
+bool FlipsTriangle(const Vertex* vertices, const uint32_t* triangle,
+		   uint32_t from, uint32_t to) {
+    Vect4 before[3], after[3];
+    for (uint32_t k = 0; k < 3; k++) {
+	before[k] = vertices[triangle[k]].aPos;
+	after[k] = vertices[triangle[k] == from ? to : triangle[k]].aPos;
+    }
+    double n0[3], n1[3];
+    Cross(before[0], before[1], before[2], n0);
+    Cross(after[0], after[1], after[2], n1);
+    double dot = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2];
+    double length0 = std::sqrt(n0[0] * n0[0] + n0[1] * n0[1] + n0[2] * n0[2]);
+    double length1 = std::sqrt(n1[0] * n1[0] + n1[1] * n1[1] + n1[2] * n1[2]);
+    return dot <= minCollapseNormalDot * length0 * length1;
+}
+
+float GetBoundingRadius(const Vertex* vertices, uint32_t vertexCount,
+			Vect3& center) {
+    if (vertexCount == 0) {
+	center = Vect3();
+	return 0.f;
+    }
+    Vect3 low(vertices[0].aPos.x, vertices[0].aPos.y, vertices[0].aPos.z);
+    Vect3 high = low;
+    for (uint32_t i = 1; i < vertexCount; i++) {
+	auto& p = vertices[i].aPos;
+	low = Vect3(std::min(low.x, p.x), std::min(low.y, p.y),
+		    std::min(low.z, p.z));
+	high = Vect3(std::max(high.x, p.x), std::max(high.y, p.y),
+		     std::max(high.z, p.z));
+    }
+    center = Vect3((low.x + high.x) * .5f, (low.y + high.y) * .5f,
+		   (low.z + high.z) * .5f);
+    float radius = 0.f;
+    for (uint32_t i = 0; i < vertexCount; i++) {
+	auto& p = vertices[i].aPos;
+	float dx = p.x - center.x, dy = p.y - center.y, dz = p.z - center.z;
+	radius = std::max(radius, dx * dx + dy * dy + dz * dz);
+    }
+    return std::sqrt(radius);
+}
+
+}  // namespace
+
+uint32_t SimplifyMesh(const Vertex* vertices, uint32_t vertexCount,
+		      const uint32_t* indices, uint32_t indexCount,
+		      uint32_t targetIndexCount, float maxError,
+		      uint32_t* result, float* error) {
+    std::copy(indices, indices + indexCount, result);
+    if (error != nullptr) *error = 0.f;
+    Vect3 center;
+    double radius = GetBoundingRadius(vertices, vertexCount, center);
+    if (indexCount <= targetIndexCount || radius == 0) return indexCount;
+    double maxSquaredError = maxError * radius * maxError * radius;
+
+    std::vector<uint32_t> wedgeCount;
+    auto remap = WeldPositions(vertices, vertexCount, wedgeCount);
+    auto locked = FindLockedVertices(indices, indexCount, remap, wedgeCount);
+
+    std::vector<Quadric> quadrics(vertexCount, Quadric());
+    for (uint32_t i = 0; i < indexCount; i += 3) {
+	double normal[3];
+	auto& p0 = vertices[indices[i]].aPos;
+	Cross(p0, vertices[indices[i + 1]].aPos,
+	      vertices[indices[i + 2]].aPos, normal);
+	double length = std::sqrt(normal[0] * normal[0] +
+				  normal[1] * normal[1] +
+				  normal[2] * normal[2]);
+	if (length == 0) continue;
+	double a = normal[0] / length, b = normal[1] / length,
+	       c = normal[2] / length;
+	double d = -(a * p0.x + b * p0.y + c * p0.z);
+	for (uint32_t k = 0; k < 3; k++)
+	    quadrics[indices[i + k]].AddPlane(a, b, c, d, length * .5);
+    }
+
+    double largestError = 0;
+    std::vector<uint32_t> collapsed(vertexCount);
+    std::vector<uint8_t> touched(vertexCount);
+    std::vector<uint32_t> triangleOffsets(vertexCount + 1);
+    std::vector<uint32_t> triangles;
+    std::vector<Collapse> collapses;
+    // Every pass collapses edges which don't share triangles, cheapest
+    // first, and rebuilds the adjacency for the next one
+    while (indexCount > targetIndexCount) {
+	std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+	for (uint32_t i = 0; i < indexCount; i++)
+	    triangleOffsets[result[i] + 1]++;
+	for (uint32_t i = 0; i < vertexCount; i++)
+	    triangleOffsets[i + 1] += triangleOffsets[i];
+	triangles.resize(indexCount);
+	std::vector<uint32_t> fill(triangleOffsets.begin(),
+				   triangleOffsets.end() - 1);
+	for (uint32_t i = 0; i < indexCount; i++)
+	    triangles[fill[result[i]]++] = i / 3;
+
+	collapses.clear();
+	for (uint32_t i = 0; i < indexCount; i += 3) {
+	    for (uint32_t e = 0; e < 3; e++) {
+		uint32_t a = result[i + e], b = result[i + (e + 1) % 3];
+		if (!locked[a])
+		    collapses.push_back(
+			{a, b, quadrics[a].Error(vertices[b].aPos)});
+		if (!locked[b])
+		    collapses.push_back(
+			{b, a, quadrics[b].Error(vertices[a].aPos)});
+	    }
+	}
+	std::sort(collapses.begin(), collapses.end(),
+		  [](const Collapse& a, const Collapse& b) {
+		      return a.error < b.error;
+		  });
+
+	for (uint32_t i = 0; i < vertexCount; i++) collapsed[i] = i;
+	std::fill(touched.begin(), touched.end(), 0);
+	uint32_t remaining = indexCount, collapseCount = 0;
+	for (auto& collapse : collapses) {
+	    if (remaining <= targetIndexCount ||
+		collapse.error > maxSquaredError)
+		break;
+	    uint32_t from = collapse.from, to = collapse.to;
+	    if (touched[from] || touched[to]) continue;
+	    bool flips = false;
+	    uint32_t removed = 0;
+	    for (uint32_t t = triangleOffsets[from];
+		 t < triangleOffsets[from + 1] && !flips; t++) {
+		const uint32_t* triangle = &result[triangles[t] * 3];
+		if (triangle[0] == to || triangle[1] == to ||
+		    triangle[2] == to)
+		    removed++;
+		else
+		    flips = FlipsTriangle(vertices, triangle, from, to);
+	    }
+	    if (flips) continue;
+	    for (uint32_t t = triangleOffsets[from];
+		 t < triangleOffsets[from + 1]; t++) {
+		const uint32_t* triangle = &result[triangles[t] * 3];
+		for (uint32_t k = 0; k < 3; k++) touched[triangle[k]] = 1;
+	    }
+	    collapsed[from] = to;
+	    quadrics[to].Add(quadrics[from]);
+	    largestError = std::max(largestError, collapse.error);
+	    remaining -= removed * 3;
+	    collapseCount++;
+	}
+	if (collapseCount == 0) break;
+
+	uint32_t write = 0;
+	for (uint32_t i = 0; i < indexCount; i += 3) {
+	    uint32_t a = collapsed[result[i]], b = collapsed[result[i + 1]],
+		     c = collapsed[result[i + 2]];
+	    // Also drops the ones left between wedges of one position
+	    if (remap[a] == remap[b] || remap[b] == remap[c] ||
+		remap[a] == remap[c])
+		continue;
+	    result[write++] = a;
+	    result[write++] = b;
+	    result[write++] = c;
+	}
+	indexCount = write;
+    }
+    if (error != nullptr) *error = std::sqrt(largestError) / radius;
+    return indexCount;
+}
+
+void GenerateMeshLods(const Vertex* vertices, uint32_t vertexCount,
+		      std::vector<uint32_t>& indices, Mesh& mesh) {
+    mesh.boundsRadius =
+	GetBoundingRadius(vertices, vertexCount, mesh.boundsCenter);
+    uint32_t baseCount = indices.size();
+    mesh.lods[0] = {0, baseCount, 0.f};
+    mesh.lodCount = 1;
+    std::vector<uint32_t> lod(baseCount);
+    uint32_t previousCount = baseCount;
+    for (uint32_t level = 1; level < maxMeshLods; level++) {
+	uint32_t target = (baseCount >> level) / 3 * 3;
+	float error;
+	// Every level starts from the full mesh, so error is against it
+	uint32_t count =
+	    SimplifyMesh(vertices, vertexCount, indices.data(), baseCount,
+			 target, maxLodError, lod.data(), &error);
+	if (count == 0 || count > previousCount * (1.f - minLodReduction))
+	    break;
+	OptimizeVertexCache(lod.data(), count, vertexCount);
+	mesh.lods[mesh.lodCount++] = {(uint32_t)indices.size(), count, error};
+	indices.insert(indices.end(), lod.begin(), lod.begin() + count);
+	previousCount = count;
+    }
+    mesh.indexCount = indices.size();
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <ECS/GraphicsComponent.hpp>
+#include <cstdint>
+#include <vector>
+
+// Quadric error edge collapse. Vertices only ever collapse onto one of
+// their neighbours so every level keeps using the mesh's vertex buffer,
+// the ones on borders and uv/normal seams stay where they are.
+
+// Collapses the triangle list into result (indexCount big) until it's
+// down to targetIndexCount indices or the next collapse would move the
+// surface further than maxError, relative to the mesh's bounding radius.
+// Returns the new index count, error gets the largest error taken.
+uint32_t SimplifyMesh(const Vertex* vertices, uint32_t vertexCount,
+		      const uint32_t* indices, uint32_t indexCount,
+		      uint32_t targetIndexCount, float maxError,
+		      uint32_t* result, float* error = nullptr);
+
+// Fills in the mesh's bounds and appends up to maxMeshLods - 1 coarser
+// levels of the triangle list to indices, mesh.indexCount grows to cover
+// them
+void GenerateMeshLods(const Vertex* vertices, uint32_t vertexCount,
+		      std::vector<uint32_t>& indices, Mesh& mesh);
@@ -0,0 +1,262 @@
+#include "MipGenerator.hpp"
+
+#include <Exception.hpp>
+#include <Graphics/BCnCodec.hpp>
+#include <JobSystem.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define DUNIYA_MIP_SSE
+#endif
+
+// Output rows a job filters
+constexpr uint32_t mipRowsPerJob = 16;
+// Half width of the Kaiser window in source pixels and its shape
+constexpr float kaiserRadius = 3.f;
+constexpr float kaiserAlpha = 4.f;
+
+uint32_t GetChannelCount(Texture::Format format) {
+    switch (format) {
+	case Texture::RGBA:
+	    return 4;
+	case Texture::RGB:
+	    return 3;
+	case Texture::R:
+	case Texture::BC4:
+	    return 1;
+	default:
+	    break;
+    };
+    return 4;
+}
+
+uint32_t GetMipLevelCount(uint32_t width, uint32_t height) {
+    uint32_t levels = 1;
+    for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+	levels++;
+    return levels;
+}
+
+uint32_t GetMipWidth(const Texture& texture, uint32_t level) {
+    return std::max(texture.width >> level, 1u);
+}
+
+uint32_t GetMipHeight(const Texture& texture, uint32_t level) {
+    return std::max(texture.height >> level, 1u);
+}
+
+size_t GetMipLevelSize(const Texture& texture, uint32_t level) {
+    if (IsBlockCompressed(texture.format))
+	return (size_t)((GetMipWidth(texture, level) + 3) / 4) *
+	       ((GetMipHeight(texture, level) + 3) / 4) *
+	       GetBlockSize(texture.format);
+    return (size_t)GetMipWidth(texture, level) *
+	   GetMipHeight(texture, level) * GetChannelCount(texture.format);
+}
+
+size_t GetMipLevelOffset(const Texture& texture, uint32_t level) {
+    size_t offset = 0;
+    for (uint32_t i = 0; i < level; i++) offset += GetMipLevelSize(texture, i);
+    return offset;
+}
+
+size_t GetMipChainSize(const Texture& texture) {
+    return GetMipLevelOffset(texture, std::max(texture.mipLevels, 1u));
+}
+
+namespace {
+
+// One pixel in linear space, missing channels are left at 0
+struct Pixel {
+#ifdef DUNIYA_MIP_SSE
+    __m128 value;
+    Pixel() : value(_mm_setzero_ps()) {}
+    explicit Pixel(const float* channels) : value(_mm_loadu_ps(channels)) {}
+    void AddScaled(const Pixel& pixel, float weight) {
+	value = _mm_add_ps(value, _mm_mul_ps(pixel.value, _mm_set1_ps(weight)));
+    }
+    void Store(float* channels) const { _mm_storeu_ps(channels, value); }
+#else
+    float value[4];
+    Pixel() : value{0.f, 0.f, 0.f, 0.f} {}
+    explicit Pixel(const float* channels) {
+	for (int i = 0; i < 4; i++) value[i] = channels[i];
+    }
+    void AddScaled(const Pixel& pixel, float weight) {
+	for (int i = 0; i < 4; i++) value[i] += pixel.value[i] * weight;
+    }
+    void Store(float* channels) const {
+	for (int i = 0; i < 4; i++) channels[i] = value[i];
+    }
+#endif
+};
+
+struct SrgbTables {
+    float toLinear[256];
+    // Indexed by the linear value scaled to 12 bits
+    uint8_t fromLinear[4096];
+    SrgbTables() {
+	for (int i = 0; i < 256; i++) {
+	    float c = i / 255.f;
+	    toLinear[i] = c <= 0.04045f ? c / 12.92f
+					: std::pow((c + 0.055f) / 1.055f, 2.4f);
+	}
+	for (int i = 0; i < 4096; i++) {
+	    float l = i / 4095.f;
+	    float c = l <= 0.0031308f
+			  ? l * 12.92f
+			  : 1.055f * std::pow(l, 1.f / 2.4f) - 0.055f;
+	    fromLinear[i] = (uint8_t)(c * 255.f + 0.5f);
+	}
+    }
+};
+
+const SrgbTables& GetSrgbTables() {
+    static SrgbTables tables;
+    return tables;
+}
+
+// Source pixel offsets relative to 2 * output pixel and their weights
+struct FilterTaps {
+    std::vector<int32_t> offsets;
+    std::vector<float> weights;
+};
+
+float BesselI0(float x) {
+    float sum = 1.f, term = 1.f;
+    for (int k = 1; k < 16; k++) {
+	term *= (x / (2.f * k)) * (x / (2.f * k));
+	sum += term;
+    }
+    return sum;
+}
+
+FilterTaps GetFilterTaps(MipFilter filter) {
+    FilterTaps taps;
+    if (filter == MipFilter::BOX) {
+	taps.offsets = {0, 1};
+	taps.weights = {0.5f, 0.5f};
+	return taps;
+    }
+    // Windowed sinc at half the source rate, the output pixel sits between
+    // source pixels 0 and 1
+    float sum = 0.f;
+    for (int32_t offset = 1 - (int32_t)kaiserRadius;
+	 offset <= (int32_t)kaiserRadius; offset++) {
+	float x = offset - 0.5f;
+	float sincX = 3.14159265f * x * 0.5f;
+	float sinc = std::sin(sincX) / sincX;
+	float ratio = x / kaiserRadius;
+	float window = BesselI0(kaiserAlpha * std::sqrt(1.f - ratio * ratio)) /
+		       BesselI0(kaiserAlpha);
+	taps.offsets.push_back(offset);
+	taps.weights.push_back(sinc * window);
+	sum += sinc * window;
+    }
+    for (auto& weight : taps.weights) weight /= sum;
+    return taps;
+}
+
+struct LevelFilter {
+    const uint8_t* source;
+    uint8_t* destination;
+    uint32_t sourceWidth, sourceHeight;
+    uint32_t width, height, channels;
+    bool srgb;
+    const FilterTaps* taps;
+
+    void DecodeRow(uint32_t y, std::vector<Pixel>& row) const {
+	auto& tables = GetSrgbTables();
+	const uint8_t* src = source + (size_t)y * sourceWidth * channels;
+	float pixel[4] = {0.f, 0.f, 0.f, 0.f};
+	for (uint32_t x = 0; x < sourceWidth; x++, src += channels) {
+	    for (uint32_t c = 0; c < channels; c++)
+		pixel[c] = srgb && c < 3 ? tables.toLinear[src[c]]
+					 : src[c] * (1.f / 255.f);
+	    row[x] = Pixel(pixel);
+	}
+    }
+
+    void FilterRow(const std::vector<Pixel>& decoded,
+		   std::vector<Pixel>& row) const {
+	int32_t last = sourceWidth - 1;
+	for (uint32_t x = 0; x < width; x++) {
+	    Pixel sum;
+	    for (size_t t = 0; t < taps->offsets.size(); t++) {
+		int32_t sx = std::clamp<int32_t>(2 * x + taps->offsets[t], 0,
+						 last);
+		sum.AddScaled(decoded[sx], taps->weights[t]);
+	    }
+	    row[x] = sum;
+	}
+    }
+
+    void EncodeRow(uint32_t y, const Pixel* row) const {
+	auto& tables = GetSrgbTables();
+	uint8_t* dst = destination + (size_t)y * width * channels;
+	float pixel[4];
+	for (uint32_t x = 0; x < width; x++, dst += channels) {
+	    row[x].Store(pixel);
+	    for (uint32_t c = 0; c < channels; c++) {
+		float value = std::clamp(pixel[c], 0.f, 1.f);
+		dst[c] = srgb && c < 3
+			     ? tables.fromLinear[(int)(value * 4095.f + 0.5f)]
+			     : (uint8_t)(value * 255.f + 0.5f);
+	    }
+	}
+    }
+
+    // Source rows are filtered horizontally once and kept in a ring as
+    // long as some output row still needs them
+    void Run(uint32_t begin, uint32_t end) const {
+	uint32_t ringSize = taps->offsets.size() + 2;
+	std::vector<std::vector<Pixel>> ring(ringSize,
+					     std::vector<Pixel>(width));
+	std::vector<int64_t> ringRows(ringSize, -1);
+	std::vector<Pixel> decoded(sourceWidth), row(width);
+	int32_t last = sourceHeight - 1;
+	for (uint32_t y = begin; y < end; y++) {
+	    for (uint32_t x = 0; x < width; x++) row[x] = Pixel();
+	    for (size_t t = 0; t < taps->offsets.size(); t++) {
+		int32_t sy =
+		    std::clamp<int32_t>(2 * y + taps->offsets[t], 0, last);
+		uint32_t slot = sy % ringSize;
+		if (ringRows[slot] != sy) {
+		    DecodeRow(sy, decoded);
+		    FilterRow(decoded, ring[slot]);
+		    ringRows[slot] = sy;
+		}
+		for (uint32_t x = 0; x < width; x++)
+		    row[x].AddScaled(ring[slot][x], taps->weights[t]);
+	    }
+	    EncodeRow(y, row.data());
+	}
+    }
+};
+
+}  // namespace
+
+void GenerateMips(const Texture& texture, uint8_t* chain, MipFilter filter) {
+    if (IsBlockCompressed(texture.format))
+	throw CException(__LINE__, __FILE__, "MipGenerator",
+			 "can't filter block compressed textures");
+    FilterTaps taps = GetFilterTaps(filter);
+    uint32_t channels = GetChannelCount(texture.format);
+    for (uint32_t level = 1; level < texture.mipLevels; level++) {
+	LevelFilter levelFilter;
+	levelFilter.source = chain + GetMipLevelOffset(texture, level - 1);
+	levelFilter.destination = chain + GetMipLevelOffset(texture, level);
+	levelFilter.sourceWidth = GetMipWidth(texture, level - 1);
+	levelFilter.sourceHeight = GetMipHeight(texture, level - 1);
+	levelFilter.width = GetMipWidth(texture, level);
+	levelFilter.height = GetMipHeight(texture, level);
+	levelFilter.channels = channels;
+	levelFilter.srgb = texture.colorSpace == Texture::SRGB;
+	levelFilter.taps = &taps;
+	JobSystem::GetSingleton()->ParallelFor(
+	    levelFilter.height, mipRowsPerJob,
+	    [&](uint32_t begin, uint32_t end) { levelFilter.Run(begin, end); });
+    }
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <ECS/GraphicsComponent.hpp>
+#include <cstddef>
+#include <cstdint>
+
+// A texture's mip chain is stored in its resource, level 0 first and every
+// level packed tightly right after the previous one.
+
+enum class MipFilter { BOX, KAISER };
+
+uint32_t GetChannelCount(Texture::Format format);
+// Levels down to 1x1
+uint32_t GetMipLevelCount(uint32_t width, uint32_t height);
+uint32_t GetMipWidth(const Texture& texture, uint32_t level);
+uint32_t GetMipHeight(const Texture& texture, uint32_t level);
+size_t GetMipLevelSize(const Texture& texture, uint32_t level);
+size_t GetMipLevelOffset(const Texture& texture, uint32_t level);
+size_t GetMipChainSize(const Texture& texture);
+
+// Fills levels 1 to texture.mipLevels - 1 of chain from level 0. For sRGB
+// textures the color channels are filtered in linear space, alpha is always
+// linear.
+void GenerateMips(const Texture& texture, uint8_t* chain, MipFilter filter);
@@ -0,0 +1,358 @@
+#include "ObjParser.hpp"
+
+#include <Exception.hpp>
+#include <JobSystem.hpp>
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+// Below this size a range isn't worth handing to another thread
+constexpr size_t objMinRangeSize = 1 << 16;
+constexpr int32_t objMissingIndex = INT32_MIN;
+
+// Position, uv and normal index of a face corner. Negative indices are
+// relative to the elements seen so far, they're kept relative to the start
+// of the range until the ranges before it are counted.
+struct ObjCorner {
+    int32_t index[3];
+    uint8_t relative;
+};
+
+struct ObjRange {
+    const char* begin;
+    const char* end;
+    std::vector<Vect4> positions;
+    std::vector<Vect2> uvs;
+    std::vector<Vect3> normals;
+    // Triangulated, three corners per triangle
+    std::vector<ObjCorner> corners;
+    uint32_t bases[3];
+    // Vertices deduplicated within the range
+    std::vector<std::array<int32_t, 3>> uniqueCorners;
+    std::vector<uint32_t> indicies;
+};
+
+// Open addressing hash from a corner to the vertex created for it
+class VertexHash {
+   public:
+    VertexHash(size_t expected) {
+	size_t capacity = 16;
+	while (capacity < expected * 2) capacity <<= 1;
+	mask = capacity - 1;
+	keys.resize(capacity);
+	values.assign(capacity, emptySlot);
+    }
+    // Returns the vertex of the corner, inserting nextVertex if it's new
+    uint32_t Insert(const std::array<int32_t, 3>& key, uint32_t nextVertex,
+		    bool& inserted) {
+	size_t slot = Hash(key) & mask;
+	while (values[slot] != emptySlot) {
+	    if (keys[slot] == key) {
+		inserted = false;
+		return values[slot];
+	    }
+	    slot = (slot + 1) & mask;
+	}
+	keys[slot] = key;
+	values[slot] = nextVertex;
+	inserted = true;
+	return nextVertex;
+    }
+
+   private:
+    static size_t Hash(const std::array<int32_t, 3>& key) {
+	uint64_t hash = (uint32_t)key[0] * 0x9E3779B97F4A7C15ull;
+	hash ^= (uint32_t)key[1] * 0xC2B2AE3D27D4EB4Full + (hash >> 29);
+	hash ^= (uint32_t)key[2] * 0x165667B19E3779F9ull + (hash >> 32);
+	return hash ^ (hash >> 31);
+    }
+
+   private:
+    static constexpr uint32_t emptySlot = UINT32_MAX;
+    size_t mask;
+    std::vector<std::array<int32_t, 3>> keys;
+    std::vector<uint32_t> values;
+};
+
+static const char* SkipSpaces(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    return p;
+}
+
+static bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+static const char* ParseFloat(const char* p, const char* end, float& value) {
+    static const double powers[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+				    1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+				    1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+				    1e18, 1e19, 1e20, 1e21, 1e22};
+    p = SkipSpaces(p, end);
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+    uint64_t mantissa = 0;
+    int32_t exponent = 0, digits = 0;
+    for (; p < end && IsDigit(*p); p++, digits++) {
+	if (mantissa < 1000000000000000000ull)
+	    mantissa = mantissa * 10 + (*p - '0');
+	else
+	    exponent++;
+    }
+    if (p < end && *p == '.') {
+	for (p++; p < end && IsDigit(*p); p++, digits++) {
+	    if (mantissa < 1000000000000000000ull) {
+		mantissa = mantissa * 10 + (*p - '0');
+		exponent--;
+	    }
+	}
+    }
+    if (digits == 0)
+	throw CException(__LINE__, __FILE__, "ObjLoader", "expected a number");
+    if (p < end && (*p == 'e' || *p == 'E')) {
+	p++;
+	bool negativeExponent = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	    negativeExponent = *p++ == '-';
+	int32_t explicitExponent = 0;
+	for (; p < end && IsDigit(*p); p++)
+	    explicitExponent = std::min(explicitExponent * 10 + (*p - '0'), 999);
+	exponent += negativeExponent ? -explicitExponent : explicitExponent;
+    }
+    double result = mantissa;
+    if (exponent < 0)
+	result = exponent >= -22 ? result / powers[-exponent]
+				 : result * std::pow(10.0, exponent);
+    else if (exponent > 0)
+	result = exponent <= 22 ? result * powers[exponent]
+				: result * std::pow(10.0, exponent);
+    value = (float)(negative ? -result : result);
+    return p;
+}
+
+static const char* ParseIndex(const char* p, const char* end,
+			      int32_t& value) {
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+    if (p == end || !IsDigit(*p))
+	throw CException(__LINE__, __FILE__, "ObjLoader",
+			 "expected a face index");
+    int64_t index = 0;
+    for (; p < end && IsDigit(*p); p++)
+	index = std::min<int64_t>(index * 10 + (*p - '0'), INT32_MAX);
+    value = (int32_t)(negative ? -index : index);
+    return p;
+}
+
+// Faces are fan triangulated, corners without uv or normal are missing
+static void ParseFace(const char* p, const char* end, ObjRange& range) {
+    ObjCorner face[3];
+    uint32_t cornerCount = 0;
+    uint32_t counts[3] = {(uint32_t)range.positions.size(),
+			  (uint32_t)range.uvs.size(),
+			  (uint32_t)range.normals.size()};
+    while ((p = SkipSpaces(p, end)) < end) {
+	ObjCorner corner = {{objMissingIndex, objMissingIndex, objMissingIndex},
+			    0};
+	for (uint32_t i = 0; i < 3; i++) {
+	    if (i > 0) {
+		if (p == end || *p != '/') break;
+		p++;
+		// v//n skips the uv
+		if (p < end && *p == '/') continue;
+	    }
+	    int32_t index;
+	    p = ParseIndex(p, end, index);
+	    if (index < 0) {
+		corner.index[i] = (int32_t)counts[i] + index;
+		corner.relative |= 1 << i;
+	    } else {
+		corner.index[i] = index - 1;
+	    }
+	}
+	if (cornerCount < 2) {
+	    face[cornerCount] = corner;
+	} else {
+	    face[2] = corner;
+	    range.corners.insert(range.corners.end(), face, face + 3);
+	    face[1] = corner;
+	}
+	cornerCount++;
+    }
+}
+
+static void ParseRange(ObjRange& range) {
+    const char* p = range.begin;
+    while (p < range.end) {
+	const char* lineEnd = (const char*)memchr(p, '\n', range.end - p);
+	if (lineEnd == nullptr) lineEnd = range.end;
+	p = SkipSpaces(p, lineEnd);
+	if (lineEnd - p >= 2 && p[0] == 'v') {
+	    if (p[1] == ' ' || p[1] == '\t') {
+		Vect4 position(0.f, 0.f, 0.f, 1.f);
+		const char* q = p + 1;
+		for (uint32_t i = 0; i < 3; i++)
+		    q = ParseFloat(q, lineEnd, position.coordinates[i]);
+		range.positions.push_back(position);
+	    } else if (p[1] == 't') {
+		Vect2 uv;
+		const char* q = ParseFloat(p + 2, lineEnd, uv.x);
+		// A 1D texture coordinate only has u
+		if (SkipSpaces(q, lineEnd) < lineEnd)
+		    ParseFloat(q, lineEnd, uv.y);
+		range.uvs.push_back(uv);
+	    } else if (p[1] == 'n') {
+		Vect3 normal;
+		const char* q = p + 2;
+		for (uint32_t i = 0; i < 3; i++)
+		    q = ParseFloat(q, lineEnd, normal.coordinates[i]);
+		range.normals.push_back(normal);
+	    }
+	} else if (lineEnd - p >= 2 && p[0] == 'f' &&
+		   (p[1] == ' ' || p[1] == '\t')) {
+	    ParseFace(p + 1, lineEnd, range);
+	}
+	p = lineEnd + 1;
+    }
+}
+
+// Turns relative indices absolute and dedupes the corners of the range
+static void ResolveRange(ObjRange& range, const uint32_t totals[3]) {
+    VertexHash hash(range.corners.size() / 2);
+    range.indicies.reserve(range.corners.size());
+    for (auto& corner : range.corners) {
+	std::array<int32_t, 3> key;
+	for (uint32_t i = 0; i < 3; i++) {
+	    int64_t index = corner.index[i];
+	    if (index == objMissingIndex) {
+		key[i] = objMissingIndex;
+		continue;
+	    }
+	    if (corner.relative & (1 << i)) index += range.bases[i];
+	    if (index < 0 || index >= totals[i])
+		throw CException(__LINE__, __FILE__, "ObjLoader",
+				 "face index out of range");
+	    key[i] = (int32_t)index;
+	}
+	if (key[0] == objMissingIndex)
+	    throw CException(__LINE__, __FILE__, "ObjLoader",
+			     "face corner without a position");
+	bool inserted;
+	range.indicies.push_back(
+	    hash.Insert(key, range.uniqueCorners.size(), inserted));
+	if (inserted) range.uniqueCorners.push_back(key);
+    }
+    range.corners = std::vector<ObjCorner>();
+}
+
+void ParseObj(const char* data, size_t size, std::vector<Vertex>& verticies,
+	      std::vector<uint32_t>& indicies) {
+    auto jobSystem = JobSystem::GetSingleton();
+    const char* dataEnd = data + size;
+
+    // Ranges are cut at line boundaries so no line is split between two
+    size_t rangeCount = std::min<size_t>(
+	(jobSystem->GetWorkerCount() + 1) * 4,
+	std::max<size_t>(size / objMinRangeSize, 1));
+    std::vector<ObjRange> ranges(rangeCount);
+    const char* begin = data;
+    for (size_t i = 0; i < rangeCount; i++) {
+	const char* end = data + size * (i + 1) / rangeCount;
+	if (end < begin) end = begin;
+	const char* newLine = (const char*)memchr(end, '\n', dataEnd - end);
+	end = i + 1 == rangeCount || newLine == nullptr ? dataEnd : newLine + 1;
+	ranges[i].begin = begin;
+	ranges[i].end = end;
+	begin = end;
+    }
+    jobSystem->ParallelFor(rangeCount, 1, [&](uint32_t begin, uint32_t end) {
+	for (uint32_t i = begin; i < end; i++) ParseRange(ranges[i]);
+    });
+
+    uint32_t totals[3] = {0, 0, 0};
+    for (auto& range : ranges) {
+	std::copy(totals, totals + 3, range.bases);
+	totals[0] += range.positions.size();
+	totals[1] += range.uvs.size();
+	totals[2] += range.normals.size();
+    }
+    std::vector<Vect4> positions;
+    std::vector<Vect2> uvs;
+    std::vector<Vect3> normals;
+    positions.reserve(totals[0]);
+    uvs.reserve(totals[1]);
+    normals.reserve(totals[2]);
+    for (auto& range : ranges) {
+	positions.insert(positions.end(), range.positions.begin(),
+			 range.positions.end());
+	uvs.insert(uvs.end(), range.uvs.begin(), range.uvs.end());
+	normals.insert(normals.end(), range.normals.begin(),
+		       range.normals.end());
+    }
+    jobSystem->ParallelFor(rangeCount, 1, [&](uint32_t begin, uint32_t end) {
+	for (uint32_t i = begin; i < end; i++) ResolveRange(ranges[i], totals);
+    });
+
+    // Merges the per range vertices, only the unique ones go through here
+    size_t uniqueCount = 0, indexCount = 0;
+    for (auto& range : ranges) {
+	uniqueCount += range.uniqueCorners.size();
+	indexCount += range.indicies.size();
+    }
+    VertexHash hash(uniqueCount);
+    std::vector<std::array<int32_t, 3>> corners;
+    std::vector<std::vector<uint32_t>> remaps(rangeCount);
+    std::vector<size_t> indexOffsets(rangeCount);
+    for (size_t i = 0, offset = 0; i < rangeCount; i++) {
+	indexOffsets[i] = offset;
+	offset += ranges[i].indicies.size();
+	for (auto& corner : ranges[i].uniqueCorners) {
+	    bool inserted;
+	    remaps[i].push_back(hash.Insert(corner, corners.size(), inserted));
+	    if (inserted) corners.push_back(corner);
+	}
+    }
+    indicies.resize(indexCount);
+    verticies.resize(corners.size());
+    jobSystem->ParallelFor(rangeCount, 1, [&](uint32_t begin, uint32_t end) {
+	for (uint32_t i = begin; i < end; i++) {
+	    for (size_t j = 0; j < ranges[i].indicies.size(); j++)
+		indicies[indexOffsets[i] + j] = remaps[i][ranges[i].indicies[j]];
+	}
+    });
+
+    bool missingNormals = false;
+    for (size_t i = 0; i < corners.size(); i++) {
+	auto& corner = corners[i];
+	verticies[i].aPos = positions[corner[0]];
+	if (corner[1] != objMissingIndex) verticies[i].texCord = uvs[corner[1]];
+	if (corner[2] != objMissingIndex)
+	    verticies[i].aNormal = normals[corner[2]];
+	else
+	    missingNormals = true;
+    }
+    if (!missingNormals) return;
+
+    // Smooth normals from the area weighted normals of the faces around
+    // every position
+    std::vector<Vect3> generated(positions.size());
+    for (size_t i = 0; i + 2 < indicies.size(); i += 3) {
+	auto& a = verticies[indicies[i]].aPos;
+	auto& b = verticies[indicies[i + 1]].aPos;
+	auto& c = verticies[indicies[i + 2]].aPos;
+	Vect3 ab(b.x - a.x, b.y - a.y, b.z - a.z);
+	Vect3 ac(c.x - a.x, c.y - a.y, c.z - a.z);
+	Vect3 faceNormal(ab.y * ac.z - ab.z * ac.y, ab.z * ac.x - ab.x * ac.z,
+			 ab.x * ac.y - ab.y * ac.x);
+	for (size_t j = 0; j < 3; j++)
+	    generated[corners[indicies[i + j]][0]] += faceNormal;
+    }
+    for (size_t i = 0; i < corners.size(); i++) {
+	if (corners[i][2] != objMissingIndex) continue;
+	Vect3 normal = generated[corners[i][0]];
+	float length = std::sqrt(normal.x * normal.x + normal.y * normal.y +
+				 normal.z * normal.z);
+	if (length > 0.f) normal = normal / length;
+	verticies[i].aNormal = normal;
+    }
+}
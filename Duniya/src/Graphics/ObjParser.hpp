@@ -0,0 +1,12 @@
+#pragma once
+#include <ECS/GraphicsComponent.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Parses an OBJ file's text in line aligned ranges on the job system, the
+// ranges are merged and their vertices deduplicated at the end. Faces are
+// fan triangulated. Corners without a normal get the smoothed normal of
+// the faces around their position.
+void ParseObj(const char* data, size_t size, std::vector<Vertex>& verticies,
+	      std::vector<uint32_t>& indicies);
@@ -3,7 +3,11 @@
 #include <SDL2/SDL.h>
 
 #include <Exception.hpp>
+#include <Graphics/BCnCodec.hpp>
+#include <Graphics/MipGenerator.hpp>
 #include <SDLUtiliy.hpp>
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
 #include <memory>
 #include <sstream>
@@ -194,11 +198,87 @@ void NativeShaderStageHandler<GLRenderer>::Load() {
 			     message);
 	}
 	shaderHandler.clear();
+	LoadUniforms();
+	LoadUniformBlocks();
 	linked = true;
     }
     GLDEBUGCALL(glValidateProgram(program));
     GLDEBUGCALL(glUseProgram(program));
     renderer->shaderProgram = program;
+    renderer->uniforms = &uniforms;
+    renderer->uniformBlocks = &uniformBlocks;
+}
+
+// Hashes name and checks no other name in names has the same hash
+static UniformID HashUniformName(
+    const std::string& name,
+    std::unordered_map<UniformID, std::string>& names) {
+    auto uniform = HashUniform(name);
+    auto [itr, added] = names.emplace(uniform, name);
+    if (!added && itr->second != name)
+	throw CException(__LINE__, __FILE__, "GL Program Link Error",
+			 "uniforms " + itr->second + " and " + name +
+			     " have the same hash");
+    return uniform;
+}
+
+void NativeShaderStageHandler<GLRenderer>::LoadUniforms() {
+    GLint uniformCount = 0, maxNameLength = 0;
+    GLDEBUGCALL(glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniformCount));
+    GLDEBUGCALL(glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH,
+			       &maxNameLength));
+    std::vector<char> nameBuffer(std::max(maxNameLength, 1));
+    // Hash to name, to catch two names sharing a hash
+    std::unordered_map<UniformID, std::string> names;
+    for (GLint i = 0; i < uniformCount; i++) {
+	GLsizei length;
+	GLint size;
+	GLenum type;
+	GLint block;
+	GLuint index = i;
+	// Members of uniform blocks are set through their buffer
+	GLDEBUGCALL(glGetActiveUniformsiv(program, 1, &index,
+					  GL_UNIFORM_BLOCK_INDEX, &block));
+	if (block != -1) continue;
+	GLDEBUGCALL(glGetActiveUniform(program, i, nameBuffer.size(), &length,
+				       &size, &type, nameBuffer.data()));
+	std::string name(nameBuffer.data(), length);
+	// Arrays come as name[0], the bare name refers to the first element
+	// and every element gets its own entry
+	if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+	    name.resize(name.size() - 3);
+	    AddUniform(name, names);
+	    for (GLint j = 0; j < size; j++)
+		AddUniform(name + "[" + std::to_string(j) + "]", names);
+	} else
+	    AddUniform(name, names);
+    }
+}
+
+void NativeShaderStageHandler<GLRenderer>::AddUniform(
+    const std::string& name,
+    std::unordered_map<UniformID, std::string>& names) {
+    GLint location;
+    GLDEBUGCALL(location = glGetUniformLocation(program, name.c_str()));
+    if (location == -1) return;
+    uniforms[HashUniformName(name, names)] = location;
+}
+
+void NativeShaderStageHandler<GLRenderer>::LoadUniformBlocks() {
+    GLint blockCount = 0, maxNameLength = 0;
+    GLDEBUGCALL(
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount));
+    GLDEBUGCALL(glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH,
+			       &maxNameLength));
+    std::vector<char> nameBuffer(std::max(maxNameLength, 1));
+    std::unordered_map<UniformID, std::string> names;
+    for (GLint i = 0; i < blockCount; i++) {
+	GLsizei length;
+	GLDEBUGCALL(glGetActiveUniformBlockName(program, i, nameBuffer.size(),
+						&length, nameBuffer.data()));
+	std::string name(nameBuffer.data(), length);
+	uniformBlocks[HashUniformName(name, names)] = i;
+    }
 }
 
 void NativeShaderStageHandler<GLRenderer>::UnLoad() { glUseProgram(0); }
@@ -217,83 +297,151 @@ GLRenderer::GLRenderer() {
     glActiveTexture(GL_TEXTURE0);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glEnable(GL_BLEND);
+
+    hasS3TC = hasBPTC = false;
+    GLint extensionCount = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    for (GLint i = 0; i < extensionCount; i++) {
+	std::string extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+	if (extension == "GL_EXT_texture_compression_s3tc") hasS3TC = true;
+	if (extension == "GL_ARB_texture_compression_bptc") hasBPTC = true;
+    }
+    uniformBufferAlignment = 1;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformBufferAlignment);
 }
 
 bool GLRenderer::gladLoaded = false;
 
-GLenum GLRenderer::GetUniformLocation(const uint32_t& shaderProgram,
-				      std::string& uniformName) {
-    GLenum location;
-    GLDEBUGCALL(location =
-		    glGetUniformLocation(shaderProgram, uniformName.c_str()));
-    return location;
+GLint GLRenderer::GetUniformLocation(UniformID uniform) const {
+    if (uniforms == nullptr) return -1;
+    auto itr = uniforms->find(uniform);
+    return itr == uniforms->end() ? -1 : itr->second;
 }
 
 void GLRenderer::Uniform1f(const uint32_t count, const float* data,
-			   std::string name) {
+			   UniformID uniform) {
     if (count == 1)
-	glUniform1f(GetUniformLocation(shaderProgram, name), *data);
+	glUniform1f(GetUniformLocation(uniform), *data);
     else {
-	glUniform1fv(GetUniformLocation(shaderProgram, name), count, data);
+	glUniform1fv(GetUniformLocation(uniform), count, data);
     }
 }
 
 void GLRenderer::Uniform1u(const uint32_t count, const uint32_t* data,
-			   std::string name) {
+			   UniformID uniform) {
     if (count == 1)
-	glUniform1ui(GetUniformLocation(shaderProgram, name), *data);
+	glUniform1ui(GetUniformLocation(uniform), *data);
     else {
-	glUniform1uiv(GetUniformLocation(shaderProgram, name), count, data);
+	glUniform1uiv(GetUniformLocation(uniform), count, data);
     }
 }
 
 void GLRenderer::Uniform1i(const uint32_t count, const int32_t* data,
-			   std::string name) {
+			   UniformID uniform) {
     if (count == 1)
-	glUniform1i(GetUniformLocation(shaderProgram, name), *data);
+	glUniform1i(GetUniformLocation(uniform), *data);
     else {
-	glUniform1iv(GetUniformLocation(shaderProgram, name), count, data);
+	glUniform1iv(GetUniformLocation(uniform), count, data);
     }
 }
 
 void GLRenderer::Uniform2f(const uint32_t count, const Vect2* data,
-			   std::string name) {
+			   UniformID uniform) {
     if (count == 1)
-	glUniform2f(GetUniformLocation(shaderProgram, name), data->x, data->y);
+	glUniform2f(GetUniformLocation(uniform), data->x, data->y);
     else {
-	glUniform2fv(GetUniformLocation(shaderProgram, name), count,
-		     (float*)data);
+	glUniform2fv(GetUniformLocation(uniform), count, (float*)data);
     }
 }
 
 void GLRenderer::Uniform3f(const uint32_t count, const Vect3* data,
-			   std::string name) {
+			   UniformID uniform) {
     if (count == 1)
-	glUniform3f(GetUniformLocation(shaderProgram, name), data->x, data->y,
-		    data->z);
+	glUniform3f(GetUniformLocation(uniform), data->x, data->y, data->z);
     else {
-	glUniform3fv(GetUniformLocation(shaderProgram, name), count,
-		     (float*)(data));
+	glUniform3fv(GetUniformLocation(uniform), count, (float*)(data));
     }
 }
 
 void GLRenderer::Uniform4f(const uint32_t count, const Vect4* data,
-			   std::string name) {
-    auto location = GetUniformLocation(shaderProgram, name);
+			   UniformID uniform) {
+    auto location = GetUniformLocation(uniform);
     if (location == -1)
-	throw std::runtime_error("uniform location not found\nvariable name:" +
-				 name);
+	throw std::runtime_error("uniform location not found\nuniform id:" +
+				 std::to_string(uniform));
     if (count == 1)
 	glUniform4f(location, data->x, data->y, data->z, data->w);
     else {
-	glUniform4fv(GetUniformLocation(shaderProgram, name), count,
-		     (float*)data);
+	glUniform4fv(location, count, (float*)data);
+    }
+}
+
+uint32_t GLRenderer::CreateUniformBuffer() {
+    uint32_t rendererID;
+    GLDEBUGCALL(glGenBuffers(1, &rendererID));
+    uniformBuffers.push_back({rendererID, 0});
+    return uniformBuffers.size() - 1;
+}
+
+void* GLRenderer::MapUniformBuffer(uint32_t buffer, uint32_t size) {
+    auto& uniformBuffer = uniformBuffers.at(buffer);
+    GLDEBUGCALL(glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer.rendererID));
+    if (size > uniformBuffer.capacity) {
+	// Half again as large, a growing scene doesn't reallocate every frame
+	uniformBuffer.capacity =
+	    std::max(size, uniformBuffer.capacity + uniformBuffer.capacity / 2);
+	GLDEBUGCALL(glBufferData(GL_UNIFORM_BUFFER, uniformBuffer.capacity,
+				 nullptr, GL_STREAM_DRAW));
     }
+    // Invalidating lets the driver hand out fresh memory rather than wait
+    // for the draws still reading the last frame's
+    void* data;
+    GLDEBUGCALL(data = glMapBufferRange(
+		    GL_UNIFORM_BUFFER, 0, std::max(size, 1u),
+		    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    if (data == nullptr)
+	throw CException(__LINE__, __FILE__, "GL Buffer Error",
+			 "uniform buffer could not be mapped");
+    return data;
+}
+
+void GLRenderer::UnMapUniformBuffer(uint32_t buffer) {
+    GLDEBUGCALL(
+	glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffers.at(buffer).rendererID));
+    // A lost mapping only spoils this frame, the next one writes it all again
+    GLDEBUGCALL(glUnmapBuffer(GL_UNIFORM_BUFFER));
+}
+
+void GLRenderer::BindUniformBuffer(uint32_t buffer, uint32_t binding,
+				   uint32_t offset, uint32_t size) {
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding,
+		      uniformBuffers[buffer].rendererID, offset, size);
+}
+
+uint32_t GLRenderer::GetUniformBufferAlignment() {
+    return uniformBufferAlignment;
+}
+
+void GLRenderer::UniformBlockBinding(UniformID block, uint32_t binding) {
+    if (uniformBlocks == nullptr) return;
+    auto itr = uniformBlocks->find(block);
+    // Blocks the program doesn't use are left out when it links
+    if (itr == uniformBlocks->end()) return;
+    GLDEBUGCALL(glUniformBlockBinding(shaderProgram, itr->second, binding));
+}
+
+// Mat4s are row vector matrices packed row by row, read as columns they
+// are the column vector matrices the shaders multiply with, as the 4x4 Mat
+// path below uploads them
+void GLRenderer::UniformMat(const uint32_t count, const Mat4* mat,
+			    UniformID uniform) {
+    glUniformMatrix4fv(GetUniformLocation(uniform), count, GL_FALSE,
+		       mat->data);
 }
 
 void GLRenderer::UniformMat(const uint32_t count, const Mat* mat,
-			    std::string name) {
-    GLDEBUGCALL(uint32_t uLocation = GetUniformLocation(shaderProgram, name));
+			    UniformID uniform) {
+    GLint uLocation = GetUniformLocation(uniform);
     float* answer = new float[mat->sizet * count];
     for (uint32_t i = 0; i < count; i++) {
 	std::copy(mat[i].buffer.get(), mat[i].buffer.get() + mat[i].sizet,
@@ -387,6 +535,11 @@ void GLRenderer::ClearColor(float r, float g, float b) {
 
 void GLRenderer::ClearDepth(float depthLevel) { glClearDepth(depthLevel); }
 
+void GLRenderer::Viewport(int32_t x, int32_t y, uint32_t width,
+			  uint32_t height) {
+    glViewport(x, y, width, height);
+}
+
 void GLRenderer::FinalizeVertexSpecification() {}
 
 void GLRenderer::LoadBuffer(GBuffer* gBuffer) {
@@ -461,7 +614,8 @@ NativeShaderHandlerParent* GLRenderer::CreateShader(ShaderType type) {
     return new NativeShaderHandler<GLRenderer>(type);
 }
 
-void GLRenderer::LoadTexture(Texture* texture, GBuffer* gBuffer) {
+void GLRenderer::LoadTexture(Texture* texture, GBuffer* gBuffer,
+			     uint32_t baseLevel) {
     uint32_t rendererID = 0;
     // gBuffer = new GBuffer;
     GLDEBUGCALL(glGenTextures(1, &rendererID));
@@ -486,33 +640,78 @@ void GLRenderer::LoadTexture(Texture* texture, GBuffer* gBuffer) {
     //         break;
     // };
     //
-    GLenum format;
-    uint32_t channel = 0;
+    uint32_t levels = std::max(texture->mipLevels, 1u);
+    glBindTexture(GL_TEXTURE_2D, rendererID);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+		    levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    binders.emplace_back(new GLTextureBinder(pvao, rendererID, GL_TEXTURE_2D));
+    gBuffer->bindNo = binders.size() - 1;
+    // Smallest first, each level becomes the base as soon as it is there
+    for (uint32_t level = levels; level-- > baseLevel;)
+	LoadTextureLevel(texture, gBuffer, level);
+}
+
+GLenum GLRenderer::GetCompressedFormat(Texture::Format format) {
+    switch (format) {
+	case Texture::Format::BC1:
+	    return hasS3TC ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : 0;
+	case Texture::Format::BC3:
+	    return hasS3TC ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : 0;
+	case Texture::Format::BC4:
+	    return GL_COMPRESSED_RED_RGTC1;
+	case Texture::Format::BC7:
+	    return hasBPTC ? GL_COMPRESSED_RGBA_BPTC_UNORM : 0;
+	default:
+	    return 0;
+    };
+}
+
+void GLRenderer::LoadTextureLevel(Texture* texture, GBuffer* gBuffer,
+				  uint32_t level) {
+    GLenum format = GL_RGBA;
     switch (texture->format) {
-	case Texture::Format::RGBA:
-	    format = GL_RGBA;
-	    break;
 	case Texture::Format::R:
+	case Texture::Format::BC4:
 	    format = GL_RED;
 	    break;
 	case Texture::Format::RGB:
 	    format = GL_RGB;
 	    break;
+	default:
+	    format = GL_RGBA;
+	    break;
     };
-    glBindTexture(GL_TEXTURE_2D, rendererID);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    GLDEBUGCALL(glTexImage2D(GL_TEXTURE_2D, 0, format, texture->width,
-			     texture->height, 0, format, GL_UNSIGNED_BYTE,
-			     resourceBank->resources[texture->data].Get()));
-
-    binders.emplace_back(new GLTextureBinder(pvao, rendererID, GL_TEXTURE_2D));
-
-    gBuffer->bindNo = binders.size() - 1;
+    auto data = (const uint8_t*)resourceBank->resources[texture->data].Get();
+    const uint8_t* pixels = data + GetMipLevelOffset(*texture, level);
+    uint32_t width = GetMipWidth(*texture, level);
+    uint32_t height = GetMipHeight(*texture, level);
     Bind(*gBuffer);
-    GLDEBUGCALL(glGenerateMipmap(GL_TEXTURE_2D));
+    GLenum compressedFormat = GetCompressedFormat(texture->format);
+    std::vector<uint8_t> decoded;
+    if (compressedFormat != 0) {
+	GLDEBUGCALL(glCompressedTexImage2D(
+	    GL_TEXTURE_2D, level, compressedFormat, width, height, 0,
+	    GetMipLevelSize(*texture, level), pixels));
+    } else {
+	// Block formats the driver lacks are decoded here instead
+	if (IsBlockCompressed(texture->format)) {
+	    DecodeBlocks(*texture, data, level, decoded);
+	    pixels = decoded.data();
+	}
+	// Levels are packed without any row padding, other uploads keep the
+	// alignment they expect
+	GLint alignment;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	GLDEBUGCALL(glTexImage2D(GL_TEXTURE_2D, level, format, width, height,
+				 0, format, GL_UNSIGNED_BYTE, pixels));
+	glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
 }
 
 ShaderStageHandler* GLRenderer::CreateShaderStage() {
@@ -550,6 +749,15 @@ void GLRenderer::Draw(DrawPrimitive drawPrimitive, GBuffer* gBuffer) {
 			       GL_UNSIGNED_INT, (const void*)0));
 }
 
+void GLRenderer::DrawRange(DrawPrimitive drawPrimitive, GBuffer* gBuffer,
+			   uint32_t first, uint32_t count) {
+    if (gBuffer != nullptr) this->Bind(*gBuffer);
+    glBindVertexArray(pvao);
+    GLDEBUGCALL(glDrawElements(GetDrawTarget(drawPrimitive), count,
+			       GL_UNSIGNED_INT,
+			       (const void*)(first * sizeof(uint32_t))));
+}
+
 void GLRenderer::DrawInstanced(DrawPrimitive drawPrimitive, GBuffer* gBuffer,
 			       uint32_t numInstanced) {
     if (gBuffer != nullptr) this->Bind(*gBuffer);
@@ -584,33 +792,59 @@ void GLRenderer::Clear() {
     GLDEBUGCALL(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
 }
 
+// Points the attributes at the bound vertex buffer, so call it after
+// binding the buffer of every draw
 void GLRenderer::SetLayout(const uint32_t layout) {
-    glBindVertexArray(vaos[layout].first);
-    auto& tmp = vaos[layout].second;
-    uint32_t offset = 0;
-    for (uint32_t i = 0; i < tmp.size() - 1; i++) {
-	GLDEBUGCALL(glVertexAttribPointer(i, tmp[i], GL_FLOAT, GL_FALSE,
-					  tmp.back(), (const void*)offset));
-	std::cout << tmp[i] << " " << offset << std::endl;
+    glBindVertexArray(pvao);
+    auto& vertexLayout = layouts[layout];
+    uint32_t count = vertexLayout.attributes.size();
+    for (uint32_t i = 0; i < count; i++) {
+	auto& attribute = vertexLayout.attributes[i];
+	GLDEBUGCALL(glVertexAttribPointer(
+	    i, attribute.count, attribute.type, attribute.normalized,
+	    vertexLayout.stride, (const void*)(uintptr_t)attribute.offset));
 	GLDEBUGCALL(glEnableVertexAttribArray(i));
-	offset += tmp[i] * sizeof(float);
     }
+    // Missing attributes read the constant (0, 0, 0, 1)
+    for (uint32_t i = count; i < enabledAttributes; i++)
+	glDisableVertexAttribArray(i);
+    enabledAttributes = count;
 }
 
 uint32_t GLRenderer::AddSpecification(
     VertexSpecification& vertexSpecification) {
     glBindVertexArray(pvao);
-    vaos.emplace_back();
-    vaos.back().first = pvao;
-    uint32_t totalSize = 0;
+    layouts.emplace_back();
+    auto& vertexLayout = layouts.back();
+    uint32_t offset = 0;
     for (uint32_t i = 0; i < vertexSpecification.size(); i++) {
-	totalSize += vertexSpecification[i].second;
+	auto& attribute = vertexSpecification[i];
 	GLDEBUGCALL(glBindAttribLocation(shaderProgram, i,
-					 vertexSpecification[i].first.c_str()));
-	vaos.back().second.push_back(vertexSpecification[i].second);
+					 attribute.name.c_str()));
+	GLVertexAttribute glAttribute;
+	glAttribute.count = attribute.count;
+	glAttribute.normalized = attribute.normalized ? GL_TRUE : GL_FALSE;
+	glAttribute.offset = offset;
+	uint32_t size = 0;
+	switch (attribute.type) {
+	    case AttributeType::FLOAT:
+		glAttribute.type = GL_FLOAT;
+		size = sizeof(float);
+		break;
+	    case AttributeType::HALF_FLOAT:
+		glAttribute.type = GL_HALF_FLOAT;
+		size = sizeof(uint16_t);
+		break;
+	    case AttributeType::SHORT:
+		glAttribute.type = GL_SHORT;
+		size = sizeof(int16_t);
+		break;
+	};
+	offset += size * attribute.count;
+	vertexLayout.attributes.push_back(glAttribute);
     }
-    vaos.back().second.push_back(totalSize * sizeof(float));
-    return vaos.size() - 1;
+    vertexLayout.stride = offset;
+    return layouts.size() - 1;
 }
 
 void GLRenderer::LoadGladGL() {
@@ -1,8 +1,22 @@
 
 #include <glad/glad.h>
 
+// Block compressed formats from GL_EXT_texture_compression_s3tc and
+// GL_ARB_texture_compression_bptc, glad only has the core ones
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+
 #include <Exception.hpp>
 #include <Graphics/Renderer.hpp>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 class GLException : public CException {
@@ -48,9 +62,11 @@ class GLRenderer : public Renderer {
    public:
     GLRenderer();
     GLenum GetOption(Options option);
-    GLenum GetUniformLocation(const uint32_t& shaderProgram,
-			      std::string& uniformName);
+    // -1 when the current program has no such active uniform
+    GLint GetUniformLocation(UniformID uniform) const;
     void Draw(DrawPrimitive drawPrimitive, GBuffer* gBuffer) override;
+    void DrawRange(DrawPrimitive drawPrimitive, GBuffer* gBuffer,
+		   uint32_t first, uint32_t count) override;
     void DrawInstanced(DrawPrimitive drawPrimitive, GBuffer* gBuffer,
 		       uint32_t numInstanced) override;
     void DrawBuffer(DrawPrimitive drawPrimitive, GBuffer* gBuffer) override;
@@ -60,26 +76,40 @@ class GLRenderer : public Renderer {
 			     uint32_t numElement,
 			     uint32_t numInstanced) override;
     void LoadBuffer(GBuffer* gBuffer) override;
-    void LoadTexture(Texture* texture, GBuffer* gbuffer) override;
+    void LoadTexture(Texture* texture, GBuffer* gbuffer,
+		     uint32_t baseLevel) override;
+    void LoadTextureLevel(Texture* texture, GBuffer* gBuffer,
+			  uint32_t level) override;
     void Enable(Options option) override;
     void Disable(Options option) override;
     void Clear() override;
     void ClearColor(float r, float g, float b) override;
     void ClearDepth(float depthLevel) override;
+    void Viewport(int32_t x, int32_t y, uint32_t width,
+		  uint32_t height) override;
     void Uniform1u(const uint32_t count, const uint32_t* data,
-		   std::string name) override;
+		   UniformID uniform) override;
     void Uniform1i(const uint32_t count, const int32_t* data,
-		   std::string name) override;
+		   UniformID uniform) override;
     void Uniform1f(const uint32_t count, const float* data,
-		   std::string name) override;
+		   UniformID uniform) override;
     void Uniform2f(const uint32_t count, const Vect2* data,
-		   std::string name) override;
+		   UniformID uniform) override;
     void Uniform3f(const uint32_t count, const Vect3* data,
-		   std::string name) override;
+		   UniformID uniform) override;
     void Uniform4f(const uint32_t count, const Vect4* data,
-		   std::string name) override;
+		   UniformID uniform) override;
     void UniformMat(const uint32_t count, const Mat* mat,
-		    std::string name) override;
+		    UniformID uniform) override;
+    void UniformMat(const uint32_t count, const Mat4* mat,
+		    UniformID uniform) override;
+    uint32_t CreateUniformBuffer() override;
+    void* MapUniformBuffer(uint32_t buffer, uint32_t size) override;
+    void UnMapUniformBuffer(uint32_t buffer) override;
+    void BindUniformBuffer(uint32_t buffer, uint32_t binding, uint32_t offset,
+			   uint32_t size) override;
+    uint32_t GetUniformBufferAlignment() override;
+    void UniformBlockBinding(UniformID block, uint32_t binding) override;
     void UseShaderStage(ShaderStageHandler* shaderStagerHandler) override;
     void SetLayout(const uint32_t layout) override;
     void WireFrameMode(bool) override;
@@ -93,16 +123,41 @@ class GLRenderer : public Renderer {
     void FinalizeVertexSpecification();
     void UseCurrentShaderProgram();
     GLenum GetDrawTarget(DrawPrimitive drawPrimitive);
+    // 0 when the driver can't sample the format
+    GLenum GetCompressedFormat(Texture::Format format);
 
    private:
     static bool gladLoaded;
     uint32_t pvao;
+    bool hasS3TC;
+    bool hasBPTC;
+    GLint uniformBufferAlignment;
 
    private:
-    std::vector<std::pair<uint32_t, std::vector<uint32_t>>> vaos;
+    struct GLVertexAttribute {
+	GLint count;
+	GLenum type;
+	GLboolean normalized;
+	uint32_t offset;
+    };
+    struct GLVertexLayout {
+	std::vector<GLVertexAttribute> attributes;
+	uint32_t stride;
+    };
+    std::vector<GLVertexLayout> layouts;
+    // Attribute arrays the last SetLayout enabled
+    uint32_t enabledAttributes = 0;
+    struct GLUniformBuffer {
+	uint32_t rendererID;
+	uint32_t capacity;
+    };
+    std::vector<GLUniformBuffer> uniformBuffers;
 
    public:
     uint32_t shaderProgram;
+    // Locations of the current program, filled in when it linked
+    const std::unordered_map<UniformID, GLint>* uniforms = nullptr;
+    const std::unordered_map<UniformID, GLuint>* uniformBlocks = nullptr;
 };
 
 template <>
@@ -119,9 +174,18 @@ struct NativeShaderStageHandler<GLRenderer> : public ShaderStageHandler {
     bool linked;
     uint32_t program;
     GLRenderer* renderer;
+    std::unordered_map<UniformID, GLint> uniforms;
+    // Block indices by the hash of the block name
+    std::unordered_map<UniformID, GLuint> uniformBlocks;
     NativeShaderStageHandler();
     ~NativeShaderStageHandler();
     void Load() override;
     void UnLoad() override;
+
+   private:
+    void LoadUniforms();
+    void LoadUniformBlocks();
+    void AddUniform(const std::string& name,
+		    std::unordered_map<UniformID, std::string>& names);
 };
 
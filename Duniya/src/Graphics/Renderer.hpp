@@ -2,13 +2,26 @@
 
 #include <ECS/ECS.hpp>
 #include <ECS/GraphicsComponent.hpp>
+#include <Graphics/UniformID.hpp>
+#include <Math/FixedMat.hpp>
 #include <Math/Mat.hpp>
 #include <cstdint>
 #include <iostream>
 #include <memory>
 #include <vector>
 
-using VertexSpecification = std::vector<std::pair<std::string, uint32_t>>;
+enum class AttributeType { FLOAT, HALF_FLOAT, SHORT };
+
+struct VertexAttribute {
+    std::string name;
+    uint32_t count;
+    AttributeType type;
+    // Integers are read as [-1, 1] rather than as their value
+    bool normalized;
+};
+
+// Attributes are packed tightly in order
+using VertexSpecification = std::vector<VertexAttribute>;
 
 struct GBinder {
     virtual void Bind() const noexcept = 0;
@@ -61,6 +74,9 @@ class Renderer {
     void Bind(GBuffer& buffer);
     void UnBind(GBuffer& buffer);
     virtual void Draw(DrawPrimitive drawPrimitive, GBuffer* gBuffer) = 0;
+    // Draws count indices of the index buffer starting at first
+    virtual void DrawRange(DrawPrimitive drawPrimitive, GBuffer* gBuffer,
+			   uint32_t first, uint32_t count) = 0;
     virtual void DrawInstanced(DrawPrimitive drawPrimitive, GBuffer* gBuffer,
 			       uint32_t numInstanced) = 0;
     virtual void DrawBuffer(DrawPrimitive drawPrimitive, GBuffer* gBuffer) = 0;
@@ -70,28 +86,51 @@ class Renderer {
 				     GBuffer* gBuffer, uint32_t numElement,
 				     uint32_t numInstanced) = 0;
     virtual void LoadBuffer(GBuffer* gBuffer) = 0;
-    virtual void LoadTexture(Texture* texture, GBuffer* gBuffer) = 0;
+    // Uploads the levels from baseLevel down to the smallest one, the finer
+    // ones can follow through LoadTextureLevel
+    virtual void LoadTexture(Texture* texture, GBuffer* gBuffer,
+			     uint32_t baseLevel) = 0;
+    virtual void LoadTextureLevel(Texture* texture, GBuffer* gBuffer,
+				  uint32_t level) = 0;
     virtual void Enable(Options option) = 0;
     virtual void Disable(Options option) = 0;
     virtual void Uniform1f(const uint32_t count, const float* data,
-			   std::string name) = 0;
+			   UniformID uniform) = 0;
     virtual void Uniform2f(const uint32_t count, const Vect2* data,
-			   std::string name) = 0;
+			   UniformID uniform) = 0;
     virtual void Uniform3f(const uint32_t count, const Vect3* data,
-			   std::string name) = 0;
+			   UniformID uniform) = 0;
     virtual void Uniform1u(const uint32_t count, const uint32_t* data,
-			   std::string name) = 0;
+			   UniformID uniform) = 0;
     virtual void Uniform1i(const uint32_t count, const int32_t* data,
-			   std::string name) = 0;
+			   UniformID uniform) = 0;
     virtual void Uniform4f(const uint32_t count, const Vect4* data,
-			   std::string name) = 0;
+			   UniformID uniform) = 0;
     virtual void UniformMat(const uint32_t count, const Mat* mat,
-			    std::string name) = 0;
+			    UniformID uniform) = 0;
+    virtual void UniformMat(const uint32_t count, const Mat4* mat,
+			    UniformID uniform) = 0;
+    // Uniform buffers back the shaders' uniform blocks, they are written
+    // whole once a frame and the blocks read ranges of them
+    virtual uint32_t CreateUniformBuffer() = 0;
+    // Write only, the previous contents are dropped. The buffer grows to
+    // size when it's smaller.
+    virtual void* MapUniformBuffer(uint32_t buffer, uint32_t size) = 0;
+    virtual void UnMapUniformBuffer(uint32_t buffer) = 0;
+    // offset is a multiple of GetUniformBufferAlignment
+    virtual void BindUniformBuffer(uint32_t buffer, uint32_t binding,
+				   uint32_t offset, uint32_t size) = 0;
+    virtual uint32_t GetUniformBufferAlignment() = 0;
+    // The current program's block reads the buffer range bound to binding
+    virtual void UniformBlockBinding(UniformID block, uint32_t binding) = 0;
     virtual void UseShaderStage(ShaderStageHandler* shaderStageHandler) = 0;
     virtual void SetLayout(const uint32_t layout) = 0;
     virtual void Clear() = 0;
     virtual void ClearColor(float r, float g, float b) = 0;
     virtual void ClearDepth(float depthLevel) = 0;
+    // In pixels from the bottom left of the window
+    virtual void Viewport(int32_t x, int32_t y, uint32_t width,
+			  uint32_t height) = 0;
     virtual void WireFrameMode(bool) = 0;
     virtual NativeShaderHandlerParent* CreateShader(ShaderType type) = 0;
     virtual ShaderStageHandler* CreateShaderStage() = 0;
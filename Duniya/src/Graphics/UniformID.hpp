@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+// Uniforms are addressed by the FNV-1a hash of their GLSL name, the renderer
+// resolves the hashes to locations once when the program links. Fixed names
+// hash at compile time, array elements and struct fields hash their full
+// name, as in "pointLights[2].lightColor.ambient".
+using UniformID = uint32_t;
+
+constexpr UniformID uniformHashBasis = 2166136261u;
+constexpr UniformID uniformHashPrime = 16777619u;
+
+// Continues hash with name so names can be hashed piece by piece
+constexpr UniformID HashUniform(std::string_view name,
+				UniformID hash = uniformHashBasis) {
+    for (char c : name) {
+	hash ^= static_cast<uint8_t>(c);
+	hash *= uniformHashPrime;
+    }
+    return hash;
+}
+
+// Hash of name[index]field without building the string
+constexpr UniformID HashUniformElement(std::string_view name, uint32_t index,
+				       std::string_view field = "") {
+    char digits[10] = {};
+    uint32_t count = 0;
+    do {
+	digits[count++] = '0' + index % 10;
+	index /= 10;
+    } while (index != 0);
+    UniformID hash = HashUniform("[", HashUniform(name));
+    while (count != 0) hash = HashUniform({&digits[--count], 1}, hash);
+    return HashUniform(field, HashUniform("]", hash));
+}
@@ -0,0 +1,248 @@
+#include "VertexFormat.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Largest position error quantizing may introduce, in world units
+constexpr float maxPositionError = 1e-3f;
+// Half floats keep about a texel of a 1024 texture up to here
+constexpr float maxHalfUV = 4.f;
+
+uint32_t GetVertexSize(VertexFormat format) {
+    switch (format) {
+	case VertexFormat::COMPACT:
+	    return 16;
+	case VertexFormat::COMPACT_NO_UV:
+	    return 12;
+	case VertexFormat::COMPACT_FLOAT_POSITION:
+	    return 20;
+	default:
+	    return sizeof(Vertex);
+    };
+}
+
+VertexSpecification GetVertexSpecification(VertexFormat format) {
+    // Positions carry a fourth short so the normal stays 4 byte aligned
+    switch (format) {
+	case VertexFormat::COMPACT:
+	    return {{"aPos", 4, AttributeType::SHORT, true},
+		    {"aNormal", 2, AttributeType::SHORT, true},
+		    {"texCoord", 2, AttributeType::HALF_FLOAT, false}};
+	case VertexFormat::COMPACT_NO_UV:
+	    return {{"aPos", 4, AttributeType::SHORT, true},
+		    {"aNormal", 2, AttributeType::SHORT, true}};
+	case VertexFormat::COMPACT_FLOAT_POSITION:
+	    return {{"aPos", 3, AttributeType::FLOAT, false},
+		    {"aNormal", 2, AttributeType::SHORT, true},
+		    {"texCoord", 2, AttributeType::HALF_FLOAT, false}};
+	default:
+	    return {{"aPos", 4, AttributeType::FLOAT, false},
+		    {"aNormal", 3, AttributeType::FLOAT, false},
+		    {"texCoord", 2, AttributeType::FLOAT, false}};
+    };
+}
+
+bool HasQuantizedPosition(VertexFormat format) {
+    return format == VertexFormat::COMPACT ||
+	   format == VertexFormat::COMPACT_NO_UV;
+}
+
+bool HasOctahedralNormal(VertexFormat format) {
+    return format != VertexFormat::FULL;
+}
+
+static void GetBounds(const Vertex* vertices, uint32_t count, float min[3],
+		      float max[3]) {
+    for (uint32_t k = 0; k < 3; k++) {
+	min[k] = count ? INFINITY : 0.f;
+	max[k] = count ? -INFINITY : 0.f;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+	const float position[3] = {vertices[i].aPos.x, vertices[i].aPos.y,
+				   vertices[i].aPos.z};
+	for (uint32_t k = 0; k < 3; k++) {
+	    min[k] = std::min(min[k], position[k]);
+	    max[k] = std::max(max[k], position[k]);
+	}
+    }
+}
+
+VertexFormat SelectVertexFormat(const Vertex* vertices, uint32_t count) {
+    float maxUV = 0.f;
+    for (uint32_t i = 0; i < count; i++)
+	maxUV = std::max({maxUV, std::fabs(vertices[i].texCord.x),
+			  std::fabs(vertices[i].texCord.y)});
+    if (maxUV > maxHalfUV) return VertexFormat::FULL;
+
+    float min[3], max[3];
+    GetBounds(vertices, count, min, max);
+    float halfExtent = 0.f;
+    for (uint32_t k = 0; k < 3; k++)
+	halfExtent = std::max(halfExtent, (max[k] - min[k]) / 2.f);
+    // Rounding is off by half a step at most
+    if (halfExtent / 32767.f / 2.f > maxPositionError)
+	return VertexFormat::COMPACT_FLOAT_POSITION;
+    return maxUV == 0.f ? VertexFormat::COMPACT_NO_UV : VertexFormat::COMPACT;
+}
+
+static int16_t ToSnorm16(float value) {
+    return (int16_t)std::lround(std::clamp(value, -1.f, 1.f) * 32767.f);
+}
+
+static uint16_t ToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, 4);
+    uint16_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = (int32_t)((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+    if (exponent >= 31) return sign | 0x7c00;
+    if (exponent <= 0) {
+	// Denormal, or too small for one
+	if (exponent < -10) return sign;
+	mantissa |= 0x800000;
+	uint32_t shift = 14 - exponent;
+	return sign | (uint16_t)((mantissa + (1u << (shift - 1))) >> shift);
+    }
+    // Rounding may carry into the exponent, which is still correct
+    return sign | (uint16_t)(((exponent << 10) | (mantissa >> 13)) +
+			     ((mantissa >> 12) & 1));
+}
+
+// As OpenGL normalizes snorm16, -32768 and -32767 are both -1
+static float FromSnorm16(int16_t value) {
+    return std::max(value / 32767.f, -1.f);
+}
+
+static float FromHalf(uint16_t value) {
+    uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1f;
+    uint32_t mantissa = value & 0x3ff;
+    uint32_t bits;
+    if (exponent == 31) {
+	bits = sign | 0x7f800000 | (mantissa << 13);
+    } else if (exponent != 0) {
+	bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    } else {
+	// Denormals are exact in float, zero keeps its sign
+	float magnitude = std::ldexp((float)mantissa, -24);
+	memcpy(&bits, &magnitude, 4);
+	bits |= sign;
+    }
+    float result;
+    memcpy(&result, &bits, 4);
+    return result;
+}
+
+// Folds the unit sphere onto the [-1, 1] square
+static void OctahedralEncode(const Vect3& normal, int16_t encoded[2]) {
+    float length =
+	std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+    float x = length > 0.f ? normal.x / length : 0.f;
+    float y = length > 0.f ? normal.y / length : 0.f;
+    if (length > 0.f && normal.z < 0.f) {
+	float foldedX = (1.f - std::fabs(y)) * (x >= 0.f ? 1.f : -1.f);
+	float foldedY = (1.f - std::fabs(x)) * (y >= 0.f ? 1.f : -1.f);
+	x = foldedX;
+	y = foldedY;
+    }
+    encoded[0] = ToSnorm16(x);
+    encoded[1] = ToSnorm16(y);
+}
+
+void EncodeVertices(const Vertex* vertices, uint32_t count,
+		    VertexFormat format, Mesh& mesh, uint8_t* output) {
+    mesh.vertexFormat = format;
+    mesh.positionScale = Vect3(1.f, 1.f, 1.f);
+    mesh.positionOffset = Vect3();
+    uint32_t vertexSize = GetVertexSize(format);
+    if (format == VertexFormat::FULL) {
+	memcpy(output, vertices, (size_t)vertexSize * count);
+	return;
+    }
+    float min[3], max[3], scale[3], offset[3];
+    GetBounds(vertices, count, min, max);
+    for (uint32_t k = 0; k < 3; k++) {
+	offset[k] = (min[k] + max[k]) / 2.f;
+	scale[k] = max[k] > min[k] ? (max[k] - min[k]) / 2.f : 1.f;
+    }
+    if (HasQuantizedPosition(format)) {
+	mesh.positionScale = Vect3(scale[0], scale[1], scale[2]);
+	mesh.positionOffset = Vect3(offset[0], offset[1], offset[2]);
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+	const Vertex& vertex = vertices[i];
+	uint8_t* out = output + (size_t)i * vertexSize;
+	const float position[3] = {vertex.aPos.x, vertex.aPos.y,
+				   vertex.aPos.z};
+	if (HasQuantizedPosition(format)) {
+	    int16_t quantized[4] = {0, 0, 0, 32767};
+	    for (uint32_t k = 0; k < 3; k++)
+		quantized[k] = ToSnorm16((position[k] - offset[k]) / scale[k]);
+	    memcpy(out, quantized, 8);
+	    out += 8;
+	} else {
+	    memcpy(out, position, 12);
+	    out += 12;
+	}
+	int16_t normal[2];
+	OctahedralEncode(vertex.aNormal, normal);
+	memcpy(out, normal, 4);
+	out += 4;
+	if (format != VertexFormat::COMPACT_NO_UV) {
+	    uint16_t uv[2] = {ToHalf(vertex.texCord.x),
+			      ToHalf(vertex.texCord.y)};
+	    memcpy(out, uv, 4);
+	}
+    }
+}
+
+// The vertex shader's OctahedralDecode
+static Vect3 OctahedralDecode(const int16_t encoded[2]) {
+    float x = FromSnorm16(encoded[0]), y = FromSnorm16(encoded[1]);
+    float z = 1.f - std::fabs(x) - std::fabs(y);
+    float t = std::max(-z, 0.f);
+    x += x >= 0.f ? -t : t;
+    y += y >= 0.f ? -t : t;
+    float length = std::sqrt(x * x + y * y + z * z);
+    return Vect3(x / length, y / length, z / length);
+}
+
+void DecodeVertices(const uint8_t* input, uint32_t count, const Mesh& mesh,
+		    Vertex* vertices) {
+    VertexFormat format = mesh.vertexFormat;
+    uint32_t vertexSize = GetVertexSize(format);
+    if (format == VertexFormat::FULL) {
+	memcpy(vertices, input, (size_t)vertexSize * count);
+	return;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+	Vertex& vertex = vertices[i];
+	const uint8_t* in = input + (size_t)i * vertexSize;
+	float position[3];
+	if (HasQuantizedPosition(format)) {
+	    int16_t quantized[4];
+	    memcpy(quantized, in, 8);
+	    for (uint32_t k = 0; k < 3; k++)
+		position[k] = mesh.positionOffset.coordinates[k] +
+			      mesh.positionScale.coordinates[k] *
+				  FromSnorm16(quantized[k]);
+	    in += 8;
+	} else {
+	    memcpy(position, in, 12);
+	    in += 12;
+	}
+	vertex.aPos = Vect4(position[0], position[1], position[2], 1.f);
+	int16_t normal[2];
+	memcpy(normal, in, 4);
+	vertex.aNormal = OctahedralDecode(normal);
+	in += 4;
+	vertex.texCord = Vect2();
+	if (format != VertexFormat::COMPACT_NO_UV) {
+	    uint16_t uv[2];
+	    memcpy(uv, in, 4);
+	    vertex.texCord = Vect2(FromHalf(uv[0]), FromHalf(uv[1]));
+	}
+    }
+}
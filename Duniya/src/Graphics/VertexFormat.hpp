@@ -0,0 +1,28 @@
+#pragma once
+#include <ECS/GraphicsComponent.hpp>
+#include <Graphics/Renderer.hpp>
+#include <cstdint>
+
+// Vertex layouts a mesh can be stored in, every one has aPos, aNormal and
+// texCoord (except COMPACT_NO_UV) in that order:
+// FULL                    Vertex as is, 36 bytes
+// COMPACT                 snorm16 position, octahedral snorm16 normal and
+//                         half float uv, 16 bytes
+// COMPACT_NO_UV           COMPACT without the uv, 12 bytes
+// COMPACT_FLOAT_POSITION  COMPACT with a float position, 20 bytes
+
+uint32_t GetVertexSize(VertexFormat format);
+VertexSpecification GetVertexSpecification(VertexFormat format);
+bool HasQuantizedPosition(VertexFormat format);
+bool HasOctahedralNormal(VertexFormat format);
+
+// The smallest layout which keeps the mesh's positions and uvs intact
+VertexFormat SelectVertexFormat(const Vertex* vertices, uint32_t count);
+// Writes the vertices in format to output and sets the mesh's
+// vertexFormat, positionScale and positionOffset
+void EncodeVertices(const Vertex* vertices, uint32_t count,
+		    VertexFormat format, Mesh& mesh, uint8_t* output);
+// Reads back what EncodeVertices wrote for mesh, decoded the way the vertex
+// shader decodes it
+void DecodeVertices(const uint8_t* input, uint32_t count, const Mesh& mesh,
+		    Vertex* vertices);
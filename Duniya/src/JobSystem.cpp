@@ -0,0 +1,109 @@
+#include "JobSystem.hpp"
+
+#include <algorithm>
+
+JobSystem* JobSystem::singleton = nullptr;
+
+JobSystem::JobSystem(uint32_t workerCount) : quit(false) {
+    for (uint32_t i = 0; i < workerCount; i++)
+	workers.emplace_back(&JobSystem::WorkerLoop, this);
+}
+
+JobSystem::~JobSystem() {
+    {
+	std::unique_lock<std::mutex> lock(jobsMutex);
+	quit = true;
+    }
+    jobsCondition.notify_all();
+    for (auto& worker : workers) worker.join();
+}
+
+// Loader threads may ask for the pool first, only one of them may create
+// it, the worker count of later calls is ignored
+static std::once_flag singletonInit;
+
+JobSystem* JobSystem::init(uint32_t workerCount) {
+    std::call_once(singletonInit, [workerCount]() mutable {
+	if (workerCount == defaultWorkerCount) {
+	    uint32_t hardwareThreads = std::thread::hardware_concurrency();
+	    workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+	JobSystem::singleton = new JobSystem(workerCount);
+    });
+    return singleton;
+}
+
+JobSystem* JobSystem::GetSingleton() { return init(); }
+
+uint32_t JobSystem::GetWorkerCount() const { return workers.size(); }
+
+void JobSystem::Enqueue(Job job) {
+    {
+	std::unique_lock<std::mutex> lock(jobsMutex);
+	jobs.push_back(std::move(job));
+    }
+    jobsCondition.notify_one();
+}
+
+bool JobSystem::RunPending() {
+    Job job;
+    {
+	std::unique_lock<std::mutex> lock(jobsMutex);
+	if (jobs.empty()) return false;
+	job = std::move(jobs.front());
+	jobs.pop_front();
+    }
+    job();
+    return true;
+}
+
+void JobSystem::WorkerLoop() {
+    while (true) {
+	Job job;
+	{
+	    std::unique_lock<std::mutex> lock(jobsMutex);
+	    jobsCondition.wait(lock, [this]() { return quit || !jobs.empty(); });
+	    if (quit && jobs.empty()) return;
+	    job = std::move(jobs.front());
+	    jobs.pop_front();
+	}
+	job();
+    }
+}
+
+void JobSystem::ParallelFor(
+    uint32_t count, uint32_t grainSize,
+    const std::function<void(uint32_t, uint32_t)>& function) {
+    if (count == 0) return;
+    grainSize = std::max(grainSize, 1u);
+    uint32_t rangeCount = (count + grainSize - 1) / grainSize;
+    rangeCount = std::min(rangeCount, (GetWorkerCount() + 1) * 4);
+    if (rangeCount <= 1) {
+	function(0, count);
+	return;
+    }
+    uint32_t rangeSize = (count + rangeCount - 1) / rangeCount;
+    rangeCount = (count + rangeSize - 1) / rangeSize;
+
+    std::atomic<uint32_t> remaining(rangeCount);
+    std::exception_ptr error = nullptr;
+    std::mutex errorMutex;
+    auto RunRange = [&](uint32_t range) {
+	uint32_t begin = range * rangeSize;
+	uint32_t end = std::min(begin + rangeSize, count);
+	try {
+	    function(begin, end);
+	} catch (...) {
+	    std::unique_lock<std::mutex> lock(errorMutex);
+	    if (error == nullptr) error = std::current_exception();
+	}
+	remaining--;
+    };
+    for (uint32_t range = 1; range < rangeCount; range++)
+	Enqueue([&RunRange, range]() { RunRange(range); });
+    RunRange(0);
+    while (remaining.load() != 0) {
+	if (!RunPending()) std::this_thread::yield();
+    }
+    if (error != nullptr) std::rethrow_exception(error);
+}
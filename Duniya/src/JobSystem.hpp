@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Pool of worker threads shared by every system that wants to spread work
+// over the cores. Threads waiting on their own jobs help draining the queue,
+// so jobs are free to push and wait on more jobs.
+class JobSystem {
+   public:
+    using Job = std::function<void()>;
+
+   private:
+    JobSystem(uint32_t workerCount);
+
+   public:
+    ~JobSystem();
+    // Picks hardware_concurrency - 1 workers
+    static constexpr uint32_t defaultWorkerCount = ~0u;
+    // With no workers ParallelFor runs every range on the calling thread
+    // and Push runs its job before returning, nothing is left in the queue
+    // for a future nobody would fulfil
+    static JobSystem* init(uint32_t workerCount = defaultWorkerCount);
+    static JobSystem* GetSingleton();
+
+    template <typename F>
+    auto Push(F&& function) -> std::future<decltype(function())>;
+    // Splits [0, count) in ranges of at least grainSize elements and runs
+    // function(begin, end) for each of them, returns once all are done.
+    void ParallelFor(uint32_t count, uint32_t grainSize,
+		     const std::function<void(uint32_t, uint32_t)>& function);
+    // Runs one queued job on the calling thread, false if queue was empty
+    bool RunPending();
+    uint32_t GetWorkerCount() const;
+
+   private:
+    void Enqueue(Job job);
+    void WorkerLoop();
+
+   private:
+    std::vector<std::thread> workers;
+    std::deque<Job> jobs;
+    std::mutex jobsMutex;
+    std::condition_variable jobsCondition;
+    bool quit;
+
+   public:
+    static JobSystem* singleton;
+};
+
+template <typename F>
+auto JobSystem::Push(F&& function) -> std::future<decltype(function())> {
+    using Result = decltype(function());
+    auto task = std::make_shared<std::packaged_task<Result()>>(
+	std::forward<F>(function));
+    auto future = task->get_future();
+    if (workers.empty())
+	(*task)();
+    else
+	Enqueue([task]() { (*task)(); });
+    return future;
+}
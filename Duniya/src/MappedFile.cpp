@@ -0,0 +1,58 @@
+#include "MappedFile.hpp"
+
+#include <Exception.hpp>
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define DUNIYA_HAS_MMAP
+#endif
+
+MappedFile::MappedFile(const std::string& filePath, Access access)
+    : data(nullptr), size(0), mapped(false) {
+#ifdef DUNIYA_HAS_MMAP
+    int fd = open(filePath.c_str(), O_RDONLY);
+    if (fd >= 0) {
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0) {
+	    int protection = access == Access::COPY_ON_WRITE
+				 ? PROT_READ | PROT_WRITE
+				 : PROT_READ;
+	    void* address = mmap(nullptr, fileStat.st_size, protection,
+				 MAP_PRIVATE, fd, 0);
+	    if (address != MAP_FAILED) {
+		madvise(address, fileStat.st_size, MADV_SEQUENTIAL);
+		data = (char*)address;
+		size = fileStat.st_size;
+		mapped = true;
+	    }
+	}
+	close(fd);
+	if (mapped) return;
+    }
+#endif
+    std::ifstream fin(filePath, std::ios::binary | std::ios::ate);
+    if (!fin)
+	throw CException(__LINE__, __FILE__, "MappedFile",
+			 "Couldn't open the file path: " + filePath);
+    buffer.resize(fin.tellg());
+    fin.seekg(0);
+    fin.read(buffer.data(), buffer.size());
+    data = buffer.data();
+    size = buffer.size();
+}
+
+MappedFile::~MappedFile() {
+#ifdef DUNIYA_HAS_MMAP
+    if (mapped) munmap((void*)data, size);
+#endif
+}
+
+const char* MappedFile::GetData() const { return data; }
+
+char* MappedFile::GetData() { return data; }
+
+size_t MappedFile::GetSize() const { return size; }
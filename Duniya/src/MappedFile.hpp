@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// View of a whole file. The file is mmap'd where the platform allows it and
+// read into memory otherwise.
+class MappedFile {
+   public:
+    // COPY_ON_WRITE pages may be written to, the file itself never changes
+    enum class Access { READ, COPY_ON_WRITE };
+
+    MappedFile(const std::string& filePath, Access access = Access::READ);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* GetData() const;
+    // Only writable for COPY_ON_WRITE files
+    char* GetData();
+    size_t GetSize() const;
+
+   private:
+    char* data;
+    size_t size;
+    bool mapped;
+    std::vector<char> buffer;
+};
@@ -0,0 +1,502 @@
+#include "Bounds.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "Mat4Kernels.hpp"
+#include "SimdVect.hpp"
+
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define DUNIYA_BOUNDS_X86
+#define DUNIYA_TARGET(features) __attribute__((target(features)))
+#endif
+
+// Below this a ray counts as parallel to a slab or a triangle
+constexpr float parallelEpsilon = 1e-8f;
+
+static Vect3 Abs(const Vect3& vect) {
+    return Vect3(fabsf(vect.x), fabsf(vect.y), fabsf(vect.z));
+}
+
+// World matrices map column vectors, p' = mat * p
+static Vect3 TransformPoint(const Mat4& mat, const Vect3& point) {
+    Vect3 result;
+    for (uint32_t i = 0; i < 3; i++)
+	result.coordinates[i] = mat.Get(i, 0) * point.x +
+				mat.Get(i, 1) * point.y +
+				mat.Get(i, 2) * point.z + mat.Get(i, 3);
+    return result;
+}
+
+static Vect3 Column(const Mat4& mat, uint32_t column) {
+    return Vect3(mat.Get(0, column), mat.Get(1, column), mat.Get(2, column));
+}
+
+Plane::Plane(const Vect3& normal, float distance)
+    : normal(normal), distance(distance) {}
+
+Plane::Plane(const Vect3& normal, const Vect3& point)
+    : normal(normal), distance(-normal.dot(point)) {}
+
+void Plane::normalize() {
+    float length = normal.distance();
+    if (length == 0.f) return;
+    normal /= length;
+    distance /= length;
+}
+
+float Plane::SignedDistance(const Vect3& point) const {
+    return normal.dot(point) + distance;
+}
+
+AABB::AABB(const Vect3& min, const Vect3& max) : min(min), max(max) {}
+
+AABB AABB::FromCenterExtents(const Vect3& center, const Vect3& extents) {
+    return AABB(center - extents, center + extents);
+}
+
+// No points give an inverted box that anything merged into replaces
+AABB AABB::FromPoints(const Vect3* points, uint32_t count) {
+    float inf = std::numeric_limits<float>::infinity();
+    AABB box(Vect3(inf, inf, inf), Vect3(-inf, -inf, -inf));
+    for (uint32_t i = 0; i < count; i++) box.Merge(points[i]);
+    return box;
+}
+
+Vect3 AABB::Center() const { return (min + max) * .5f; }
+
+Vect3 AABB::Extents() const { return (max - min) * .5f; }
+
+void AABB::Merge(const Vect3& point) {
+    for (uint32_t i = 0; i < 3; i++) {
+	min.coordinates[i] = std::min(min.coordinates[i], point.coordinates[i]);
+	max.coordinates[i] = std::max(max.coordinates[i], point.coordinates[i]);
+    }
+}
+
+void AABB::Merge(const AABB& other) {
+    Merge(other.min);
+    Merge(other.max);
+}
+
+// Vect3's comparisons are lexicographic, these go component by component
+bool AABB::Contains(const Vect3& point) const {
+    for (uint32_t i = 0; i < 3; i++)
+	if (point.coordinates[i] < min.coordinates[i] ||
+	    point.coordinates[i] > max.coordinates[i])
+	    return false;
+    return true;
+}
+
+bool AABB::Intersects(const AABB& other) const {
+    for (uint32_t i = 0; i < 3; i++)
+	if (other.max.coordinates[i] < min.coordinates[i] ||
+	    other.min.coordinates[i] > max.coordinates[i])
+	    return false;
+    return true;
+}
+
+// Arvo's, the extents go through the absolute of the matrix
+AABB AABB::Transformed(const Mat4& mat) const {
+    Vect3 center = Center(), extents = Extents(), newExtents;
+    for (uint32_t i = 0; i < 3; i++)
+	newExtents.coordinates[i] = fabsf(mat.Get(i, 0)) * extents.x +
+				    fabsf(mat.Get(i, 1)) * extents.y +
+				    fabsf(mat.Get(i, 2)) * extents.z;
+    return FromCenterExtents(TransformPoint(mat, center), newExtents);
+}
+
+Sphere::Sphere(const Vect3& center, float radius)
+    : center(center), radius(radius) {}
+
+Sphere Sphere::FromPoints(const Vect3* points, uint32_t count) {
+    if (count == 0) return Sphere();
+    auto farthest = [&](const Vect3& from) {
+	uint32_t index = 0;
+	float best = -1.f;
+	for (uint32_t i = 0; i < count; i++) {
+	    Vect3 offset = points[i] - from;
+	    float distance = offset.dot(offset);
+	    if (distance > best) best = distance, index = i;
+	}
+	return points[index];
+    };
+    Vect3 a = farthest(points[0]);
+    Vect3 b = farthest(a);
+    Sphere sphere((a + b) * .5f, (b - a).distance() * .5f);
+    // Grows just enough to take in each point left out
+    for (uint32_t i = 0; i < count; i++) {
+	Vect3 offset = points[i] - sphere.center;
+	float distance = offset.distance();
+	if (distance <= sphere.radius) continue;
+	float radius = (sphere.radius + distance) * .5f;
+	sphere.center += offset * ((radius - sphere.radius) / distance);
+	sphere.radius = radius;
+    }
+    // Moving the center rounds, the radius is measured again from where it
+    // ended up so Contains holds for every point. The few ulps on top keep
+    // squaring it back from falling short.
+    float farthestDistance = 0.f;
+    for (uint32_t i = 0; i < count; i++) {
+	Vect3 offset = points[i] - sphere.center;
+	farthestDistance = std::max(farthestDistance, offset.dot(offset));
+    }
+    sphere.radius = sqrtf(farthestDistance) *
+		    (1.f + 4.f * std::numeric_limits<float>::epsilon());
+    return sphere;
+}
+
+bool Sphere::Contains(const Vect3& point) const {
+    Vect3 offset = point - center;
+    return offset.dot(offset) <= radius * radius;
+}
+
+bool Sphere::Intersects(const Sphere& other) const {
+    Vect3 offset = other.center - center;
+    float radii = radius + other.radius;
+    return offset.dot(offset) <= radii * radii;
+}
+
+bool Sphere::Intersects(const AABB& box) const {
+    Vect3 closest;
+    for (uint32_t i = 0; i < 3; i++)
+	closest.coordinates[i] =
+	    std::clamp(center.coordinates[i], box.min.coordinates[i],
+		       box.max.coordinates[i]);
+    return Contains(closest);
+}
+
+Sphere Sphere::Transformed(const Mat4& mat) const {
+    float scale = 0.f;
+    for (uint32_t i = 0; i < 3; i++) {
+	Vect3 axis = Column(mat, i);
+	scale = std::max(scale, axis.dot(axis));
+    }
+    return Sphere(TransformPoint(mat, center), radius * sqrtf(scale));
+}
+
+OBB OBB::FromAABB(const AABB& box, const Mat4& mat) {
+    OBB obb;
+    obb.center = TransformPoint(mat, box.Center());
+    Vect3 extents = box.Extents();
+    for (uint32_t i = 0; i < 3; i++) {
+	Vect3 axis = Column(mat, i);
+	float length = axis.distance();
+	if (length != 0.f) obb.axes[i] = axis / length;
+	obb.extents.coordinates[i] = extents.coordinates[i] * length;
+    }
+    return obb;
+}
+
+AABB OBB::ToAABB() const {
+    Vect3 size = Abs(axes[0]) * extents.x + Abs(axes[1]) * extents.y +
+		 Abs(axes[2]) * extents.z;
+    return AABB::FromCenterExtents(center, size);
+}
+
+bool OBB::Contains(const Vect3& point) const {
+    Vect3 offset = point - center;
+    for (uint32_t i = 0; i < 3; i++)
+	if (fabsf(offset.dot(axes[i])) > extents.coordinates[i]) return false;
+    return true;
+}
+
+// Gottschalk's, everything is in this box's frame. The epsilon keeps near
+// parallel edges from making a null cross product axis separate them.
+bool OBB::Intersects(const OBB& other) const {
+    constexpr float epsilon = 1e-6f;
+    float r[3][3], absR[3][3];
+    for (uint32_t i = 0; i < 3; i++)
+	for (uint32_t j = 0; j < 3; j++) {
+	    r[i][j] = axes[i].dot(other.axes[j]);
+	    absR[i][j] = fabsf(r[i][j]) + epsilon;
+	}
+    Vect3 offset = other.center - center;
+    float t[3] = {offset.dot(axes[0]), offset.dot(axes[1]),
+		  offset.dot(axes[2])};
+    const float* a = extents.coordinates;
+    const float* b = other.extents.coordinates;
+
+    for (uint32_t i = 0; i < 3; i++) {
+	float rb = b[0] * absR[i][0] + b[1] * absR[i][1] + b[2] * absR[i][2];
+	if (fabsf(t[i]) > a[i] + rb) return false;
+    }
+    for (uint32_t j = 0; j < 3; j++) {
+	float ra = a[0] * absR[0][j] + a[1] * absR[1][j] + a[2] * absR[2][j];
+	float distance = t[0] * r[0][j] + t[1] * r[1][j] + t[2] * r[2][j];
+	if (fabsf(distance) > ra + b[j]) return false;
+    }
+    // Axis i of this box crossed with axis j of other
+    for (uint32_t i = 0; i < 3; i++) {
+	uint32_t i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+	for (uint32_t j = 0; j < 3; j++) {
+	    uint32_t j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+	    float ra = a[i1] * absR[i2][j] + a[i2] * absR[i1][j];
+	    float rb = b[j1] * absR[i][j2] + b[j2] * absR[i][j1];
+	    float distance = t[i2] * r[i1][j] - t[i1] * r[i2][j];
+	    if (fabsf(distance) > ra + rb) return false;
+	}
+    }
+    return true;
+}
+
+// Gribb and Hartmann's, each plane is the last column plus or minus
+// another. Points are row vectors, clip = point * viewProjection, so clip
+// coordinate i is the dot with column i. Vect4A because Vect4's + and -
+// leave w alone.
+Frustum Frustum::FromMatrix(const Mat4& viewProjection) {
+    auto column = [&](uint32_t i) {
+	return Vect4A(viewProjection.Get(0, i), viewProjection.Get(1, i),
+		      viewProjection.Get(2, i), viewProjection.Get(3, i));
+    };
+    Vect4A last = column(3);
+    Frustum frustum;
+    for (uint32_t i = 0; i < 3; i++) {
+	Vect4A current = column(i);
+	Vect4A sides[2] = {last + current, last - current};
+	for (uint32_t side = 0; side < 2; side++) {
+	    Plane& plane = frustum.planes[i * 2 + side];
+	    plane = Plane(Vect3(sides[side].x, sides[side].y, sides[side].z),
+			  sides[side].w);
+	    plane.normalize();
+	}
+    }
+    return frustum;
+}
+
+bool Frustum::Intersects(const AABB& box) const {
+    Vect3 center = box.Center(), extents = box.Extents();
+    for (auto& plane : planes)
+	if (plane.SignedDistance(center) < -Abs(plane.normal).dot(extents))
+	    return false;
+    return true;
+}
+
+bool Frustum::Intersects(const Sphere& sphere) const {
+    for (auto& plane : planes)
+	if (plane.SignedDistance(sphere.center) < -sphere.radius) return false;
+    return true;
+}
+
+bool Frustum::Intersects(const OBB& box) const {
+    for (auto& plane : planes) {
+	float radius = 0.f;
+	for (uint32_t i = 0; i < 3; i++) {
+	    float projected = fabsf(plane.normal.dot(box.axes[i]));
+	    radius += box.extents.coordinates[i] * projected;
+	}
+	if (plane.SignedDistance(box.center) < -radius) return false;
+    }
+    return true;
+}
+
+bool Frustum::Contains(const Vect3& point) const {
+    for (auto& plane : planes)
+	if (plane.SignedDistance(point) < 0.f) return false;
+    return true;
+}
+
+// Slabs, a ray parallel to one only has to start between its planes
+bool Intersect(const Ray& ray, const AABB& box, float& t) {
+    float enter = 0.f, leave = std::numeric_limits<float>::infinity();
+    for (uint32_t i = 0; i < 3; i++) {
+	float origin = ray.origin.coordinates[i];
+	float direction = ray.direction.coordinates[i];
+	float min = box.min.coordinates[i], max = box.max.coordinates[i];
+	if (fabsf(direction) < parallelEpsilon) {
+	    if (origin < min || origin > max) return false;
+	    continue;
+	}
+	float inverse = 1.f / direction;
+	float first = (min - origin) * inverse;
+	float second = (max - origin) * inverse;
+	if (first > second) std::swap(first, second);
+	enter = std::max(enter, first);
+	leave = std::min(leave, second);
+	if (enter > leave) return false;
+    }
+    t = enter;
+    return true;
+}
+
+bool Intersect(const Ray& ray, const Sphere& sphere, float& t) {
+    Vect3 offset = ray.origin - sphere.center;
+    float a = ray.direction.dot(ray.direction);
+    float b = offset.dot(ray.direction);
+    float c = offset.dot(offset) - sphere.radius * sphere.radius;
+    // Outside and pointing away
+    if (c > 0.f && b > 0.f) return false;
+    float discriminant = b * b - a * c;
+    if (discriminant < 0.f || a == 0.f) return false;
+    t = std::max((-b - sqrtf(discriminant)) / a, 0.f);
+    return true;
+}
+
+bool Intersect(const Ray& ray, const Vect3& a, const Vect3& b,
+	       const Vect3& c, float& t, float* u, float* v) {
+    Vect3 edge1 = b - a, edge2 = c - a;
+    Vect3 p = ray.direction.cross(edge2);
+    float determinant = edge1.dot(p);
+    if (fabsf(determinant) < parallelEpsilon) return false;
+    float inverse = 1.f / determinant;
+    Vect3 offset = ray.origin - a;
+    float baryU = offset.dot(p) * inverse;
+    if (baryU < 0.f || baryU > 1.f) return false;
+    Vect3 q = offset.cross(edge1);
+    float baryV = ray.direction.dot(q) * inverse;
+    if (baryV < 0.f || baryU + baryV > 1.f) return false;
+    float distance = edge2.dot(q) * inverse;
+    if (distance < 0.f) return false;
+    t = distance;
+    if (u != nullptr) *u = baryU;
+    if (v != nullptr) *v = baryV;
+    return true;
+}
+
+// The batch tests run on N lanes of Floats, gathered from the AoS inputs.
+// Always inlined so the AVX2 callers get the body built for AVX2.
+template <typename Floats, uint32_t N>
+__attribute__((always_inline)) inline uint32_t CullAABBLanes(
+    const Frustum& frustum, const AABB* boxes, uint8_t* visible) {
+    Floats center[3], extents[3];
+    for (uint32_t lane = 0; lane < N; lane++)
+	for (uint32_t i = 0; i < 3; i++) {
+	    float min = boxes[lane].min.coordinates[i];
+	    float max = boxes[lane].max.coordinates[i];
+	    center[i][lane] = (max + min) * .5f;
+	    extents[i][lane] = (max - min) * .5f;
+	}
+    auto inside = Floats{} == Floats{};
+    for (auto& plane : frustum.planes) {
+	Floats distance = center[0] * plane.normal.x +
+			  center[1] * plane.normal.y +
+			  center[2] * plane.normal.z + plane.distance;
+	Floats radius = extents[0] * fabsf(plane.normal.x) +
+			extents[1] * fabsf(plane.normal.y) +
+			extents[2] * fabsf(plane.normal.z);
+	inside &= distance >= -radius;
+    }
+    uint32_t count = 0;
+    for (uint32_t lane = 0; lane < N; lane++) {
+	visible[lane] = inside[lane] != 0;
+	count += visible[lane];
+    }
+    return count;
+}
+
+template <typename Floats, uint32_t N>
+__attribute__((always_inline)) inline uint32_t CullSphereLanes(
+    const Frustum& frustum, const Sphere* spheres, uint8_t* visible) {
+    Floats center[3], radius;
+    for (uint32_t lane = 0; lane < N; lane++) {
+	for (uint32_t i = 0; i < 3; i++)
+	    center[i][lane] = spheres[lane].center.coordinates[i];
+	radius[lane] = spheres[lane].radius;
+    }
+    auto inside = Floats{} == Floats{};
+    for (auto& plane : frustum.planes) {
+	Floats distance = center[0] * plane.normal.x +
+			  center[1] * plane.normal.y +
+			  center[2] * plane.normal.z + plane.distance;
+	inside &= distance >= -radius;
+    }
+    uint32_t count = 0;
+    for (uint32_t lane = 0; lane < N; lane++) {
+	visible[lane] = inside[lane] != 0;
+	count += visible[lane];
+    }
+    return count;
+}
+
+// One at a time, the scalar level and the tails of the wider ones
+static uint32_t CullAABBs1(const Frustum& frustum, const AABB* boxes,
+			   uint32_t count, uint8_t* visible) {
+    uint32_t visibleCount = 0;
+    for (uint32_t i = 0; i < count; i++)
+	visibleCount += visible[i] = frustum.Intersects(boxes[i]);
+    return visibleCount;
+}
+
+static uint32_t CullSpheres1(const Frustum& frustum, const Sphere* spheres,
+			     uint32_t count, uint8_t* visible) {
+    uint32_t visibleCount = 0;
+    for (uint32_t i = 0; i < count; i++)
+	visibleCount += visible[i] = frustum.Intersects(spheres[i]);
+    return visibleCount;
+}
+
+static uint32_t CullAABBs4(const Frustum& frustum, const AABB* boxes,
+			   uint32_t count, uint8_t* visible) {
+    uint32_t visibleCount = 0, i = 0;
+    for (; i + 4 <= count; i += 4)
+	visibleCount +=
+	    CullAABBLanes<Float4, 4>(frustum, boxes + i, visible + i);
+    return visibleCount +
+	   CullAABBs1(frustum, boxes + i, count - i, visible + i);
+}
+
+static uint32_t CullSpheres4(const Frustum& frustum, const Sphere* spheres,
+			     uint32_t count, uint8_t* visible) {
+    uint32_t visibleCount = 0, i = 0;
+    for (; i + 4 <= count; i += 4)
+	visibleCount +=
+	    CullSphereLanes<Float4, 4>(frustum, spheres + i, visible + i);
+    return visibleCount +
+	   CullSpheres1(frustum, spheres + i, count - i, visible + i);
+}
+
+#ifdef DUNIYA_BOUNDS_X86
+DUNIYA_TARGET("avx2")
+static uint32_t CullAABBs8(const Frustum& frustum, const AABB* boxes,
+			   uint32_t count, uint8_t* visible) {
+    uint32_t visibleCount = 0, i = 0;
+    for (; i + 8 <= count; i += 8)
+	visibleCount +=
+	    CullAABBLanes<Float8, 8>(frustum, boxes + i, visible + i);
+    return visibleCount +
+	   CullAABBs4(frustum, boxes + i, count - i, visible + i);
+}
+
+DUNIYA_TARGET("avx2")
+static uint32_t CullSpheres8(const Frustum& frustum, const Sphere* spheres,
+			     uint32_t count, uint8_t* visible) {
+    uint32_t visibleCount = 0, i = 0;
+    for (; i + 8 <= count; i += 8)
+	visibleCount +=
+	    CullSphereLanes<Float8, 8>(frustum, spheres + i, visible + i);
+    return visibleCount +
+	   CullSpheres4(frustum, spheres + i, count - i, visible + i);
+}
+#endif
+
+uint32_t CullAABBs(const Frustum& frustum, const AABB* boxes, uint32_t count,
+		   uint8_t* visible) {
+#ifdef DUNIYA_BOUNDS_X86
+    switch (Mat4Kernels::GetSimdLevel()) {
+	case Mat4Kernels::SimdLevel::SCALAR:
+	    return CullAABBs1(frustum, boxes, count, visible);
+	case Mat4Kernels::SimdLevel::AVX2:
+	    return CullAABBs8(frustum, boxes, count, visible);
+	default:
+	    break;
+    }
+#endif
+    return CullAABBs4(frustum, boxes, count, visible);
+}
+
+uint32_t CullSpheres(const Frustum& frustum, const Sphere* spheres,
+		     uint32_t count, uint8_t* visible) {
+#ifdef DUNIYA_BOUNDS_X86
+    switch (Mat4Kernels::GetSimdLevel()) {
+	case Mat4Kernels::SimdLevel::SCALAR:
+	    return CullSpheres1(frustum, spheres, count, visible);
+	case Mat4Kernels::SimdLevel::AVX2:
+	    return CullSpheres8(frustum, spheres, count, visible);
+	default:
+	    break;
+    }
+#endif
+    return CullSpheres4(frustum, spheres, count, visible);
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+
+#include "FixedMat.hpp"
+#include "Vect3.hpp"
+
+// Bounding volumes for culling, picking and physics. The engine's matrices
+// come in two conventions and each function taking one names which:
+// - World matrices, as ComposeTransforms builds them, map column vectors,
+//   p' = mat * p, the translation in column 3.
+// - The camera's matrices map row vectors, clip = p * view * projection,
+//   the translation in row 3.
+
+// Points with dot(normal, p) + distance >= 0 are in front
+struct Plane {
+    Vect3 normal;
+    float distance = 0.f;
+
+    Plane() = default;
+    Plane(const Vect3& normal, float distance);
+    Plane(const Vect3& normal, const Vect3& point);
+    // Unit normal, distance scaled along
+    void normalize();
+    float SignedDistance(const Vect3& point) const;
+};
+
+struct AABB {
+    Vect3 min;
+    Vect3 max;
+
+    AABB() = default;
+    AABB(const Vect3& min, const Vect3& max);
+    static AABB FromCenterExtents(const Vect3& center, const Vect3& extents);
+    static AABB FromPoints(const Vect3* points, uint32_t count);
+
+    Vect3 Center() const;
+    // Half of the size
+    Vect3 Extents() const;
+    void Merge(const Vect3& point);
+    void Merge(const AABB& other);
+    bool Contains(const Vect3& point) const;
+    bool Intersects(const AABB& other) const;
+    // Box around the box a world matrix maps, p' = mat * p
+    AABB Transformed(const Mat4& mat) const;
+};
+
+struct Sphere {
+    Vect3 center;
+    float radius = 0.f;
+
+    Sphere() = default;
+    Sphere(const Vect3& center, float radius);
+    // Not the smallest sphere but close to it, Ritter's two passes
+    static Sphere FromPoints(const Vect3* points, uint32_t count);
+
+    bool Contains(const Vect3& point) const;
+    bool Intersects(const Sphere& other) const;
+    bool Intersects(const AABB& box) const;
+    // Mapped by a world matrix, p' = mat * p, the radius grows by the
+    // largest scale of mat
+    Sphere Transformed(const Mat4& mat) const;
+};
+
+// Box along axes, the axes are unit length and orthogonal
+struct OBB {
+    Vect3 center;
+    Vect3 axes[3] = {Vect3(1, 0, 0), Vect3(0, 1, 0), Vect3(0, 0, 1)};
+    Vect3 extents;
+
+    OBB() = default;
+    // box mapped by a world matrix, p' = mat * p, that may scale but not
+    // shear
+    static OBB FromAABB(const AABB& box, const Mat4& mat);
+
+    AABB ToAABB() const;
+    bool Contains(const Vect3& point) const;
+    // Separating axis test over the 15 axes
+    bool Intersects(const OBB& other) const;
+};
+
+struct Frustum {
+    enum PlaneIndex { LEFT, RIGHT, BOTTOM, TOP, NEAR_PLANE, FAR_PLANE };
+    // Normals point inwards
+    Plane planes[6];
+
+    // World space planes of the volume the camera's view * projection maps
+    // inside the OpenGL clip cube, -w <= x, y, z <= w, points taken as row
+    // vectors, clip = p * viewProjection
+    static Frustum FromMatrix(const Mat4& viewProjection);
+
+    // Conservative, boxes near the corners may be kept though they're out
+    bool Intersects(const AABB& box) const;
+    bool Intersects(const Sphere& sphere) const;
+    bool Intersects(const OBB& box) const;
+    bool Contains(const Vect3& point) const;
+};
+
+struct Ray {
+    Vect3 origin;
+    // Need not be unit length, hit distances are in its lengths
+    Vect3 direction;
+};
+
+// t is the distance to the entry point, 0 if origin is in the box. Misses
+// return false and leave t alone.
+bool Intersect(const Ray& ray, const AABB& box, float& t);
+bool Intersect(const Ray& ray, const Sphere& sphere, float& t);
+// Möller-Trumbore, both faces hit. u and v are the barycentrics of b and c.
+bool Intersect(const Ray& ray, const Vect3& a, const Vect3& b,
+	       const Vect3& c, float& t, float* u = nullptr,
+	       float* v = nullptr);
+
+// visible[i] = frustum.Intersects(boxes[i]), eight boxes at a time on AVX2,
+// one at the scalar level and four otherwise. Returns how many are visible.
+uint32_t CullAABBs(const Frustum& frustum, const AABB* boxes, uint32_t count,
+		   uint8_t* visible);
+uint32_t CullSpheres(const Frustum& frustum, const Sphere* spheres,
+		     uint32_t count, uint8_t* visible);
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cassert>
+#include <cmath>
+#include <initializer_list>
+#include <iostream>
+
+#include "Mat.hpp"
+#include "MathUtils.hpp"
+#include "Vect3.hpp"
+#include "Vect4.hpp"
+
+// Lets the constexpr operators take the SIMD kernels at run time
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_is_constant_evaluated)
+#define DUNIYA_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#endif
+#endif
+#ifndef DUNIYA_CONSTANT_EVALUATED
+#define DUNIYA_CONSTANT_EVALUATED() true
+#endif
+
+template <uint32_t R, uint32_t C>
+struct FixedMat;
+
+// Defined in Mat4Kernels.cpp
+namespace Mat4Kernels {
+FixedMat<4, 4> Multiply(const FixedMat<4, 4>& a, const FixedMat<4, 4>& b);
+Vect4 Transform(const FixedMat<4, 4>& mat, const Vect4& vect);
+FixedMat<4, 4> Transpose(const FixedMat<4, 4>& mat);
+};  // namespace Mat4Kernels
+
+// Matrix whose size is known at compile time, stored inline row by row like
+// Mat so the two convert freely. Nothing allocates and out of range accesses
+// are only caught by asserts. Use Mat for sizes only known at run time.
+template <uint32_t R, uint32_t C>
+struct FixedMat {
+    static constexpr uint32_t rows = R;
+    static constexpr uint32_t columns = C;
+
+    constexpr FixedMat() : data{} {}
+    // Row by row, missing values stay 0
+    constexpr FixedMat(std::initializer_list<float> l) : data{} {
+	uint32_t i = 0;
+	for (auto itr = l.begin(); i < R * C && itr != l.end(); i++, itr++)
+	    data[i] = *itr;
+    }
+    // The overlapping part of mat
+    explicit FixedMat(const Mat& mat) : data{} {
+	for (uint32_t i = 0; i < R && i < mat.dimension.row; i++)
+	    for (uint32_t j = 0; j < C && j < mat.dimension.column; j++)
+		data[i * C + j] = mat.Get(i, j);
+    }
+
+    Mat ToMat() const { return Mat({R, C}, const_cast<float*>(data)); }
+
+    constexpr float& Get(uint32_t row, uint32_t column) {
+	assert(row < R && column < C);
+	return data[row * C + column];
+    }
+    constexpr const float& Get(uint32_t row, uint32_t column) const {
+	assert(row < R && column < C);
+	return data[row * C + column];
+    }
+    constexpr float& operator[](MatIndex a) { return Get(a.x, a.y); }
+
+    template <uint32_t K>
+    constexpr FixedMat<R, K> operator*(const FixedMat<C, K>& other) const {
+	if constexpr (R == 4 && C == 4 && K == 4)
+	    if (!DUNIYA_CONSTANT_EVALUATED())
+		return Mat4Kernels::Multiply(*this, other);
+	FixedMat<R, K> mat;
+	for (uint32_t i = 0; i < R; i++)
+	    for (uint32_t a = 0; a < C; a++)
+		for (uint32_t j = 0; j < K; j++)
+		    mat.data[i * K + j] +=
+			data[i * C + a] * other.data[a * K + j];
+	return mat;
+    }
+    constexpr FixedMat& operator*=(const FixedMat<C, C>& other) {
+	return *this = *this * other;
+    }
+    constexpr FixedMat operator+(const FixedMat& other) const {
+	FixedMat mat;
+	for (uint32_t i = 0; i < R * C; i++)
+	    mat.data[i] = data[i] + other.data[i];
+	return mat;
+    }
+    constexpr FixedMat operator-(const FixedMat& other) const {
+	FixedMat mat;
+	for (uint32_t i = 0; i < R * C; i++)
+	    mat.data[i] = data[i] - other.data[i];
+	return mat;
+    }
+    constexpr FixedMat& operator+=(const FixedMat& other) {
+	return *this = *this + other;
+    }
+    constexpr FixedMat& operator-=(const FixedMat& other) {
+	return *this = *this - other;
+    }
+
+    Vect3 operator*(const Vect3& other) const {
+	static_assert(R == 3 && C == 3, "Vect3 needs a 3x3 matrix");
+	Vect3 ans;
+	for (uint32_t i = 0; i < 3; i++)
+	    for (uint32_t j = 0; j < 3; j++)
+		ans.coordinates[i] += data[i * 3 + j] * other.coordinates[j];
+	return ans;
+    }
+    Vect4 operator*(const Vect4& other) const {
+	static_assert(R == 4 && C == 4, "Vect4 needs a 4x4 matrix");
+	return Mat4Kernels::Transform(*this, other);
+    }
+
+    constexpr FixedMat<C, R> Transposed() const {
+	if constexpr (R == 4 && C == 4)
+	    if (!DUNIYA_CONSTANT_EVALUATED()) return Mat4Kernels::Transpose(*this);
+	FixedMat<C, R> mat;
+	for (uint32_t i = 0; i < R; i++)
+	    for (uint32_t j = 0; j < C; j++) mat.data[j * R + i] = data[i * C + j];
+	return mat;
+    }
+
+    friend std::ostream& operator<<(std::ostream& output,
+				    const FixedMat& mat) {
+	for (uint32_t i = 0; i < R; i++) {
+	    for (uint32_t j = 0; j < C; j++)
+		output << mat.data[i * C + j] << " ";
+	    output << std::endl;
+	}
+	return output;
+    }
+
+    float data[R * C];
+};
+
+using Mat3 = FixedMat<3, 3>;
+using Mat4 = FixedMat<4, 4>;
+
+// Arrays of them are handed to the renderer as is
+static_assert(sizeof(Mat4) == sizeof(float) * 16, "Mat4 must stay packed");
+
+namespace DefaultMatrix {
+template <uint32_t N>
+constexpr FixedMat<N, N> generateIdentityMatrix() {
+    FixedMat<N, N> mat;
+    for (uint32_t i = 0; i < N; i++) mat.data[i * N + i] = 1.f;
+    return mat;
+}
+template <uint32_t N>
+FixedMat<N, N> generateRollMatrix(float x) {
+    static_assert(N >= 3, "roll needs at least a 3x3 matrix");
+    auto mat = generateIdentityMatrix<N>();
+    mat.Get(1, 1) = cosf(x);
+    mat.Get(1, 2) = -sinf(x);
+    mat.Get(2, 1) = sinf(x);
+    mat.Get(2, 2) = cosf(x);
+    return mat;
+}
+template <uint32_t N>
+FixedMat<N, N> generatePitchMatrix(float y) {
+    static_assert(N >= 3, "pitch needs at least a 3x3 matrix");
+    auto mat = generateIdentityMatrix<N>();
+    mat.Get(0, 0) = cosf(y);
+    mat.Get(0, 2) = sinf(y);
+    mat.Get(2, 0) = -sinf(y);
+    mat.Get(2, 2) = cosf(y);
+    return mat;
+}
+template <uint32_t N>
+FixedMat<N, N> generateYawMatrix(float z) {
+    static_assert(N >= 2, "yaw needs at least a 2x2 matrix");
+    auto mat = generateIdentityMatrix<N>();
+    mat.Get(0, 0) = cosf(z);
+    mat.Get(0, 1) = -sinf(z);
+    mat.Get(1, 0) = sinf(z);
+    mat.Get(1, 1) = cosf(z);
+    return mat;
+}
+};  // namespace DefaultMatrix
@@ -3,7 +3,9 @@
 
 #include <string.h>
 
+#include <Exception.hpp>
 #include <cassert>
+#include <cmath>
 #include <initializer_list>
 #include <stdexcept>
 
@@ -22,6 +24,7 @@ Mat::Mat(Dimension dimension, float* otherBuffer) {
 }
 
 Mat::Mat(Dimension s, const std::initializer_list<float> l) {
+    dimension = s;
     sizet = s.row * s.column;
     buffer.reset(new float[sizet]);
     auto itr = l.begin();
@@ -139,6 +142,72 @@ Mat Mat::operator-=(const Mat& other) {
     return *this;
 }
 
+// Reduces to an upper triangle, the product of the pivots is the determinant
+float Mat::Deter() {
+    if (dimension.row != dimension.column)
+	throw CException(__LINE__, __FILE__, "Mat",
+			 "determinant of a non square matrix");
+    uint32_t n = dimension.row;
+    Mat mat(*this);
+    float det = 1.f;
+    for (uint32_t i = 0; i < n; i++) {
+	uint32_t pivot = i;
+	for (uint32_t r = i + 1; r < n; r++)
+	    if (fabsf(mat.Get(r, i)) > fabsf(mat.Get(pivot, i))) pivot = r;
+	if (mat.Get(pivot, i) == 0.f) return 0.f;
+	if (pivot != i) {
+	    for (uint32_t c = 0; c < n; c++)
+		std::swap(mat.Get(i, c), mat.Get(pivot, c));
+	    det = -det;
+	}
+	det *= mat.Get(i, i);
+	for (uint32_t r = i + 1; r < n; r++) {
+	    float factor = mat.Get(r, i) / mat.Get(i, i);
+	    for (uint32_t c = i; c < n; c++)
+		mat.Get(r, c) -= factor * mat.Get(i, c);
+	}
+    }
+    return det;
+}
+
+// Gauss Jordan with partial pivoting, the identity next to it turns into the
+// inverse
+Mat& Mat::inverse() {
+    if (dimension.row != dimension.column)
+	throw CException(__LINE__, __FILE__, "Mat",
+			 "inverse of a non square matrix");
+    uint32_t n = dimension.row;
+    Mat mat(*this);
+    Mat result = DefaultMatrix::generateIdentityMatrix(dimension);
+    for (uint32_t i = 0; i < n; i++) {
+	uint32_t pivot = i;
+	for (uint32_t r = i + 1; r < n; r++)
+	    if (fabsf(mat.Get(r, i)) > fabsf(mat.Get(pivot, i))) pivot = r;
+	if (mat.Get(pivot, i) == 0.f)
+	    throw CException(__LINE__, __FILE__, "Mat",
+			     "inverse of a singular matrix");
+	if (pivot != i)
+	    for (uint32_t c = 0; c < n; c++) {
+		std::swap(mat.Get(i, c), mat.Get(pivot, c));
+		std::swap(result.Get(i, c), result.Get(pivot, c));
+	    }
+	float scale = 1.f / mat.Get(i, i);
+	for (uint32_t c = 0; c < n; c++) {
+	    mat.Get(i, c) *= scale;
+	    result.Get(i, c) *= scale;
+	}
+	for (uint32_t r = 0; r < n; r++) {
+	    if (r == i || mat.Get(r, i) == 0.f) continue;
+	    float factor = mat.Get(r, i);
+	    for (uint32_t c = 0; c < n; c++) {
+		mat.Get(r, c) -= factor * mat.Get(i, c);
+		result.Get(r, c) -= factor * result.Get(i, c);
+	    }
+	}
+    }
+    return *this = result;
+}
+
 Mat DefaultMatrix::generateIdentityMatrix(Dimension s) {
     Mat mat(s);
     for (uint32_t i = 0; i < s.row; i++) {
@@ -0,0 +1,411 @@
+#include "Mat4Kernels.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define DUNIYA_MAT4_X86
+#define DUNIYA_TARGET(features) __attribute__((target(features)))
+#endif
+
+namespace Mat4Kernels {
+namespace {
+
+// Every kernel works on row major float[16], out may alias the inputs
+struct Kernels {
+    void (*multiply)(const float* a, const float* b, float* out);
+    void (*transformOne)(const float* mat, const float* in, float* out);
+    void (*transform)(const float* mat, const float* in, float* out,
+		      uint32_t count);
+    void (*transpose)(const float* mat, float* out);
+    // Return the determinant and write the inverse to out unless it's 0
+    // or out is null
+    float (*inverse)(const float* mat, float* out);
+    float (*inverseAffine)(const float* mat, float* out);
+};
+
+void MultiplyScalar(const float* a, const float* b, float* out) {
+    float result[16] = {};
+    for (uint32_t i = 0; i < 4; i++)
+	for (uint32_t k = 0; k < 4; k++)
+	    for (uint32_t j = 0; j < 4; j++)
+		result[i * 4 + j] += a[i * 4 + k] * b[k * 4 + j];
+    memcpy(out, result, sizeof(result));
+}
+
+void TransformOneScalar(const float* mat, const float* in, float* out) {
+    float result[4];
+    for (uint32_t i = 0; i < 4; i++)
+	result[i] = mat[i * 4] * in[0] + mat[i * 4 + 1] * in[1] +
+		    mat[i * 4 + 2] * in[2] + mat[i * 4 + 3] * in[3];
+    memcpy(out, result, sizeof(result));
+}
+
+void TransformScalar(const float* mat, const float* in, float* out,
+		     uint32_t count) {
+    for (uint32_t i = 0; i < count; i++)
+	TransformOneScalar(mat, in + i * 4, out + i * 4);
+}
+
+void TransposeScalar(const float* mat, float* out) {
+    float result[16];
+    for (uint32_t i = 0; i < 4; i++)
+	for (uint32_t j = 0; j < 4; j++) result[j * 4 + i] = mat[i * 4 + j];
+    memcpy(out, result, sizeof(result));
+}
+
+// Laplace expansion over the 2x2 minors of the top and bottom row pairs
+float InverseScalar(const float* m, float* out) {
+    float s0 = m[0] * m[5] - m[4] * m[1];
+    float s1 = m[0] * m[6] - m[4] * m[2];
+    float s2 = m[0] * m[7] - m[4] * m[3];
+    float s3 = m[1] * m[6] - m[5] * m[2];
+    float s4 = m[1] * m[7] - m[5] * m[3];
+    float s5 = m[2] * m[7] - m[6] * m[3];
+    float c5 = m[10] * m[15] - m[14] * m[11];
+    float c4 = m[9] * m[15] - m[13] * m[11];
+    float c3 = m[9] * m[14] - m[13] * m[10];
+    float c2 = m[8] * m[15] - m[12] * m[11];
+    float c1 = m[8] * m[14] - m[12] * m[10];
+    float c0 = m[8] * m[13] - m[12] * m[9];
+    float det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+    if (out == nullptr || det == 0.f) return det;
+    float invDet = 1.f / det;
+    float result[16] = {
+	(m[5] * c5 - m[6] * c4 + m[7] * c3) * invDet,
+	(-m[1] * c5 + m[2] * c4 - m[3] * c3) * invDet,
+	(m[13] * s5 - m[14] * s4 + m[15] * s3) * invDet,
+	(-m[9] * s5 + m[10] * s4 - m[11] * s3) * invDet,
+	(-m[4] * c5 + m[6] * c2 - m[7] * c1) * invDet,
+	(m[0] * c5 - m[2] * c2 + m[3] * c1) * invDet,
+	(-m[12] * s5 + m[14] * s2 - m[15] * s1) * invDet,
+	(m[8] * s5 - m[10] * s2 + m[11] * s1) * invDet,
+	(m[4] * c4 - m[5] * c2 + m[7] * c0) * invDet,
+	(-m[0] * c4 + m[1] * c2 - m[3] * c0) * invDet,
+	(m[12] * s4 - m[13] * s2 + m[15] * s0) * invDet,
+	(-m[8] * s4 + m[9] * s2 - m[11] * s0) * invDet,
+	(-m[4] * c3 + m[5] * c1 - m[6] * c0) * invDet,
+	(m[0] * c3 - m[1] * c1 + m[2] * c0) * invDet,
+	(-m[12] * s3 + m[13] * s1 - m[14] * s0) * invDet,
+	(m[8] * s3 - m[9] * s1 + m[10] * s0) * invDet};
+    memcpy(out, result, sizeof(result));
+    return det;
+}
+
+// The columns of the 3x3 part's inverse are the cross products of its rows
+// over the determinant, the translation is moved back through it
+float InverseAffineScalar(const float* m, float* out) {
+    float c0[3] = {m[5] * m[10] - m[6] * m[9], m[6] * m[8] - m[4] * m[10],
+		   m[4] * m[9] - m[5] * m[8]};
+    float c1[3] = {m[9] * m[2] - m[10] * m[1], m[10] * m[0] - m[8] * m[2],
+		   m[8] * m[1] - m[9] * m[0]};
+    float c2[3] = {m[1] * m[6] - m[2] * m[5], m[2] * m[4] - m[0] * m[6],
+		   m[0] * m[5] - m[1] * m[4]};
+    float det = m[0] * c0[0] + m[1] * c0[1] + m[2] * c0[2];
+    if (out == nullptr || det == 0.f) return det;
+    float invDet = 1.f / det;
+    float result[16] = {};
+    for (uint32_t i = 0; i < 3; i++) {
+	result[i * 4] = c0[i] * invDet;
+	result[i * 4 + 1] = c1[i] * invDet;
+	result[i * 4 + 2] = c2[i] * invDet;
+	result[i * 4 + 3] = -(result[i * 4] * m[3] + result[i * 4 + 1] * m[7] +
+			      result[i * 4 + 2] * m[11]);
+    }
+    result[15] = 1.f;
+    memcpy(out, result, sizeof(result));
+    return det;
+}
+
+#ifdef DUNIYA_MAT4_X86
+
+#define SHUFFLE_MASK(x, y, z, w) ((x) | ((y) << 2) | ((z) << 4) | ((w) << 6))
+#define SWIZZLE(v, x, y, z, w) _mm_shuffle_ps(v, v, SHUFFLE_MASK(x, y, z, w))
+
+DUNIYA_TARGET("sse4.1")
+void MultiplySse(const float* a, const float* b, float* out) {
+    __m128 b0 = _mm_loadu_ps(b), b1 = _mm_loadu_ps(b + 4),
+	   b2 = _mm_loadu_ps(b + 8), b3 = _mm_loadu_ps(b + 12);
+    __m128 rows[4];
+    for (uint32_t i = 0; i < 4; i++) {
+	__m128 row = _mm_loadu_ps(a + i * 4);
+	__m128 result = _mm_mul_ps(SWIZZLE(row, 0, 0, 0, 0), b0);
+	result = _mm_add_ps(result, _mm_mul_ps(SWIZZLE(row, 1, 1, 1, 1), b1));
+	result = _mm_add_ps(result, _mm_mul_ps(SWIZZLE(row, 2, 2, 2, 2), b2));
+	rows[i] = _mm_add_ps(result, _mm_mul_ps(SWIZZLE(row, 3, 3, 3, 3), b3));
+    }
+    for (uint32_t i = 0; i < 4; i++) _mm_storeu_ps(out + i * 4, rows[i]);
+}
+
+DUNIYA_TARGET("sse4.1")
+void TransformOneSse(const float* mat, const float* in, float* out) {
+    __m128 vect = _mm_loadu_ps(in);
+    // Every row's dot product lands in its own lane
+    __m128 x = _mm_dp_ps(_mm_loadu_ps(mat), vect, 0xF1);
+    __m128 y = _mm_dp_ps(_mm_loadu_ps(mat + 4), vect, 0xF2);
+    __m128 z = _mm_dp_ps(_mm_loadu_ps(mat + 8), vect, 0xF4);
+    __m128 w = _mm_dp_ps(_mm_loadu_ps(mat + 12), vect, 0xF8);
+    _mm_storeu_ps(out, _mm_or_ps(_mm_or_ps(x, y), _mm_or_ps(z, w)));
+}
+
+DUNIYA_TARGET("sse4.1")
+void TransposeSse(const float* mat, float* out) {
+    __m128 r0 = _mm_loadu_ps(mat), r1 = _mm_loadu_ps(mat + 4),
+	   r2 = _mm_loadu_ps(mat + 8), r3 = _mm_loadu_ps(mat + 12);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    _mm_storeu_ps(out, r0);
+    _mm_storeu_ps(out + 4, r1);
+    _mm_storeu_ps(out + 8, r2);
+    _mm_storeu_ps(out + 12, r3);
+}
+
+// A batch is the sum of the matrix's columns scaled by the vector's
+// components
+DUNIYA_TARGET("sse4.1")
+void TransformSse(const float* mat, const float* in, float* out,
+		  uint32_t count) {
+    float columns[16];
+    TransposeSse(mat, columns);
+    __m128 c0 = _mm_loadu_ps(columns), c1 = _mm_loadu_ps(columns + 4),
+	   c2 = _mm_loadu_ps(columns + 8), c3 = _mm_loadu_ps(columns + 12);
+    for (uint32_t i = 0; i < count; i++) {
+	__m128 vect = _mm_loadu_ps(in + i * 4);
+	__m128 result = _mm_mul_ps(SWIZZLE(vect, 0, 0, 0, 0), c0);
+	result = _mm_add_ps(result, _mm_mul_ps(SWIZZLE(vect, 1, 1, 1, 1), c1));
+	result = _mm_add_ps(result, _mm_mul_ps(SWIZZLE(vect, 2, 2, 2, 2), c2));
+	result = _mm_add_ps(result, _mm_mul_ps(SWIZZLE(vect, 3, 3, 3, 3), c3));
+	_mm_storeu_ps(out + i * 4, result);
+    }
+}
+
+// 2x2 row major blocks in one register
+DUNIYA_TARGET("sse4.1")
+inline __m128 Mat2Mul(__m128 a, __m128 b) {
+    return _mm_add_ps(_mm_mul_ps(a, SWIZZLE(b, 0, 3, 0, 3)),
+		      _mm_mul_ps(SWIZZLE(a, 1, 0, 3, 2), SWIZZLE(b, 2, 1, 2, 1)));
+}
+// adjugate(a) * b
+DUNIYA_TARGET("sse4.1")
+inline __m128 Mat2AdjMul(__m128 a, __m128 b) {
+    return _mm_sub_ps(_mm_mul_ps(SWIZZLE(a, 3, 3, 0, 0), b),
+		      _mm_mul_ps(SWIZZLE(a, 1, 1, 2, 2), SWIZZLE(b, 2, 3, 0, 1)));
+}
+// a * adjugate(b)
+DUNIYA_TARGET("sse4.1")
+inline __m128 Mat2MulAdj(__m128 a, __m128 b) {
+    return _mm_sub_ps(_mm_mul_ps(a, SWIZZLE(b, 3, 0, 3, 0)),
+		      _mm_mul_ps(SWIZZLE(a, 1, 0, 3, 2), SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+// Blockwise inversion of [A B; C D] through the 2x2 adjugates
+DUNIYA_TARGET("sse4.1")
+float InverseSse(const float* mat, float* out) {
+    __m128 r0 = _mm_loadu_ps(mat), r1 = _mm_loadu_ps(mat + 4),
+	   r2 = _mm_loadu_ps(mat + 8), r3 = _mm_loadu_ps(mat + 12);
+    __m128 a = _mm_movelh_ps(r0, r1), b = _mm_movehl_ps(r1, r0);
+    __m128 c = _mm_movelh_ps(r2, r3), d = _mm_movehl_ps(r3, r2);
+    // |A| |B| |C| |D|
+    __m128 detSub = _mm_sub_ps(
+	_mm_mul_ps(_mm_shuffle_ps(r0, r2, SHUFFLE_MASK(0, 2, 0, 2)),
+		   _mm_shuffle_ps(r1, r3, SHUFFLE_MASK(1, 3, 1, 3))),
+	_mm_mul_ps(_mm_shuffle_ps(r0, r2, SHUFFLE_MASK(1, 3, 1, 3)),
+		   _mm_shuffle_ps(r1, r3, SHUFFLE_MASK(0, 2, 0, 2))));
+    __m128 detA = SWIZZLE(detSub, 0, 0, 0, 0);
+    __m128 detB = SWIZZLE(detSub, 1, 1, 1, 1);
+    __m128 detC = SWIZZLE(detSub, 2, 2, 2, 2);
+    __m128 detD = SWIZZLE(detSub, 3, 3, 3, 3);
+
+    __m128 dc = Mat2AdjMul(d, c);
+    __m128 ab = Mat2AdjMul(a, b);
+    // |M| = |A||D| + |B||C| - tr((A#B)(D#C))
+    __m128 trace = _mm_mul_ps(ab, SWIZZLE(dc, 0, 2, 1, 3));
+    trace = _mm_hadd_ps(trace, trace);
+    trace = _mm_hadd_ps(trace, trace);
+    __m128 detM = _mm_sub_ps(
+	_mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC)), trace);
+    float det = _mm_cvtss_f32(detM);
+    if (out == nullptr || det == 0.f) return det;
+
+    __m128 x = _mm_sub_ps(_mm_mul_ps(detD, a), Mat2Mul(b, dc));
+    __m128 w = _mm_sub_ps(_mm_mul_ps(detA, d), Mat2Mul(c, ab));
+    __m128 y = _mm_sub_ps(_mm_mul_ps(detB, c), Mat2MulAdj(d, ab));
+    __m128 z = _mm_sub_ps(_mm_mul_ps(detC, b), Mat2MulAdj(a, dc));
+    __m128 invDet = _mm_div_ps(_mm_setr_ps(1.f, -1.f, -1.f, 1.f), detM);
+    x = _mm_mul_ps(x, invDet);
+    y = _mm_mul_ps(y, invDet);
+    z = _mm_mul_ps(z, invDet);
+    w = _mm_mul_ps(w, invDet);
+    // The blocks' adjugates, shuffled back into rows
+    _mm_storeu_ps(out, _mm_shuffle_ps(x, y, SHUFFLE_MASK(3, 1, 3, 1)));
+    _mm_storeu_ps(out + 4, _mm_shuffle_ps(x, y, SHUFFLE_MASK(2, 0, 2, 0)));
+    _mm_storeu_ps(out + 8, _mm_shuffle_ps(z, w, SHUFFLE_MASK(3, 1, 3, 1)));
+    _mm_storeu_ps(out + 12, _mm_shuffle_ps(z, w, SHUFFLE_MASK(2, 0, 2, 0)));
+    return det;
+}
+
+// The w lanes cancel out, so rows can go in with the translation in them
+DUNIYA_TARGET("sse4.1")
+inline __m128 Cross(__m128 a, __m128 b) {
+    __m128 result = _mm_sub_ps(_mm_mul_ps(a, SWIZZLE(b, 1, 2, 0, 3)),
+			       _mm_mul_ps(SWIZZLE(a, 1, 2, 0, 3), b));
+    return SWIZZLE(result, 1, 2, 0, 3);
+}
+
+DUNIYA_TARGET("sse4.1")
+float InverseAffineSse(const float* mat, float* out) {
+    __m128 r0 = _mm_loadu_ps(mat), r1 = _mm_loadu_ps(mat + 4),
+	   r2 = _mm_loadu_ps(mat + 8);
+    __m128 c0 = Cross(r1, r2), c1 = Cross(r2, r0), c2 = Cross(r0, r1);
+    __m128 detM = _mm_dp_ps(r0, c0, 0x7F);
+    float det = _mm_cvtss_f32(detM);
+    if (out == nullptr || det == 0.f) return det;
+    __m128 invDet = _mm_div_ps(_mm_set1_ps(1.f), detM);
+    c0 = _mm_mul_ps(c0, invDet);
+    c1 = _mm_mul_ps(c1, invDet);
+    c2 = _mm_mul_ps(c2, invDet);
+    __m128 c3 = _mm_setzero_ps();
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    __m128 translation = _mm_setr_ps(mat[3], mat[7], mat[11], 0.f);
+    __m128 zero = _mm_setzero_ps();
+    c0 = _mm_blend_ps(c0, _mm_sub_ps(zero, _mm_dp_ps(c0, translation, 0x7F)),
+		      0x8);
+    c1 = _mm_blend_ps(c1, _mm_sub_ps(zero, _mm_dp_ps(c1, translation, 0x7F)),
+		      0x8);
+    c2 = _mm_blend_ps(c2, _mm_sub_ps(zero, _mm_dp_ps(c2, translation, 0x7F)),
+		      0x8);
+    _mm_storeu_ps(out, c0);
+    _mm_storeu_ps(out + 4, c1);
+    _mm_storeu_ps(out + 8, c2);
+    _mm_storeu_ps(out + 12, _mm_setr_ps(0.f, 0.f, 0.f, 1.f));
+    return det;
+}
+
+// Two vectors per iteration, each 128 bit half takes one
+DUNIYA_TARGET("avx2,fma")
+void TransformAvx(const float* mat, const float* in, float* out,
+		  uint32_t count) {
+    float columns[16];
+    TransposeSse(mat, columns);
+    __m256 c0 = _mm256_broadcast_ps((const __m128*)columns);
+    __m256 c1 = _mm256_broadcast_ps((const __m128*)(columns + 4));
+    __m256 c2 = _mm256_broadcast_ps((const __m128*)(columns + 8));
+    __m256 c3 = _mm256_broadcast_ps((const __m128*)(columns + 12));
+    uint32_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+	__m256 vects = _mm256_loadu_ps(in + i * 4);
+	__m256 result =
+	    _mm256_mul_ps(_mm256_shuffle_ps(vects, vects, 0x00), c0);
+	result =
+	    _mm256_fmadd_ps(_mm256_shuffle_ps(vects, vects, 0x55), c1, result);
+	result =
+	    _mm256_fmadd_ps(_mm256_shuffle_ps(vects, vects, 0xAA), c2, result);
+	result =
+	    _mm256_fmadd_ps(_mm256_shuffle_ps(vects, vects, 0xFF), c3, result);
+	_mm256_storeu_ps(out + i * 4, result);
+    }
+    if (i < count) TransformSse(mat, in + i * 4, out + i * 4, count - i);
+}
+
+#undef SWIZZLE
+#undef SHUFFLE_MASK
+
+#endif
+
+// Indexed by SimdLevel, the AVX2 level only widens what gains from it. A
+// 4x4 multiply is too short for 256 bit lanes to pay for their shuffles,
+// it stays on SSE.
+const Kernels kernels[] = {
+    {MultiplyScalar, TransformOneScalar, TransformScalar, TransposeScalar,
+     InverseScalar, InverseAffineScalar},
+#ifdef DUNIYA_MAT4_X86
+    {MultiplySse, TransformOneSse, TransformSse, TransposeSse, InverseSse,
+     InverseAffineSse},
+    {MultiplySse, TransformOneSse, TransformAvx, TransposeSse, InverseSse,
+     InverseAffineSse},
+#endif
+};
+
+SimdLevel DetectSimdLevel() {
+#ifdef DUNIYA_MAT4_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+	return SimdLevel::AVX2;
+    if (__builtin_cpu_supports("sse4.1")) return SimdLevel::SSE41;
+#endif
+    return SimdLevel::SCALAR;
+}
+
+std::atomic<uint32_t>& CurrentLevel() {
+    static std::atomic<uint32_t> level((uint32_t)DetectSimdLevel());
+    return level;
+}
+
+const Kernels& Current() {
+    return kernels[CurrentLevel().load(std::memory_order_relaxed)];
+}
+
+}  // namespace
+
+SimdLevel GetSimdLevel() { return (SimdLevel)CurrentLevel().load(); }
+
+void SetSimdLevel(SimdLevel level) {
+    CurrentLevel().store(
+	std::min((uint32_t)level, (uint32_t)DetectSimdLevel()));
+}
+
+const char* GetSimdLevelName(SimdLevel level) {
+    switch (level) {
+	case SimdLevel::SSE41:
+	    return "SSE4.1";
+	case SimdLevel::AVX2:
+	    return "AVX2";
+	default:
+	    return "scalar";
+    }
+}
+
+Mat4 Multiply(const Mat4& a, const Mat4& b) {
+    Mat4 result;
+    Current().multiply(a.data, b.data, result.data);
+    return result;
+}
+
+Vect4 Transform(const Mat4& mat, const Vect4& vect) {
+    Vect4 result;
+    Current().transformOne(mat.data, vect.coordinates, result.coordinates);
+    return result;
+}
+
+void Transform(const Mat4& mat, const Vect4* in, Vect4* out, uint32_t count) {
+    static_assert(sizeof(Vect4) == sizeof(float) * 4, "Vect4 must be packed");
+    Current().transform(mat.data, (const float*)in, (float*)out, count);
+}
+
+Mat4 Transpose(const Mat4& mat) {
+    Mat4 result;
+    Current().transpose(mat.data, result.data);
+    return result;
+}
+
+float Determinant(const Mat4& mat) {
+    return Current().inverse(mat.data, nullptr);
+}
+
+bool Inverse(const Mat4& mat, Mat4& result) {
+    Mat4 inverse;
+    if (Current().inverse(mat.data, inverse.data) == 0.f) return false;
+    result = inverse;
+    return true;
+}
+
+bool InverseAffine(const Mat4& mat, Mat4& result) {
+    Mat4 inverse;
+    if (Current().inverseAffine(mat.data, inverse.data) == 0.f) return false;
+    result = inverse;
+    return true;
+}
+};  // namespace Mat4Kernels
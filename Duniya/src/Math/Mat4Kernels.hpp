@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+
+#include "FixedMat.hpp"
+#include "Vect4.hpp"
+
+// Mat4 operations on the widest SIMD the CPU has, picked on first use.
+// The x86 kernels are built with per function target attributes, so the
+// rest of the engine doesn't need -mavx2 for them.
+namespace Mat4Kernels {
+enum class SimdLevel : uint32_t { SCALAR, SSE41, AVX2 };
+
+SimdLevel GetSimdLevel();
+// Pins the kernels to level, capped to what the CPU supports. Meant for
+// benchmarks and for comparing the levels' results.
+void SetSimdLevel(SimdLevel level);
+const char* GetSimdLevelName(SimdLevel level);
+
+Mat4 Multiply(const Mat4& a, const Mat4& b);
+Vect4 Transform(const Mat4& mat, const Vect4& vect);
+// out[i] = mat * in[i], in and out may be the same array
+void Transform(const Mat4& mat, const Vect4* in, Vect4* out, uint32_t count);
+Mat4 Transpose(const Mat4& mat);
+float Determinant(const Mat4& mat);
+// False if mat is singular, result is left alone then
+bool Inverse(const Mat4& mat, Mat4& result);
+// Only for matrices whose last row is 0 0 0 1, cheaper than Inverse
+bool InverseAffine(const Mat4& mat, Mat4& result);
+};  // namespace Mat4Kernels
@@ -0,0 +1,39 @@
+#include "Projection.hpp"
+
+#include <cmath>
+
+Mat4 GetLookAtMatrix(const Vect3& eye, const Vect3& at, const Vect3& up) {
+    auto zaxis = at - eye;
+    zaxis.normalize();
+    auto xaxis = (Vect3::cross(zaxis, up)).normalized();
+    auto yaxis = Vect3::cross(xaxis, zaxis).normalized();
+    Mat4 mat = {xaxis.x,
+		yaxis.x,
+		-zaxis.x,
+		0,
+		xaxis.y,
+		yaxis.y,
+		-zaxis.y,
+		0,
+		xaxis.z,
+		yaxis.z,
+		-zaxis.z,
+		0,
+		-Vect3::dot(xaxis, eye),
+		-Vect3::dot(yaxis, eye),
+		Vect3::dot(zaxis, eye),
+		1};
+    return mat;
+}
+
+Mat4 GetPerspectiveMatrix(float fov, float aspectRatio, float near,
+			  float far) {
+    Mat4 mat;
+    auto camFov = 1 / tan(fov / 2);
+    mat.Get(0, 0) = camFov * 1 / aspectRatio;
+    mat.Get(1, 1) = camFov;
+    mat.Get(2, 2) = -(far + near) / (far - near);
+    mat.Get(3, 2) = (2 * far * near) / (far - near);
+    mat.Get(2, 3) = 1;
+    return mat;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "FixedMat.hpp"
+#include "Vect3.hpp"
+
+// The camera matrices the renderer builds every frame. Both are laid out the
+// way RendererSystem has always multiplied them, view * projection.
+Mat4 GetLookAtMatrix(const Vect3& eye, const Vect3& at, const Vect3& up);
+// fov is vertical, in radians
+Mat4 GetPerspectiveMatrix(float fov, float aspectRatio, float near,
+			  float far);
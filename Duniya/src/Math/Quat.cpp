@@ -0,0 +1,459 @@
+#include "Quat.hpp"
+
+#include <cmath>
+
+#include "Mat4Kernels.hpp"
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define DUNIYA_QUAT_SSE
+#endif
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define DUNIYA_QUAT_X86
+#define DUNIYA_TARGET(features) __attribute__((target(features)))
+#endif
+
+// Below this angle's cosine Slerp is well conditioned, above it Nlerp is
+// just as exact
+constexpr float slerpNlerpDot = .9995f;
+
+Quat::Quat(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+
+Quat Quat::FromAxisAngle(const Vect3& axis, float angle) {
+    auto unit = axis;
+    unit.normalize();
+    float sine = sinf(angle * .5f);
+    return Quat(unit.x * sine, unit.y * sine, unit.z * sine,
+		cosf(angle * .5f));
+}
+
+Quat Quat::FromEuler(const Vect3& rotation) {
+    return FromAxisAngle(Vect3(1.f, 0.f, 0.f), rotation.x) *
+	   FromAxisAngle(Vect3(0.f, 1.f, 0.f), rotation.y) *
+	   FromAxisAngle(Vect3(0.f, 0.f, 1.f), rotation.z);
+}
+
+Quat Quat::operator*(const Quat& other) const {
+#ifdef DUNIYA_QUAT_SSE
+    // Every component of this scales a signed shuffle of other
+    __m128 a = _mm_loadu_ps(coordinates);
+    __m128 b = _mm_loadu_ps(other.coordinates);
+    __m128 result =
+	_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 3, 3)), b);
+    result = _mm_add_ps(
+	result,
+	_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 0, 0)),
+		   _mm_xor_ps(_mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 1, 2, 3)),
+			      _mm_setr_ps(0.f, -0.f, 0.f, -0.f))));
+    result = _mm_add_ps(
+	result,
+	_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 1, 1, 1)),
+		   _mm_xor_ps(_mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 0, 3, 2)),
+			      _mm_setr_ps(0.f, 0.f, -0.f, -0.f))));
+    result = _mm_add_ps(
+	result,
+	_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 2, 2)),
+		   _mm_xor_ps(_mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 3, 0, 1)),
+			      _mm_setr_ps(-0.f, 0.f, 0.f, -0.f))));
+    Quat quat;
+    _mm_storeu_ps(quat.coordinates, result);
+    return quat;
+#else
+    return Quat(w * other.x + x * other.w + y * other.z - z * other.y,
+		w * other.y - x * other.z + y * other.w + z * other.x,
+		w * other.z + x * other.y - y * other.x + z * other.w,
+		w * other.w - x * other.x - y * other.y - z * other.z);
+#endif
+}
+
+Quat Quat::operator*=(const Quat& other) { return *this = *this * other; }
+
+bool Quat::operator==(const Quat& other) const {
+    return x == other.x && y == other.y && z == other.z && w == other.w;
+}
+
+float Quat::dot(const Quat& other) const {
+    return x * other.x + y * other.y + z * other.z + w * other.w;
+}
+
+Quat Quat::conjugate() const { return Quat(-x, -y, -z, w); }
+
+// A zero quaternion turns into the identity
+void Quat::normalize() {
+#ifdef DUNIYA_QUAT_SSE
+    __m128 quat = _mm_loadu_ps(coordinates);
+    __m128 length = _mm_mul_ps(quat, quat);
+    length = _mm_add_ps(
+	length, _mm_shuffle_ps(length, length, _MM_SHUFFLE(2, 3, 0, 1)));
+    length = _mm_add_ps(
+	length, _mm_shuffle_ps(length, length, _MM_SHUFFLE(1, 0, 3, 2)));
+    if (_mm_cvtss_f32(length) == 0.f) {
+	*this = Quat();
+	return;
+    }
+    _mm_storeu_ps(coordinates, _mm_div_ps(quat, _mm_sqrt_ps(length)));
+#else
+    float length = sqrtf(dot(*this));
+    if (length == 0.f) {
+	*this = Quat();
+	return;
+    }
+    for (uint32_t i = 0; i < 4; i++) coordinates[i] /= length;
+#endif
+}
+
+Quat Quat::normalized() const {
+    auto tmp = *this;
+    tmp.normalize();
+    return tmp;
+}
+
+// v + 2w(u x v) + 2u x (u x v), u being the vector part
+Vect3 Quat::Rotate(const Vect3& vect) const {
+    Vect3 u(x, y, z);
+    auto t = Vect3::cross(u, vect) * 2.f;
+    return vect + t * w + Vect3::cross(u, t);
+}
+
+Mat3 Quat::ToMat3() const {
+    float xx = x * x, yy = y * y, zz = z * z;
+    float xy = x * y, xz = x * z, yz = y * z;
+    float wx = w * x, wy = w * y, wz = w * z;
+    return {1.f - 2.f * (yy + zz), 2.f * (xy - wz), 2.f * (xz + wy),
+	    2.f * (xy + wz), 1.f - 2.f * (xx + zz), 2.f * (yz - wx),
+	    2.f * (xz - wy), 2.f * (yz + wx), 1.f - 2.f * (xx + yy)};
+}
+
+Mat4 Quat::ToMat4() const {
+    auto rotation = ToMat3();
+    Mat4 mat;
+    for (uint32_t i = 0; i < 3; i++)
+	for (uint32_t j = 0; j < 3; j++) mat.Get(i, j) = rotation.Get(i, j);
+    mat.Get(3, 3) = 1.f;
+    return mat;
+}
+
+Quat Nlerp(const Quat& a, const Quat& b, float t) {
+    float sign = a.dot(b) < 0.f ? -1.f : 1.f;
+    Quat quat;
+    for (uint32_t i = 0; i < 4; i++)
+	quat.coordinates[i] = a.coordinates[i] +
+			      t * (sign * b.coordinates[i] - a.coordinates[i]);
+    return quat.normalized();
+}
+
+Quat Slerp(const Quat& a, const Quat& b, float t) {
+    float cosine = a.dot(b);
+    float sign = cosine < 0.f ? -1.f : 1.f;
+    cosine *= sign;
+    if (cosine > slerpNlerpDot) return Nlerp(a, b, t);
+    float angle = acosf(cosine);
+    float sine = sinf(angle);
+    float weightA = sinf((1.f - t) * angle) / sine;
+    float weightB = sign * sinf(t * angle) / sine;
+    Quat quat;
+    for (uint32_t i = 0; i < 4; i++)
+	quat.coordinates[i] =
+	    weightA * a.coordinates[i] + weightB * b.coordinates[i];
+    return quat;
+}
+
+// The batches replace slerp's trigonometry by Eberly's polynomial, "A Fast
+// and Accurate Algorithm for Computing SLERP", which vectorizes to plain
+// FMAs. With 12 terms and the last one scaled to make up for the truncated
+// rest, the weights stay within 7.2e-7 of the exact ones.
+constexpr int32_t slerpTerms = 12;
+constexpr float slerpLastTermScale = 1.893715f;
+
+struct SlerpCoefficients {
+    float u[slerpTerms];
+    float v[slerpTerms];
+};
+
+constexpr SlerpCoefficients MakeSlerpCoefficients() {
+    SlerpCoefficients coefficients = {};
+    for (int32_t i = 0; i < slerpTerms; i++) {
+	float scale = i + 1 == slerpTerms ? slerpLastTermScale : 1.f;
+	coefficients.u[i] = scale / ((i + 1) * (2 * i + 3));
+	coefficients.v[i] = scale * (i + 1) / (2 * i + 3);
+    }
+    return coefficients;
+}
+
+constexpr auto slerpCoefficients = MakeSlerpCoefficients();
+
+static void NlerpBatchScalar(const Quat* a, const Quat* b, const float* t,
+			     Quat* out, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) out[i] = Nlerp(a[i], b[i], t[i]);
+}
+
+static float SlerpWeight(float t, float cosineMinusOne) {
+    float squared = t * t;
+    float weight = 1.f;
+    for (int32_t i = slerpTerms - 1; i >= 0; i--)
+	weight = 1.f + (slerpCoefficients.u[i] * squared -
+			slerpCoefficients.v[i]) *
+			   cosineMinusOne * weight;
+    return t * weight;
+}
+
+static void SlerpBatchScalar(const Quat* a, const Quat* b, const float* t,
+			     Quat* out, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+	float cosine = a[i].dot(b[i]);
+	float sign = cosine < 0.f ? -1.f : 1.f;
+	float weightA = SlerpWeight(1.f - t[i], sign * cosine - 1.f);
+	float weightB = sign * SlerpWeight(t[i], sign * cosine - 1.f);
+	Quat quat;
+	for (uint32_t j = 0; j < 4; j++)
+	    quat.coordinates[j] = weightA * a[i].coordinates[j] +
+				  weightB * b[i].coordinates[j];
+	out[i] = quat;
+    }
+}
+
+#ifdef DUNIYA_QUAT_X86
+
+// The batches work on quaternions transposed to one coordinate per
+// register, each lane its own quaternion, so the polynomial's work is
+// never repeated across lanes. SSE does four per iteration.
+DUNIYA_TARGET("sse4.1")
+static inline void LoadQuatsSse(const Quat* quats, __m128 coordinates[4]) {
+    for (uint32_t i = 0; i < 4; i++)
+	coordinates[i] = _mm_loadu_ps(quats[i].coordinates);
+    _MM_TRANSPOSE4_PS(coordinates[0], coordinates[1], coordinates[2],
+		      coordinates[3]);
+}
+
+DUNIYA_TARGET("sse4.1")
+static inline void StoreQuatsSse(__m128 coordinates[4], Quat* quats) {
+    _MM_TRANSPOSE4_PS(coordinates[0], coordinates[1], coordinates[2],
+		      coordinates[3]);
+    for (uint32_t i = 0; i < 4; i++)
+	_mm_storeu_ps(quats[i].coordinates, coordinates[i]);
+}
+
+DUNIYA_TARGET("sse4.1")
+static inline __m128 DotSse(const __m128 a[4], const __m128 b[4]) {
+    __m128 dot = _mm_mul_ps(a[0], b[0]);
+    for (uint32_t i = 1; i < 4; i++)
+	dot = _mm_add_ps(dot, _mm_mul_ps(a[i], b[i]));
+    return dot;
+}
+
+// The sign bit where the dot product is below zero, as the scalar paths
+// compare, a -0 dot product keeps b as it is
+DUNIYA_TARGET("sse4.1")
+static inline __m128 NegativeSignSse(__m128 dot) {
+    return _mm_and_ps(_mm_cmplt_ps(dot, _mm_setzero_ps()), _mm_set1_ps(-0.f));
+}
+
+DUNIYA_TARGET("sse4.1")
+static __m128 SlerpWeightSse(__m128 t, __m128 cosineMinusOne) {
+    __m128 squared = _mm_mul_ps(t, t);
+    __m128 one = _mm_set1_ps(1.f);
+    __m128 weight = one;
+    for (int32_t i = slerpTerms - 1; i >= 0; i--) {
+	__m128 u = _mm_set1_ps(slerpCoefficients.u[i]);
+	__m128 v = _mm_set1_ps(slerpCoefficients.v[i]);
+	__m128 b = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(u, squared), v),
+			      cosineMinusOne);
+	weight = _mm_add_ps(one, _mm_mul_ps(b, weight));
+    }
+    return _mm_mul_ps(t, weight);
+}
+
+DUNIYA_TARGET("sse4.1")
+static void NlerpBatchSse(const Quat* a, const Quat* b, const float* t,
+			  Quat* out, uint32_t count) {
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+	__m128 first[4], second[4], quat[4];
+	LoadQuatsSse(a + i, first);
+	LoadQuatsSse(b + i, second);
+	__m128 sign = NegativeSignSse(DotSse(first, second));
+	__m128 time = _mm_loadu_ps(t + i);
+	for (uint32_t j = 0; j < 4; j++)
+	    quat[j] = _mm_add_ps(
+		first[j],
+		_mm_mul_ps(time,
+			   _mm_sub_ps(_mm_xor_ps(second[j], sign), first[j])));
+	__m128 length = _mm_sqrt_ps(DotSse(quat, quat));
+	for (uint32_t j = 0; j < 4; j++) quat[j] = _mm_div_ps(quat[j], length);
+	StoreQuatsSse(quat, out + i);
+    }
+    NlerpBatchScalar(a + i, b + i, t + i, out + i, count - i);
+}
+
+DUNIYA_TARGET("sse4.1")
+static void SlerpBatchSse(const Quat* a, const Quat* b, const float* t,
+			  Quat* out, uint32_t count) {
+    const __m128 one = _mm_set1_ps(1.f);
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+	__m128 first[4], second[4], quat[4];
+	LoadQuatsSse(a + i, first);
+	LoadQuatsSse(b + i, second);
+	__m128 cosine = DotSse(first, second);
+	__m128 sign = NegativeSignSse(cosine);
+	__m128 cosineMinusOne = _mm_sub_ps(_mm_xor_ps(cosine, sign), one);
+	__m128 time = _mm_loadu_ps(t + i);
+	__m128 weightA =
+	    SlerpWeightSse(_mm_sub_ps(one, time), cosineMinusOne);
+	__m128 weightB =
+	    _mm_xor_ps(SlerpWeightSse(time, cosineMinusOne), sign);
+	for (uint32_t j = 0; j < 4; j++)
+	    quat[j] = _mm_add_ps(_mm_mul_ps(weightA, first[j]),
+				 _mm_mul_ps(weightB, second[j]));
+	StoreQuatsSse(quat, out + i);
+    }
+    SlerpBatchScalar(a + i, b + i, t + i, out + i, count - i);
+}
+
+// AVX2 does eight per iteration, quaternions i to i + 3 in the low halves
+// and i + 4 to i + 7 in the high ones, so that the in-lane transpose leaves
+// the lanes in order
+DUNIYA_TARGET("avx2,fma")
+static inline void TransposeAvx(__m256 coordinates[4]) {
+    __m256 low01 = _mm256_unpacklo_ps(coordinates[0], coordinates[1]);
+    __m256 low23 = _mm256_unpacklo_ps(coordinates[2], coordinates[3]);
+    __m256 high01 = _mm256_unpackhi_ps(coordinates[0], coordinates[1]);
+    __m256 high23 = _mm256_unpackhi_ps(coordinates[2], coordinates[3]);
+    coordinates[0] = _mm256_shuffle_ps(low01, low23, _MM_SHUFFLE(1, 0, 1, 0));
+    coordinates[1] = _mm256_shuffle_ps(low01, low23, _MM_SHUFFLE(3, 2, 3, 2));
+    coordinates[2] =
+	_mm256_shuffle_ps(high01, high23, _MM_SHUFFLE(1, 0, 1, 0));
+    coordinates[3] =
+	_mm256_shuffle_ps(high01, high23, _MM_SHUFFLE(3, 2, 3, 2));
+}
+
+DUNIYA_TARGET("avx2,fma")
+static inline void LoadQuatsAvx(const Quat* quats, __m256 coordinates[4]) {
+    for (uint32_t i = 0; i < 4; i++)
+	coordinates[i] = _mm256_insertf128_ps(
+	    _mm256_castps128_ps256(_mm_loadu_ps(quats[i].coordinates)),
+	    _mm_loadu_ps(quats[i + 4].coordinates), 1);
+    TransposeAvx(coordinates);
+}
+
+DUNIYA_TARGET("avx2,fma")
+static inline void StoreQuatsAvx(__m256 coordinates[4], Quat* quats) {
+    TransposeAvx(coordinates);
+    for (uint32_t i = 0; i < 4; i++) {
+	_mm_storeu_ps(quats[i].coordinates,
+		      _mm256_castps256_ps128(coordinates[i]));
+	_mm_storeu_ps(quats[i + 4].coordinates,
+		      _mm256_extractf128_ps(coordinates[i], 1));
+    }
+}
+
+DUNIYA_TARGET("avx2,fma")
+static inline __m256 DotAvx(const __m256 a[4], const __m256 b[4]) {
+    __m256 dot = _mm256_mul_ps(a[0], b[0]);
+    for (uint32_t i = 1; i < 4; i++) dot = _mm256_fmadd_ps(a[i], b[i], dot);
+    return dot;
+}
+
+DUNIYA_TARGET("avx2,fma")
+static inline __m256 NegativeSignAvx(__m256 dot) {
+    return _mm256_and_ps(_mm256_cmp_ps(dot, _mm256_setzero_ps(), _CMP_LT_OQ),
+			 _mm256_set1_ps(-0.f));
+}
+
+DUNIYA_TARGET("avx2,fma")
+static __m256 SlerpWeightAvx(__m256 t, __m256 cosineMinusOne) {
+    __m256 squared = _mm256_mul_ps(t, t);
+    __m256 one = _mm256_set1_ps(1.f);
+    __m256 weight = one;
+    for (int32_t i = slerpTerms - 1; i >= 0; i--) {
+	__m256 u = _mm256_set1_ps(slerpCoefficients.u[i]);
+	__m256 v = _mm256_set1_ps(slerpCoefficients.v[i]);
+	__m256 b =
+	    _mm256_mul_ps(_mm256_fmsub_ps(u, squared, v), cosineMinusOne);
+	weight = _mm256_fmadd_ps(b, weight, one);
+    }
+    return _mm256_mul_ps(t, weight);
+}
+
+DUNIYA_TARGET("avx2,fma")
+static void NlerpBatchAvx(const Quat* a, const Quat* b, const float* t,
+			  Quat* out, uint32_t count) {
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+	__m256 first[4], second[4], quat[4];
+	LoadQuatsAvx(a + i, first);
+	LoadQuatsAvx(b + i, second);
+	__m256 sign = NegativeSignAvx(DotAvx(first, second));
+	__m256 time = _mm256_loadu_ps(t + i);
+	for (uint32_t j = 0; j < 4; j++)
+	    quat[j] = _mm256_fmadd_ps(
+		time, _mm256_sub_ps(_mm256_xor_ps(second[j], sign), first[j]),
+		first[j]);
+	__m256 length = _mm256_sqrt_ps(DotAvx(quat, quat));
+	for (uint32_t j = 0; j < 4; j++)
+	    quat[j] = _mm256_div_ps(quat[j], length);
+	StoreQuatsAvx(quat, out + i);
+    }
+    NlerpBatchSse(a + i, b + i, t + i, out + i, count - i);
+}
+
+DUNIYA_TARGET("avx2,fma")
+static void SlerpBatchAvx(const Quat* a, const Quat* b, const float* t,
+			  Quat* out, uint32_t count) {
+    const __m256 one = _mm256_set1_ps(1.f);
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+	__m256 first[4], second[4], quat[4];
+	LoadQuatsAvx(a + i, first);
+	LoadQuatsAvx(b + i, second);
+	__m256 cosine = DotAvx(first, second);
+	__m256 sign = NegativeSignAvx(cosine);
+	__m256 cosineMinusOne =
+	    _mm256_sub_ps(_mm256_xor_ps(cosine, sign), one);
+	__m256 time = _mm256_loadu_ps(t + i);
+	__m256 weightA =
+	    SlerpWeightAvx(_mm256_sub_ps(one, time), cosineMinusOne);
+	__m256 weightB =
+	    _mm256_xor_ps(SlerpWeightAvx(time, cosineMinusOne), sign);
+	for (uint32_t j = 0; j < 4; j++)
+	    quat[j] = _mm256_fmadd_ps(weightA, first[j],
+				      _mm256_mul_ps(weightB, second[j]));
+	StoreQuatsAvx(quat, out + i);
+    }
+    SlerpBatchSse(a + i, b + i, t + i, out + i, count - i);
+}
+
+#endif
+
+// Both follow the Mat4 kernels' SIMD level
+void NlerpBatch(const Quat* a, const Quat* b, const float* t, Quat* out,
+		uint32_t count) {
+#ifdef DUNIYA_QUAT_X86
+    switch (Mat4Kernels::GetSimdLevel()) {
+	case Mat4Kernels::SimdLevel::AVX2:
+	    return NlerpBatchAvx(a, b, t, out, count);
+	case Mat4Kernels::SimdLevel::SSE41:
+	    return NlerpBatchSse(a, b, t, out, count);
+	default:
+	    break;
+    }
+#endif
+    NlerpBatchScalar(a, b, t, out, count);
+}
+
+void SlerpBatch(const Quat* a, const Quat* b, const float* t, Quat* out,
+		uint32_t count) {
+#ifdef DUNIYA_QUAT_X86
+    switch (Mat4Kernels::GetSimdLevel()) {
+	case Mat4Kernels::SimdLevel::AVX2:
+	    return SlerpBatchAvx(a, b, t, out, count);
+	case Mat4Kernels::SimdLevel::SSE41:
+	    return SlerpBatchSse(a, b, t, out, count);
+	default:
+	    break;
+    }
+#endif
+    SlerpBatchScalar(a, b, t, out, count);
+}
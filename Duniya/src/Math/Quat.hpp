@@ -0,0 +1,57 @@
+#pragma once
+
+#include <iostream>
+
+#include "FixedMat.hpp"
+#include "MathUtils.hpp"
+#include "Vect3.hpp"
+
+// Rotation as a unit quaternion, w is the real part. Composes like the
+// matrices it stands for, a * b rotates by b first.
+class Quat {
+   public:
+    union {
+	struct {
+	    float x, y, z, w;
+	};
+	float coordinates[4];
+    };
+
+   public:
+    Quat(float x = .0f, float y = .0f, float z = .0f, float w = 1.f);
+    static Quat FromAxisAngle(const Vect3& axis, float angle);
+    // Same rotation as GetRotationMatrix(rotation), roll * pitch * yaw
+    static Quat FromEuler(const Vect3& rotation);
+
+    Quat operator*(const Quat& other) const;
+    Quat operator*=(const Quat& other);
+    bool operator==(const Quat& other) const;
+
+    float dot(const Quat& other) const;
+    // The inverse of a unit quaternion
+    Quat conjugate() const;
+    void normalize();
+    Quat normalized() const;
+    Vect3 Rotate(const Vect3& vect) const;
+    Mat3 ToMat3() const;
+    Mat4 ToMat4() const;
+
+    friend std::istream& operator>>(std::istream& input, Quat& a) {
+	input >> a.x >> a.y >> a.z >> a.w;
+	return input;
+    }
+    friend std::ostream& operator<<(std::ostream& output, const Quat& a) {
+	output << a.x << " " << a.y << " " << a.z << " " << a.w;
+	return output;
+    }
+};
+
+// Both take the shorter way around and return a unit quaternion
+Quat Nlerp(const Quat& a, const Quat& b, float t);
+Quat Slerp(const Quat& a, const Quat& b, float t);
+// out[i] = Nlerp/Slerp(a[i], b[i], t[i]), for blending animation tracks.
+// out may be a or b.
+void NlerpBatch(const Quat* a, const Quat* b, const float* t, Quat* out,
+		uint32_t count);
+void SlerpBatch(const Quat* a, const Quat* b, const float* t, Quat* out,
+		uint32_t count);
@@ -0,0 +1,322 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "Vect3.hpp"
+#include "Vect4.hpp"
+
+// Vectors kept in SIMD registers for the hot paths, Vect3 and Vect4 stay
+// the storage and interface types. Built on the GCC/clang vector
+// extensions, an operator on a Float4 is one SSE instruction on x86 (the
+// type is __m128 there) and one NEON instruction on ARM, a Float8 one AVX
+// instruction when it's enabled and two SSE ones otherwise.
+using Float4 = float __attribute__((vector_size(16)));
+using Float8 = float __attribute__((vector_size(32)));
+using Int4 = int32_t __attribute__((vector_size(16)));
+
+// Lanes of a then b picked by index, GCC only has __builtin_shufflevector
+// since 12 and takes the indices as a mask vector before that
+#if defined(__clang__) || __GNUC__ >= 12
+#define DUNIYA_SHUFFLE4(a, b, i0, i1, i2, i3) \
+    __builtin_shufflevector(a, b, i0, i1, i2, i3)
+#else
+#define DUNIYA_SHUFFLE4(a, b, i0, i1, i2, i3) \
+    __builtin_shuffle(a, b, Int4{i0, i1, i2, i3})
+#endif
+
+inline float HorizontalSum(Float4 value) {
+    value += DUNIYA_SHUFFLE4(value, value, 2, 3, 0, 1);
+    value += DUNIYA_SHUFFLE4(value, value, 1, 0, 3, 2);
+    return value[0];
+}
+
+// Vect3 padded to 16 bytes, w stays 0 through every operation
+struct Vect3A {
+    union {
+	Float4 value;
+	struct {
+	    float x, y, z, w;
+	};
+	float coordinates[4];
+    };
+
+    Vect3A() : value{} {}
+    Vect3A(float x, float y, float z) : value{x, y, z, 0.f} {}
+    explicit Vect3A(Float4 value) : value(value) {}
+    explicit Vect3A(const Vect3& other)
+	: value{other.x, other.y, other.z, 0.f} {}
+    Vect3 ToVect3() const { return Vect3(x, y, z); }
+
+    Vect3A& operator+=(const Vect3A& other) {
+	value += other.value;
+	return *this;
+    }
+    Vect3A& operator-=(const Vect3A& other) {
+	value -= other.value;
+	return *this;
+    }
+    Vect3A& operator*=(const Vect3A& other) {
+	value *= other.value;
+	return *this;
+    }
+    // w is divided by 1 to stay 0
+    Vect3A& operator/=(const Vect3A& other) {
+	Float4 one = {1.f, 1.f, 1.f, 1.f};
+	value /= DUNIYA_SHUFFLE4(other.value, one, 0, 1, 2, 4);
+	return *this;
+    }
+    Vect3A& operator*=(float other) {
+	value *= other;
+	return *this;
+    }
+    // w is scaled by 0, 0 times an infinite reciprocal would be NaN
+    Vect3A& operator/=(float other) {
+	float reciprocal = 1.f / other;
+	value *= Float4{reciprocal, reciprocal, reciprocal, 0.f};
+	return *this;
+    }
+
+    Vect3A operator+(const Vect3A& other) const {
+	return Vect3A(*this) += other;
+    }
+    Vect3A operator-(const Vect3A& other) const {
+	return Vect3A(*this) -= other;
+    }
+    Vect3A operator*(const Vect3A& other) const {
+	return Vect3A(*this) *= other;
+    }
+    Vect3A operator/(const Vect3A& other) const {
+	return Vect3A(*this) /= other;
+    }
+    Vect3A operator*(float other) const {
+	return Vect3A(*this) *= other;
+    }
+    Vect3A operator/(float other) const {
+	return Vect3A(*this) /= other;
+    }
+    Vect3A operator-() const { return Vect3A(-value); }
+
+    float dot(const Vect3A& other) const {
+	return HorizontalSum(value * other.value);
+    }
+    float distance() const { return sqrtf(dot(*this)); }
+    void normalize() { *this /= distance(); }
+    Vect3A normalized() const { return *this / distance(); }
+
+    static float dot(const Vect3A& first, const Vect3A& other) {
+	return first.dot(other);
+    }
+    // first.yzx * other.zxy - first.zxy * other.yzx
+    static Vect3A cross(const Vect3A& first, const Vect3A& other) {
+	Float4 a = first.value, b = other.value;
+	Float4 ab = a * DUNIYA_SHUFFLE4(b, b, 1, 2, 0, 3);
+	Float4 ba = DUNIYA_SHUFFLE4(a, a, 1, 2, 0, 3) * b;
+	Float4 crossed = ab - ba;
+	return Vect3A(DUNIYA_SHUFFLE4(crossed, crossed, 1, 2, 0, 3));
+    }
+    static Vect3A Min(const Vect3A& first, const Vect3A& other) {
+	return Vect3A(first.value < other.value ? first.value : other.value);
+    }
+    static Vect3A Max(const Vect3A& first, const Vect3A& other) {
+	return Vect3A(first.value > other.value ? first.value : other.value);
+    }
+};
+
+struct Vect4A {
+    union {
+	Float4 value;
+	struct {
+	    float x, y, z, w;
+	};
+	float coordinates[4];
+    };
+
+    Vect4A() : value{} {}
+    Vect4A(float x, float y, float z, float w) : value{x, y, z, w} {}
+    Vect4A(const Vect3A& other, float w) : value(other.value) {
+	this->w = w;
+    }
+    explicit Vect4A(Float4 value) : value(value) {}
+    explicit Vect4A(const Vect4& other) {
+	memcpy(&value, other.coordinates, sizeof(value));
+    }
+    Vect4 ToVect4() const { return Vect4(x, y, z, w); }
+
+    Vect4A& operator+=(const Vect4A& other) {
+	value += other.value;
+	return *this;
+    }
+    Vect4A& operator-=(const Vect4A& other) {
+	value -= other.value;
+	return *this;
+    }
+    Vect4A& operator*=(const Vect4A& other) {
+	value *= other.value;
+	return *this;
+    }
+    Vect4A& operator/=(const Vect4A& other) {
+	value /= other.value;
+	return *this;
+    }
+    Vect4A& operator*=(float other) {
+	value *= other;
+	return *this;
+    }
+    Vect4A& operator/=(float other) {
+	value *= 1.f / other;
+	return *this;
+    }
+
+    Vect4A operator+(const Vect4A& other) const {
+	return Vect4A(*this) += other;
+    }
+    Vect4A operator-(const Vect4A& other) const {
+	return Vect4A(*this) -= other;
+    }
+    Vect4A operator*(const Vect4A& other) const {
+	return Vect4A(*this) *= other;
+    }
+    Vect4A operator/(const Vect4A& other) const {
+	return Vect4A(*this) /= other;
+    }
+    Vect4A operator*(float other) const {
+	return Vect4A(*this) *= other;
+    }
+    Vect4A operator/(float other) const {
+	return Vect4A(*this) /= other;
+    }
+    Vect4A operator-() const { return Vect4A(-value); }
+
+    float dot(const Vect4A& other) const {
+	return HorizontalSum(value * other.value);
+    }
+    float distance() const { return sqrtf(dot(*this)); }
+    void normalize() { *this /= distance(); }
+    Vect4A normalized() const { return *this / distance(); }
+
+    static float dot(const Vect4A& first, const Vect4A& other) {
+	return first.dot(other);
+    }
+    static Vect4A Min(const Vect4A& first, const Vect4A& other) {
+	return Vect4A(first.value < other.value ? first.value : other.value);
+    }
+    static Vect4A Max(const Vect4A& first, const Vect4A& other) {
+	return Vect4A(first.value > other.value ? first.value : other.value);
+    }
+};
+
+static_assert(sizeof(Vect3A) == 16 && alignof(Vect3A) == 16,
+	      "Vect3A must fill one register");
+static_assert(sizeof(Vect4A) == 16 && alignof(Vect4A) == 16,
+	      "Vect4A must fill one register");
+
+// Everything below is inline, Float8 never crosses a call whose ABI the
+// warning is about
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+// Eight Vect3s component by component, every operator works on all eight
+// at once. Per lane scalars are Float8s.
+struct Vect3x8 {
+    Float8 x, y, z;
+
+    Vect3x8() : x{}, y{}, z{} {}
+    Vect3x8(const Float8& x, const Float8& y, const Float8& z)
+	: x(x), y(y), z(z) {}
+    // other in every lane
+    explicit Vect3x8(const Vect3& other)
+	: x(Float8{} + other.x),
+	  y(Float8{} + other.y),
+	  z(Float8{} + other.z) {}
+
+    // Eight floats from each array, no alignment needed
+    static Vect3x8 Load(const float* x, const float* y, const float* z) {
+	Vect3x8 vects;
+	memcpy(&vects.x, x, sizeof(Float8));
+	memcpy(&vects.y, y, sizeof(Float8));
+	memcpy(&vects.z, z, sizeof(Float8));
+	return vects;
+    }
+    static Vect3x8 Load(const Vect3* vects) {
+	Vect3x8 result;
+	for (uint32_t i = 0; i < 8; i++) {
+	    result.x[i] = vects[i].x;
+	    result.y[i] = vects[i].y;
+	    result.z[i] = vects[i].z;
+	}
+	return result;
+    }
+    void Store(float* x, float* y, float* z) const {
+	memcpy(x, &this->x, sizeof(Float8));
+	memcpy(y, &this->y, sizeof(Float8));
+	memcpy(z, &this->z, sizeof(Float8));
+    }
+    Vect3 Get(uint32_t lane) const {
+	return Vect3(x[lane], y[lane], z[lane]);
+    }
+
+    Vect3x8& operator+=(const Vect3x8& other) {
+	x += other.x;
+	y += other.y;
+	z += other.z;
+	return *this;
+    }
+    Vect3x8& operator-=(const Vect3x8& other) {
+	x -= other.x;
+	y -= other.y;
+	z -= other.z;
+	return *this;
+    }
+    Vect3x8& operator*=(const Vect3x8& other) {
+	x *= other.x;
+	y *= other.y;
+	z *= other.z;
+	return *this;
+    }
+    Vect3x8& operator*=(const Float8& other) {
+	x *= other;
+	y *= other;
+	z *= other;
+	return *this;
+    }
+
+    Vect3x8 operator+(const Vect3x8& other) const {
+	return Vect3x8(*this) += other;
+    }
+    Vect3x8 operator-(const Vect3x8& other) const {
+	return Vect3x8(*this) -= other;
+    }
+    Vect3x8 operator*(const Vect3x8& other) const {
+	return Vect3x8(*this) *= other;
+    }
+    Vect3x8 operator*(const Float8& other) const {
+	return Vect3x8(*this) *= other;
+    }
+
+    static Float8 dot(const Vect3x8& first, const Vect3x8& other) {
+	return first.x * other.x + first.y * other.y + first.z * other.z;
+    }
+    static Vect3x8 cross(const Vect3x8& first, const Vect3x8& other) {
+	return Vect3x8(first.y * other.z - first.z * other.y,
+		       first.z * other.x - first.x * other.z,
+		       first.x * other.y - first.y * other.x);
+    }
+    static Vect3x8 Min(const Vect3x8& first, const Vect3x8& other) {
+	return Vect3x8(first.x < other.x ? first.x : other.x,
+		       first.y < other.y ? first.y : other.y,
+		       first.z < other.z ? first.z : other.z);
+    }
+    static Vect3x8 Max(const Vect3x8& first, const Vect3x8& other) {
+	return Vect3x8(first.x > other.x ? first.x : other.x,
+		       first.y > other.y ? first.y : other.y,
+		       first.z > other.z ? first.z : other.z);
+    }
+};
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
@@ -0,0 +1,326 @@
+#include "TransformBatch.hpp"
+
+#include <JobSystem.hpp>
+#include <cassert>
+#include <cmath>
+
+#include "Mat4Kernels.hpp"
+
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define DUNIYA_TRANSFORM_X86
+#define DUNIYA_TARGET(features) __attribute__((target(features)))
+#endif
+
+void TransformBuffer::Clear() {
+    for (auto& component : components) component.clear();
+}
+
+void TransformBuffer::Reserve(uint32_t count) {
+    for (auto& component : components) component.reserve(count);
+}
+
+uint32_t TransformBuffer::Push(const Vect3& pos, const Vect3& rotation,
+			       const Vect3& scale) {
+    assert(components[9].empty() && "rotations and orientations mixed");
+    for (uint32_t i = 0; i < 3; i++) {
+	components[i].push_back(pos.coordinates[i]);
+	components[3 + i].push_back(rotation.coordinates[i]);
+	components[6 + i].push_back(scale.coordinates[i]);
+    }
+    return components[0].size() - 1;
+}
+
+uint32_t TransformBuffer::Push(const Vect3& pos, const Quat& orientation,
+			       const Vect3& scale) {
+    assert(components[3].empty() && "rotations and orientations mixed");
+    for (uint32_t i = 0; i < 3; i++) {
+	components[i].push_back(pos.coordinates[i]);
+	components[6 + i].push_back(scale.coordinates[i]);
+    }
+    for (uint32_t i = 0; i < 4; i++)
+	components[9 + i].push_back(orientation.coordinates[i]);
+    return components[0].size() - 1;
+}
+
+uint32_t TransformBuffer::GetSize() const { return components[0].size(); }
+
+TransformSoA TransformBuffer::View() const {
+    TransformSoA view = {components[0].data(), components[1].data(),
+			 components[2].data(), components[3].data(),
+			 components[4].data(), components[5].data(),
+			 components[6].data(), components[7].data(),
+			 components[8].data()};
+    if (!components[9].empty()) {
+	view.orientationX = components[9].data();
+	view.orientationY = components[10].data();
+	view.orientationZ = components[11].data();
+	view.orientationW = components[12].data();
+    }
+    return view;
+}
+
+// roll * pitch * yaw multiplied out
+static void EulerRotation(const TransformSoA& t, uint32_t i, float* r) {
+    float sinX = sinf(t.rotationX[i]), cosX = cosf(t.rotationX[i]);
+    float sinY = sinf(t.rotationY[i]), cosY = cosf(t.rotationY[i]);
+    float sinZ = sinf(t.rotationZ[i]), cosZ = cosf(t.rotationZ[i]);
+    r[0] = cosY * cosZ;
+    r[1] = -cosY * sinZ;
+    r[2] = sinY;
+    r[3] = sinX * sinY * cosZ + cosX * sinZ;
+    r[4] = cosX * cosZ - sinX * sinY * sinZ;
+    r[5] = -sinX * cosY;
+    r[6] = sinX * sinZ - cosX * sinY * cosZ;
+    r[7] = sinX * cosZ + cosX * sinY * sinZ;
+    r[8] = cosX * cosY;
+}
+
+static void QuaternionRotation(const TransformSoA& t, uint32_t i, float* r) {
+    float x = t.orientationX[i], y = t.orientationY[i],
+	  z = t.orientationZ[i], w = t.orientationW[i];
+    r[0] = 1.f - 2.f * (y * y + z * z);
+    r[1] = 2.f * (x * y - w * z);
+    r[2] = 2.f * (x * z + w * y);
+    r[3] = 2.f * (x * y + w * z);
+    r[4] = 1.f - 2.f * (x * x + z * z);
+    r[5] = 2.f * (y * z - w * x);
+    r[6] = 2.f * (x * z - w * y);
+    r[7] = 2.f * (y * z + w * x);
+    r[8] = 1.f - 2.f * (x * x + y * y);
+}
+
+// The rotation's rows scaled by the scale, next to the position
+static void ComposeScalar(const TransformSoA& t, uint32_t begin, uint32_t end,
+			  Mat4* world, const Mat4* viewProjection, Mat4* mvp) {
+    for (uint32_t i = begin; i < end; i++) {
+	float r[9];
+	if (t.orientationX != nullptr)
+	    QuaternionRotation(t, i, r);
+	else
+	    EulerRotation(t, i, r);
+	float scaleX = t.scaleX[i], scaleY = t.scaleY[i],
+	      scaleZ = t.scaleZ[i];
+	world[i] = {scaleX * r[0], scaleX * r[1], scaleX * r[2], t.posX[i],
+		    scaleY * r[3], scaleY * r[4], scaleY * r[5], t.posY[i],
+		    scaleZ * r[6], scaleZ * r[7], scaleZ * r[8], t.posZ[i],
+		    0.f, 0.f, 0.f, 1.f};
+	if (viewProjection != nullptr)
+	    mvp[i] = Mat4Kernels::Multiply(*viewProjection, world[i]);
+    }
+}
+
+#ifdef DUNIYA_TRANSFORM_X86
+
+// Cephes' single precision sincos, exact to a few ulp for the angles a
+// transform holds
+DUNIYA_TARGET("avx2,fma")
+static void SinCos8(__m256 x, __m256& sine, __m256& cosine) {
+    const __m256 signMask = _mm256_set1_ps(-0.f);
+    __m256 sinSign = _mm256_and_ps(x, signMask);
+    x = _mm256_andnot_ps(signMask, x);
+    // Octant, rounded up to even
+    __m256i octant = _mm256_cvttps_epi32(
+	_mm256_mul_ps(x, _mm256_set1_ps(1.27323954473516f)));
+    octant = _mm256_and_si256(_mm256_add_epi32(octant, _mm256_set1_epi32(1)),
+			      _mm256_set1_epi32(~1));
+    __m256 y = _mm256_cvtepi32_ps(octant);
+    sinSign = _mm256_xor_ps(
+	sinSign, _mm256_castsi256_ps(_mm256_slli_epi32(
+		     _mm256_and_si256(octant, _mm256_set1_epi32(4)), 29)));
+    __m256 cosSign = _mm256_castsi256_ps(_mm256_slli_epi32(
+	_mm256_andnot_si256(_mm256_sub_epi32(octant, _mm256_set1_epi32(2)),
+			    _mm256_set1_epi32(4)),
+	29));
+    // Where the sine polynomial gives the sine
+    __m256 polyMask = _mm256_castsi256_ps(
+	_mm256_cmpeq_epi32(_mm256_and_si256(octant, _mm256_set1_epi32(2)),
+			   _mm256_setzero_si256()));
+    // x - y * pi / 4 in three steps to keep the precision
+    x = _mm256_fnmadd_ps(y, _mm256_set1_ps(0.78515625f), x);
+    x = _mm256_fnmadd_ps(y, _mm256_set1_ps(2.4187564849853515625e-4f), x);
+    x = _mm256_fnmadd_ps(y, _mm256_set1_ps(3.77489497744594108e-8f), x);
+    __m256 z = _mm256_mul_ps(x, x);
+
+    __m256 cosPoly = _mm256_set1_ps(2.443315711809948e-5f);
+    cosPoly =
+	_mm256_fmadd_ps(cosPoly, z, _mm256_set1_ps(-1.388731625493765e-3f));
+    cosPoly =
+	_mm256_fmadd_ps(cosPoly, z, _mm256_set1_ps(4.166664568298827e-2f));
+    cosPoly = _mm256_mul_ps(_mm256_mul_ps(cosPoly, z), z);
+    cosPoly = _mm256_fnmadd_ps(_mm256_set1_ps(.5f), z, cosPoly);
+    cosPoly = _mm256_add_ps(cosPoly, _mm256_set1_ps(1.f));
+
+    __m256 sinPoly = _mm256_set1_ps(-1.9515295891e-4f);
+    sinPoly = _mm256_fmadd_ps(sinPoly, z, _mm256_set1_ps(8.3321608736e-3f));
+    sinPoly = _mm256_fmadd_ps(sinPoly, z, _mm256_set1_ps(-1.6666654611e-1f));
+    sinPoly = _mm256_fmadd_ps(_mm256_mul_ps(sinPoly, z), x, x);
+
+    sine = _mm256_xor_ps(_mm256_blendv_ps(cosPoly, sinPoly, polyMask),
+			 sinSign);
+    cosine = _mm256_xor_ps(_mm256_blendv_ps(sinPoly, cosPoly, polyMask),
+			   cosSign);
+}
+
+// Eight lanes of eight registers to eight registers of eight lanes
+DUNIYA_TARGET("avx2,fma")
+static void Transpose8(__m256* r) {
+    __m256 t[8], u[8];
+    for (uint32_t i = 0; i < 8; i += 2) {
+	t[i] = _mm256_unpacklo_ps(r[i], r[i + 1]);
+	t[i + 1] = _mm256_unpackhi_ps(r[i], r[i + 1]);
+    }
+    for (uint32_t i = 0; i < 8; i += 4) {
+	u[i] = _mm256_shuffle_ps(t[i], t[i + 2], _MM_SHUFFLE(1, 0, 1, 0));
+	u[i + 1] = _mm256_shuffle_ps(t[i], t[i + 2], _MM_SHUFFLE(3, 2, 3, 2));
+	u[i + 2] =
+	    _mm256_shuffle_ps(t[i + 1], t[i + 3], _MM_SHUFFLE(1, 0, 1, 0));
+	u[i + 3] =
+	    _mm256_shuffle_ps(t[i + 1], t[i + 3], _MM_SHUFFLE(3, 2, 3, 2));
+    }
+    for (uint32_t i = 0; i < 4; i++) {
+	r[i] = _mm256_permute2f128_ps(u[i], u[i + 4], 0x20);
+	r[i + 4] = _mm256_permute2f128_ps(u[i], u[i + 4], 0x31);
+    }
+}
+
+// elements[k] holds element k of eight matrices, one per lane
+DUNIYA_TARGET("avx2,fma")
+static void StoreMatrices(const __m256* elements, Mat4* out) {
+    __m256 half[8];
+    for (uint32_t offset = 0; offset < 16; offset += 8) {
+	for (uint32_t i = 0; i < 8; i++) half[i] = elements[offset + i];
+	Transpose8(half);
+	for (uint32_t i = 0; i < 8; i++)
+	    _mm256_storeu_ps(out[i].data + offset, half[i]);
+    }
+}
+
+DUNIYA_TARGET("avx2,fma")
+static void EulerRotation8(const TransformSoA& t, uint32_t i, __m256* r) {
+    __m256 sinX, cosX, sinY, cosY, sinZ, cosZ;
+    SinCos8(_mm256_loadu_ps(t.rotationX + i), sinX, cosX);
+    SinCos8(_mm256_loadu_ps(t.rotationY + i), sinY, cosY);
+    SinCos8(_mm256_loadu_ps(t.rotationZ + i), sinZ, cosZ);
+    __m256 zero = _mm256_setzero_ps();
+    __m256 sinXSinY = _mm256_mul_ps(sinX, sinY);
+    __m256 cosXSinY = _mm256_mul_ps(cosX, sinY);
+    r[0] = _mm256_mul_ps(cosY, cosZ);
+    r[1] = _mm256_fnmadd_ps(cosY, sinZ, zero);
+    r[2] = sinY;
+    r[3] = _mm256_fmadd_ps(sinXSinY, cosZ, _mm256_mul_ps(cosX, sinZ));
+    r[4] = _mm256_fnmadd_ps(sinXSinY, sinZ, _mm256_mul_ps(cosX, cosZ));
+    r[5] = _mm256_fnmadd_ps(sinX, cosY, zero);
+    r[6] = _mm256_fnmadd_ps(cosXSinY, cosZ, _mm256_mul_ps(sinX, sinZ));
+    r[7] = _mm256_fmadd_ps(cosXSinY, sinZ, _mm256_mul_ps(sinX, cosZ));
+    r[8] = _mm256_mul_ps(cosX, cosY);
+}
+
+DUNIYA_TARGET("avx2,fma")
+static void QuaternionRotation8(const TransformSoA& t, uint32_t i,
+				__m256* r) {
+    __m256 x = _mm256_loadu_ps(t.orientationX + i);
+    __m256 y = _mm256_loadu_ps(t.orientationY + i);
+    __m256 z = _mm256_loadu_ps(t.orientationZ + i);
+    __m256 w = _mm256_loadu_ps(t.orientationW + i);
+    __m256 one = _mm256_set1_ps(1.f);
+    // Doubled once so every term below is a single FMA
+    __m256 x2 = _mm256_add_ps(x, x), y2 = _mm256_add_ps(y, y),
+	   z2 = _mm256_add_ps(z, z);
+    __m256 xx = _mm256_mul_ps(x, x2), yy = _mm256_mul_ps(y, y2),
+	   zz = _mm256_mul_ps(z, z2);
+    __m256 xy = _mm256_mul_ps(x, y2), xz = _mm256_mul_ps(x, z2),
+	   yz = _mm256_mul_ps(y, z2);
+    __m256 wx = _mm256_mul_ps(w, x2), wy = _mm256_mul_ps(w, y2),
+	   wz = _mm256_mul_ps(w, z2);
+    r[0] = _mm256_sub_ps(one, _mm256_add_ps(yy, zz));
+    r[1] = _mm256_sub_ps(xy, wz);
+    r[2] = _mm256_add_ps(xz, wy);
+    r[3] = _mm256_add_ps(xy, wz);
+    r[4] = _mm256_sub_ps(one, _mm256_add_ps(xx, zz));
+    r[5] = _mm256_sub_ps(yz, wx);
+    r[6] = _mm256_sub_ps(xz, wy);
+    r[7] = _mm256_add_ps(yz, wx);
+    r[8] = _mm256_sub_ps(one, _mm256_add_ps(xx, yy));
+}
+
+DUNIYA_TARGET("avx2,fma")
+static void ComposeAvx(const TransformSoA& t, uint32_t begin, uint32_t end,
+		       Mat4* world, const Mat4* viewProjection, Mat4* mvp) {
+    const __m256 zero = _mm256_setzero_ps();
+    const float* pos[3] = {t.posX, t.posY, t.posZ};
+    const float* scale[3] = {t.scaleX, t.scaleY, t.scaleZ};
+    uint32_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+	__m256 r[9];
+	if (t.orientationX != nullptr)
+	    QuaternionRotation8(t, i, r);
+	else
+	    EulerRotation8(t, i, r);
+	__m256 m[16];
+	for (uint32_t row = 0; row < 3; row++) {
+	    __m256 rowScale = _mm256_loadu_ps(scale[row] + i);
+	    for (uint32_t column = 0; column < 3; column++)
+		m[row * 4 + column] =
+		    _mm256_mul_ps(rowScale, r[row * 3 + column]);
+	    m[row * 4 + 3] = _mm256_loadu_ps(pos[row] + i);
+	}
+	m[12] = m[13] = m[14] = zero;
+	m[15] = _mm256_set1_ps(1.f);
+	StoreMatrices(m, world + i);
+	if (viewProjection == nullptr) continue;
+
+	// The world matrices' last row is 0 0 0 1
+	const float* vp = viewProjection->data;
+	__m256 p[16];
+	for (uint32_t row = 0; row < 4; row++) {
+	    __m256 v0 = _mm256_set1_ps(vp[row * 4]);
+	    __m256 v1 = _mm256_set1_ps(vp[row * 4 + 1]);
+	    __m256 v2 = _mm256_set1_ps(vp[row * 4 + 2]);
+	    for (uint32_t column = 0; column < 4; column++) {
+		__m256 sum = column == 3 ? _mm256_set1_ps(vp[row * 4 + 3])
+					 : zero;
+		sum = _mm256_fmadd_ps(v0, m[column], sum);
+		sum = _mm256_fmadd_ps(v1, m[4 + column], sum);
+		p[row * 4 + column] = _mm256_fmadd_ps(v2, m[8 + column], sum);
+	    }
+	}
+	StoreMatrices(p, mvp + i);
+    }
+    if (i < end) ComposeScalar(t, i, end, world, viewProjection, mvp);
+}
+
+#endif
+
+static void ComposeRange(const TransformSoA& transforms, uint32_t begin,
+			 uint32_t end, Mat4* world, const Mat4* viewProjection,
+			 Mat4* mvp) {
+#ifdef DUNIYA_TRANSFORM_X86
+    // Follows the Mat4 kernels' level so both can be pinned together
+    if (Mat4Kernels::GetSimdLevel() == Mat4Kernels::SimdLevel::AVX2) {
+	ComposeAvx(transforms, begin, end, world, viewProjection, mvp);
+	return;
+    }
+#endif
+    ComposeScalar(transforms, begin, end, world, viewProjection, mvp);
+}
+
+void ComposeTransforms(const TransformSoA& transforms, uint32_t count,
+		       Mat4* world, const Mat4* viewProjection, Mat4* mvp) {
+    ComposeRange(transforms, 0, count, world, viewProjection, mvp);
+}
+
+void ComposeTransformsParallel(const TransformSoA& transforms, uint32_t count,
+			       Mat4* world, const Mat4* viewProjection,
+			       Mat4* mvp) {
+    if (count <= transformBatchGrain) {
+	ComposeRange(transforms, 0, count, world, viewProjection, mvp);
+	return;
+    }
+    JobSystem::GetSingleton()->ParallelFor(count, transformBatchGrain,
+			   [&](uint32_t begin, uint32_t end) {
+			       ComposeRange(transforms, begin, end, world,
+					    viewProjection, mvp);
+			   });
+}
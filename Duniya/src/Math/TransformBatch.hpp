@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "FixedMat.hpp"
+#include "Quat.hpp"
+#include "Vect3.hpp"
+
+// Ranges handed to one job by ComposeTransformsParallel
+constexpr uint32_t transformBatchGrain = 1024;
+
+// Transforms laid out one component per array, every array count long
+struct TransformSoA {
+    const float* posX;
+    const float* posY;
+    const float* posZ;
+    const float* rotationX;
+    const float* rotationY;
+    const float* rotationZ;
+    const float* scaleX;
+    const float* scaleY;
+    const float* scaleZ;
+    // Set for transforms rotated by a unit quaternion, the rotation arrays
+    // are ignored then
+    const float* orientationX = nullptr;
+    const float* orientationY = nullptr;
+    const float* orientationZ = nullptr;
+    const float* orientationW = nullptr;
+};
+
+// Owns the arrays of a TransformSoA, filled one transform at a time. A
+// buffer holds either Euler rotations or orientations, not both.
+class TransformBuffer {
+   public:
+    void Clear();
+    void Reserve(uint32_t count);
+    // Return the transform's index
+    uint32_t Push(const Vect3& pos, const Vect3& rotation, const Vect3& scale);
+    uint32_t Push(const Vect3& pos, const Quat& orientation,
+		  const Vect3& scale);
+    uint32_t GetSize() const;
+    TransformSoA View() const;
+
+   private:
+    std::vector<float> components[13];
+};
+
+// world[i] is what ConvertTranforToMatrix builds for transform i, that is
+// [scale | pos] * roll * pitch * yaw or * the orientation's matrix. When
+// viewProjection is given, mvp[i] = *viewProjection * world[i] is written
+// too. Eight transforms are composed per iteration when the CPU has AVX2.
+void ComposeTransforms(const TransformSoA& transforms, uint32_t count,
+		       Mat4* world, const Mat4* viewProjection = nullptr,
+		       Mat4* mvp = nullptr);
+// Same, split in ranges of transformBatchGrain over the JobSystem
+void ComposeTransformsParallel(const TransformSoA& transforms, uint32_t count,
+			       Mat4* world,
+			       const Mat4* viewProjection = nullptr,
+			       Mat4* mvp = nullptr);
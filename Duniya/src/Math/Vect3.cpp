@@ -13,17 +13,3 @@ void Vect3::normalize() {
     }
 }
 
-float Vect3::dot(const Vect3& other) const {
-    float game = 0.f;
-    for (uint32_t i = 0; i < 3; i++) {
-	game += this->coordinates[i] * other.coordinates[i];
-    }
-    return game;
-}
-Vect3 Vect3::cross(const Vect3& other) const {
-    Vect3 game;
-    game.x = y * other.z - z * other.y;
-    game.y = z * other.x - x * other.z;
-    game.z = x * other.y - y * other.x;
-    return game;
-}
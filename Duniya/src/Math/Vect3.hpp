@@ -56,21 +56,29 @@ class Vect3 {
     }
     // Static functions
    public:
-    inline Vect3 normalized() {
+    inline Vect3 normalized() const {
 	auto tmp = *this;
 	tmp.normalize();
 	return tmp;
     }
     inline static float dot(const Vect3& first, const Vect3& other) {
-	auto temp = first;
-	return temp.dot(other);
+	return first.dot(other);
     }
     inline static Vect3 cross(const Vect3& first, const Vect3& other) {
-	auto temp = first;
-	return temp.cross(other);
+	return first.cross(other);
     }
 };
 
+// Inline so the hot loops calling them don't pay for a call each
+inline float Vect3::dot(const Vect3& other) const {
+    return x * other.x + y * other.y + z * other.z;
+}
+
+inline Vect3 Vect3::cross(const Vect3& other) const {
+    return Vect3(y * other.z - z * other.y, z * other.x - x * other.z,
+		 x * other.y - y * other.x);
+}
+
 inline Vect3 Vect3::operator+(const float& other) const {
     Vect3 temp(*this);
     temp.x += other;
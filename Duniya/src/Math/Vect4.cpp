@@ -16,5 +16,14 @@ float Vect4::dot(const Vect4& other) const {
     return game;
 }
 
-Vect4 Vect4::cross(const Vect4& other) const {}
+// Of the xyz parts, w is 0
+Vect4 Vect4::cross(const Vect4& other) const {
+    return Vect4(y * other.z - z * other.y, z * other.x - x * other.z,
+		 x * other.y - y * other.x, 0.f);
+}
+
+void Vect4::normalize() {
+    float distance = sqrtf(dot(*this));
+    for (uint32_t i = 0; i < 4; i++) coordinates[i] /= distance;
+}
 
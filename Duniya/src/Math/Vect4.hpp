@@ -57,14 +57,13 @@ class Vect4 {
     }
 
    public:
-    inline Vect4 normalized() {
+    inline Vect4 normalized() const {
 	auto tmp = *this;
 	tmp.normalize();
 	return tmp;
     }
     inline static float dot(const Vect4& first, const Vect4& other) {
-	auto temp = first;
-	return temp.dot(other);
+	return first.dot(other);
     }
 };
 
@@ -0,0 +1,119 @@
+#include "Bench.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+#include <thread>
+
+// Iterations grow until one run takes this much of minTime
+constexpr double calibrationShare = .1;
+
+static double Seconds(const BenchRunner::Body& body, uint64_t iterations) {
+    auto start = std::chrono::steady_clock::now();
+    body(iterations);
+    std::chrono::duration<double> elapsed =
+	std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+static std::string Escape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+	if (c == '"' || c == '\\') escaped += '\\';
+	escaped += c;
+    }
+    return escaped;
+}
+
+void BenchRunner::Add(std::string name, Body body, uint32_t items) {
+    benches.push_back({std::move(name), std::move(body), items});
+}
+
+void BenchRunner::AddContext(std::string key, std::string value) {
+    context.emplace_back(std::move(key), std::move(value));
+}
+
+std::vector<BenchResult> BenchRunner::Run(const BenchOptions& options) {
+    std::vector<BenchResult> results;
+    for (auto& bench : benches) {
+	if (bench.name.find(options.filter) == std::string::npos) continue;
+	// Also warms the caches and the branch predictors up
+	uint64_t iterations = 1;
+	double seconds = Seconds(bench.body, iterations);
+	while (seconds < options.minTime * calibrationShare) {
+	    double scale = seconds > 0. ? options.minTime / seconds : 100.;
+	    iterations = iterations * std::clamp(scale, 2., 100.);
+	    seconds = Seconds(bench.body, iterations);
+	}
+	iterations = std::max<uint64_t>(
+	    1, iterations * options.minTime / std::max(seconds, 1e-9));
+
+	std::vector<double> times;
+	for (uint32_t i = 0; i < std::max(options.repetitions, 1u); i++)
+	    times.push_back(Seconds(bench.body, iterations) * 1e9 /
+			    iterations);
+	std::sort(times.begin(), times.end());
+	double median = times[times.size() / 2];
+	results.push_back({bench.name, iterations, median, times.front(),
+			   bench.items * 1e9 / median});
+    }
+    return results;
+}
+
+void BenchRunner::WriteTable(std::ostream& output,
+			     const std::vector<BenchResult>& results) const {
+    size_t width = 9;
+    for (auto& result : results) width = std::max(width, result.name.size());
+    output << std::left << std::setw(width + 2) << "Benchmark" << std::right
+	   << std::setw(14) << "median ns" << std::setw(14) << "min ns"
+	   << std::setw(14) << "Mitems/s" << std::setw(12) << "iterations"
+	   << "\n";
+    output << std::fixed << std::setprecision(2);
+    for (auto& result : results)
+	output << std::left << std::setw(width + 2) << result.name
+	       << std::right << std::setw(14) << result.medianNanoseconds
+	       << std::setw(14) << result.minNanoseconds << std::setw(14)
+	       << result.itemsPerSecond / 1e6 << std::setw(12)
+	       << result.iterations << "\n";
+    output << std::defaultfloat << std::flush;
+}
+
+void BenchRunner::WriteJson(std::ostream& output,
+			    const std::vector<BenchResult>& results) const {
+    char date[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S",
+		  std::localtime(&now));
+    output << "{\n  \"context\": {\n";
+    output << "    \"date\": \"" << date << "\",\n";
+    output << "    \"num_cpus\": " << std::thread::hardware_concurrency()
+	   << ",\n";
+    // Whether the code was optimized, NDEBUG alone calls -O2 builds that
+    // keep their asserts debug
+#if defined(__OPTIMIZE__) || (!defined(__GNUC__) && defined(NDEBUG))
+    output << "    \"library_build_type\": \"release\"";
+#else
+    output << "    \"library_build_type\": \"debug\"";
+#endif
+    for (auto& [key, value] : context)
+	output << ",\n    \"" << Escape(key) << "\": \"" << Escape(value)
+	       << "\"";
+    output << "\n  },\n  \"benchmarks\": [";
+    output << std::setprecision(9);
+    for (size_t i = 0; i < results.size(); i++) {
+	auto& result = results[i];
+	output << (i == 0 ? "\n" : ",\n") << "    {\n";
+	output << "      \"name\": \"" << Escape(result.name) << "\",\n";
+	output << "      \"run_name\": \"" << Escape(result.name) << "\",\n";
+	output << "      \"run_type\": \"iteration\",\n";
+	output << "      \"iterations\": " << result.iterations << ",\n";
+	output << "      \"real_time\": " << result.medianNanoseconds << ",\n";
+	output << "      \"cpu_time\": " << result.medianNanoseconds << ",\n";
+	output << "      \"min_time\": " << result.minNanoseconds << ",\n";
+	output << "      \"time_unit\": \"ns\",\n";
+	output << "      \"items_per_second\": " << result.itemsPerSecond
+	       << "\n    }";
+    }
+    output << "\n  ]\n}\n" << std::flush;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Keeps the compiler from dropping the computation that produced value
+template <typename T>
+inline void DoNotOptimize(T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : "+m"(value) : : "memory");
+#else
+    static volatile char sink;
+    sink = *reinterpret_cast<volatile char*>(&value);
+#endif
+}
+
+struct BenchOptions {
+    // Benchmarks whose name contains it, all of them when empty
+    std::string filter;
+    // Each repetition runs at least this long
+    double minTime = .1;
+    uint32_t repetitions = 5;
+};
+
+struct BenchResult {
+    std::string name;
+    uint64_t iterations;
+    // Per iteration, the median and the fastest of the repetitions
+    double medianNanoseconds;
+    double minNanoseconds;
+    double itemsPerSecond;
+};
+
+// Self contained harness, benchmarks are a body running some number of
+// iterations. The JSON follows Google Benchmark's, so its compare.py can
+// diff two runs.
+class BenchRunner {
+   public:
+    using Body = std::function<void(uint64_t iterations)>;
+
+    // items is how many elements one iteration handles, for items/s
+    void Add(std::string name, Body body, uint32_t items = 1);
+    // Context lines for the JSON, the SIMD level the run was on and such
+    void AddContext(std::string key, std::string value);
+    std::vector<BenchResult> Run(const BenchOptions& options);
+
+    void WriteTable(std::ostream& output,
+		    const std::vector<BenchResult>& results) const;
+    void WriteJson(std::ostream& output,
+		   const std::vector<BenchResult>& results) const;
+
+   private:
+    struct Bench {
+	std::string name;
+	Body body;
+	uint32_t items;
+    };
+    std::vector<Bench> benches;
+    std::vector<std::pair<std::string, std::string>> context;
+};
@@ -0,0 +1,450 @@
+#include <ECS/CommonComponent.hpp>
+#include <Math/Bounds.hpp>
+#include <Math/Mat.hpp>
+#include <Math/Mat4Kernels.hpp>
+#include <Math/Projection.hpp>
+#include <Math/Quat.hpp>
+#include <Math/SimdVect.hpp>
+#include <Math/TransformBatch.hpp>
+#include <MathBench/Bench.hpp>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// The Vect3x8 benchmarks pass Float8s around in builds without AVX, all
+// inlined, so the ABI the warning is about never comes up
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+using Mat4Kernels::SimdLevel;
+
+// Elements per iteration of the batched benchmarks, small enough for L1
+constexpr uint32_t batchSize = 1024;
+
+static void PrintUsage(const char* program) {
+    std::cerr << "usage: " << program
+	      << " [--filter <substring>] [--json <file>|-]"
+		 " [--min-time <seconds>] [--repetitions <count>]"
+	      << std::endl;
+}
+
+// Fixed seed, runs on different commits see the same inputs
+struct Inputs {
+    std::mt19937 random{0x15};
+
+    float Next(float min = -10.f, float max = 10.f) {
+	return std::uniform_real_distribution<float>(min, max)(random);
+    }
+    Vect3 NextVect3() { return Vect3(Next(), Next(), Next()); }
+    Mat4 NextMat4() {
+	Mat4 mat;
+	for (auto& value : mat.data) value = Next();
+	return mat;
+    }
+    Quat NextQuat() {
+	return Quat::FromEuler(Vect3(Next(-3.f, 3.f), Next(-3.f, 3.f),
+				     Next(-3.f, 3.f)));
+    }
+};
+
+// The levels the CPU supports, each benchmark with a SIMD variant is
+// registered once per level
+static std::vector<SimdLevel> SupportedLevels() {
+    std::vector<SimdLevel> levels;
+    SimdLevel best = Mat4Kernels::GetSimdLevel();
+    for (auto level : {SimdLevel::SCALAR, SimdLevel::SSE41, SimdLevel::AVX2})
+	if (level <= best) levels.push_back(level);
+    return levels;
+}
+
+static std::string Name(const std::string& name, SimdLevel level) {
+    return name + "/" + Mat4Kernels::GetSimdLevelName(level);
+}
+
+static void AddMatBenches(BenchRunner& runner, Inputs& inputs) {
+    Mat4 a = inputs.NextMat4(), b = inputs.NextMat4();
+    runner.Add("Mat/Multiply", [a, b](uint64_t iterations) {
+	Mat first = a.ToMat(), second = b.ToMat();
+	for (uint64_t i = 0; i < iterations; i++) {
+	    Mat result = first * second;
+	    DoNotOptimize(result.buffer);
+	}
+    });
+    // Mat inverts in place, the copy is part of what's measured
+    runner.Add("Mat/Inverse", [a](uint64_t iterations) {
+	Mat mat = a.ToMat();
+	for (uint64_t i = 0; i < iterations; i++) {
+	    Mat result = mat;
+	    result.inverse();
+	    DoNotOptimize(result.buffer);
+	}
+    });
+
+    auto vects = std::make_shared<std::vector<Vect4>>();
+    for (uint32_t i = 0; i < batchSize; i++)
+	vects->push_back(Vect4(inputs.NextVect3(), 1.f));
+    for (auto level : SupportedLevels()) {
+	runner.Add(Name("Mat4/Multiply", level), [=](uint64_t iterations) {
+	    Mat4Kernels::SetSimdLevel(level);
+	    Mat4 result = a;
+	    for (uint64_t i = 0; i < iterations; i++) {
+		result = Mat4Kernels::Multiply(result, b);
+		DoNotOptimize(result);
+	    }
+	});
+	runner.Add(Name("Mat4/Inverse", level), [=](uint64_t iterations) {
+	    Mat4Kernels::SetSimdLevel(level);
+	    Mat4 result;
+	    for (uint64_t i = 0; i < iterations; i++) {
+		Mat4Kernels::Inverse(a, result);
+		DoNotOptimize(result);
+	    }
+	});
+	runner.Add(
+	    Name("Mat4/TransformBatch", level),
+	    [=](uint64_t iterations) {
+		Mat4Kernels::SetSimdLevel(level);
+		std::vector<Vect4> out(batchSize);
+		for (uint64_t i = 0; i < iterations; i++) {
+		    Mat4Kernels::Transform(a, vects->data(), out.data(),
+					   batchSize);
+		    DoNotOptimize(out[0]);
+		}
+	    },
+	    batchSize);
+    }
+}
+
+static void AddTransformBenches(BenchRunner& runner, Inputs& inputs) {
+    auto transforms = std::make_shared<std::vector<Transform>>();
+    auto orientations = std::make_shared<std::vector<Orientation>>();
+    auto buffer = std::make_shared<TransformBuffer>();
+    for (uint32_t i = 0; i < batchSize; i++) {
+	Transform transform = {inputs.NextVect3(), inputs.NextVect3(),
+			       inputs.NextVect3()};
+	transforms->push_back(transform);
+	orientations->push_back({inputs.NextQuat()});
+	buffer->Push(transform.pos, transform.rotation, transform.scale);
+    }
+    Mat4 viewProjection = inputs.NextMat4();
+
+    runner.Add(
+	"Transform/ConvertTranforToMatrix",
+	[=](uint64_t iterations) {
+	    for (uint64_t i = 0; i < iterations; i++)
+		for (auto& transform : *transforms) {
+		    Mat4 world = ConvertTranforToMatrix(transform);
+		    DoNotOptimize(world);
+		}
+	},
+	batchSize);
+    runner.Add(
+	"Transform/ConvertTranforToMatrixOriented",
+	[=](uint64_t iterations) {
+	    for (uint64_t i = 0; i < iterations; i++)
+		for (uint32_t j = 0; j < batchSize; j++) {
+		    auto& transform = (*transforms)[j];
+		    Mat4 world =
+			ConvertTranforToMatrix(transform, (*orientations)[j]);
+		    DoNotOptimize(world);
+		}
+	},
+	batchSize);
+    // ComposeTransforms only has scalar and AVX2 paths
+    for (auto level : SupportedLevels()) {
+	if (level == SimdLevel::SSE41) continue;
+	runner.Add(
+	    Name("Transform/ComposeTransforms", level),
+	    [=](uint64_t iterations) {
+		Mat4Kernels::SetSimdLevel(level);
+		std::vector<Mat4> world(batchSize);
+		for (uint64_t i = 0; i < iterations; i++) {
+		    ComposeTransforms(buffer->View(), batchSize,
+				      world.data());
+		    DoNotOptimize(world[0]);
+		}
+	    },
+	    batchSize);
+	runner.Add(
+	    Name("Transform/ComposeTransformsMVP", level),
+	    [=](uint64_t iterations) {
+		Mat4Kernels::SetSimdLevel(level);
+		std::vector<Mat4> world(batchSize), mvp(batchSize);
+		for (uint64_t i = 0; i < iterations; i++) {
+		    ComposeTransforms(buffer->View(), batchSize,
+				      world.data(), &viewProjection,
+				      mvp.data());
+		    DoNotOptimize(mvp[0]);
+		}
+	    },
+	    batchSize);
+    }
+}
+
+static void AddCameraBenches(BenchRunner& runner, Inputs& inputs) {
+    Vect3 eye = inputs.NextVect3(), at = inputs.NextVect3();
+    runner.Add("Camera/LookAt", [=](uint64_t iterations) {
+	Vect3 from = eye;
+	for (uint64_t i = 0; i < iterations; i++) {
+	    DoNotOptimize(from);
+	    Mat4 view = GetLookAtMatrix(from, at, Vect3(0, 1, 0));
+	    DoNotOptimize(view);
+	}
+    });
+    runner.Add("Camera/Perspective", [](uint64_t iterations) {
+	float fov = 1.2f;
+	for (uint64_t i = 0; i < iterations; i++) {
+	    DoNotOptimize(fov);
+	    Mat4 projection =
+		GetPerspectiveMatrix(fov, 16.f / 9.f, .1f, 100.f);
+	    DoNotOptimize(projection);
+	}
+    });
+}
+
+// The same dot, cross and normalize over Vect3, the aligned Vect3A and the
+// SoA Vect3x8
+static void AddVectBenches(BenchRunner& runner, Inputs& inputs) {
+    auto vects = std::make_shared<std::vector<Vect3>>();
+    auto aligned = std::make_shared<std::vector<Vect3A>>();
+    auto soa = std::make_shared<std::vector<Vect3x8>>();
+    for (uint32_t i = 0; i < batchSize; i++) {
+	vects->push_back(inputs.NextVect3());
+	aligned->push_back(Vect3A(vects->back()));
+    }
+    for (uint32_t i = 0; i < batchSize; i += 8)
+	soa->push_back(Vect3x8::Load(vects->data() + i));
+    Vect3 other = inputs.NextVect3();
+
+    runner.Add(
+	"Vect3/Dot",
+	[=](uint64_t iterations) {
+	    for (uint64_t i = 0; i < iterations; i++) {
+		float sum = 0.f;
+		for (auto& vect : *vects) sum += Vect3::dot(vect, other);
+		DoNotOptimize(sum);
+	    }
+	},
+	batchSize);
+    runner.Add(
+	"Vect3A/Dot",
+	[=](uint64_t iterations) {
+	    Vect3A second(other);
+	    for (uint64_t i = 0; i < iterations; i++) {
+		float sum = 0.f;
+		for (auto& vect : *aligned)
+		    sum += Vect3A::dot(vect, second);
+		DoNotOptimize(sum);
+	    }
+	},
+	batchSize);
+    runner.Add(
+	"Vect3x8/Dot",
+	[=](uint64_t iterations) {
+	    Vect3x8 second(other);
+	    for (uint64_t i = 0; i < iterations; i++) {
+		Float8 sum = {};
+		for (auto& vects : *soa) sum += Vect3x8::dot(vects, second);
+		DoNotOptimize(sum);
+	    }
+	},
+	batchSize);
+
+    runner.Add(
+	"Vect3/Cross",
+	[=](uint64_t iterations) {
+	    std::vector<Vect3> out(batchSize);
+	    for (uint64_t i = 0; i < iterations; i++) {
+		for (uint32_t j = 0; j < batchSize; j++)
+		    out[j] = Vect3::cross((*vects)[j], other);
+		DoNotOptimize(out[0]);
+	    }
+	},
+	batchSize);
+    runner.Add(
+	"Vect3A/Cross",
+	[=](uint64_t iterations) {
+	    std::vector<Vect3A> out(batchSize);
+	    Vect3A second(other);
+	    for (uint64_t i = 0; i < iterations; i++) {
+		for (uint32_t j = 0; j < batchSize; j++)
+		    out[j] = Vect3A::cross((*aligned)[j], second);
+		DoNotOptimize(out[0]);
+	    }
+	},
+	batchSize);
+    runner.Add(
+	"Vect3x8/Cross",
+	[=](uint64_t iterations) {
+	    std::vector<Vect3x8> out(batchSize / 8);
+	    Vect3x8 second(other);
+	    for (uint64_t i = 0; i < iterations; i++) {
+		for (uint32_t j = 0; j < batchSize / 8; j++)
+		    out[j] = Vect3x8::cross((*soa)[j], second);
+		DoNotOptimize(out[0]);
+	    }
+	},
+	batchSize);
+
+    runner.Add(
+	"Vect3/Normalize",
+	[=](uint64_t iterations) {
+	    std::vector<Vect3> out(batchSize);
+	    for (uint64_t i = 0; i < iterations; i++) {
+		for (uint32_t j = 0; j < batchSize; j++)
+		    out[j] = (*vects)[j].normalized();
+		DoNotOptimize(out[0]);
+	    }
+	},
+	batchSize);
+    runner.Add(
+	"Vect3A/Normalize",
+	[=](uint64_t iterations) {
+	    std::vector<Vect3A> out(batchSize);
+	    for (uint64_t i = 0; i < iterations; i++) {
+		for (uint32_t j = 0; j < batchSize; j++)
+		    out[j] = (*aligned)[j].normalized();
+		DoNotOptimize(out[0]);
+	    }
+	},
+	batchSize);
+}
+
+static void AddQuatBenches(BenchRunner& runner, Inputs& inputs) {
+    auto a = std::make_shared<std::vector<Quat>>();
+    auto b = std::make_shared<std::vector<Quat>>();
+    auto t = std::make_shared<std::vector<float>>();
+    for (uint32_t i = 0; i < batchSize; i++) {
+	a->push_back(inputs.NextQuat());
+	b->push_back(inputs.NextQuat());
+	t->push_back(inputs.Next(0.f, 1.f));
+    }
+    for (auto level : SupportedLevels()) {
+	runner.Add(
+	    Name("Quat/NlerpBatch", level),
+	    [=](uint64_t iterations) {
+		Mat4Kernels::SetSimdLevel(level);
+		std::vector<Quat> out(batchSize);
+		for (uint64_t i = 0; i < iterations; i++) {
+		    NlerpBatch(a->data(), b->data(), t->data(), out.data(),
+			       batchSize);
+		    DoNotOptimize(out[0]);
+		}
+	    },
+	    batchSize);
+	runner.Add(
+	    Name("Quat/SlerpBatch", level),
+	    [=](uint64_t iterations) {
+		Mat4Kernels::SetSimdLevel(level);
+		std::vector<Quat> out(batchSize);
+		for (uint64_t i = 0; i < iterations; i++) {
+		    SlerpBatch(a->data(), b->data(), t->data(), out.data(),
+			       batchSize);
+		    DoNotOptimize(out[0]);
+		}
+	    },
+	    batchSize);
+    }
+}
+
+static void AddBoundsBenches(BenchRunner& runner, Inputs& inputs) {
+    auto boxes = std::make_shared<std::vector<AABB>>();
+    for (uint32_t i = 0; i < batchSize; i++)
+	boxes->push_back(AABB::FromCenterExtents(
+	    inputs.NextVect3() * 5.f,
+	    Vect3(inputs.Next(.1f, 2.f), inputs.Next(.1f, 2.f),
+		  inputs.Next(.1f, 2.f))));
+    // From the middle of the boxes, part of them are visible whichever way
+    // the camera faces
+    Mat4 view = GetLookAtMatrix(Vect3(0, 0, 0), Vect3(0, 0, 1), Vect3(0, 1, 0));
+    Mat4 projection = GetPerspectiveMatrix(1.2f, 16.f / 9.f, .1f, 100.f);
+    Frustum frustum = Frustum::FromMatrix(view * projection);
+
+    runner.Add(
+	"Bounds/FrustumAABB",
+	[=](uint64_t iterations) {
+	    std::vector<uint8_t> visible(batchSize);
+	    for (uint64_t i = 0; i < iterations; i++) {
+		for (uint32_t j = 0; j < batchSize; j++)
+		    visible[j] = frustum.Intersects((*boxes)[j]);
+		DoNotOptimize(visible[0]);
+	    }
+	},
+	batchSize);
+    for (auto level : SupportedLevels()) {
+	runner.Add(
+	    Name("Bounds/CullAABBs", level),
+	    [=](uint64_t iterations) {
+		Mat4Kernels::SetSimdLevel(level);
+		std::vector<uint8_t> visible(batchSize);
+		for (uint64_t i = 0; i < iterations; i++) {
+		    CullAABBs(frustum, boxes->data(), batchSize,
+			      visible.data());
+		    DoNotOptimize(visible[0]);
+		}
+	    },
+	    batchSize);
+    }
+}
+
+// duniya_math_bench [--filter <substring>] [--json <file>|-]
+//		     [--min-time <seconds>] [--repetitions <count>]
+// Prints a table, the JSON goes to the file or to stdout for -
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    std::string jsonPath;
+    for (int i = 1; i < argc; i++) {
+	std::string argument = argv[i];
+	if (i + 1 >= argc) {
+	    PrintUsage(argv[0]);
+	    return EXIT_FAILURE;
+	}
+	if (argument == "--filter")
+	    options.filter = argv[++i];
+	else if (argument == "--json")
+	    jsonPath = argv[++i];
+	else if (argument == "--min-time")
+	    options.minTime = std::atof(argv[++i]);
+	else if (argument == "--repetitions")
+	    options.repetitions = std::atoi(argv[++i]);
+	else {
+	    PrintUsage(argv[0]);
+	    return EXIT_FAILURE;
+	}
+    }
+
+    SimdLevel best = Mat4Kernels::GetSimdLevel();
+    BenchRunner runner;
+    runner.AddContext("simd_level", Mat4Kernels::GetSimdLevelName(best));
+#if defined(__VERSION__)
+    runner.AddContext("compiler", __VERSION__);
+#endif
+    Inputs inputs;
+    AddMatBenches(runner, inputs);
+    AddTransformBenches(runner, inputs);
+    AddCameraBenches(runner, inputs);
+    AddVectBenches(runner, inputs);
+    AddQuatBenches(runner, inputs);
+    AddBoundsBenches(runner, inputs);
+
+    auto results = runner.Run(options);
+    Mat4Kernels::SetSimdLevel(best);
+    if (jsonPath == "-") {
+	runner.WriteJson(std::cout, results);
+	return EXIT_SUCCESS;
+    }
+    runner.WriteTable(std::cout, results);
+    if (!jsonPath.empty()) {
+	std::ofstream json(jsonPath);
+	if (!json) {
+	    std::cerr << "can't write " << jsonPath << std::endl;
+	    return EXIT_FAILURE;
+	}
+	runner.WriteJson(json, results);
+    }
+    return EXIT_SUCCESS;
+}
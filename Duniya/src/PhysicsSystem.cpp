@@ -1,5 +1,10 @@
+#include <ECS/ComponentReflection.hpp>
 #include <PhysicsSystem.hpp>
 
+DUNIYA_REGISTER_COMPONENT(RigidBody, ComponentTypes::RIGIDBODY);
+DUNIYA_REGISTER_COMPONENT(CollisionBox2D, ComponentTypes::COLLISIONBOX2D);
+DUNIYA_REGISTER_COMPONENT(CollisionBox3D, ComponentTypes::COLLISIONBOX3D);
+
 PhysicsSystem::PhysicsSystem() { collisionBoxes.resize(1000); }
 
 void PhysicsSystem::LoadScene(Scene* scene) {
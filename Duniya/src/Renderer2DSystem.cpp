@@ -15,6 +15,16 @@
 
 Renderer2DSystem* Renderer2DSystem::singleton = nullptr;
 
+DUNIYA_REGISTER_COMPONENT(Panel, ComponentTypes::PANEL);
+DUNIYA_REGISTER_COMPONENT(Text, ComponentTypes::TEXTBOX);
+DUNIYA_REGISTER_COMPONENT(TextPanel, ComponentTypes::TEXTPANEL);
+
+// Instances per draw call, the shaders' arrays hold at least this many
+constexpr uint32_t panelBatchSize = 50;
+constexpr uint32_t glyphBatchSize = 10;
+
+constexpr UniformID textColorUniform = HashUniform("color");
+
 Renderer2DSystem::Renderer2DSystem() {
     messageID = 0x35;
     renderer = new GLRenderer();
@@ -43,6 +53,15 @@ Renderer2DSystem::Renderer2DSystem() {
     fontShaderStageHandler->shaderHandler.push_back(std::move(fontFragShader));
     fontShaderStageHandler->Load();
     shaderStageHandler->Load();
+
+    for (uint32_t i = 0; i < panelBatchSize; i++)
+	panelUniforms.push_back({HashUniformElement("panels", i),
+				 HashUniformElement("panelColors", i),
+				 HashUniformElement("panelCorners", i)});
+    for (uint32_t i = 0; i < glyphBatchSize; i++)
+	glyphUniforms.push_back({HashUniformElement("pos", i),
+				 HashUniformElement("uvs", i),
+				 HashUniformElement("boxPositions", i)});
 }
 
 Renderer2DSystem* Renderer2DSystem::Init() {
@@ -63,7 +82,7 @@ void Renderer2DSystem::LoadScene(Scene* scene) {
 	throw std::runtime_error("Couldn't pack font");
     }
     renderer->SetResourceBank(scene->resourceBank);
-    renderer->LoadTexture(&defaultFont.texture, &defaultFont.gBuffer);
+    renderer->LoadTexture(&defaultFont.texture, &defaultFont.gBuffer, 0);
     this->scene = scene;
     Scan();
 }
@@ -109,15 +128,14 @@ void Renderer2DSystem::LoadPanels() {
     for (auto i = 0; i < panels.size(); i++) {
 	auto& componentList = scene->entities[panels[i]];
 	if (componentList->Get(ComponentTypes::PANEL) != nullptr) {
-	    std::string panelIndex = "[" + std::to_string(goat) + "]";
+	    auto& uniforms = panelUniforms[goat];
 	    goat++;
 	    auto panel = reinterpret_cast<Panel*>(
 		componentList->Get(ComponentTypes::PANEL));
-	    renderer->Uniform4f(1, &panel->dimension, "panels" + panelIndex);
-	    renderer->Uniform4f(1, &panel->color, "panelColors" + panelIndex);
-	    renderer->Uniform1f(1, &panel->sideDist,
-				"panelCorners" + panelIndex);
-	    if (goat == 50) {
+	    renderer->Uniform4f(1, &panel->dimension, uniforms.dimension);
+	    renderer->Uniform4f(1, &panel->color, uniforms.color);
+	    renderer->Uniform1f(1, &panel->sideDist, uniforms.corner);
+	    if (goat == panelBatchSize) {
 		renderer->DrawInstancedArrays(DrawPrimitive::TRIANGLES_STRIPS,
 					      nullptr, 4, goat);
 		goat = 0;
@@ -135,7 +153,6 @@ void Renderer2DSystem::LoadPanels() {
 void Renderer2DSystem::LoadFontGlyph() {
     uint32_t goat = 0;
     fontShaderStageHandler->Load();
-    uint32_t batchSize = 10;
     renderer->Bind(defaultFont.gBuffer);
     for (int i = 0; i < texts.size(); i++) {
 	auto& text =
@@ -156,13 +173,13 @@ void Renderer2DSystem::LoadFontGlyph() {
 		Vect4(curPos, settings->Normalize(temp.pos) * scale);
 
 	    glyphPos.y -= settings->NormalizeY(defaultFont.fontSize) * scale;
-	    auto luft = "[" + std::to_string(goat) + "]";
-	    renderer->Uniform4f(1, &glyphPos, "pos" + luft);
-	    renderer->Uniform4f(1, &uv, "uvs" + luft);
-	    renderer->Uniform4f(1, &panel.dimension, "boxPositions" + luft);
-	    renderer->Uniform3f(1, &text.color, "color");
+	    auto& uniforms = glyphUniforms[goat];
+	    renderer->Uniform4f(1, &glyphPos, uniforms.pos);
+	    renderer->Uniform4f(1, &uv, uniforms.uv);
+	    renderer->Uniform4f(1, &panel.dimension, uniforms.box);
+	    renderer->Uniform3f(1, &text.color, textColorUniform);
 	    goat++;
-	    if (goat == batchSize) {
+	    if (goat == glyphBatchSize) {
 		renderer->DrawInstancedArrays(DrawPrimitive::TRIANGLES_STRIPS,
 					      nullptr, 4, goat);
 		goat = 0;
@@ -1,4 +1,5 @@
 #pragma once
+#include <ECS/ComponentReflection.hpp>
 #include <ECS/ECS.hpp>
 #include <Graphics/Renderer.hpp>
 #include <TexturePacker.hpp>
@@ -33,6 +34,7 @@ struct Text {
     uint32_t scale;
     Vect3 color;
 };
+DUNIYA_REFLECT(Text, &Text::str, &Text::scale, &Text::color);
 
 struct Button {
     uint32_t id;
@@ -43,6 +45,19 @@ struct Font {
     Vect2 umap[128][4];
 };
 
+// Uniform IDs of one instance slot in RectVert.glsl and FontVert.glsl
+struct PanelUniforms {
+    UniformID dimension;
+    UniformID color;
+    UniformID corner;
+};
+
+struct GlyphUniforms {
+    UniformID pos;
+    UniformID uv;
+    UniformID box;
+};
+
 class Renderer2DSystem : public System {
     struct AddMessage : public Message {
 	uint32_t entity;
@@ -72,6 +87,9 @@ class Renderer2DSystem : public System {
     Scene* scene;
     std::vector<uint32_t> panels;
     uint32_t layout;
+    // One per instance of a draw call, hashed once
+    std::vector<PanelUniforms> panelUniforms;
+    std::vector<GlyphUniforms> glyphUniforms;
     void LoadFontFile(std::string fontFile);
     void LoadPanels();
     void LoadFontGlyph();
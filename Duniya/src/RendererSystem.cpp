@@ -3,8 +3,14 @@
 #include <sys/types.h>
 
 #include <AssetLoader.hpp>
+#include <JobSystem.hpp>
+#include <Graphics/MipGenerator.hpp>
+#include <Graphics/VertexFormat.hpp>
+#include <UploadQueue.hpp>
+#include <algorithm>
 #include <chrono>
 #include <cmath>
+#include <cstring>
 #include <iterator>
 #include <stdexcept>
 #include <string>
@@ -16,20 +22,42 @@
 #include "Graphics/OpenGL/GLRenderer.hpp"
 #include "Graphics/Renderer.hpp"
 #include "Math/Mat.hpp"
+#include "Math/Mat4Kernels.hpp"
 #include "Math/Vect3.hpp"
 
 RendererSystem* RendererSystem::singleton = nullptr;
 
+// Mip levels up to this size go up together with the texture, the larger
+// ones follow one per upload
+constexpr uint32_t firstTextureLevelSize = 64;
+// Coarsest LOD error allowed on screen, in pixels
+constexpr float maxLodPixelError = 1.f;
+// transformSlots of the entities without a mesh
+constexpr uint32_t noTransformSlot = ~0u;
+// Uniform block bindings of the main shader
+constexpr uint32_t frameBinding = 0;
+constexpr uint32_t lightsBinding = 1;
+constexpr uint32_t materialBinding = 2;
+
+constexpr UniformID mvpUniform = HashUniform("MVP");
+constexpr UniformID positionScaleUniform = HashUniform("positionScale");
+constexpr UniformID positionOffsetUniform = HashUniform("positionOffset");
+constexpr UniformID octahedralNormalUniform = HashUniform("octahedralNormal");
+
 RendererSystem::RendererSystem() {
     animated = .0f;
     renderer = std::unique_ptr<Renderer>(new GLRenderer);
     SetupMainShader();
-    VertexSpecification specification = {
-	{"aPos", 4}, {"aNormal", 3}, {"texCoord", 2}};
     mainShaderStage->Load();
-    layout = renderer->AddSpecification(specification);
+    for (auto format :
+	 {VertexFormat::FULL, VertexFormat::COMPACT, VertexFormat::COMPACT_NO_UV,
+	  VertexFormat::COMPACT_FLOAT_POSITION}) {
+	auto specification = GetVertexSpecification(format);
+	vertexLayouts.push_back(renderer->AddSpecification(specification));
+    }
     SetupDefaultMaterial();
     SetupDefaultCamera();
+    SetupUniformBlocks();
 }
 
 RendererSystem* RendererSystem::init(Graphics_API graphicsAPI) {
@@ -40,10 +68,10 @@ RendererSystem* RendererSystem::init(Graphics_API graphicsAPI) {
 
 RendererSystem* RendererSystem::GetSingleton() { return singleton; }
 
-void RendererSystem::LoadLightColor(const LightColor& color, std::string name) {
-    renderer->Uniform3f(1, &color.ambient, name + ".ambient");
-    renderer->Uniform3f(1, &color.specular, name + ".specular");
-    renderer->Uniform3f(1, &color.diffuse, name + ".diffuse");
+static void LoadLightColor(const LightColor& color, LightColorBlock& block) {
+    block.ambient = color.ambient;
+    block.diffuse = color.diffuse;
+    block.specular = color.specular;
 }
 
 Scene* RendererSystem::GetScene() {
@@ -52,37 +80,109 @@ Scene* RendererSystem::GetScene() {
     return this->scene;
 }
 
-void RendererSystem::LoadLights() {
+void RendererSystem::LoadLights(LightsBlock& block) {
     uint32_t numPointLights = 0, numDirLights = 0;
     auto scene = GetScene();
     for (auto i : lights) {
-	if (scene->entities[i]->Get(ComponentTypes::POINTLIGHT) != nullptr) {
+	// The lights past the shader's arrays are left out
+	if (scene->entities[i]->Get(ComponentTypes::POINTLIGHT) != nullptr &&
+	    numPointLights < maxPointLights) {
 	    auto pointLight = reinterpret_cast<PointLight*>(
 		scene->entities[i]->Get(ComponentTypes::POINTLIGHT));
-	    std::string pointLightName("pointLights[");
-	    pointLightName += std::to_string(numPointLights) + "]";
-	    renderer->Uniform3f(1, &pointLight->pos, pointLightName + ".pos");
-	    LoadLightColor(pointLight->lightColor,
-			   pointLightName + ".lightColor");
-	    renderer->Uniform1f(1, &pointLight->constant,
-				pointLightName + ".constant");
-	    renderer->Uniform1f(1, &pointLight->linear,
-				pointLightName + ".linear");
-	    renderer->Uniform1f(1, &pointLight->quadratic, ".quadratic");
+	    auto& pointLightBlock = block.pointLights[numPointLights];
+	    pointLightBlock.pos = pointLight->pos;
+	    pointLightBlock.constant = pointLight->constant;
+	    pointLightBlock.linear = pointLight->linear;
+	    pointLightBlock.quadratic = pointLight->quadratic;
+	    LoadLightColor(pointLight->lightColor, pointLightBlock.lightColor);
 	    numPointLights++;
 	}
-	if (scene->entities[i]->Get(ComponentTypes::DIRLIGHT) != nullptr) {
+	if (scene->entities[i]->Get(ComponentTypes::DIRLIGHT) != nullptr &&
+	    numDirLights < maxDirLights) {
 	    auto dirLight = scene->entities[i]->Get<DirectionalLight>(
 		ComponentTypes::DIRLIGHT);
-	    std::string dirLightName("dirLights[");
-	    dirLightName += std::to_string(numDirLights) + "]";
-	    renderer->Uniform3f(1, &dirLight->dir, dirLightName + ".direction");
-	    LoadLightColor(dirLight->lightColor, dirLightName + ".lightColor");
+	    auto& dirLightBlock = block.dirLights[numDirLights];
+	    dirLightBlock.direction = dirLight->dir;
+	    LoadLightColor(dirLight->lightColor, dirLightBlock.lightColor);
 	    numDirLights++;
 	}
     }
-    renderer->Uniform1u(1, &numPointLights, "numPointLights");
-    renderer->Uniform1u(1, &numDirLights, "numDirLights");
+    block.numPointLights = numPointLights;
+    block.numDirLights = numDirLights;
+}
+
+// Offsets between blocks are multiples of the renderer's alignment
+static uint32_t AlignUniformBlock(uint32_t size, uint32_t alignment) {
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+void RendererSystem::SetupUniformBlocks() {
+    renderer->UniformBlockBinding(HashUniform("Frame"), frameBinding);
+    renderer->UniformBlockBinding(HashUniform("Lights"), lightsBinding);
+    renderer->UniformBlockBinding(HashUniform("MaterialBlock"),
+				  materialBinding);
+    uniformBuffer = renderer->CreateUniformBuffer();
+    auto alignment = std::max(renderer->GetUniformBufferAlignment(), 1u);
+    frameBlockOffset = AlignUniformBlock(sizeof(LightsBlock), alignment);
+    frameBlockStride = AlignUniformBlock(sizeof(FrameBlock), alignment);
+    materialBlockStride = AlignUniformBlock(sizeof(MaterialBlock), alignment);
+}
+
+static void LoadMaterialBlock(const Material& material, MaterialBlock& block) {
+    block.ambient = material.color.ambient;
+    block.diffuse = material.color.diffuse;
+    block.specular = material.color.specular;
+    block.shininess = material.shininess;
+}
+
+// Everything the uniform blocks hold for this frame is laid out in
+// uniformData and goes up with one mapped write. The lights stay bound for
+// the whole frame.
+void RendererSystem::WriteUniformBlocks() {
+    auto scene = GetScene();
+    materialSlots.assign(scene->entities.size(), 0);
+    uint32_t materialCount = 1;
+    for (uint32_t entity = 0; entity < scene->entities.size(); entity++) {
+	auto& components = scene->entities[entity];
+	if (components != nullptr &&
+	    components->Get(ComponentTypes::MATERIAL) != nullptr)
+	    materialSlots[entity] = materialCount++;
+    }
+    materialBlockOffset =
+	frameBlockOffset + activeCameras.size() * frameBlockStride;
+    uniformData.assign(
+	materialBlockOffset + materialCount * materialBlockStride, 0);
+    auto blockAt = [this](uint32_t offset) {
+	return uniformData.data() + offset;
+    };
+
+    LoadLights(*reinterpret_cast<LightsBlock*>(blockAt(0)));
+    for (uint32_t i = 0; i < activeCameras.size(); i++) {
+	auto rect = GetViewportRect(activeCameras[i]);
+	if (rect.z < 1.f || rect.w < 1.f) continue;
+	auto& matrices = UpdateCamera(activeCameras[i], rect.z / rect.w);
+	auto& frame = *reinterpret_cast<FrameBlock*>(
+	    blockAt(frameBlockOffset + i * frameBlockStride));
+	frame.viewProjection = matrices.viewProjection;
+	frame.viewPos = matrices.transform.pos;
+    }
+    LoadMaterialBlock(defaultMaterial,
+		      *reinterpret_cast<MaterialBlock*>(blockAt(
+			  materialBlockOffset)));
+    for (uint32_t entity = 0; entity < materialSlots.size(); entity++) {
+	if (materialSlots[entity] == 0) continue;
+	LoadMaterialBlock(
+	    *scene->entities[entity]->Get<Material>(ComponentTypes::MATERIAL),
+	    *reinterpret_cast<MaterialBlock*>(blockAt(
+		materialBlockOffset +
+		materialSlots[entity] * materialBlockStride)));
+    }
+
+    auto data = renderer->MapUniformBuffer(uniformBuffer, uniformData.size());
+    std::memcpy(data, uniformData.data(), uniformData.size());
+    renderer->UnMapUniformBuffer(uniformBuffer);
+    renderer->BindUniformBuffer(uniformBuffer, lightsBinding, 0,
+				sizeof(LightsBlock));
 }
 
 void RendererSystem::SetupDefaultMaterial() {
@@ -107,7 +207,7 @@ void RendererSystem::SetupDefaultTexture() {
     defaultTexture.format = Texture::RGBA;
     defaultTexture.width = defTextureWidth;
     defaultTexture.height = defTextureHeight;
-    renderer->LoadTexture(&defaultTexture, &defaultTextureGBuffer);
+    renderer->LoadTexture(&defaultTexture, &defaultTextureGBuffer, 0);
 }
 
 void RendererSystem::SetupMainShader() {
@@ -118,10 +218,13 @@ void RendererSystem::SetupMainShader() {
 
     auto assetLoader = AssetLoader::init();
 
-    assetLoader->LoadTextFile("Resource/Shaders/VertexShader.glsl",
-			      vertShader->source);
-    assetLoader->LoadTextFile("Resource/Shaders/FragmentShader.glsl",
-			      fragShader->source);
+    // Both reads are in flight together
+    auto vertSource =
+	assetLoader->LoadTextFileAsync("Resource/Shaders/VertexShader.glsl");
+    auto fragSource =
+	assetLoader->LoadTextFileAsync("Resource/Shaders/FragmentShader.glsl");
+    vertShader->source = vertSource.get();
+    fragShader->source = fragSource.get();
 
     mainShaderStage->shaderHandler.push_back(std::move(vertShader));
     mainShaderStage->shaderHandler.push_back(std::move(fragShader));
@@ -160,7 +263,8 @@ void RendererSystem::CreateGBufferMesh(Mesh* mesh, GBuffer* indexBuffer,
     vertexBuffer->bufferStyle.type = GBuffer::GBufferStyle::BufferType::VERTEX;
     vertexBuffer->bufferStyle.usage = GBuffer::GBufferStyle::Usage::DRAW;
     vertexBuffer->count = mesh->vertexCount;
-    vertexBuffer->sizet = mesh->vertexCount * sizeof(Vertex);
+    vertexBuffer->sizet =
+	mesh->vertexCount * GetVertexSize(mesh->vertexFormat);
     vertexBuffer->data = mesh->verticiesIndex;
 }
 
@@ -169,7 +273,7 @@ void RendererSystem::CreateRendererStuff(Mesh* mesh,
     if (rendererStuff == nullptr) rendererStuff = new RendererStuff;
     CreateGBufferMesh(mesh, &rendererStuff->iBuffer, &rendererStuff->vBuffer);
     renderer->LoadBuffer(&rendererStuff->vBuffer);
-    renderer->SetLayout(layout);
+    renderer->SetLayout(vertexLayouts[(uint32_t)mesh->vertexFormat]);
     renderer->LoadBuffer(&rendererStuff->iBuffer);
 }
 
@@ -187,7 +291,8 @@ void RendererSystem::LoadScene(Scene* scene) {
 	Scene::IComponentArray* componentArray;
 	componentArray = i.get();
 	auto mesh = componentArray->Get<Mesh>(ComponentTypes::MESH);
-	if (mesh != nullptr) {
+	// Meshes still loading are uploaded once they arrive
+	if (mesh != nullptr && mesh->vertexCount != 0) {
 	    if (componentArray->Get<RendererStuff>(
 		    ComponentTypes::RENDERERSTUFF) == nullptr) {
 		CreateRendererStuff(mesh,
@@ -210,131 +315,322 @@ void RendererSystem::LoadScene(Scene* scene) {
     }
 }
 
-Mat RendererSystem::SetupCamera(uint32_t entity) {
-    auto scene = GetScene();
-    auto transform =
-	scene->GetEntity(entity)->Get<Transform>(ComponentTypes::TRANSFORM);
-    auto camera = scene->GetEntity(entity)->Get<Camera>(ComponentTypes::CAMERA);
-    auto perspectiveMat = SetupPerspective(*camera);
+static bool SameCamera(const CameraMatrices& matrices,
+		       const Transform& transform, const Camera& camera,
+		       float aspectRatio) {
+    return matrices.built && matrices.transform.pos == transform.pos &&
+	   matrices.transform.rotation == transform.rotation &&
+	   matrices.camera.fov == camera.fov &&
+	   matrices.camera.near == camera.near &&
+	   matrices.camera.far == camera.far &&
+	   matrices.camera.lookAt == camera.lookAt &&
+	   matrices.aspectRatio == aspectRatio;
+}
+
+// The entity's CameraMatrices, rebuilt only when its transform, its
+// Camera or the aspect ratio changed since the last frame
+const CameraMatrices& RendererSystem::UpdateCamera(uint32_t entity,
+						   float aspectRatio) {
+    auto components = GetScene()->GetEntity(entity);
+    auto transform = components->Get<Transform>(ComponentTypes::TRANSFORM);
+    auto camera = components->Get<Camera>(ComponentTypes::CAMERA);
+    auto matrices =
+	components->Get<CameraMatrices>(ComponentTypes::CAMERAMATRICES);
+    if (matrices == nullptr)
+	matrices = components->Emplace<CameraMatrices>(
+	    ComponentTypes::CAMERAMATRICES);
+    if (SameCamera(*matrices, *transform, *camera, aspectRatio))
+	return *matrices;
+
+    matrices->projection = GetPerspectiveMatrix(camera->fov, aspectRatio,
+						camera->near, camera->far);
     auto lookAt = camera->lookAt;
     if (transform->rotation.x != 0.f) {
 	lookAt =
-	    DefaultMatrix::generateRollMatrix({3, 3}, transform->rotation.x) *
-	    lookAt;
+	    DefaultMatrix::generateRollMatrix<3>(transform->rotation.x) * lookAt;
     }
     if (transform->rotation.y != 0.f) {
-	lookAt =
-	    DefaultMatrix::generatePitchMatrix({3, 3}, transform->rotation.y) *
-	    lookAt;
+	lookAt = DefaultMatrix::generatePitchMatrix<3>(transform->rotation.y) *
+		 lookAt;
     }
     if (transform->rotation.z != 0.f) {
 	lookAt =
-	    DefaultMatrix::generateYawMatrix({3, 3}, transform->rotation.z) *
-	    lookAt;
+	    DefaultMatrix::generateYawMatrix<3>(transform->rotation.z) * lookAt;
     }
     lookAt.normalize();
-    auto tmp = transform->pos + lookAt;
-    renderer->Uniform3f(1, &transform->pos, "viewPos");
-    return LookAt(transform->pos, tmp, Vect3(0, 1, 0)) * perspectiveMat;
-}
-
-Mat RendererSystem::LookAt(const Vect3& eye, const Vect3& at, const Vect3& up) {
-    auto zaxis = at - eye;
-    zaxis.normalize();
-    auto xaxis = (Vect3::cross(zaxis, up)).normalized();
-    auto yaxis = Vect3::cross(xaxis, zaxis).normalized();
-    Mat mat({4, 4});
-    mat = {xaxis.x,
-	   yaxis.x,
-	   -zaxis.x,
-	   0,
-	   xaxis.y,
-	   yaxis.y,
-	   -zaxis.y,
-	   0,
-	   xaxis.z,
-	   yaxis.z,
-	   -zaxis.z,
-	   0,
-	   -Vect3::dot(xaxis, eye),
-	   -Vect3::dot(yaxis, eye),
-	   Vect3::dot(zaxis, eye),
-	   1};
-    return mat;
-}
-
-Mat RendererSystem::SetupPerspective(Camera& camera) {
-    Mat mat({4, 4});
-    auto camFov = 1 / tan(camera.fov / 2);
-    mat.Get(0, 0) = camFov * 1 / settings->GetAspectRatio();
-    mat.Get(1, 1) = camFov;
-    mat.Get(2, 2) = -(camera.far + camera.near) / (camera.far - camera.near);
-    mat.Get(3, 2) = (2 * camera.far * camera.near) / (camera.far - camera.near);
-    mat.Get(2, 3) = 1;
-    return mat;
+    matrices->view = GetLookAtMatrix(transform->pos, transform->pos + lookAt,
+				     Vect3(0, 1, 0));
+    matrices->viewProjection = matrices->view * matrices->projection;
+    if (!Mat4Kernels::Inverse(matrices->viewProjection,
+			      matrices->inverseViewProjection))
+	matrices->inverseViewProjection =
+	    DefaultMatrix::generateIdentityMatrix<4>();
+    matrices->transform = *transform;
+    matrices->camera = *camera;
+    matrices->aspectRatio = aspectRatio;
+    matrices->built = true;
+    return *matrices;
+}
+
+// The cameras with a Viewport in their order, or the main camera alone
+void RendererSystem::FindCameras() {
+    activeCameras.clear();
+    for (uint32_t entity = 0; entity < scene->entities.size(); entity++) {
+	auto& components = scene->entities[entity];
+	if (components != nullptr &&
+	    components->Get(ComponentTypes::CAMERA) != nullptr &&
+	    components->Get(ComponentTypes::VIEWPORT) != nullptr)
+	    activeCameras.push_back(entity);
+    }
+    auto order = [this](uint32_t entity) {
+	return scene->entities[entity]
+	    ->Get<Viewport>(ComponentTypes::VIEWPORT)
+	    ->order;
+    };
+    std::stable_sort(
+	activeCameras.begin(), activeCameras.end(),
+	[&](uint32_t a, uint32_t b) { return order(a) < order(b); });
+    if (activeCameras.empty()) activeCameras.push_back(mainCamera);
+}
+
+// The camera's viewport in pixels, x and y of its corner then its size
+Vect4 RendererSystem::GetViewportRect(uint32_t entity) {
+    auto viewport =
+	GetScene()->GetEntity(entity)->Get<Viewport>(ComponentTypes::VIEWPORT);
+    Vect2 offset, size(1.f, 1.f);
+    if (viewport != nullptr) {
+	offset = viewport->offset;
+	size = viewport->size;
+    }
+    auto& resolution = settings->resolution;
+    return Vect4(resolution.x * offset.x, resolution.y * offset.y,
+		 resolution.x * size.x, resolution.y * size.y);
+}
+
+// Draws every mesh through the index-th active camera, false if its
+// viewport is empty. The first camera drawn composes the world matrices
+// along with its MVPs.
+bool RendererSystem::DrawCamera(uint32_t index, bool first) {
+    auto entity = activeCameras[index];
+    auto rect = GetViewportRect(entity);
+    if (rect.z < 1.f || rect.w < 1.f) return false;
+    renderer->Viewport(rect.x, rect.y, rect.z, rect.w);
+
+    auto& matrices = UpdateCamera(entity, rect.z / rect.w);
+    if (first)
+	UpdateTransforms(matrices.viewProjection);
+    else
+	UpdateMVPs(matrices.viewProjection);
+    currentCamera = entity;
+    currentViewportHeight = rect.w;
+    renderer->BindUniformBuffer(uniformBuffer, frameBinding,
+				frameBlockOffset + index * frameBlockStride,
+				sizeof(FrameBlock));
+    for (auto itr = scene->entities.begin(); itr != scene->entities.end();
+	 itr++) {
+	LoadMesh(itr);
+    }
+    return true;
 }
 
 void RendererSystem::LoadMaterial(Scene::Entities::iterator& itr) {
-    auto material = (*itr)->Get<Material>(ComponentTypes::MATERIAL);
-    if (material == nullptr) {
-	material = &defaultMaterial;
+    uint32_t dist = std::distance(scene->entities.begin(), itr);
+    // Entities added since the blocks were written use the default
+    uint32_t slot = dist < materialSlots.size() ? materialSlots[dist] : 0;
+    renderer->BindUniformBuffer(uniformBuffer, materialBinding,
+				materialBlockOffset + slot * materialBlockStride,
+				sizeof(MaterialBlock));
+}
+
+// Composes every mesh's world and MVP matrix in one batch ahead of the draws
+void RendererSystem::UpdateTransforms(const Mat4& viewProjection) {
+    transformBuffer.Clear();
+    orientedTransformBuffer.Clear();
+    orientedEntities.clear();
+    transformSlots.assign(scene->entities.size(), noTransformSlot);
+    for (uint32_t entity = 0; entity < scene->entities.size(); entity++) {
+	auto& components = scene->entities[entity];
+	if (components == nullptr ||
+	    components->Get(ComponentTypes::MESH) == nullptr)
+	    continue;
+	auto transform = components->Get<Transform>(ComponentTypes::TRANSFORM);
+	if (transform == nullptr) {
+	    transform =
+		components->Emplace<Transform>(ComponentTypes::TRANSFORM);
+	    transform->scale = Vect3(.5f, .5f, .5f);
+	}
+	auto orientation =
+	    components->Get<Orientation>(ComponentTypes::ORIENTATION);
+	if (orientation != nullptr) {
+	    transformSlots[entity] = orientedTransformBuffer.Push(
+		transform->pos, orientation->rotation, transform->scale);
+	    orientedEntities.push_back(entity);
+	} else {
+	    transformSlots[entity] = transformBuffer.Push(
+		transform->pos, transform->rotation, transform->scale);
+	}
     }
-    LoadLightColor(material->color, "material");
-    renderer->Uniform1f(1, &material->shininess, "material.shininess");
+    uint32_t eulerCount = transformBuffer.GetSize();
+    for (auto entity : orientedEntities) transformSlots[entity] += eulerCount;
+    uint32_t count = eulerCount + orientedTransformBuffer.GetSize();
+    worldMatrices.resize(count);
+    mvpMatrices.resize(count);
+    ComposeTransformsParallel(transformBuffer.View(), eulerCount,
+			      worldMatrices.data(), &viewProjection,
+			      mvpMatrices.data());
+    ComposeTransformsParallel(orientedTransformBuffer.View(),
+			      count - eulerCount,
+			      worldMatrices.data() + eulerCount,
+			      &viewProjection, mvpMatrices.data() + eulerCount);
+}
+
+// The world matrices are the same for every camera, only the MVPs change
+void RendererSystem::UpdateMVPs(const Mat4& viewProjection) {
+    JobSystem::GetSingleton()->ParallelFor(
+	worldMatrices.size(), transformBatchGrain,
+	[&](uint32_t begin, uint32_t end) {
+	    for (uint32_t i = begin; i < end; i++)
+		mvpMatrices[i] =
+		    Mat4Kernels::Multiply(viewProjection, worldMatrices[i]);
+	});
 }
 
 void RendererSystem::LoadTransform(Scene::EntitiesItr& itr) {
-    Mat mat = cameras[mainCamera];
-    Transform* transform =
-	static_cast<Transform*>((*itr)->Get(ComponentTypes::TRANSFORM));
-    if (transform != nullptr) {
-	transform = (*itr)->Emplace<Transform>(ComponentTypes::TRANSFORM);
-	transform->scale = Vect3(.5f, .5f, .5f);
-    }
-    mat *= ConvertTranforToMatrix(*transform);
-    renderer->UniformMat(1, &mat, "MVP");
+    uint32_t dist = std::distance(scene->entities.begin(), itr);
+    renderer->UniformMat(1, &mvpMatrices[transformSlots[dist]], mvpUniform);
 }
 
 void RendererSystem::LoadMesh(Scene::EntitiesItr& itr) {
     auto mesh = (*itr)->Get<Mesh>(ComponentTypes::MESH);
-    auto dist = std::distance(scene->entities.begin(), itr);
-    if (mesh != nullptr) {
-	auto rendererCheck = meshGBuffers.find(dist);
-	if (rendererCheck == meshGBuffers.end()) {
-	    meshGBuffers.insert(std::make_pair(dist, RendererStuff()));
-	    rendererCheck = meshGBuffers.find(dist);
-	    CreateRendererStuff(mesh, &rendererCheck->second);
+    if (mesh == nullptr || mesh->vertexCount == 0) return;
+    uint32_t dist = std::distance(scene->entities.begin(), itr);
+    auto rendererCheck = meshGBuffers.find(dist);
+    if (rendererCheck == meshGBuffers.end()) {
+	// Uploads are spread over frames, the mesh is drawn once it's on the
+	// GPU
+	if (pendingMeshes.insert(dist).second) {
+	    UploadQueue::GetSingleton()->Push([this, dist]() {
+		pendingMeshes.erase(dist);
+		auto entity = GetScene()->GetEntity(dist);
+		auto mesh = entity != nullptr
+				? entity->Get<Mesh>(ComponentTypes::MESH)
+				: nullptr;
+		if (mesh == nullptr || mesh->vertexCount == 0) return;
+		CreateRendererStuff(mesh, &meshGBuffers[dist]);
+	    });
 	}
+	return;
+    }
 
-	auto& rendererStuff = rendererCheck->second;
-	renderer->Bind(rendererStuff.vBuffer);
-	auto verticies = reinterpret_cast<Vertex*>(
-	    scene->resourceBank->resources[rendererStuff.vBuffer.data].Get());
-	LoadTexture(itr);
-	LoadMaterial(itr);
-	LoadTransform(itr);
-	// renderer->WireFrameMode(true);
-	if (rendererStuff.iBuffer.sizet != 0)
-	    renderer->Draw(
-		(*itr)->Get<Mesh>(ComponentTypes::MESH)->drawPrimitive,
-		&rendererStuff.iBuffer);
-	else
-	    renderer->DrawArrays(
-		(*itr)->Get<Mesh>(ComponentTypes::MESH)->drawPrimitive,
-		&rendererStuff.vBuffer, rendererStuff.vBuffer.count);
+    auto& rendererStuff = rendererCheck->second;
+    renderer->Bind(rendererStuff.vBuffer);
+    LoadVertexFormat(*mesh);
+    LoadTexture(itr);
+    LoadMaterial(itr);
+    LoadTransform(itr);
+    // renderer->WireFrameMode(true);
+    if (rendererStuff.iBuffer.sizet != 0 && mesh->lodCount > 1) {
+	auto& lod = mesh->lods[SelectLod(*mesh, dist)];
+	renderer->DrawRange(mesh->drawPrimitive, &rendererStuff.iBuffer,
+			    lod.indexOffset, lod.indexCount);
+    } else if (rendererStuff.iBuffer.sizet != 0)
+	renderer->Draw(mesh->drawPrimitive, &rendererStuff.iBuffer);
+    else
+	renderer->DrawArrays(mesh->drawPrimitive, &rendererStuff.vBuffer,
+			     rendererStuff.vBuffer.count);
+}
+
+// The coarsest level whose error, scaled by the bounding sphere's projected
+// radius, stays under maxLodPixelError
+uint32_t RendererSystem::SelectLod(const Mesh& mesh, uint32_t entity) {
+    auto cameraEntity = GetScene()->GetEntity(currentCamera);
+    auto cameraTransform =
+	cameraEntity->Get<Transform>(ComponentTypes::TRANSFORM);
+    auto camera = cameraEntity->Get<Camera>(ComponentTypes::CAMERA);
+    Vect4 center(mesh.boundsCenter.x, mesh.boundsCenter.y,
+		 mesh.boundsCenter.z, 1.f);
+    auto scale = GetScene()
+		     ->GetEntity(entity)
+		     ->Get<Transform>(ComponentTypes::TRANSFORM)
+		     ->scale;
+    center = worldMatrices[transformSlots[entity]] * center;
+    float radius =
+	mesh.boundsRadius * std::max({std::fabs(scale.x), std::fabs(scale.y),
+				      std::fabs(scale.z)});
+    auto toCenter = Vect3(center.x, center.y, center.z) - cameraTransform->pos;
+    float distance = std::sqrt(Vect3::dot(toCenter, toCenter));
+    float tanHalfFov = std::tan(camera->fov / 2);
+    if (distance <= radius || tanHalfFov <= 0.f) return 0;
+    float projectedRadius =
+	radius / (distance * tanHalfFov) * currentViewportHeight * .5f;
+    for (uint32_t lod = mesh.lodCount - 1; lod > 0; lod--) {
+	if (mesh.lods[lod].error * projectedRadius <= maxLodPixelError)
+	    return lod;
     }
+    return 0;
+}
+
+void RendererSystem::LoadVertexFormat(const Mesh& mesh) {
+    renderer->SetLayout(vertexLayouts[(uint32_t)mesh.vertexFormat]);
+    Vect3 scale(1.f, 1.f, 1.f), offset;
+    if (HasQuantizedPosition(mesh.vertexFormat)) {
+	scale = mesh.positionScale;
+	offset = mesh.positionOffset;
+    }
+    int32_t octahedralNormal = HasOctahedralNormal(mesh.vertexFormat);
+    renderer->Uniform3f(1, &scale, positionScaleUniform);
+    renderer->Uniform3f(1, &offset, positionOffsetUniform);
+    renderer->Uniform1i(1, &octahedralNormal, octahedralNormalUniform);
 }
 
 void RendererSystem::LoadTexture(Scene::EntitiesItr& itr) {
-    if ((*itr)->Get(ComponentTypes::TEXTURE) != nullptr) {
-	renderer->Bind(
-	    textureGBuffer.find(std::distance(scene->entities.begin(), itr))
-		->second);
-    } else {
-	renderer->Bind(defaultTextureGBuffer);
+    auto texture = (*itr)->Get<Texture>(ComponentTypes::TEXTURE);
+    uint32_t dist = std::distance(scene->entities.begin(), itr);
+    auto textureCheck = textureGBuffer.find(dist);
+    if (textureCheck != textureGBuffer.end()) {
+	renderer->Bind(textureCheck->second);
+	return;
+    }
+    // The default texture stands in while the entity's one is loading
+    renderer->Bind(defaultTextureGBuffer);
+    if (texture == nullptr || texture->width == 0) return;
+    if (pendingTextures.insert(dist).second) {
+	UploadQueue::GetSingleton()->Push([this, dist]() {
+	    pendingTextures.erase(dist);
+	    auto entity = GetScene()->GetEntity(dist);
+	    auto texture = entity != nullptr
+			       ? entity->Get<Texture>(ComponentTypes::TEXTURE)
+			       : nullptr;
+	    if (texture == nullptr || texture->width == 0) return;
+	    uint32_t level = std::max(texture->mipLevels, 1u) - 1;
+	    while (level > 0 &&
+		   std::max(GetMipWidth(*texture, level - 1),
+			    GetMipHeight(*texture, level - 1)) <=
+		       firstTextureLevelSize)
+		level--;
+	    renderer->LoadTexture(texture, &textureGBuffer[dist], level);
+	    if (level > 0) UploadTextureLevel(dist, texture->data, level - 1);
+	});
     }
 }
 
+void RendererSystem::UploadTextureLevel(uint32_t entity, uint32_t data,
+					uint32_t level) {
+    UploadQueue::GetSingleton()->Push([this, entity, data, level]() {
+	auto components = GetScene()->GetEntity(entity);
+	auto texture = components != nullptr
+			   ? components->Get<Texture>(ComponentTypes::TEXTURE)
+			   : nullptr;
+	auto gBuffer = textureGBuffer.find(entity);
+	// Stop streaming once the entity's texture has been swapped
+	if (texture == nullptr || texture->data != data ||
+	    gBuffer == textureGBuffer.end())
+	    return;
+	renderer->LoadTextureLevel(texture, &gBuffer->second, level);
+	if (level > 0) UploadTextureLevel(entity, data, level - 1);
+    });
+}
+
 void RendererSystem::ScanLights() {
     lights.clear();
     for (auto itr = scene->entities.begin(); itr != scene->entities.end();
@@ -370,12 +666,12 @@ void RendererSystem::Update(float deltaTime) {
     renderer->Enable(Options::BLEND);
     renderer->Enable(Options::DEPTH_TEST);
     renderer->Enable(Options::FACE_CULL);
-    cameras[mainCamera] = SetupCamera(mainCamera);
     ProcessMessages();
-    LoadLights();
-    for (auto itr = scene->entities.begin(); itr != scene->entities.end();
-	 itr++) {
-	LoadMesh(itr);
-    }
+    FindCameras();
+    WriteUniformBlocks();
+    bool composed = false;
+    for (uint32_t i = 0; i < activeCameras.size(); i++)
+	if (DrawCamera(i, !composed)) composed = true;
+    renderer->Viewport(0, 0, settings->resolution.x, settings->resolution.y);
     animated += .01f;
 }
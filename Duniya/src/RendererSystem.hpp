@@ -2,13 +2,78 @@
 #include <ECS/CommonComponent.hpp>
 #include <ECS/GraphicsComponent.hpp>
 #include <Graphics/Renderer.hpp>
+#include <Math/Projection.hpp>
+#include <Math/TransformBatch.hpp>
 #include <unordered_map>
+#include <unordered_set>
 
 struct RendererStuff {
     GBuffer iBuffer;
     GBuffer vBuffer;
 };
 
+// Array sizes in FragmentShader.glsl
+constexpr uint32_t maxPointLights = 75;
+constexpr uint32_t maxDirLights = 75;
+
+// std140 mirrors of the uniform blocks in FragmentShader.glsl. vec3s, structs
+// and array elements start on 16 bytes.
+struct LightColorBlock {
+    Vect3 ambient;
+    float padding0;
+    Vect3 diffuse;
+    float padding1;
+    Vect3 specular;
+    float padding2;
+};
+
+struct DirLightBlock {
+    LightColorBlock lightColor;
+    Vect3 direction;
+    float padding;
+};
+
+struct PointLightBlock {
+    Vect3 pos;
+    float constant;
+    float linear;
+    float quadratic;
+    float padding[2];
+    LightColorBlock lightColor;
+};
+
+struct LightsBlock {
+    DirLightBlock dirLights[maxDirLights];
+    PointLightBlock pointLights[maxPointLights];
+    uint32_t numDirLights;
+    uint32_t numPointLights;
+};
+
+struct FrameBlock {
+    // Copied as is, like the MVP uniform that's uploaded untransposed. The
+    // block is column major in the shaders, so GLSL reads Mat4's rows as
+    // columns and viewProjection * p there is p * viewProjection here.
+    Mat4 viewProjection;
+    Vect3 viewPos;
+    float padding;
+};
+
+struct MaterialBlock {
+    Vect3 ambient;
+    float padding0;
+    Vect3 diffuse;
+    float padding1;
+    Vect3 specular;
+    float shininess;
+};
+
+static_assert(sizeof(LightColorBlock) == 48 && sizeof(DirLightBlock) == 64 &&
+		  sizeof(PointLightBlock) == 80 &&
+		  sizeof(LightsBlock) ==
+		      maxDirLights * 64 + maxPointLights * 80 + 8 &&
+		  sizeof(FrameBlock) == 80 && sizeof(MaterialBlock) == 48,
+	      "uniform blocks don't match the std140 layout");
+
 class RendererSystem : public System {
     enum class MessageID : uint32_t { SCANLIGTHS = 0 };
 
@@ -26,7 +91,22 @@ class RendererSystem : public System {
    private:
     std::unordered_map<uint32_t, RendererStuff> meshGBuffers;
     std::unordered_map<uint32_t, GBuffer> textureGBuffer;
-    std::unordered_map<uint32_t, Mat> cameras;
+    // Entities whose GPU buffers are waiting in the UploadQueue
+    std::unordered_set<uint32_t> pendingMeshes;
+    std::unordered_set<uint32_t> pendingTextures;
+    // The cameras drawn this frame, see Viewport
+    std::vector<uint32_t> activeCameras;
+    uint32_t currentCamera;
+    float currentViewportHeight;
+    // Rebuilt every frame for the entities with a mesh, transformSlots maps
+    // an entity to its matrices. The ones with an Orientation go to their
+    // own buffer and their matrices follow the others'.
+    TransformBuffer transformBuffer;
+    TransformBuffer orientedTransformBuffer;
+    std::vector<uint32_t> orientedEntities;
+    std::vector<Mat4> worldMatrices;
+    std::vector<Mat4> mvpMatrices;
+    std::vector<uint32_t> transformSlots;
 
    private:
     void ProcessMessages();
@@ -34,9 +114,14 @@ class RendererSystem : public System {
     void LoadMaterial(Scene::EntitiesItr& itr);
     void LoadMesh(Scene::EntitiesItr& itr);
     void LoadTexture(Scene::EntitiesItr& itr);
-    void LoadLights();
-    void LoadLightColor(const LightColor& color, std::string name);
+    void UploadTextureLevel(uint32_t entity, uint32_t data, uint32_t level);
+    void LoadLights(LightsBlock& block);
+    void WriteUniformBlocks();
+    void UpdateTransforms(const Mat4& viewProjection);
+    void UpdateMVPs(const Mat4& viewProjection);
     void LoadTransform(Scene::Entities::iterator& itr);
+    void LoadVertexFormat(const Mesh& mesh);
+    uint32_t SelectLod(const Mesh& mesh, uint32_t entity);
     void LoadBuffer(GBuffer* buffer);
     void CreateRendererStuff(Mesh* mesh, RendererStuff* rendererStuff);
 
@@ -44,12 +129,14 @@ class RendererSystem : public System {
     void SetupDefaultTexture();
     void SetupMainShader();
     void SetupDefaultCamera();
+    void SetupUniformBlocks();
 
     void ScanLights();
 
-    Mat LookAt(const Vect3& pos, const Vect3& dir, const Vect3& up);
-    Mat SetupPerspective(Camera& camera);
-    Mat SetupCamera(uint32_t entity);
+    void FindCameras();
+    const CameraMatrices& UpdateCamera(uint32_t entity, float aspectRatio);
+    Vect4 GetViewportRect(uint32_t entity);
+    bool DrawCamera(uint32_t index, bool first);
 
     Scene* GetScene();
 
@@ -66,8 +153,20 @@ class RendererSystem : public System {
     GBuffer defaultTextureGBuffer;
     Material defaultMaterial;
     //
-    uint32_t layout;
+    // Renderer layout of every VertexFormat
+    std::vector<uint32_t> vertexLayouts;
     Scene::IComponentArray* camera;
     std::vector<uint32_t> lights;
+    // The lights, a FrameBlock per active camera and a MaterialBlock per
+    // material, uploaded together once a frame. The draws bind their
+    // ranges.
+    uint32_t uniformBuffer;
+    std::vector<uint8_t> uniformData;
+    uint32_t frameBlockOffset;
+    uint32_t frameBlockStride;
+    uint32_t materialBlockOffset;
+    uint32_t materialBlockStride;
+    // An entity's MaterialBlock, 0 is the default material
+    std::vector<uint32_t> materialSlots;
     std::unique_ptr<ShaderStageHandler> mainShaderStage;
 };
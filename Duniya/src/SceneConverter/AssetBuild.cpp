@@ -0,0 +1,132 @@
+#include "AssetBuild.hpp"
+
+#include <Exception.hpp>
+#include <MappedFile.hpp>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+static uint64_t Fnv1a(const void* data, uint64_t size,
+		      uint64_t hash = 0xcbf29ce484222325ull) {
+    auto bytes = (const uint8_t*)data;
+    for (uint64_t i = 0; i < size; i++) {
+	hash ^= bytes[i];
+	hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static std::string Trim(const std::string& text) {
+    auto begin = text.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) return "";
+    auto end = text.find_last_not_of(" \t\r");
+    return text.substr(begin, end - begin + 1);
+}
+
+static bool FileExists(const std::string& filePath) {
+    return std::ifstream(filePath).good();
+}
+
+// Throws when a dependency can't be read
+static uint64_t HashDependencies(const std::vector<std::string>& files) {
+    uint64_t hash = Fnv1a(&converterVersion, sizeof(converterVersion));
+    for (auto& file : files) {
+	MappedFile contents(file);
+	uint64_t contentHash = Fnv1a(contents.GetData(), contents.GetSize());
+	hash = Fnv1a(file.data(), file.size(), hash);
+	hash = Fnv1a(&contentHash, sizeof(contentHash), hash);
+    }
+    return hash;
+}
+
+std::vector<AssetBuildItem> ReadManifest(const std::string& filePath) {
+    std::ifstream fin(filePath);
+    if (!fin.is_open())
+	throw CException(__LINE__, __FILE__, "Manifest Exception",
+			 "Couldn't open " + filePath);
+    auto directory = filePath.substr(0, filePath.find_last_of("/\\") + 1);
+    auto resolve = [&](const std::string& path) {
+	return path.empty() || path[0] == '/' ? path : directory + path;
+    };
+    std::vector<AssetBuildItem> items;
+    std::string line;
+    for (uint32_t lineNo = 1; std::getline(fin, line); lineNo++) {
+	line = Trim(line);
+	if (line.empty() || line[0] == '#') continue;
+	auto arrow = line.find("->");
+	if (arrow == std::string::npos)
+	    throw CException(__LINE__, __FILE__, "Manifest Exception",
+			     filePath + ":" + std::to_string(lineNo) +
+				 " isn't of the form <input> -> <output>");
+	AssetBuildItem item;
+	item.input = resolve(Trim(line.substr(0, arrow)));
+	item.output = resolve(Trim(line.substr(arrow + 2)));
+	items.push_back(std::move(item));
+    }
+    return items;
+}
+
+bool IsUpToDate(AssetBuildItem& item) {
+    std::ifstream stamp(item.output + ".stamp");
+    if (!stamp.is_open() || !FileExists(item.output)) return false;
+    uint64_t hash = 0;
+    stamp >> std::hex >> hash;
+    stamp.ignore(1);
+    std::vector<std::string> dependencies;
+    std::string line;
+    while (std::getline(stamp, line))
+	if (!line.empty()) dependencies.push_back(line);
+    if (dependencies.empty() || dependencies[0] != item.input) return false;
+    try {
+	if (HashDependencies(dependencies) != hash) return false;
+    } catch (const CException&) {
+	return false;
+    }
+    item.dependencies = std::move(dependencies);
+    return true;
+}
+
+void WriteStamp(const AssetBuildItem& item) {
+    auto stampPath = item.output + ".stamp";
+    std::ofstream fout(stampPath);
+    if (!fout.is_open())
+	throw CException(__LINE__, __FILE__, "File Exception",
+			 "Couldn't create " + stampPath);
+    fout << std::hex << HashDependencies(item.dependencies) << "\n";
+    for (auto& dependency : item.dependencies) fout << dependency << "\n";
+}
+
+// Spaces, # and $ would end or change a path in the rule
+static std::string EscapeDepfilePath(const std::string& path) {
+    std::string escaped;
+    for (char c : path) {
+	if (c == ' ' || c == '#' || c == '\\') escaped += '\\';
+	if (c == '$') escaped += '$';
+	escaped += c;
+    }
+    return escaped;
+}
+
+void WriteDepfile(const std::string& filePath,
+		  const std::vector<AssetBuildItem>& items) {
+    std::ostringstream rules;
+    for (auto& item : items) {
+	if (item.dependencies.empty()) continue;
+	rules << EscapeDepfilePath(item.output) << ":";
+	for (auto& dependency : item.dependencies)
+	    rules << " \\\n  " << EscapeDepfilePath(dependency);
+	rules << "\n";
+    }
+    // Written aside and renamed so a build tool never sees half of it
+    auto tempPath = filePath + ".tmp";
+    {
+	std::ofstream fout(tempPath);
+	if (!fout.is_open())
+	    throw CException(__LINE__, __FILE__, "File Exception",
+			     "Couldn't create " + tempPath);
+	fout << rules.str();
+    }
+    if (std::rename(tempPath.c_str(), filePath.c_str()) != 0)
+	throw CException(__LINE__, __FILE__, "File Exception",
+			 "Couldn't write " + filePath);
+}
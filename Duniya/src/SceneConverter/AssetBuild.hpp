@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Bump whenever the converter writes something different for the same
+// input, every output gets rebuilt on the next run
+constexpr uint32_t converterVersion = 1;
+
+// One conversion of a manifest
+struct AssetBuildItem {
+    std::string input;
+    std::string output;
+    // Files the output was built from, the input first
+    std::vector<std::string> dependencies;
+};
+
+// A manifest lists one "<input> -> <output>" per line, relative paths are
+// relative to the manifest. Empty lines and lines starting with # are
+// skipped.
+std::vector<AssetBuildItem> ReadManifest(const std::string& filePath);
+
+// Every output has a <output>.stamp next to it holding the hash of the
+// converter version and of its dependencies' contents, followed by their
+// paths. An output is up to date as long as its stamp still matches.
+bool IsUpToDate(AssetBuildItem& item);
+void WriteStamp(const AssetBuildItem& item);
+
+// Make style rules of every output on its dependencies
+void WriteDepfile(const std::string& filePath,
+		  const std::vector<AssetBuildItem>& items);
@@ -0,0 +1,113 @@
+#include <JobSystem.hpp>
+#include <SceneConverter/AssetBuild.hpp>
+#include <SceneConverter/SceneConverter.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static void PrintUsage(const char* program) {
+    std::cerr << "usage: " << program << " <input> <output>\n"
+	      << "       " << program
+	      << " --manifest <file> [--depfile <file>] [--jobs <count>]"
+		 " [--force]"
+	      << std::endl;
+}
+
+// Converts the item and stamps it, false if it failed
+static bool Convert(AssetBuildItem& item) {
+    try {
+	SceneConverter converter;
+	converter.Import(item.input, item.output);
+	item.dependencies = converter.GetDependencies();
+	WriteStamp(item);
+	return true;
+    } catch (const std::exception& exception) {
+	std::cerr << item.input << ": " << exception.what() << std::endl;
+	return false;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string manifestPath, depfilePath;
+    uint32_t jobs = 0;
+    bool force = false;
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; i++) {
+	std::string argument = argv[i];
+	bool hasValue = i + 1 < argc;
+	if (argument == "--manifest" && hasValue) {
+	    manifestPath = argv[++i];
+	} else if (argument == "--depfile" && hasValue) {
+	    depfilePath = argv[++i];
+	} else if (argument == "--jobs" && hasValue) {
+	    jobs = std::strtoul(argv[++i], nullptr, 10);
+	} else if (argument == "--force") {
+	    force = true;
+	} else if (argument.rfind("--", 0) == 0) {
+	    PrintUsage(argv[0]);
+	    return -1;
+	} else {
+	    positional.push_back(argument);
+	}
+    }
+
+    std::vector<AssetBuildItem> items;
+    try {
+	if (!manifestPath.empty() && positional.empty()) {
+	    items = ReadManifest(manifestPath);
+	} else if (manifestPath.empty() && positional.size() == 2) {
+	    items.push_back({positional[0], positional[1], {}});
+	} else {
+	    PrintUsage(argv[0]);
+	    return -1;
+	}
+    } catch (const std::exception& exception) {
+	std::cerr << exception.what() << std::endl;
+	return -1;
+    }
+
+    // The calling thread works through the queue too, so --jobs counts it
+    // and --jobs 1 converts on it alone. No --jobs uses every core.
+    JobSystem::init(jobs != 0 ? jobs - 1 : JobSystem::defaultWorkerCount);
+    auto timerStart = std::chrono::steady_clock::now();
+    std::atomic<uint32_t> converted(0), failed(0);
+    std::vector<std::future<void>> conversions;
+    for (auto& item : items) {
+	if (!force && IsUpToDate(item)) continue;
+	conversions.push_back(JobSystem::GetSingleton()->Push([&item, &converted,
+								 &failed]() {
+	    if (Convert(item))
+		converted++;
+	    else
+		failed++;
+	}));
+    }
+    for (auto& conversion : conversions) {
+	while (conversion.wait_for(std::chrono::seconds(0)) !=
+	       std::future_status::ready) {
+	    if (!JobSystem::GetSingleton()->RunPending())
+		std::this_thread::yield();
+	}
+    }
+    std::cout << converted << " converted, "
+	      << items.size() - conversions.size() << " up to date, "
+	      << failed << " failed in "
+	      << std::chrono::duration<float>(std::chrono::steady_clock::now() -
+					      timerStart)
+		     .count()
+	      << "s" << std::endl;
+
+    if (!depfilePath.empty()) {
+	try {
+	    WriteDepfile(depfilePath, items);
+	} catch (const std::exception& exception) {
+	    std::cerr << exception.what() << std::endl;
+	    return -1;
+	}
+    }
+    return failed == 0 ? 0 : 1;
+}
@@ -4,20 +4,25 @@
 #include <assimp/material.h>
 #include <assimp/vector3.h>
 
+#include <SDL2/SDL_image.h>
+
+#include <Exception.hpp>
+#include <Graphics/BCnCodec.hpp>
+#include <Graphics/MeshOptimizer.hpp>
+#include <Graphics/MeshSimplifier.hpp>
+#include <Graphics/MipGenerator.hpp>
+#include <Graphics/VertexFormat.hpp>
 #include <assimp/Importer.hpp>
 #include <chrono>
 #include <cstdint>
 #include <memory>
+#include <mutex>
 #include <thread>
 
 #include "ECS/GraphicsComponent.hpp"
 
-SceneConverter* SceneConverter::singleton = nullptr;
-
-SceneConverter* SceneConverter::init() {
-    singleton = new SceneConverter;
-    return singleton;
-}
+// Scene::SaveScene goes through the SerializerSystem singleton
+static std::mutex saveSceneMutex;
 
 template <typename T>
 void ConVec3(Vect3& vect3, const T& vec) {
@@ -25,54 +30,64 @@ void ConVec3(Vect3& vect3, const T& vec) {
 }
 
 void SceneConverter::Import(std::string filePath, std::string resultedPath) {
-    Scene* resultedScene = new Scene;
+    std::unique_ptr<Scene> resultedScene(new Scene);
+    scene = resultedScene.get();
+    dependencies.assign(1, filePath);
+    sourceDirectory = filePath.substr(0, filePath.find_last_of("/\\") + 1);
     Assimp::Importer importer;
     auto timerStart = std::chrono::system_clock::now();
     uint32_t assimpFlag = aiProcess_GenSmoothNormals |
 			  aiProcess_CalcTangentSpace | aiProcess_Triangulate |
 			  aiProcess_JoinIdenticalVertices;
-    const aiScene* scene = importer.ReadFile(filePath.c_str(), assimpFlag);
+    const aiScene* queryScene =
+	importer.ReadFile(filePath.c_str(), assimpFlag);
+    if (queryScene == nullptr)
+	throw CException(__LINE__, __FILE__, "Import Exception",
+			 "Couldn't import " + filePath + ": " +
+			     importer.GetErrorString());
     auto timerEnd = std::chrono::system_clock::now();
-    std::cout << "Time Taken importing: "
+    std::cout << filePath << ": imported in "
 	      << static_cast<std::chrono::duration<float>>(timerEnd -
 							   timerStart)
 		     .count()
-	      << std::endl;
-    if (scene->HasMeshes()) {
+	      << "s" << std::endl;
+    if (queryScene->HasMeshes()) {
 	resultedScene->componentTypeMap.insert(std::make_pair(
 	    std::type_index(typeid(Mesh)), ComponentTypes::MESH));
     }
-    if (scene->HasMaterials()) {
+    if (queryScene->HasMaterials()) {
 	resultedScene->componentTypeMap.insert(std::make_pair(
 	    std::type_index(typeid(Material)), ComponentTypes::MATERIAL));
     }
-    if (scene->HasTextures()) {
+    // Diffuse textures come with the materials when they aren't embedded
+    if (queryScene->HasTextures() || queryScene->HasMaterials()) {
 	resultedScene->componentTypeMap.insert(std::make_pair(
 	    std::type_index(typeid(Texture)), ComponentTypes::TEXTURE));
     }
-    if (scene->HasLights()) {
+    if (queryScene->HasLights()) {
 	resultedScene->componentTypeMap.insert(std::make_pair(
 	    std::type_index(typeid(PointLight)), ComponentTypes::POINTLIGHT));
 	resultedScene->componentTypeMap.insert(
 	    std::make_pair(std::type_index(typeid(DirectionalLight)),
 			   ComponentTypes::DIRLIGHT));
     }
-    if (scene->HasCameras())
+    if (queryScene->HasCameras())
 	resultedScene->componentTypeMap.insert(std::make_pair(
 	    std::type_index(typeid(Camera)), ComponentTypes::CAMERA));
 
-    ProcessNodes(scene->mRootNode, scene);
+    ProcessNodes(queryScene->mRootNode, queryScene);
+    if (queryScene->HasLights()) ProcessLight(queryScene);
 
-    for (auto& i : resultedScene->entities) {
-	for (auto& j : i.get()->components) {
-	    if (j.first == ComponentTypes::MESH) {
-		Mesh* mesh =
-		    reinterpret_cast<Mesh*>(j.second.base->GetPointer());
-	    }
-	}
+    {
+	std::lock_guard<std::mutex> lock(saveSceneMutex);
+	resultedScene->SaveScene(resultedPath);
     }
-    resultedScene->SaveScene(resultedPath);
     importer.FreeScene();
+    scene = nullptr;
+}
+
+const std::vector<std::string>& SceneConverter::GetDependencies() const {
+    return dependencies;
 }
 
 void SceneConverter::ProcessLightColor(const aiLight* light,
@@ -87,12 +102,9 @@ void SceneConverter::ProcessMeshes(aiMesh* mesh, const aiScene* queryScene,
     Mesh* resultedMesh = (Mesh*)scene->entities[entity]
 			     ->components[ComponentTypes::MESH]
 			     .emplace(new ComponentPtr::Impl<Mesh>);
-    resultedMesh->verticiesIndex = scene->resourceBank->Push_Back(
-	reinterpret_cast<uint8_t*>(new Vertex[mesh->mNumVertices]),
-	sizeof(Vertex) * mesh->mNumVertices);
+    *resultedMesh = Mesh();
     resultedMesh->vertexCount = mesh->mNumVertices;
-    auto verticies = reinterpret_cast<Vertex*>(
-	scene->resourceBank->resources[resultedMesh->verticiesIndex].Get());
+    std::vector<Vertex> verticies(mesh->mNumVertices);
     for (uint32_t i = 0; i < mesh->mNumVertices; i++) {
 	Vertex vertex;
 	vertex.aPos.x = mesh->mVertices[i].x;
@@ -100,33 +112,145 @@ void SceneConverter::ProcessMeshes(aiMesh* mesh, const aiScene* queryScene,
 	vertex.aPos.z = mesh->mVertices[i].z;
 	vertex.aPos.w = 1.f;
 	vertex.aNormal = *((Vect3*)&mesh->mNormals[i]);
-	vertex.texCord = *((Vect2*)&mesh->mTextureCoords[0][i]);
+	vertex.texCord = mesh->HasTextureCoords(0)
+			     ? *((Vect2*)&mesh->mTextureCoords[0][i])
+			     : Vect2();
 	verticies[i] = vertex;
     }
     if (mesh->HasFaces()) {
 	resultedMesh->indexCount = mesh->mNumFaces * 3;
-	resultedMesh->indiciesIndex = scene->resourceBank->Push_Back(
-	    reinterpret_cast<uint8_t*>(new uint32_t[resultedMesh->indexCount]),
-	    resultedMesh->indexCount * sizeof(uint32_t));
-	auto indicies = reinterpret_cast<uint32_t*>(
-	    scene->resourceBank->resources[resultedMesh->indiciesIndex].Get());
-
+	auto indicies =
+	    std::make_shared<std::vector<uint32_t>>(resultedMesh->indexCount);
 	for (uint32_t i = 0; i < mesh->mNumFaces; i++) {
 	    aiFace* face = &mesh->mFaces[i];
 	    for (uint32_t j = 0; j < 3; j++) {
-		indicies[i * 3 + j] = face->mIndices[j];
+		(*indicies)[i * 3 + j] = face->mIndices[j];
 	    }
 	}
+	VertexCacheStatistics before, after;
+	resultedMesh->vertexCount = OptimizeMesh(
+	    verticies.data(), sizeof(Vertex), indicies->data(),
+	    resultedMesh->indexCount, resultedMesh->vertexCount, &before,
+	    &after);
+	std::cout << mesh->mName.C_Str() << ": ACMR " << before.acmr << " -> "
+		  << after.acmr << ", ATVR " << before.atvr << " -> "
+		  << after.atvr << std::endl;
+	verticies.resize(resultedMesh->vertexCount);
+	GenerateMeshLods(verticies.data(), resultedMesh->vertexCount,
+			 *indicies, *resultedMesh);
+	auto& coarsest = resultedMesh->lods[resultedMesh->lodCount - 1];
+	std::cout << mesh->mName.C_Str() << ": " << resultedMesh->lodCount
+		  << " LODs, down to " << coarsest.indexCount / 3
+		  << " triangles" << std::endl;
+	resultedMesh->indiciesIndex = scene->resourceBank->Push_Back(
+	    (uint8_t*)indicies->data(),
+	    indicies->size() * sizeof(uint32_t), indicies);
     }
+    auto format =
+	SelectVertexFormat(verticies.data(), resultedMesh->vertexCount);
+    auto encoded = std::make_shared<std::vector<uint8_t>>(
+	(size_t)GetVertexSize(format) * resultedMesh->vertexCount);
+    EncodeVertices(verticies.data(), resultedMesh->vertexCount, format,
+		   *resultedMesh, encoded->data());
+    resultedMesh->verticiesIndex = scene->resourceBank->Push_Back(
+	encoded->data(), encoded->size(), encoded);
     if (mesh->mMaterialIndex) {
 	ProcessMaterial(queryScene->mMaterials[mesh->mMaterialIndex],
 			queryScene, entity);
     }
 }
 
+// Copies the surface's pixels as tightly packed RGBA and frees it
+static bool ReadSurface(SDL_Surface* surface, std::vector<uint8_t>& pixels) {
+    if (surface == nullptr) return false;
+    SDL_Surface* converted =
+	SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+    SDL_FreeSurface(surface);
+    if (converted == nullptr) return false;
+    uint32_t rowSize = converted->w * 4;
+    pixels.resize((size_t)rowSize * converted->h);
+    SDL_LockSurface(converted);
+    for (int32_t row = 0; row < converted->h; row++)
+	memcpy(pixels.data() + (size_t)row * rowSize,
+	       (uint8_t*)converted->pixels + (size_t)row * converted->pitch,
+	       rowSize);
+    SDL_UnlockSurface(converted);
+    SDL_FreeSurface(converted);
+    return true;
+}
+
 void SceneConverter::ProcessTexture(aiTexture* texture,
 				    const aiScene* queryScene,
-				    uint32_t entity) {}
+				    uint32_t entity) {
+    std::vector<uint8_t> pixels;
+    uint32_t width = texture->mWidth, height = texture->mHeight;
+    if (height == 0) {
+	// A whole image file of mWidth bytes
+	SDL_Surface* surface = IMG_Load_RW(
+	    SDL_RWFromConstMem(texture->pcData, texture->mWidth), 1);
+	width = surface != nullptr ? surface->w : 0;
+	height = surface != nullptr ? surface->h : 0;
+	if (!ReadSurface(surface, pixels)) {
+	    std::cerr << "Can't decode embedded texture "
+		      << texture->mFilename.C_Str() << ": " << IMG_GetError()
+		      << std::endl;
+	    return;
+	}
+    } else {
+	pixels.resize((size_t)width * height * 4);
+	for (size_t i = 0; i < (size_t)width * height; i++) {
+	    const aiTexel& texel = texture->pcData[i];
+	    pixels[i * 4 + 0] = texel.r;
+	    pixels[i * 4 + 1] = texel.g;
+	    pixels[i * 4 + 2] = texel.b;
+	    pixels[i * 4 + 3] = texel.a;
+	}
+    }
+    StoreTexture(pixels, width, height, entity);
+}
+
+void SceneConverter::ProcessTextureFile(const std::string& filePath,
+					uint32_t entity) {
+    std::vector<uint8_t> pixels;
+    SDL_Surface* surface = IMG_Load(filePath.c_str());
+    uint32_t width = surface != nullptr ? surface->w : 0;
+    uint32_t height = surface != nullptr ? surface->h : 0;
+    if (!ReadSurface(surface, pixels)) {
+	std::cerr << "Can't load texture " << filePath << ": "
+		  << IMG_GetError() << std::endl;
+	return;
+    }
+    // Only files that loaded can be hashed into the stamp
+    dependencies.push_back(filePath);
+    StoreTexture(pixels, width, height, entity);
+}
+
+void SceneConverter::StoreTexture(std::vector<uint8_t>& pixels,
+				  uint32_t width, uint32_t height,
+				  uint32_t entity) {
+    Texture texture = Texture();
+    texture.width = width;
+    texture.height = height;
+    texture.format = Texture::RGBA;
+    // Only diffuse textures are converted
+    texture.colorSpace = Texture::SRGB;
+    texture.mipLevels = GetMipLevelCount(width, height);
+    bool opaque = true;
+    for (size_t i = 3; i < pixels.size() && opaque; i += 4)
+	opaque = pixels[i] == 0xff;
+    pixels.resize(GetMipChainSize(texture));
+    GenerateMips(texture, pixels.data(), MipFilter::KAISER);
+    // BC1 is half the size of BC7 but has no alpha to speak of
+    auto blocks = std::make_shared<std::vector<uint8_t>>();
+    Texture* resultedTexture = (Texture*)scene->entities[entity]
+				   ->components[ComponentTypes::TEXTURE]
+				   .emplace(new ComponentPtr::Impl<Texture>);
+    *resultedTexture =
+	EncodeBlocks(texture, pixels.data(),
+		     opaque ? Texture::BC1 : Texture::BC7, *blocks);
+    resultedTexture->data = scene->resourceBank->Push_Back(
+	blocks->data(), blocks->size(), blocks);
+}
 
 void SceneConverter::ProcessMaterial(aiMaterial* material,
 				     const aiScene* queryScene,
@@ -138,23 +262,31 @@ void SceneConverter::ProcessMaterial(aiMaterial* material,
 	    scene->entities[entity]
 		->components[ComponentTypes::MATERIAL]
 		.emplace(new ComponentPtr::Impl<Material>));
-	material->Get(AI_MATKEY_COLOR_SPECULAR,
-		      resultedMaterial->spectacular.coordinates);
-	material->Get(AI_MATKEY_COLOR_DIFFUSE,
-		      resultedMaterial->diffuse.coordinates);
-	material->Get(AI_MATKEY_COLOR_AMBIENT,
-		      resultedMaterial->ambient.coordinates);
+	aiColor3D specular, diffuse, ambient;
+	material->Get(AI_MATKEY_COLOR_SPECULAR, specular);
+	material->Get(AI_MATKEY_COLOR_DIFFUSE, diffuse);
+	material->Get(AI_MATKEY_COLOR_AMBIENT, ambient);
+	ConVec3(resultedMaterial->color.specular, specular);
+	ConVec3(resultedMaterial->color.diffuse, diffuse);
+	ConVec3(resultedMaterial->color.ambient, ambient);
 	material->Get(AI_MATKEY_SHININESS_STRENGTH,
 		      resultedMaterial->shininess);
     }
+    aiString texturePath;
+    if (material->GetTexture(aiTextureType_DIFFUSE, 0, &texturePath) ==
+	AI_SUCCESS) {
+	auto embedded = queryScene->GetEmbeddedTexture(texturePath.C_Str());
+	if (embedded != nullptr)
+	    ProcessTexture(const_cast<aiTexture*>(embedded), queryScene,
+			   entity);
+	else
+	    ProcessTextureFile(sourceDirectory + texturePath.C_Str(), entity);
+    }
 }
 
 void SceneConverter::ProcessNodes(aiNode* node, const aiScene* queryScene) {
     for (uint32_t i = 0; i < node->mNumMeshes; i++) {
-	auto entity = scene->entityManager->CreateEntity();
-	scene->entities.push_back(
-	    std::move(std::unique_ptr<Scene::IComponentArray>(
-		new Scene::IComponentArray)));
+	auto entity = scene->PushDef();
 	ProcessTransform(node, entity);
 	ProcessMeshes(queryScene->mMeshes[node->mMeshes[i]], queryScene,
 		      entity);
@@ -205,13 +337,3 @@ void SceneConverter::ProcessLight(const aiScene* queryScene) {
 	}
     }
 }
-
-int main(int argc, char* argv[]) {
-    if (argc != 3) {
-	std::cerr << " We need two arguments " << std::endl;
-	return -1;
-    }
-    SceneConverter::init();
-    SceneConverter::singleton->Import(argv[1], argv[2]);
-    return 0;
-}
@@ -8,30 +8,37 @@
 #include <ECS/ECS.hpp>
 #include <ECS/GraphicsComponent.hpp>
 #include <assimp/Importer.hpp>
+#include <string>
+#include <vector>
 
+// Converts one source scene, give every conversion running at the same time
+// its own converter
 class SceneConverter {
-   private:
-    SceneConverter() = default;
-
    public:
-    static SceneConverter* init();
+    SceneConverter() = default;
     void Import(std::string filePath, std::string resultedPath);
     void Export(std::string filePath);
+    // Files the last Import read, the source first
+    const std::vector<std::string>& GetDependencies() const;
 
    private:
     Scene* scene;
+    std::vector<std::string> dependencies;
+    // Texture paths in the source are relative to it
+    std::string sourceDirectory;
     void ProcessMeshes(aiMesh* mesh, const aiScene* queryScene,
 		       const uint32_t& entity);
     void ProcessMaterial(aiMaterial* material, const aiScene* queryScene,
 			 uint32_t entity);
     void ProcessTexture(aiTexture* texture, const aiScene* queryScene,
 			uint32_t entity);
+    void ProcessTextureFile(const std::string& filePath, uint32_t entity);
+    // Builds the mips of the RGBA pixels and stores them block compressed
+    void StoreTexture(std::vector<uint8_t>& pixels, uint32_t width,
+		      uint32_t height, uint32_t entity);
     void ProcessLight(const aiScene* queryScene);
     void ProcessCamera(aiCamera* camera, const aiScene* queryScene);
     void ProcessLightColor(const aiLight* light, LightColor& color);
     void ProcessTransform(const aiNode* node, const uint32_t& entity);
     void ProcessNodes(aiNode* node, const aiScene* queryScene);
-
-   public:
-    static SceneConverter* singleton;
 };
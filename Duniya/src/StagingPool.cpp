@@ -0,0 +1,58 @@
+#include "StagingPool.hpp"
+
+StagingPool* StagingPool::singleton = nullptr;
+
+// Decode jobs reach for the pool from several threads at once
+static std::once_flag singletonInit;
+
+StagingPool::StagingPool(size_t maxPooledBytes)
+    : pooledBytes(0), maxPooledBytes(maxPooledBytes) {}
+
+StagingPool::~StagingPool() {
+    for (auto& buffer : freeBuffers) delete[] buffer.second;
+}
+
+StagingPool* StagingPool::init(size_t maxPooledBytes) {
+    std::call_once(singletonInit, [maxPooledBytes]() {
+	StagingPool::singleton = new StagingPool(maxPooledBytes);
+    });
+    return singleton;
+}
+
+StagingPool* StagingPool::GetSingleton() { return init(); }
+
+std::shared_ptr<uint8_t> StagingPool::Acquire(size_t size) {
+    uint8_t* data = nullptr;
+    size_t capacity = size;
+    {
+	std::unique_lock<std::mutex> lock(poolMutex);
+	// Buffers more than twice the size waste too much to hand out
+	auto itr = freeBuffers.lower_bound(size);
+	if (itr != freeBuffers.end() && itr->first <= size * 2) {
+	    capacity = itr->first;
+	    data = itr->second;
+	    pooledBytes -= capacity;
+	    freeBuffers.erase(itr);
+	}
+    }
+    if (data == nullptr) data = new uint8_t[capacity];
+    return std::shared_ptr<uint8_t>(
+	data, [this, capacity](uint8_t* data) { Release(data, capacity); });
+}
+
+size_t StagingPool::GetPooledBytes() {
+    std::unique_lock<std::mutex> lock(poolMutex);
+    return pooledBytes;
+}
+
+void StagingPool::Release(uint8_t* data, size_t capacity) {
+    {
+	std::unique_lock<std::mutex> lock(poolMutex);
+	if (pooledBytes + capacity <= maxPooledBytes) {
+	    freeBuffers.emplace(capacity, data);
+	    pooledBytes += capacity;
+	    return;
+	}
+    }
+    delete[] data;
+}
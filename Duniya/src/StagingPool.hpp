@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+
+// Recycles the CPU buffers decoded assets are written into. A buffer goes
+// back to the pool once its last owner drops it. The resource bank keeps
+// resident textures' buffers for as long as the scene lives, so buffers
+// come back when a scene is unloaded or a decode is thrown away, not after
+// each upload.
+class StagingPool {
+   private:
+    StagingPool(size_t maxPooledBytes);
+
+   public:
+    ~StagingPool();
+    static StagingPool* init(size_t maxPooledBytes = 64u << 20);
+    static StagingPool* GetSingleton();
+
+    // At least size bytes, the contents are whatever was there before
+    std::shared_ptr<uint8_t> Acquire(size_t size);
+    size_t GetPooledBytes();
+
+   private:
+    void Release(uint8_t* data, size_t capacity);
+
+   private:
+    // Free buffers by capacity, a request takes the smallest that fits
+    std::multimap<size_t, uint8_t*> freeBuffers;
+    std::mutex poolMutex;
+    size_t pooledBytes;
+    size_t maxPooledBytes;
+
+   public:
+    static StagingPool* singleton;
+};
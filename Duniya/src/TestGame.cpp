@@ -24,8 +24,8 @@ void TestGame::LoadScene(Scene* scene) {
 
     uint32_t cube = scene->Push();
     AssetLoader::GetSingleton()->scene = scene;
-    auto mesh = scene->GetEntity(cube)->Emplace<Mesh>(ComponentTypes::MESH);
-    AssetLoader::GetSingleton()->LoadObj("Resource/Test/cube1.obj", mesh);
+    // The cube shows up once it's loaded, the scene runs meanwhile
+    AssetLoader::GetSingleton()->LoadObjAsync("Resource/Test/cube1.obj", cube);
     // mesh->drawPrimitive = DrawPrimitive::LINES;
     auto cubeTransform =
 	scene->GetEntity(cube)->Emplace<Transform>(ComponentTypes::TRANSFORM);
@@ -0,0 +1,105 @@
+#include <Graphics/BCnCodec.hpp>
+#include <Graphics/MipGenerator.hpp>
+#include <Tests/Check.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+
+struct CodecError {
+    float rms;
+    uint32_t max;
+};
+
+// Smooth gradients with a little noise, what photos and albedo maps look
+// like at the scale of a block. Not a multiple of 4 so the edge blocks are
+// cropped.
+static std::vector<uint8_t> MakeImage(uint32_t width, uint32_t height,
+				      uint32_t channels) {
+    std::mt19937 random(17);
+    std::uniform_int_distribution<int32_t> noise(-3, 3);
+    std::vector<uint8_t> pixels((size_t)width * height * channels);
+    for (uint32_t y = 0; y < height; y++)
+	for (uint32_t x = 0; x < width; x++)
+	    for (uint32_t c = 0; c < channels; c++) {
+		float wave = sinf(x * .09f + y * .05f + c * .4f);
+		int32_t value = (int32_t)(128.f + 100.f * wave) + noise(random);
+		pixels[((size_t)y * width + x) * channels + c] =
+		    (uint8_t)std::min(std::max(value, 0), 255);
+	    }
+    return pixels;
+}
+
+static CodecError RoundTrip(Texture::Format format, uint32_t channels,
+			    const std::vector<uint8_t>& pixels,
+			    uint32_t width, uint32_t height,
+			    std::vector<uint8_t>& decoded) {
+    Texture source = {};
+    source.width = width;
+    source.height = height;
+    source.channels = channels;
+    source.format = channels == 1 ? Texture::R : Texture::RGBA;
+    source.mipLevels = 1;
+    std::vector<uint8_t> blocks;
+    Texture encoded = EncodeBlocks(source, pixels.data(), format, blocks);
+    DecodeBlocks(encoded, blocks.data(), 0, decoded);
+
+    CodecError error = {0.f, 0};
+    double squared = 0.0;
+    for (size_t i = 0; i < pixels.size(); i++) {
+	int32_t difference = (int32_t)decoded[i] - pixels[i];
+	squared += difference * difference;
+	error.max = std::max(error.max, (uint32_t)std::abs(difference));
+    }
+    error.rms = sqrtf(squared / pixels.size());
+    return error;
+}
+
+// Bounds measured on the encoder as written with some headroom, a change
+// that loses precision shows up here before it shows up on screen
+DUNIYA_TEST(BCnRoundTripStaysWithinBounds) {
+    const uint32_t width = 37, height = 22;
+    auto rgba = MakeImage(width, height, 4);
+    std::vector<uint8_t> decoded;
+
+    // BC1 is written opaque, alpha is compared against 255
+    auto opaque = rgba;
+    for (size_t i = 3; i < opaque.size(); i += 4) opaque[i] = 255;
+    auto bc1 = RoundTrip(Texture::BC1, 4, opaque, width, height, decoded);
+    CHECK(bc1.rms < 7.f && bc1.max <= 32);
+
+    auto bc3 = RoundTrip(Texture::BC3, 4, rgba, width, height, decoded);
+    CHECK(bc3.rms < 7.f && bc3.max <= 32);
+    uint32_t alphaError = 0;
+    for (size_t i = 3; i < rgba.size(); i += 4)
+	alphaError =
+	    std::max(alphaError, (uint32_t)std::abs(decoded[i] - rgba[i]));
+    // Alpha has its own block with 3 bit indices
+    CHECK(alphaError <= 6);
+
+    auto bc7 = RoundTrip(Texture::BC7, 4, rgba, width, height, decoded);
+    CHECK(bc7.rms < 3.5f && bc7.max <= 16);
+
+    auto r = MakeImage(width, height, 1);
+    auto bc4 = RoundTrip(Texture::BC4, 1, r, width, height, decoded);
+    CHECK(bc4.rms < 2.f && bc4.max <= 6);
+}
+
+// One color is an endpoint, only the endpoints' quantization is left
+DUNIYA_TEST(BCnFlatColorIsNearlyExact) {
+    const uint32_t width = 8, height = 8;
+    const uint8_t color[4] = {200, 101, 37, 180};
+    std::vector<uint8_t> rgba((size_t)width * height * 4), decoded;
+    for (size_t i = 0; i < rgba.size(); i++) rgba[i] = color[i % 4];
+    std::vector<uint8_t> r((size_t)width * height, color[0]);
+
+    auto opaque = rgba;
+    for (size_t i = 3; i < opaque.size(); i += 4) opaque[i] = 255;
+    // 5 and 6 bit endpoints round to within half a step
+    CHECK(RoundTrip(Texture::BC1, 4, opaque, width, height, decoded).max <=
+	  4);
+    CHECK(RoundTrip(Texture::BC3, 4, rgba, width, height, decoded).max <= 4);
+    for (size_t i = 3; i < rgba.size(); i += 4) CHECK(decoded[i] == color[3]);
+    CHECK(RoundTrip(Texture::BC7, 4, rgba, width, height, decoded).max <= 1);
+    CHECK(RoundTrip(Texture::BC4, 1, r, width, height, decoded).max == 0);
+}
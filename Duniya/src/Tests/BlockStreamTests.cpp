@@ -0,0 +1,57 @@
+#include <ECS/BlockStream.hpp>
+#include <Exception.hpp>
+#include <Tests/Check.hpp>
+#include <cstddef>
+#include <sstream>
+
+static std::string WriteBlocks(const std::string& raw, BlockCodec codec) {
+    BlockOptions options;
+    options.codec = codec;
+    options.blockSize = 64;
+    std::ostringstream oss(std::ios::binary);
+    BlockWriter::Write(oss, raw, options);
+    return oss.str();
+}
+
+static std::string RawData() {
+    std::string raw;
+    for (uint32_t i = 0; i < 200; i++) raw.push_back((char)(i * 7));
+    return raw;
+}
+
+DUNIYA_TEST(BlocksRoundTrip) {
+    auto raw = RawData();
+    std::istringstream iss(WriteBlocks(raw, BlockCodec::NONE),
+			   std::ios::binary);
+    BlockReader reader(iss);
+    CHECK(reader.GetBlockCount() == 4);
+    std::string out;
+    reader.ReadAll(out);
+    CHECK(out == raw);
+    reader.ReadBlock(3, out);
+    CHECK(out == raw.substr(192));
+}
+
+// A NONE block whose stored size isn't its raw size would be copied past
+// the data read for it
+DUNIYA_TEST(RawBlockWithWrongSizeIsRejected) {
+    auto raw = RawData();
+    auto section = WriteBlocks(raw, BlockCodec::NONE);
+    // Only the last block may be short, it still has to match rawSize
+    uint64_t lastEntry = sizeof(BlockHeader) + 3 * sizeof(BlockEntry);
+    uint32_t compressedSize = 2;
+    section.replace(lastEntry + offsetof(BlockEntry, compressedSize),
+		    sizeof(uint32_t), (char*)&compressedSize,
+		    sizeof(uint32_t));
+
+    std::istringstream iss(section, std::ios::binary);
+    BlockReader reader(iss);
+    std::string out;
+    bool rejected = false;
+    try {
+	reader.ReadBlock(3, out);
+    } catch (CException&) {
+	rejected = true;
+    }
+    CHECK(rejected);
+}
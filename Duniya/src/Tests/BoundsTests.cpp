@@ -0,0 +1,135 @@
+#include <Math/Bounds.hpp>
+#include <Math/Projection.hpp>
+#include <Math/TransformBatch.hpp>
+#include <Tests/Check.hpp>
+#include <cmath>
+#include <random>
+
+// Points are row vectors, clip = point * viewProjection
+static bool InsideClipCube(const Mat4& viewProjection, const Vect3& point,
+			   bool& nearEdge) {
+    float clip[4];
+    for (uint32_t j = 0; j < 4; j++)
+	clip[j] = point.x * viewProjection.Get(0, j) +
+		  point.y * viewProjection.Get(1, j) +
+		  point.z * viewProjection.Get(2, j) + viewProjection.Get(3, j);
+    bool inside = true;
+    nearEdge = false;
+    for (uint32_t i = 0; i < 3; i++) {
+	float margin = clip[3] - fabsf(clip[i]);
+	inside = inside && margin >= 0.f;
+	nearEdge = nearEdge || fabsf(margin) < 1e-3f * fabsf(clip[3]) + 1e-4f;
+    }
+    return inside;
+}
+
+DUNIYA_TEST(FrustumMatchesTheClipCube) {
+    Mat4 view =
+	GetLookAtMatrix(Vect3(1, 2, 3), Vect3(4, 0, -2), Vect3(0, 1, 0));
+    Mat4 projection = GetPerspectiveMatrix(1.2f, 16.f / 9.f, .1f, 100.f);
+    Mat4 viewProjection = view * projection;
+    Frustum frustum = Frustum::FromMatrix(viewProjection);
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> coordinate(-120.f, 120.f);
+    uint32_t insideCount = 0;
+    for (uint32_t i = 0; i < 20000; i++) {
+	Vect3 point(coordinate(random), coordinate(random), coordinate(random));
+	bool nearEdge;
+	bool inside = InsideClipCube(viewProjection, point, nearEdge);
+	if (nearEdge) continue;
+	CHECK(frustum.Contains(point) == inside);
+	insideCount += inside;
+    }
+    // Enough of the samples land inside for the comparison to mean something
+    CHECK(insideCount > 100);
+}
+
+DUNIYA_TEST(FrustumKeepsPointsAcrossItsDepth) {
+    // The whole near to far range along the view axis, not a thin slice
+    Mat4 view =
+	GetLookAtMatrix(Vect3(0, 0, 0), Vect3(0, 0, -1), Vect3(0, 1, 0));
+    Mat4 projection = GetPerspectiveMatrix(1.2f, 16.f / 9.f, .1f, 100.f);
+    Mat4 viewProjection = view * projection;
+    Frustum frustum = Frustum::FromMatrix(viewProjection);
+    uint32_t insideCount = 0;
+    for (float depth : {.2f, .5f, 1.f, 5.f, 20.f, 50.f, 99.f})
+	for (float sign : {-1.f, 1.f}) {
+	    Vect3 point(0.f, 0.f, depth * sign);
+	    bool nearEdge;
+	    bool inside = InsideClipCube(viewProjection, point, nearEdge);
+	    CHECK(frustum.Contains(point) == inside);
+	    insideCount += inside;
+	}
+    CHECK(insideCount == 7);
+}
+
+// World matrices map column vectors, p' = world * p
+static Vect3 ToWorld(const Mat4& world, const Vect3& point) {
+    Vect3 result;
+    for (uint32_t i = 0; i < 3; i++)
+	result.coordinates[i] = world.Get(i, 0) * point.x +
+				world.Get(i, 1) * point.y +
+				world.Get(i, 2) * point.z + world.Get(i, 3);
+    return result;
+}
+
+// Matrices built the way RendererSystem builds a camera's and a mesh's, the
+// boxes of the meshes the camera sees must be kept
+DUNIYA_TEST(FrustumKeepsWhatTheRendererDraws) {
+    Vect3 eye(2.f, 1.f, 6.f), lookAt(-.3f, -.1f, -1.f);
+    lookAt.normalize();
+    Mat4 view = GetLookAtMatrix(eye, eye + lookAt, Vect3(0, 1, 0));
+    Mat4 projection = GetPerspectiveMatrix(1.f, 4.f / 3.f, .1f, 60.f);
+    Mat4 viewProjection = view * projection;
+    Frustum frustum = Frustum::FromMatrix(viewProjection);
+
+    std::mt19937 random(13);
+    std::uniform_real_distribution<float> coordinate(-70.f, 70.f);
+    std::uniform_real_distribution<float> angle(-3.f, 3.f);
+    std::uniform_real_distribution<float> scale(.2f, 3.f);
+    TransformBuffer transforms;
+    for (uint32_t i = 0; i < 4000; i++)
+	transforms.Push(
+	    Vect3(coordinate(random), coordinate(random), coordinate(random)),
+	    Vect3(angle(random), angle(random), angle(random)),
+	    Vect3(scale(random), scale(random), scale(random)));
+    std::vector<Mat4> worlds(transforms.GetSize());
+    ComposeTransforms(transforms.View(), worlds.size(), worlds.data());
+
+    AABB box(Vect3(-1.f, -1.f, -1.f), Vect3(1.f, 1.f, 1.f));
+    uint32_t seenCount = 0;
+    for (auto& world : worlds) {
+	AABB worldBox = box.Transformed(world);
+	bool seen = false;
+	for (uint32_t corner = 0; corner < 8; corner++) {
+	    Vect3 point = ToWorld(
+		world, Vect3(corner & 1 ? 1.f : -1.f, corner & 2 ? 1.f : -1.f,
+			     corner & 4 ? 1.f : -1.f));
+	    for (uint32_t i = 0; i < 3; i++) {
+		float value = point.coordinates[i];
+		float slack = 1e-4f * (1.f + fabsf(value));
+		CHECK(value >= worldBox.min.coordinates[i] - slack);
+		CHECK(value <= worldBox.max.coordinates[i] + slack);
+	    }
+	    bool nearEdge;
+	    seen = seen || (InsideClipCube(viewProjection, point, nearEdge) &&
+			    !nearEdge);
+	}
+	if (seen) CHECK(frustum.Intersects(worldBox));
+	seenCount += seen;
+    }
+    CHECK(seenCount > 50);
+}
+
+DUNIYA_TEST(SphereFromPointsContainsThem) {
+    std::mt19937 random(11);
+    std::uniform_real_distribution<float> coordinate(-1000.f, 1000.f);
+    for (uint32_t set = 0; set < 200; set++) {
+	std::vector<Vect3> points(3 + set % 50);
+	for (auto& point : points)
+	    point = Vect3(coordinate(random), coordinate(random) * .01f,
+			  coordinate(random) + 5000.f);
+	Sphere sphere = Sphere::FromPoints(points.data(), points.size());
+	for (auto& point : points) CHECK(sphere.Contains(point));
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Self registering behaviour checks, duniya_tests runs all of them or the
+// ones whose name contains its argument
+struct TestCase {
+    const char* name;
+    void (*body)();
+};
+
+std::vector<TestCase>& GetTestCases();
+
+struct TestRegistrar {
+    TestRegistrar(const char* name, void (*body)()) {
+	GetTestCases().push_back({name, body});
+    }
+};
+
+struct CheckFailure {
+    std::string message;
+};
+
+#define DUNIYA_TEST(NAME)                                         \
+    static void NAME();                                           \
+    static TestRegistrar NAME##Registrar(#NAME, NAME);            \
+    static void NAME()
+
+#define CHECK(CONDITION)                                               \
+    if (!(CONDITION))                                                  \
+    throw CheckFailure{std::string(__FILE__) + ":" +                   \
+		       std::to_string(__LINE__) + ": " #CONDITION}
@@ -0,0 +1,65 @@
+#include <ECS/CommonComponent.hpp>
+#include <ECS/DeltaSerializer.hpp>
+#include <ECS/ECS.hpp>
+#include <ECS/SerializerSystem.hpp>
+#include <Tests/Check.hpp>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+static std::string ReadBytes(const std::string& filePath) {
+    std::ifstream fin(filePath, std::ifstream::binary);
+    std::ostringstream bytes;
+    bytes << fin.rdbuf();
+    return bytes.str();
+}
+
+DUNIYA_TEST(DeltaRoundTripMatchesFullSave) {
+    static uint8_t first[64], second[32];
+    for (uint32_t i = 0; i < sizeof(first); i++) first[i] = i;
+    for (uint32_t i = 0; i < sizeof(second); i++) second[i] = 255 - i;
+
+    // Two chunks, so one of them stays untouched
+    Scene scene;
+    uint32_t count = SerializerSystem::entitiesPerChunk + 5;
+    for (uint32_t i = 0; i < count; i++) {
+	uint32_t entity = scene.PushDef();
+	auto transform = scene.entities[entity]->Emplace<Transform>(
+	    ComponentTypes::TRANSFORM);
+	transform->pos = Vect3(i, 2.f * i, 3.f * i);
+	transform->scale = Vect3(1.f, 1.f, 1.f);
+    }
+    scene.resourceBank->Push_Back(first, sizeof(first));
+
+    SceneSnapshot baseline;
+    baseline.Capture(scene);
+
+    uint32_t last = count - 1;
+    scene.entities[last]->Get<Transform>(ComponentTypes::TRANSFORM)->pos.y =
+	-7.f;
+    scene.entities[last - 1]
+	->Emplace<Orientation>(ComponentTypes::ORIENTATION)
+	->rotation = Quat(0.5f, 0.5f, 0.5f, 0.5f);
+    scene.entities[last - 2].reset();
+    scene.resourceBank->Push_Back(second, sizeof(second));
+
+    const std::string deltaPath = "DeltaRoundTrip.delta";
+    const std::string savedPath = "DeltaRoundTrip.scene";
+    const std::string loadedPath = "DeltaRoundTripLoaded.scene";
+    scene.SaveSceneDelta(deltaPath, baseline);
+    scene.SaveScene(savedPath);
+
+    Scene loaded;
+    loaded.LoadSceneDelta(deltaPath, baseline);
+    loaded.SaveScene(loadedPath);
+
+    std::string saved = ReadBytes(savedPath);
+    CHECK(!saved.empty());
+    CHECK(saved == ReadBytes(loadedPath));
+    // Only the second chunk and the new resource are in the delta
+    CHECK(ReadBytes(deltaPath).size() < saved.size() / 2);
+
+    std::remove(deltaPath.c_str());
+    std::remove(savedPath.c_str());
+    std::remove(loadedPath.c_str());
+}
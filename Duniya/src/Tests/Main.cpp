@@ -0,0 +1,32 @@
+#include <Exception.hpp>
+#include <JobSystem.hpp>
+#include <Tests/Check.hpp>
+#include <iostream>
+
+std::vector<TestCase>& GetTestCases() {
+    static std::vector<TestCase> testCases;
+    return testCases;
+}
+
+int main(int argc, char** argv) {
+    std::string filter = argc > 1 ? argv[1] : "";
+    JobSystem::init();
+    uint32_t passed = 0, failed = 0;
+    for (auto& testCase : GetTestCases()) {
+	if (std::string(testCase.name).find(filter) == std::string::npos)
+	    continue;
+	try {
+	    testCase.body();
+	    passed++;
+	    continue;
+	} catch (CheckFailure& failure) {
+	    std::cerr << testCase.name << ": " << failure.message << std::endl;
+	} catch (std::exception& exception) {
+	    std::cerr << testCase.name << ": " << exception.what()
+		      << std::endl;
+	}
+	failed++;
+    }
+    std::cout << passed << " passed, " << failed << " failed" << std::endl;
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,96 @@
+#include <Math/Mat4Kernels.hpp>
+#include <Tests/Check.hpp>
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+using Mat4Kernels::SimdLevel;
+
+// Every level the CPU has, SetSimdLevel caps the rest to the best one
+static std::vector<SimdLevel> Levels() {
+    std::vector<SimdLevel> levels;
+    Mat4Kernels::SetSimdLevel(SimdLevel::AVX2);
+    SimdLevel best = Mat4Kernels::GetSimdLevel();
+    for (auto level : {SimdLevel::SCALAR, SimdLevel::SSE41, SimdLevel::AVX2})
+	if (level <= best) levels.push_back(level);
+    return levels;
+}
+
+// Largest difference relative to the largest entry of expected
+static float RelativeError(const float* expected, const float* actual,
+			   uint32_t count) {
+    float scale = 0.f, error = 0.f;
+    for (uint32_t i = 0; i < count; i++) {
+	scale = std::max(scale, fabsf(expected[i]));
+	error = std::max(error, fabsf(expected[i] - actual[i]));
+    }
+    return scale != 0.f ? error / scale : error;
+}
+
+static Mat4 RandomMat4(std::mt19937& random) {
+    std::uniform_real_distribution<float> value(-1.f, 1.f);
+    Mat4 mat;
+    for (auto& element : mat.data) element = value(random);
+    // Diagonally dominant, well away from singular
+    for (uint32_t i = 0; i < 4; i++) mat.Get(i, i) += 4.f;
+    return mat;
+}
+
+DUNIYA_TEST(Mat4KernelsAgreeWithScalar) {
+    std::mt19937 random(3);
+    std::uniform_real_distribution<float> value(-10.f, 10.f);
+    std::vector<Vect4> vects(37);
+    for (auto& vect : vects)
+	vect = Vect4(value(random), value(random), value(random), 1.f);
+    for (uint32_t round = 0; round < 50; round++) {
+	Mat4 a = RandomMat4(random), b = RandomMat4(random);
+	Mat4Kernels::SetSimdLevel(SimdLevel::SCALAR);
+	Mat4 product = Mat4Kernels::Multiply(a, b), inverse;
+	CHECK(Mat4Kernels::Inverse(a, inverse));
+	std::vector<Vect4> transformed(vects.size());
+	Mat4Kernels::Transform(a, vects.data(), transformed.data(),
+			       vects.size());
+	for (auto level : Levels()) {
+	    Mat4Kernels::SetSimdLevel(level);
+	    Mat4 levelProduct = Mat4Kernels::Multiply(a, b), levelInverse;
+	    CHECK(RelativeError(product.data, levelProduct.data, 16) < 1e-5f);
+	    CHECK(Mat4Kernels::Inverse(a, levelInverse));
+	    CHECK(RelativeError(inverse.data, levelInverse.data, 16) < 1e-5f);
+	    std::vector<Vect4> levelTransformed(vects.size());
+	    Mat4Kernels::Transform(a, vects.data(), levelTransformed.data(),
+				   vects.size());
+	    for (size_t i = 0; i < vects.size(); i++) {
+		Vect4 one = Mat4Kernels::Transform(a, vects[i]);
+		CHECK(RelativeError(transformed[i].coordinates,
+				    levelTransformed[i].coordinates,
+				    4) < 1e-5f);
+		CHECK(RelativeError(transformed[i].coordinates,
+				    one.coordinates, 4) < 1e-5f);
+	    }
+	}
+    }
+    Mat4Kernels::SetSimdLevel(SimdLevel::AVX2);
+}
+
+DUNIYA_TEST(Mat4KernelsInvertIllConditioned) {
+    // The last row is nearly the sum of the others, the condition number
+    // is around 1e4 so the levels' inverses agree only loosely. Each one
+    // still has to undo the matrix.
+    Mat4 mat = {2.f, 1.f,   0.5f, 3.f, -1.f, 4.f,  1.f,   0.f,
+		0.f, 2.f,   3.f,  1.f, 1.f,  7.f, 4.501f, 4.f};
+    Mat4Kernels::SetSimdLevel(SimdLevel::SCALAR);
+    Mat4 expected;
+    CHECK(Mat4Kernels::Inverse(mat, expected));
+    for (auto level : Levels()) {
+	Mat4Kernels::SetSimdLevel(level);
+	Mat4 inverse;
+	CHECK(Mat4Kernels::Inverse(mat, inverse));
+	CHECK(RelativeError(expected.data, inverse.data, 16) < 1e-2f);
+	Mat4 identity = Mat4Kernels::Multiply(mat, inverse);
+	for (uint32_t i = 0; i < 4; i++)
+	    for (uint32_t j = 0; j < 4; j++)
+		CHECK(fabsf(identity.Get(i, j) - (i == j ? 1.f : 0.f)) <
+		      1e-2f);
+    }
+    Mat4Kernels::SetSimdLevel(SimdLevel::AVX2);
+}
@@ -0,0 +1,18 @@
+#include <Graphics/MeshOptimizer.hpp>
+#include <Tests/Check.hpp>
+
+DUNIYA_TEST(RepeatedTriangleHitsTheCache) {
+    uint32_t indices[] = {0, 1, 2, 0, 1, 2};
+    auto statistics = AnalyzeVertexCache(indices, 6, 3, 3);
+    CHECK(statistics.acmr == 1.5f);
+    CHECK(statistics.atvr == 1.f);
+}
+
+DUNIYA_TEST(VertexCacheIsFifoOfCacheSize) {
+    // 3 pushes 0 out of the 3 entry cache, bringing 0 back in then pushes
+    // out 1 and 2 in turn
+    uint32_t indices[] = {0, 1, 2, 3, 1, 2, 0, 1, 2};
+    auto statistics = AnalyzeVertexCache(indices, 9, 4, 3);
+    CHECK(statistics.acmr == 7.f / 3.f);
+    CHECK(statistics.atvr == 7.f / 4.f);
+}
@@ -0,0 +1,73 @@
+#include <Graphics/MeshSimplifier.hpp>
+#include <Tests/Check.hpp>
+#include <cmath>
+
+// Gently rolling heightfield, enough curvature that the coarser levels
+// carry some error but not so much that simplifying stops early
+static void MakeTerrain(uint32_t size, std::vector<Vertex>& vertices,
+			std::vector<uint32_t>& indices) {
+    for (uint32_t y = 0; y < size; y++)
+	for (uint32_t x = 0; x < size; x++) {
+	    Vertex vertex = {};
+	    float height = .3f * sinf(x * .2f) * cosf(y * .15f);
+	    vertex.aPos = Vect4(x, height, y, 1.f);
+	    vertex.aNormal = Vect3(0.f, 1.f, 0.f);
+	    vertex.texCord =
+		Vect2((float)x / (size - 1), (float)y / (size - 1));
+	    vertices.push_back(vertex);
+	}
+    for (uint32_t y = 0; y + 1 < size; y++)
+	for (uint32_t x = 0; x + 1 < size; x++) {
+	    uint32_t corner = y * size + x;
+	    uint32_t quad[6] = {corner, corner + size, corner + 1,
+				corner + 1, corner + size, corner + size + 1};
+	    indices.insert(indices.end(), quad, quad + 6);
+	}
+}
+
+DUNIYA_TEST(MeshLodsShrinkAndStayValid) {
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    MakeTerrain(40, vertices, indices);
+    uint32_t baseCount = indices.size();
+    Mesh mesh = {};
+    GenerateMeshLods(vertices.data(), vertices.size(), indices, mesh);
+
+    CHECK(mesh.lodCount >= 2 && mesh.lodCount <= maxMeshLods);
+    CHECK(mesh.lods[0].indexOffset == 0);
+    CHECK(mesh.lods[0].indexCount == baseCount);
+    // The levels are appended back to back and indexCount covers them all
+    uint32_t offset = 0;
+    for (uint32_t level = 0; level < mesh.lodCount; level++) {
+	auto& lod = mesh.lods[level];
+	CHECK(lod.indexOffset == offset);
+	CHECK(lod.indexCount % 3 == 0 && lod.indexCount > 0);
+	if (level > 0) {
+	    CHECK(lod.indexCount <= mesh.lods[level - 1].indexCount);
+	    CHECK(lod.error >= 0.f);
+	}
+	offset += lod.indexCount;
+    }
+    CHECK(mesh.indexCount == offset);
+    CHECK(mesh.indexCount == indices.size());
+
+    for (uint32_t level = 0; level < mesh.lodCount; level++) {
+	auto& lod = mesh.lods[level];
+	for (uint32_t i = lod.indexOffset; i < lod.indexOffset + lod.indexCount;
+	     i += 3) {
+	    uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+	    CHECK(a < vertices.size() && b < vertices.size() &&
+		  c < vertices.size());
+	    // Collapsed triangles are dropped, not left behind degenerate
+	    CHECK(a != b && b != c && a != c);
+	}
+    }
+
+    for (auto& vertex : vertices) {
+	float dx = vertex.aPos.x - mesh.boundsCenter.x;
+	float dy = vertex.aPos.y - mesh.boundsCenter.y;
+	float dz = vertex.aPos.z - mesh.boundsCenter.z;
+	float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+	CHECK(distance <= mesh.boundsRadius * 1.0001f);
+    }
+}
@@ -0,0 +1,62 @@
+#include <Graphics/MipGenerator.hpp>
+#include <Tests/Check.hpp>
+#include <algorithm>
+#include <vector>
+
+static Texture MakeTexture(uint32_t width, uint32_t height,
+			   Texture::Format format,
+			   Texture::ColorSpace colorSpace) {
+    Texture texture = {};
+    texture.width = width;
+    texture.height = height;
+    texture.format = format;
+    texture.channels = GetChannelCount(format);
+    texture.mipLevels = GetMipLevelCount(width, height);
+    texture.colorSpace = colorSpace;
+    return texture;
+}
+
+DUNIYA_TEST(MipChainOfOddSizes) {
+    // Width, height and the levels down to 1x1
+    const uint32_t sizes[][3] = {
+	{37, 22, 6}, {1, 13, 4}, {100, 1, 7}, {255, 256, 9}, {1, 1, 1}};
+    for (auto& size : sizes) {
+	Texture texture =
+	    MakeTexture(size[0], size[1], Texture::RGBA, Texture::SRGB);
+	CHECK(texture.mipLevels == size[2]);
+	size_t offset = 0;
+	for (uint32_t level = 0; level < texture.mipLevels; level++) {
+	    // Halved and rounded down, never below 1
+	    uint32_t width = std::max(size[0] >> level, 1u);
+	    uint32_t height = std::max(size[1] >> level, 1u);
+	    CHECK(GetMipWidth(texture, level) == width);
+	    CHECK(GetMipHeight(texture, level) == height);
+	    CHECK(GetMipLevelSize(texture, level) ==
+		  (size_t)width * height * 4);
+	    CHECK(GetMipLevelOffset(texture, level) == offset);
+	    offset += GetMipLevelSize(texture, level);
+	}
+	uint32_t last = texture.mipLevels - 1;
+	CHECK(GetMipWidth(texture, last) == 1);
+	CHECK(GetMipHeight(texture, last) == 1);
+	CHECK(GetMipChainSize(texture) == offset);
+    }
+}
+
+DUNIYA_TEST(ConstantImageStaysConstant) {
+    const uint8_t color[4] = {200, 91, 17, 128};
+    for (auto filter : {MipFilter::BOX, MipFilter::KAISER})
+	for (auto colorSpace : {Texture::SRGB, Texture::LINEAR})
+	    for (auto format : {Texture::RGBA, Texture::R}) {
+		Texture texture = MakeTexture(37, 22, format, colorSpace);
+		uint32_t channels = texture.channels;
+		std::vector<uint8_t> chain(GetMipChainSize(texture));
+		for (size_t i = 0; i < GetMipLevelSize(texture, 0); i++)
+		    chain[i] = color[i % channels];
+		GenerateMips(texture, chain.data(), filter);
+		// Both filters' weights sum to one, sRGB goes to linear and
+		// back through the same tables
+		for (size_t i = 0; i < chain.size(); i++)
+		    CHECK(chain[i] == color[i % channels]);
+	    }
+}
@@ -0,0 +1,88 @@
+#include <Graphics/ObjParser.hpp>
+#include <Tests/Check.hpp>
+#include <cmath>
+#include <string>
+
+struct ParsedObj {
+    std::vector<Vertex> verticies;
+    std::vector<uint32_t> indicies;
+};
+
+static ParsedObj Parse(const std::string& text) {
+    ParsedObj parsed;
+    ParseObj(text.data(), text.size(), parsed.verticies, parsed.indicies);
+    return parsed;
+}
+
+static bool Near(float a, float b) { return fabsf(a - b) < 1e-6f; }
+
+static bool PositionIs(const Vertex& vertex, float x, float y, float z) {
+    return Near(vertex.aPos.x, x) && Near(vertex.aPos.y, y) &&
+	   Near(vertex.aPos.z, z) && Near(vertex.aPos.w, 1.f);
+}
+
+static bool NormalIs(const Vertex& vertex, float x, float y, float z) {
+    return Near(vertex.aNormal.x, x) && Near(vertex.aNormal.y, y) &&
+	   Near(vertex.aNormal.z, z);
+}
+
+DUNIYA_TEST(ObjRelativeIndices) {
+    // The face refers to the last three positions, not the first
+    auto parsed = Parse(
+	"v 9 9 9\n"
+	"v 0 0 0\n"
+	"v 1 0 0\n"
+	"v 0 1 0\n"
+	"f -3 -2 -1\n");
+    CHECK(parsed.verticies.size() == 3);
+    CHECK(parsed.indicies.size() == 3);
+    auto& v = parsed.verticies;
+    auto& i = parsed.indicies;
+    CHECK(PositionIs(v[i[0]], 0.f, 0.f, 0.f));
+    CHECK(PositionIs(v[i[1]], 1.f, 0.f, 0.f));
+    CHECK(PositionIs(v[i[2]], 0.f, 1.f, 0.f));
+    // Without normals in the file they come from the face
+    for (auto& vertex : v) CHECK(NormalIs(vertex, 0.f, 0.f, 1.f));
+}
+
+DUNIYA_TEST(ObjNormalsWithoutUvs) {
+    auto parsed = Parse(
+	"v 0 0 0\n"
+	"v 1 0 0\n"
+	"v 0 1 0\n"
+	"vn 1 0 0\n"
+	"vn 0 1 0\n"
+	"vn 0 0 -1\n"
+	"f 1//1 2//2 3//3\n");
+    CHECK(parsed.verticies.size() == 3);
+    CHECK(parsed.indicies.size() == 3);
+    auto& v = parsed.verticies;
+    auto& i = parsed.indicies;
+    CHECK(PositionIs(v[i[0]], 0.f, 0.f, 0.f) && NormalIs(v[i[0]], 1, 0, 0));
+    CHECK(PositionIs(v[i[1]], 1.f, 0.f, 0.f) && NormalIs(v[i[1]], 0, 1, 0));
+    CHECK(PositionIs(v[i[2]], 0.f, 1.f, 0.f) && NormalIs(v[i[2]], 0, 0, -1));
+    for (auto& vertex : v)
+	CHECK(vertex.texCord.x == 0.f && vertex.texCord.y == 0.f);
+}
+
+DUNIYA_TEST(ObjPlainFacesShareVertices) {
+    // A triangle and a quad over the same positions, the quad is split in
+    // a fan and every corner maps back to the one vertex of its position
+    auto parsed = Parse(
+	"v 0 0 0\n"
+	"v 2 0 0\n"
+	"v 2 2 0\n"
+	"v 0 2 0\n"
+	"f 1 2 3\n"
+	"f 1 2 3 4\n");
+    CHECK(parsed.verticies.size() == 4);
+    CHECK(parsed.indicies.size() == 9);
+    const uint32_t expected[9] = {0, 1, 2, 0, 1, 2, 0, 2, 3};
+    const float positions[4][2] = {{0, 0}, {2, 0}, {2, 2}, {0, 2}};
+    for (uint32_t j = 0; j < 9; j++) {
+	auto& vertex = parsed.verticies[parsed.indicies[j]];
+	auto& position = positions[expected[j]];
+	CHECK(PositionIs(vertex, position[0], position[1], 0.f));
+	CHECK(NormalIs(vertex, 0.f, 0.f, 1.f));
+    }
+}
@@ -0,0 +1,95 @@
+#include <Math/Mat4Kernels.hpp>
+#include <Math/Quat.hpp>
+#include <Tests/Check.hpp>
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+using Mat4Kernels::SimdLevel;
+
+// Every level the CPU has, SetSimdLevel caps the rest to the best one
+static std::vector<SimdLevel> Levels() {
+    std::vector<SimdLevel> levels;
+    Mat4Kernels::SetSimdLevel(SimdLevel::AVX2);
+    SimdLevel best = Mat4Kernels::GetSimdLevel();
+    for (auto level : {SimdLevel::SCALAR, SimdLevel::SSE41, SimdLevel::AVX2})
+	if (level <= best) levels.push_back(level);
+    return levels;
+}
+
+static Quat RandomQuat(std::mt19937& random, float scale = 1.f) {
+    std::uniform_real_distribution<float> value(-scale, scale);
+    return Quat(value(random), value(random), value(random), value(random));
+}
+
+static Quat Negated(const Quat& quat) {
+    Quat negated;
+    for (uint32_t i = 0; i < 4; i++)
+	negated.coordinates[i] = -quat.coordinates[i];
+    return negated;
+}
+
+static Quat Nudged(std::mt19937& random, const Quat& quat) {
+    Quat nudge = RandomQuat(random, 1e-3f), nudged;
+    for (uint32_t i = 0; i < 4; i++)
+	nudged.coordinates[i] = quat.coordinates[i] + nudge.coordinates[i];
+    return nudged.normalized();
+}
+
+static float Difference(const Quat& a, const Quat& b) {
+    float difference = 0.f;
+    for (uint32_t i = 0; i < 4; i++)
+	difference =
+	    std::max(difference, fabsf(a.coordinates[i] - b.coordinates[i]));
+    return difference;
+}
+
+// Counts that aren't a multiple of eight run every tail as well
+DUNIYA_TEST(QuatBatchesAgreeWithScalar) {
+    std::mt19937 random(5);
+    std::uniform_real_distribution<float> time(0.f, 1.f);
+    std::vector<Quat> a, b;
+    std::vector<float> t;
+    for (uint32_t i = 0; i < 61; i++) {
+	Quat first = RandomQuat(random).normalized(), second;
+	switch (i % 6) {
+	    case 0:
+		second = RandomQuat(random).normalized();
+		break;
+	    case 1:
+		second = Nudged(random, first);
+		break;
+	    case 2:
+		second = first;
+		break;
+	    case 3:
+		second = Negated(first);
+		break;
+	    case 4:
+		second = Negated(Nudged(random, first));
+		break;
+	    default:
+		// Opposite hemispheres, the batches flip b
+		second = Negated(RandomQuat(random).normalized());
+		if (first.dot(second) > 0.f) second = Negated(second);
+		break;
+	}
+	a.push_back(first);
+	b.push_back(second);
+	t.push_back(i % 10 == 0 ? 0.f : i % 10 == 1 ? 1.f : time(random));
+    }
+
+    for (auto level : Levels()) {
+	Mat4Kernels::SetSimdLevel(level);
+	for (uint32_t count : {61u, 8u, 5u, 1u}) {
+	    std::vector<Quat> nlerps(count), slerps(count);
+	    NlerpBatch(a.data(), b.data(), t.data(), nlerps.data(), count);
+	    SlerpBatch(a.data(), b.data(), t.data(), slerps.data(), count);
+	    for (uint32_t i = 0; i < count; i++) {
+		CHECK(Difference(Nlerp(a[i], b[i], t[i]), nlerps[i]) < 1e-5f);
+		CHECK(Difference(Slerp(a[i], b[i], t[i]), slerps[i]) < 1e-5f);
+	    }
+	}
+    }
+    Mat4Kernels::SetSimdLevel(SimdLevel::AVX2);
+}
@@ -0,0 +1,45 @@
+#include <ECS/CommonComponent.hpp>
+#include <ECS/ECS.hpp>
+#include <Tests/Check.hpp>
+#include <sstream>
+
+static Scene::Entities RoundTrip(const Scene::Entities& entities) {
+    std::ostringstream oss(std::ios::binary);
+    SerializerSystem serializer;
+    serializer.SetOStream(oss);
+    serializer.Serialize<Scene::Entities>(entities);
+
+    Scene::Entities loaded;
+    std::istringstream iss(oss.str(), std::ios::binary);
+    serializer.SetIStream(iss);
+    serializer.Deserialize<Scene::Entities>(loaded);
+    return loaded;
+}
+
+DUNIYA_TEST(NullEntitiesStayNull) {
+    Scene::Entities entities(3);
+    entities[0].reset(new Scene::IComponentArray);
+    entities[0]->Emplace<Transform>(ComponentTypes::TRANSFORM)->pos =
+	Vect3(1.f, 2.f, 3.f);
+    entities[2].reset(new Scene::IComponentArray);
+
+    auto loaded = RoundTrip(entities);
+    CHECK(loaded.size() == 3);
+    CHECK(loaded[0] != nullptr);
+    auto pos = loaded[0]->Get<Transform>(ComponentTypes::TRANSFORM)->pos;
+    CHECK(pos.x == 1.f && pos.y == 2.f && pos.z == 3.f);
+    CHECK(loaded[1] == nullptr);
+    CHECK(loaded[2] != nullptr);
+    CHECK(loaded[2]->components.empty());
+}
+
+DUNIYA_TEST(NullEntitiesAcrossChunks) {
+    Scene::Entities entities(SerializerSystem::entitiesPerChunk * 2 + 1);
+    for (uint32_t i = 0; i < entities.size(); i += 2)
+	entities[i].reset(new Scene::IComponentArray);
+
+    auto loaded = RoundTrip(entities);
+    CHECK(loaded.size() == entities.size());
+    for (uint32_t i = 0; i < loaded.size(); i++)
+	CHECK((loaded[i] == nullptr) == (i % 2 == 1));
+}
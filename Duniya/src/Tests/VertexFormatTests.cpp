@@ -0,0 +1,97 @@
+#include <Graphics/VertexFormat.hpp>
+#include <Tests/Check.hpp>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+static std::vector<Vertex> RoundTrip(const std::vector<Vertex>& vertices,
+				     VertexFormat format) {
+    Mesh mesh = {};
+    std::vector<uint8_t> encoded(GetVertexSize(format) * vertices.size());
+    EncodeVertices(vertices.data(), vertices.size(), format, mesh,
+		   encoded.data());
+    std::vector<Vertex> decoded(vertices.size());
+    DecodeVertices(encoded.data(), decoded.size(), mesh, decoded.data());
+    return decoded;
+}
+
+static bool SameBits(float a, float b) { return memcmp(&a, &b, 4) == 0; }
+
+DUNIYA_TEST(HalfUvsRoundTripExactly) {
+    // Every finite half, denormals and both zeros included, comes back bit
+    // for bit
+    std::vector<float> halves;
+    for (uint32_t bits = 0; bits < 0x10000; bits++) {
+	uint32_t exponent = (bits >> 10) & 0x1f, mantissa = bits & 0x3ff;
+	if (exponent == 31) continue;
+	float value = exponent == 0 ? std::ldexp((float)mantissa, -24)
+				    : std::ldexp((float)(mantissa | 0x400),
+						 (int32_t)exponent - 25);
+	halves.push_back(bits & 0x8000 ? -value : value);
+    }
+    std::vector<Vertex> vertices((halves.size() + 1) / 2);
+    for (size_t i = 0; i < halves.size(); i++) {
+	auto& uv = vertices[i / 2].texCord;
+	(i % 2 ? uv.y : uv.x) = halves[i];
+    }
+    auto decoded = RoundTrip(vertices, VertexFormat::COMPACT);
+    for (size_t i = 0; i < vertices.size(); i++) {
+	CHECK(SameBits(vertices[i].texCord.x, decoded[i].texCord.x));
+	CHECK(SameBits(vertices[i].texCord.y, decoded[i].texCord.y));
+    }
+}
+
+DUNIYA_TEST(HalfUvsRoundToNearest) {
+    std::mt19937 random(19);
+    std::uniform_real_distribution<float> value(-2048.f, 2048.f);
+    std::vector<Vertex> vertices(2000);
+    for (auto& vertex : vertices)
+	vertex.texCord = Vect2(value(random), value(random) * 1e-6f);
+    auto decoded = RoundTrip(vertices, VertexFormat::COMPACT);
+    for (size_t i = 0; i < vertices.size(); i++) {
+	// Half a step of an 11 bit significand, the fixed step of the
+	// denormals below 2^-14
+	float u = vertices[i].texCord.x, v = vertices[i].texCord.y;
+	CHECK(fabsf(decoded[i].texCord.x - u) <= fabsf(u) * 0x1p-11f);
+	CHECK(fabsf(decoded[i].texCord.y - v) <=
+	      std::max(fabsf(v) * 0x1p-11f, 0x1p-25f));
+    }
+}
+
+DUNIYA_TEST(OctahedralNormalsRoundTrip) {
+    const float diagonal = 1.f / sqrtf(3.f);
+    // The poles with both zeros, the axes around the fold and corners of
+    // the lower half, where the square is folded
+    std::vector<Vect3> normals = {Vect3(0.f, 0.f, 1.f),
+				  Vect3(0.f, 0.f, -1.f),
+				  Vect3(-0.f, -0.f, 1.f),
+				  Vect3(-0.f, -0.f, -1.f),
+				  Vect3(1.f, 0.f, 0.f),
+				  Vect3(-1.f, 0.f, 0.f),
+				  Vect3(0.f, 1.f, -0.f),
+				  Vect3(0.f, -1.f, -0.f),
+				  Vect3(diagonal, diagonal, -diagonal),
+				  Vect3(-diagonal, -diagonal, -diagonal)};
+    std::mt19937 random(23);
+    std::normal_distribution<float> gaussian;
+    for (uint32_t i = 0; i < 2000; i++) {
+	Vect3 normal(gaussian(random), gaussian(random), gaussian(random));
+	float length = sqrtf(normal.x * normal.x + normal.y * normal.y +
+			     normal.z * normal.z);
+	normals.push_back(normal / length);
+    }
+    std::vector<Vertex> vertices(normals.size());
+    for (size_t i = 0; i < normals.size(); i++)
+	vertices[i].aNormal = normals[i];
+    auto decoded = RoundTrip(vertices, VertexFormat::COMPACT_NO_UV);
+    for (size_t i = 0; i < normals.size(); i++) {
+	auto& normal = decoded[i].aNormal;
+	// snorm16 on the folded square is good to about 1e-4
+	CHECK(fabsf(normal.x - normals[i].x) < 2e-4f);
+	CHECK(fabsf(normal.y - normals[i].y) < 2e-4f);
+	CHECK(fabsf(normal.z - normals[i].z) < 2e-4f);
+    }
+    // The poles land on them exactly
+    CHECK(decoded[0].aNormal.z == 1.f && decoded[1].aNormal.z == -1.f);
+    CHECK(decoded[3].aNormal.z == -1.f);
+}
@@ -289,6 +289,7 @@ int32_t TexturePacker::PackFont(std::string fontFile, FontDict& dict,
     dict.texture.width = width;
     dict.texture.format = Texture::Format::R;
     dict.texture.channels = 1;
+    dict.texture.colorSpace = Texture::LINEAR;
     dict.texture.data = scene->resourceBank->Push_Back(data, width * height);
     // uint32_t entity =  scene->Push();
     // auto fontDict = scene->GetEntity(entity)->Emplace<FontDict>(0);
@@ -0,0 +1,45 @@
+#include "UploadQueue.hpp"
+
+#include <chrono>
+
+UploadQueue* UploadQueue::singleton = nullptr;
+
+// Job threads reach the queue first, only one of them may create it
+static std::once_flag singletonInit;
+
+UploadQueue* UploadQueue::init() {
+    std::call_once(singletonInit,
+		   []() { UploadQueue::singleton = new UploadQueue(); });
+    return singleton;
+}
+
+UploadQueue* UploadQueue::GetSingleton() { return init(); }
+
+void UploadQueue::Push(Upload upload) {
+    std::unique_lock<std::mutex> lock(uploadsMutex);
+    uploads.push_back(std::move(upload));
+}
+
+uint32_t UploadQueue::Drain(float budgetMs) {
+    auto start = std::chrono::steady_clock::now();
+    while (true) {
+	Upload upload;
+	{
+	    std::unique_lock<std::mutex> lock(uploadsMutex);
+	    if (uploads.empty()) return 0;
+	    upload = std::move(uploads.front());
+	    uploads.pop_front();
+	}
+	// Uploads may push more uploads, the lock isn't held while they run
+	upload();
+	std::chrono::duration<float, std::milli> elapsed =
+	    std::chrono::steady_clock::now() - start;
+	if (elapsed.count() >= budgetMs) break;
+    }
+    return GetPendingCount();
+}
+
+uint32_t UploadQueue::GetPendingCount() {
+    std::unique_lock<std::mutex> lock(uploadsMutex);
+    return uploads.size();
+}
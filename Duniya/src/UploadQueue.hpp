@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+// Work that has to happen on the main thread, like GPU uploads or handing
+// loaded assets to the scene. Any thread may push, the main thread drains a
+// frame's budget worth of it so loading never stalls a frame for long.
+class UploadQueue {
+   public:
+    using Upload = std::function<void()>;
+
+   private:
+    UploadQueue() = default;
+
+   public:
+    static UploadQueue* init();
+    static UploadQueue* GetSingleton();
+
+    void Push(Upload upload);
+    // Runs uploads until budgetMs is spent, at least one if any is queued.
+    // Returns how many are still waiting.
+    uint32_t Drain(float budgetMs);
+    uint32_t GetPendingCount();
+
+   private:
+    std::deque<Upload> uploads;
+    std::mutex uploadsMutex;
+
+   public:
+    static UploadQueue* singleton;
+};